@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+
+namespace inventory {
+
+enum class BackupFormat {
+    // A plain SQLite database, usable as it is.
+    kDatabase,
+    // kBackupMagic and the database's byte size as a LEB128 varint, then the
+    // database in blocks of kBackupBlockSize bytes (the last may be shorter):
+    // each is its size and stored size as varints, the CRC-32 of its bytes as
+    // 4 little-endian bytes, then the stored bytes, LZ77-compressed unless the
+    // stored size equals the size. The CRC-32 of the whole database closes
+    // the file.
+    kCompressed,
+};
+
+constexpr char kBackupMagic[8] = {'I', 'N', 'V', 'B', 'A', 'K', '1', '\n'};
+constexpr size_t kBackupBlockSize = 1 << 20;
+
+struct BackupOptions {
+    BackupFormat format = BackupFormat::kCompressed;
+    // Pages copied per step, and the pause after each step and each block
+    // compressed, so that the backup leaves the disk and the CPU to the
+    // window's reads and commits.
+    int pages_per_step = 256;
+    int pause_ms = 50;
+};
+
+struct BackupReport {
+    uint64_t pages = 0;
+    // The database's size, and what was written for it.
+    uint64_t bytes = 0;
+    uint64_t written_bytes = 0;
+    double seconds = 0.0;
+    bool cancelled = false;
+    std::string fatal_error;
+
+    double MegabytesPerSecond() const { return seconds > 0.0 ? bytes / seconds / 1e6 : 0.0; }
+};
+
+// Called between steps with the pages copied so far and the total, and while
+// compressing with both at the total; returning false cancels the backup.
+using BackupProgress = std::function<bool(int copied, int total)>;
+
+// Copies the database at |source_path| to |target_path| while others keep
+// reading and writing it. The copy runs sqlite3_backup_step a few pages at a
+// time inside one read transaction, so it is a consistent snapshot that
+// commits made meanwhile never restart; in WAL mode it blocks no writer, but
+// checkpoints wait for it. |target_path| is only replaced once the backup is
+// complete.
+bool BackupDatabase(const std::string& source_path, const std::string& target_path,
+                    const BackupOptions& options, BackupReport& report,
+                    const BackupProgress& progress = nullptr);
+
+struct BackupInfo {
+    BackupFormat format = BackupFormat::kDatabase;
+    uint64_t bytes = 0;
+    uint64_t stored_bytes = 0;
+    int page_size = 0;
+    uint64_t pages = 0;
+};
+
+// Checks a backup of either format: every checksum of a compressed one, then
+// SQLite's quick_check of the database it holds.
+bool VerifyBackup(const std::string& backup_path, BackupInfo& info, std::string& error);
+
+// Verifies the backup, then replaces the contents of the database at
+// |database_path| with it through the backup API, in one transaction. Safe
+// while others have the database open: they see the restored rows from
+// their next transaction on.
+bool RestoreBackup(const std::string& backup_path, const std::string& database_path,
+                   BackupReport& report);
+
+}  // namespace inventory
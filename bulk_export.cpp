@@ -0,0 +1,305 @@
+#include "bulk_export.h"
+
+#include <charconv>
+#include <chrono>
+#include <cstring>
+#include <string_view>
+#include <vector>
+
+#include "change_journal.h"
+#include "item_pager.h"
+
+namespace inventory {
+namespace {
+
+// Columns of kItemSelectColumns.
+constexpr int kIdColumn = 0;
+constexpr int kQuantityColumn = 5;
+constexpr int kTextColumns[] = {1, 2, 3, 4, 6};
+constexpr const char* kColumnNames[] = {"name", "part_number", "nsn", "serial_number",
+                                        "created_at"};
+constexpr size_t kMinBuffer = 64 * 1024;
+
+constexpr char kCsvHeader[] = "id,name,part_number,nsn,serial_number,quantity,created_at\n";
+
+class OutputBuffer {
+public:
+    OutputBuffer(std::FILE* out, size_t capacity)
+        : out_(out), buffer_(capacity < kMinBuffer ? kMinBuffer : capacity) {}
+
+    void Append(const char* data, size_t size) {
+        if (size > buffer_.size() - used_) {
+            Flush();
+            if (size > buffer_.size()) {
+                Write(data, size);
+                return;
+            }
+        }
+        std::memcpy(buffer_.data() + used_, data, size);
+        used_ += size;
+    }
+
+    void Append(std::string_view text) { Append(text.data(), text.size()); }
+
+    void Put(char c) {
+        if (used_ == buffer_.size()) {
+            Flush();
+        }
+        buffer_[used_++] = c;
+    }
+
+    void PutInteger(long long value) {
+        char digits[24];
+        auto result = std::to_chars(digits, digits + sizeof(digits), value);
+        Append(digits, static_cast<size_t>(result.ptr - digits));
+    }
+
+    void PutVarint(uint64_t value) {
+        while (value >= 0x80) {
+            Put(static_cast<char>(value | 0x80));
+            value >>= 7;
+        }
+        Put(static_cast<char>(value));
+    }
+
+    void Flush() {
+        Write(buffer_.data(), used_);
+        used_ = 0;
+    }
+
+    bool failed() const { return failed_; }
+    uint64_t bytes() const { return written_ + used_; }
+
+private:
+    void Write(const char* data, size_t size) {
+        if (!failed_ && size > 0 && std::fwrite(data, 1, size, out_) != size) {
+            failed_ = true;
+        }
+        written_ += size;
+    }
+
+    std::FILE* out_;
+    std::vector<char> buffer_;
+    size_t used_ = 0;
+    uint64_t written_ = 0;
+    bool failed_ = false;
+};
+
+std::string_view ColumnView(sqlite3_stmt* statement, int column) {
+    const unsigned char* text = sqlite3_column_text(statement, column);
+    return std::string_view(text ? reinterpret_cast<const char*>(text) : "",
+                            static_cast<size_t>(sqlite3_column_bytes(statement, column)));
+}
+
+// Quoted when it holds a separator, a quote or a line break, or when edge
+// whitespace would otherwise be trimmed on import.
+void WriteCsvField(OutputBuffer& out, std::string_view value) {
+    bool quote = !value.empty() && (value.front() == ' ' || value.front() == '\t' ||
+                                    value.back() == ' ' || value.back() == '\t');
+    for (char c : value) {
+        if (c == ',' || c == '"' || c == '\n' || c == '\r') {
+            quote = true;
+            break;
+        }
+    }
+    if (!quote) {
+        out.Append(value);
+        return;
+    }
+    out.Put('"');
+    size_t start = 0;
+    for (size_t i = 0; i < value.size(); ++i) {
+        if (value[i] == '"') {
+            out.Append(value.substr(start, i + 1 - start));
+            out.Put('"');
+            start = i + 1;
+        }
+    }
+    out.Append(value.substr(start));
+    out.Put('"');
+}
+
+void WriteJsonString(OutputBuffer& out, std::string_view value) {
+    static const char kHex[] = "0123456789abcdef";
+    out.Put('"');
+    size_t start = 0;
+    for (size_t i = 0; i < value.size(); ++i) {
+        const auto c = static_cast<unsigned char>(value[i]);
+        if (c >= 0x20 && c != '"' && c != '\\') {
+            continue;
+        }
+        out.Append(value.substr(start, i - start));
+        start = i + 1;
+        out.Put('\\');
+        switch (c) {
+            case '"':
+            case '\\':
+                out.Put(static_cast<char>(c));
+                break;
+            case '\n':
+                out.Put('n');
+                break;
+            case '\r':
+                out.Put('r');
+                break;
+            case '\t':
+                out.Put('t');
+                break;
+            default:
+                out.Append("u00", 3);
+                out.Put(kHex[c >> 4]);
+                out.Put(kHex[c & 0xF]);
+                break;
+        }
+    }
+    out.Append(value.substr(start));
+    out.Put('"');
+}
+
+void WriteCsvRow(OutputBuffer& out, sqlite3_stmt* statement) {
+    out.PutInteger(sqlite3_column_int64(statement, kIdColumn));
+    for (int field = 0; field < 4; ++field) {
+        out.Put(',');
+        WriteCsvField(out, ColumnView(statement, kTextColumns[field]));
+    }
+    out.Put(',');
+    out.PutInteger(sqlite3_column_int64(statement, kQuantityColumn));
+    out.Put(',');
+    WriteCsvField(out, ColumnView(statement, kTextColumns[4]));
+    out.Put('\n');
+}
+
+void WriteJsonRow(OutputBuffer& out, sqlite3_stmt* statement) {
+    out.Append("{\"id\":");
+    out.PutInteger(sqlite3_column_int64(statement, kIdColumn));
+    for (int field = 0; field < 5; ++field) {
+        out.Append(",\"");
+        out.Append(kColumnNames[field]);
+        out.Append("\":");
+        WriteJsonString(out, ColumnView(statement, kTextColumns[field]));
+        if (field == 3) {
+            out.Append(",\"quantity\":");
+            out.PutInteger(sqlite3_column_int64(statement, kQuantityColumn));
+        }
+    }
+    out.Append("}\n");
+}
+
+void WriteBinaryRow(OutputBuffer& out, sqlite3_stmt* statement) {
+    out.PutVarint(static_cast<uint64_t>(sqlite3_column_int64(statement, kIdColumn)));
+    const sqlite3_int64 quantity = sqlite3_column_int64(statement, kQuantityColumn);
+    out.PutVarint((static_cast<uint64_t>(quantity) << 1) ^ static_cast<uint64_t>(quantity >> 63));
+    for (int column : kTextColumns) {
+        std::string_view value = ColumnView(statement, column);
+        out.PutVarint(value.size());
+        out.Append(value);
+    }
+}
+
+// The filter applied in memory, to rows that are not in the items table.
+class RowFilter {
+public:
+    explicit RowFilter(const SearchFilter& filter)
+        : filter_(filter),
+          terms_{{kFilterName, filter.name},
+                 {kFilterPartNumber, filter.part_number},
+                 {kFilterNsn, filter.nsn},
+                 {kFilterSerialNumber, filter.serial_number}} {}
+
+    bool Matches(sqlite3_stmt* statement) const {
+        if (filter_.has_quantity &&
+            sqlite3_column_int64(statement, kQuantityColumn) != filter_.quantity) {
+            return false;
+        }
+        for (int field = 0; field < 4; ++field) {
+            if (!terms_[field].Matches(ColumnView(statement, kTextColumns[field]))) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+private:
+    const SearchFilter& filter_;
+    TermMatcher terms_[4];
+};
+
+}  // namespace
+
+bool ExportItems(Database& database, const SearchFilter& filter, std::FILE* out,
+                 const ExportOptions& options, ExportReport& report) {
+    report = ExportReport();
+    const auto start = std::chrono::steady_clock::now();
+
+    const bool as_of = !options.as_of.empty();
+    Statement statement;
+    if (as_of) {
+        // The view is rebuilt by several statements, which must all see the
+        // same snapshot.
+        if (!database.Execute("SAVEPOINT export_as_of")) {
+            report.fatal_error = database.last_error();
+            return false;
+        }
+        statement = PrepareItemsAsOf(database, options.as_of, report.fatal_error);
+        if (!statement) {
+            database.Execute("RELEASE export_as_of");
+            return false;
+        }
+    } else {
+        // The whole result as one page: a single statement stepped to the end.
+        statement = PreparePage(database, filter, PageDirection::kOlder, false);
+        if (!statement) {
+            report.fatal_error = sqlite3_errmsg(database.handle());
+            return false;
+        }
+        BindPage(statement.get(), filter, nullptr, -1, 0);
+    }
+    const RowFilter row_filter(filter);
+
+    OutputBuffer buffer(out, options.buffer_size);
+    if (options.format == ExportFormat::kCsv) {
+        buffer.Append(kCsvHeader, sizeof(kCsvHeader) - 1);
+    } else if (options.format == ExportFormat::kBinary) {
+        buffer.Append(kExportMagic, sizeof(kExportMagic));
+    }
+    int result = SQLITE_DONE;
+    while (!buffer.failed() && (result = sqlite3_step(statement.get())) == SQLITE_ROW) {
+        if (as_of && !row_filter.Matches(statement.get())) {
+            continue;
+        }
+        switch (options.format) {
+            case ExportFormat::kCsv:
+                WriteCsvRow(buffer, statement.get());
+                break;
+            case ExportFormat::kJsonLines:
+                WriteJsonRow(buffer, statement.get());
+                break;
+            case ExportFormat::kBinary:
+                WriteBinaryRow(buffer, statement.get());
+                break;
+        }
+        ++report.rows;
+    }
+    const std::string read_error = result != SQLITE_DONE ? sqlite3_errmsg(database.handle()) : "";
+    buffer.Flush();
+    const bool written = !buffer.failed() && std::fflush(out) == 0;
+    if (as_of) {
+        statement = Statement();
+        database.Execute("RELEASE export_as_of");
+    }
+
+    report.bytes = buffer.bytes();
+    report.seconds =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (!written) {
+        report.fatal_error = "cannot write the output";
+        return false;
+    }
+    if (result != SQLITE_DONE) {
+        report.fatal_error = read_error;
+        return false;
+    }
+    return true;
+}
+
+}  // namespace inventory
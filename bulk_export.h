@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+#include "database.h"
+#include "search_filter.h"
+
+namespace inventory {
+
+enum class ExportFormat {
+    // A header line, then one record per row; fields holding a comma, quote
+    // or line break, or with edge whitespace, are quoted.
+    kCsv,
+    // One JSON object per line.
+    kJsonLines,
+    // kExportMagic, then per row: id and zigzag quantity as LEB128 varints,
+    // then name, part_number, nsn, serial_number and created_at, each as a
+    // varint byte length followed by the UTF-8 bytes. Rows run to the end of
+    // the file.
+    kBinary,
+};
+
+constexpr char kExportMagic[8] = {'I', 'N', 'V', 'E', 'X', 'P', '1', '\n'};
+
+struct ExportOptions {
+    ExportFormat format = ExportFormat::kCsv;
+    // Output is assembled here and written in chunks of this size.
+    size_t buffer_size = 1 << 20;
+    // When set, the table as it was at this time, as PrepareItemsAsOf rebuilds
+    // it; the filter is then applied to each rebuilt row.
+    std::string as_of;
+};
+
+struct ExportReport {
+    uint64_t rows = 0;
+    uint64_t bytes = 0;
+    double seconds = 0.0;
+    std::string fatal_error;
+
+    double MegabytesPerSecond() const { return seconds > 0.0 ? bytes / seconds / 1e6 : 0.0; }
+};
+
+// Streams the rows matching |filter| to |out| in the window's order, newest
+// first. Cells are copied from SQLite's buffers into one fixed-size output
+// buffer, so memory stays flat however large the table is. The export reads
+// one snapshot of the database from start to finish.
+bool ExportItems(Database& database, const SearchFilter& filter, std::FILE* out,
+                 const ExportOptions& options, ExportReport& report);
+
+}  // namespace inventory
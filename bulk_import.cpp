@@ -0,0 +1,528 @@
+#include "bulk_import.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "item_keys.h"
+#include "items.h"
+
+namespace inventory {
+namespace {
+
+enum Column { kName, kPartNumber, kNsn, kSerialNumber, kQuantity, kColumnCount };
+
+constexpr const char* kColumnNames[kColumnCount] = {"name", "part_number", "nsn",
+                                                     "serial_number", "quantity"};
+constexpr int kMaxFields = 64;
+
+// Checking a row by index probes alone costs about what reading this many
+// stored rows into a DuplicateDetector does, so the detector is only filled
+// for manifests of more than a sixteenth of the table.
+constexpr sqlite3_int64 kProbeCostInRows = 16;
+// Manifest lines are about this long, and few are shorter than the minimum;
+// the filters get room for that many.
+constexpr size_t kTypicalLineBytes = 100;
+constexpr size_t kMinLineBytes = 24;
+
+// stock_ledger_insert records each row's quantity as its opening movement in
+// the same statement (see schema.cpp).
+constexpr char kInsertSql[] =
+    "INSERT INTO items (name, part_number, nsn, serial_number, quantity,"
+    " nsn_key, part_key, serial_key) VALUES (?, ?, ?, ?, ?, ?, ?, ?)";
+
+bool IsSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\v' || c == '\f' || c == '\r';
+}
+
+bool EqualsIgnoreCase(std::string_view a, std::string_view b) {
+    if (a.size() != b.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < a.size(); ++i) {
+        char x = a[i] >= 'A' && a[i] <= 'Z' ? static_cast<char>(a[i] - 'A' + 'a') : a[i];
+        if (x != b[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+std::string_view Trim(std::string_view text) {
+    while (!text.empty() && IsSpace(text.front())) {
+        text.remove_prefix(1);
+    }
+    while (!text.empty() && IsSpace(text.back())) {
+        text.remove_suffix(1);
+    }
+    return text;
+}
+
+// Splits [begin, end) on |delimiter|. Quoted fields are unescaped in place,
+// so the views point into the line itself. Returns the number of fields or
+// -1 for a malformed quoted field.
+int SplitFields(char* begin, char* end, char delimiter, std::string_view* fields) {
+    int count = 0;
+    char* p = begin;
+    while (true) {
+        std::string_view field;
+        if (p < end && *p == '"') {
+            char* start = p;
+            char* out = p;
+            ++p;
+            while (true) {
+                if (p == end) {
+                    return -1;
+                }
+                if (*p == '"') {
+                    if (p + 1 < end && p[1] == '"') {
+                        *out++ = '"';
+                        p += 2;
+                        continue;
+                    }
+                    ++p;
+                    break;
+                }
+                *out++ = *p++;
+            }
+            if (p < end && *p != delimiter) {
+                return -1;
+            }
+            field = std::string_view(start, static_cast<size_t>(out - start));
+        } else {
+            char* start = p;
+            while (p < end && *p != delimiter) {
+                ++p;
+            }
+            field = std::string_view(start, static_cast<size_t>(p - start));
+        }
+        if (count < kMaxFields) {
+            fields[count] = field;
+        }
+        ++count;
+        if (p == end) {
+            return count;
+        }
+        ++p;
+    }
+}
+
+// Finds where a record ends: at a line break outside quotes. As in
+// SplitFields, a quote opens a quoted field only at the start of a field.
+// The state carries over from one read buffer to the next.
+class RecordScanner {
+public:
+    explicit RecordScanner(char delimiter) : delimiter_(delimiter) {}
+
+    // Scans on from |p|; returns the '\n' that ends the record, or null when
+    // the record goes on past |end|.
+    char* Find(char* p, char* end);
+    // Line breaks inside quoted fields of the record so far.
+    uint64_t line_breaks() const { return line_breaks_; }
+    void Reset() {
+        state_ = kFieldStart;
+        line_breaks_ = 0;
+    }
+
+private:
+    enum State { kFieldStart, kUnquoted, kQuoted, kQuoteInQuoted };
+
+    char delimiter_;
+    State state_ = kFieldStart;
+    uint64_t line_breaks_ = 0;
+};
+
+char* RecordScanner::Find(char* p, char* end) {
+    if (state_ == kFieldStart || state_ == kUnquoted) {
+        // Most records have no quotes at all.
+        auto* newline = static_cast<char*>(std::memchr(p, '\n', static_cast<size_t>(end - p)));
+        char* stop = newline ? newline : end;
+        if (!std::memchr(p, '"', static_cast<size_t>(stop - p))) {
+            if (!newline && p < end) {
+                state_ = end[-1] == delimiter_ ? kFieldStart : kUnquoted;
+            }
+            return newline;
+        }
+    }
+    for (; p < end; ++p) {
+        const char c = *p;
+        switch (state_) {
+            case kQuoted:
+                if (c == '"') {
+                    state_ = kQuoteInQuoted;
+                } else if (c == '\n') {
+                    ++line_breaks_;
+                }
+                continue;
+            case kQuoteInQuoted:
+            case kFieldStart:
+                if (c == '"') {
+                    // An escaped quote, or the opening one.
+                    state_ = kQuoted;
+                    continue;
+                }
+                break;
+            case kUnquoted:
+                break;
+        }
+        if (c == '\n') {
+            return p;
+        }
+        state_ = c == delimiter_ ? kFieldStart : kUnquoted;
+    }
+    return nullptr;
+}
+
+class ManifestLoader {
+public:
+    ManifestLoader(Database& database, const ImportOptions& options, ImportReport& report,
+                   const ImportErrorHandler& on_error, const ImportDuplicateHandler& on_duplicate)
+        : database_(database),
+          options_(options),
+          report_(report),
+          on_error_(on_error),
+          on_duplicate_(on_duplicate) {}
+
+    bool Run(std::FILE* file, char delimiter, size_t bytes);
+
+private:
+    bool ProcessRecord(char* begin, char* end, uint64_t line_breaks);
+    bool ReadHeader(const std::string_view* fields, int count, bool& is_header);
+    bool InsertRow(const std::string_view* fields);
+    bool PrepareDuplicates(size_t bytes);
+    bool CheckDuplicate(const std::string_view* fields, bool& skip);
+    bool BeginBatch();
+    bool CommitBatch();
+    void Reject(const char* message);
+    bool Fail(const char* message);
+
+    Database& database_;
+    const ImportOptions& options_;
+    ImportReport& report_;
+    const ImportErrorHandler& on_error_;
+    const ImportDuplicateHandler& on_duplicate_;
+    DuplicateDetector duplicates_;
+    Statement insert_;
+    char delimiter_ = ',';
+    // The line the current record starts on, and the next one does.
+    uint64_t line_number_ = 0;
+    uint64_t next_line_ = 1;
+    size_t batch_rows_ = 0;
+    bool in_transaction_ = false;
+    bool seen_first_line_ = false;
+    int columns_[kColumnCount] = {kName, kPartNumber, kNsn, kSerialNumber, kQuantity};
+};
+
+void ManifestLoader::Reject(const char* message) {
+    ++report_.failed;
+    if (on_error_) {
+        on_error_(ImportError{line_number_, message});
+    }
+}
+
+bool ManifestLoader::Fail(const char* message) {
+    report_.fatal_error = message;
+    const char* detail = sqlite3_errmsg(database_.handle());
+    if (detail && *detail) {
+        report_.fatal_error += ": ";
+        report_.fatal_error += detail;
+    }
+    return false;
+}
+
+bool ManifestLoader::BeginBatch() {
+    if (!database_.Execute("BEGIN IMMEDIATE")) {
+        return Fail("could not start a transaction");
+    }
+    in_transaction_ = true;
+    batch_rows_ = 0;
+    return true;
+}
+
+bool ManifestLoader::CommitBatch() {
+    if (!in_transaction_) {
+        return true;
+    }
+    in_transaction_ = false;
+    if (!database_.Execute("COMMIT")) {
+        database_.Execute("ROLLBACK");
+        return Fail("could not commit a batch");
+    }
+    ++report_.batches;
+    return true;
+}
+
+bool ManifestLoader::ReadHeader(const std::string_view* fields, int count, bool& is_header) {
+    int found[kColumnCount] = {-1, -1, -1, -1, -1};
+    is_header = false;
+    for (int i = 0; i < count && i < kMaxFields; ++i) {
+        std::string_view field = Trim(fields[i]);
+        for (int column = 0; column < kColumnCount; ++column) {
+            if (EqualsIgnoreCase(field, kColumnNames[column])) {
+                found[column] = i;
+                is_header = true;
+            }
+        }
+    }
+    if (!is_header) {
+        return true;
+    }
+    for (int column = 0; column < kColumnCount; ++column) {
+        if (found[column] < 0) {
+            report_.fatal_error = "header is missing column ";
+            report_.fatal_error += kColumnNames[column];
+            return false;
+        }
+        columns_[column] = found[column];
+    }
+    return true;
+}
+
+bool ManifestLoader::PrepareDuplicates(size_t bytes) {
+    Statement count = database_.Prepare("SELECT COUNT(*) FROM items");
+    if (!count || sqlite3_step(count.get()) != SQLITE_ROW) {
+        return false;
+    }
+    const sqlite3_int64 rows = sqlite3_column_int64(count.get(), 0);
+    count.Release();
+    const auto lines = static_cast<sqlite3_int64>(bytes / kTypicalLineBytes);
+    return lines * kProbeCostInRows < rows || duplicates_.Build(database_, bytes / kMinLineBytes);
+}
+
+bool ManifestLoader::CheckDuplicate(const std::string_view* fields, bool& skip) {
+    skip = false;
+    DuplicateMatch match;
+    if (!duplicates_.Check(database_, fields[columns_[kPartNumber]],
+                           fields[columns_[kSerialNumber]], match)) {
+        database_.Execute("ROLLBACK");
+        in_transaction_ = false;
+        return Fail("duplicate check failed");
+    }
+    if (match.kind == DuplicateKind::kNone) {
+        return true;
+    }
+    skip = options_.duplicates == ImportDuplicates::kSkip &&
+           match.kind == DuplicateKind::kPartAndSerial;
+    ++report_.duplicates;
+    report_.skipped += skip;
+    if (on_duplicate_) {
+        on_duplicate_(ImportDuplicate{line_number_, match.kind, match.id, skip});
+    }
+    return true;
+}
+
+bool ManifestLoader::InsertRow(const std::string_view* fields) {
+    int quantity = 0;
+    if (!ParseQuantity(fields[columns_[kQuantity]], quantity)) {
+        Reject("quantity must be a whole number");
+        return true;
+    }
+    if (!in_transaction_ && !BeginBatch()) {
+        return false;
+    }
+    // Inside the batch, so the rows inserted before it count too.
+    if (options_.duplicates != ImportDuplicates::kIgnore) {
+        bool skip = false;
+        if (!CheckDuplicate(fields, skip)) {
+            return false;
+        }
+        if (skip) {
+            return true;
+        }
+    }
+
+    sqlite3_stmt* statement = insert_.get();
+    for (int column = kName; column <= kSerialNumber; ++column) {
+        std::string_view value = fields[columns_[column]];
+        sqlite3_bind_text(statement, column + 1, value.data(), static_cast<int>(value.size()),
+                          SQLITE_STATIC);
+    }
+    sqlite3_bind_int(statement, 5, quantity);
+    BindItemKeys(statement, 6, fields[columns_[kNsn]], fields[columns_[kPartNumber]],
+                 fields[columns_[kSerialNumber]]);
+    int result = sqlite3_step(statement);
+    sqlite3_reset(statement);
+    if (result != SQLITE_DONE) {
+        if ((result & 0xff) == SQLITE_CONSTRAINT) {
+            Reject("rejected by the database");
+            return true;
+        }
+        database_.Execute("ROLLBACK");
+        in_transaction_ = false;
+        return Fail("insert failed");
+    }
+    ++report_.inserted;
+    duplicates_.Add(fields[columns_[kPartNumber]], fields[columns_[kSerialNumber]]);
+    if (++batch_rows_ >= options_.batch_size) {
+        return CommitBatch();
+    }
+    return true;
+}
+
+bool ManifestLoader::ProcessRecord(char* begin, char* end, uint64_t line_breaks) {
+    line_number_ = next_line_;
+    next_line_ += line_breaks + 1;
+    if (end > begin && end[-1] == '\r') {
+        --end;
+    }
+    if (Trim(std::string_view(begin, static_cast<size_t>(end - begin))).empty()) {
+        return true;
+    }
+
+    std::string_view fields[kMaxFields];
+    int count = SplitFields(begin, end, delimiter_, fields);
+    if (!seen_first_line_) {
+        seen_first_line_ = true;
+        bool is_header = false;
+        if (count > 0 && !ReadHeader(fields, count, is_header)) {
+            return false;
+        }
+        if (is_header) {
+            return true;
+        }
+    }
+
+    ++report_.lines;
+    if (count < 0) {
+        Reject("unterminated or malformed quoted field");
+        return true;
+    }
+    for (int column = 0; column < kColumnCount; ++column) {
+        if (columns_[column] >= count || columns_[column] >= kMaxFields ||
+            (column != kQuantity && fields[columns_[column]].empty())) {
+            Reject("missing field");
+            return true;
+        }
+    }
+    return InsertRow(fields);
+}
+
+bool ManifestLoader::Run(std::FILE* file, char delimiter, size_t bytes) {
+    delimiter_ = delimiter;
+    insert_ = database_.Prepare(kInsertSql);
+    if (!insert_) {
+        return Fail("could not prepare the insert");
+    }
+    if (options_.duplicates != ImportDuplicates::kIgnore && !PrepareDuplicates(bytes)) {
+        return Fail("could not read the stored serial numbers");
+    }
+
+    std::vector<char> buffer(options_.buffer_size < 4096 ? 4096 : options_.buffer_size);
+    RecordScanner scanner(delimiter);
+    size_t filled = 0;
+    // Bytes at the start of the buffer already scanned for the record's end.
+    size_t scanned = 0;
+    bool eof = false;
+    bool skipping = false;
+    while (true) {
+        if (!eof) {
+            size_t wanted = buffer.size() - filled;
+            size_t read = std::fread(buffer.data() + filled, 1, wanted, file);
+            filled += read;
+            if (read < wanted) {
+                if (std::ferror(file)) {
+                    database_.Execute("ROLLBACK");
+                    report_.fatal_error = "read error";
+                    return false;
+                }
+                eof = true;
+            }
+        }
+
+        char* p = buffer.data();
+        char* end = p + filled;
+        if (skipping) {
+            char* record_end = scanner.Find(p, end);
+            if (!record_end) {
+                filled = 0;
+                if (eof) {
+                    break;
+                }
+                continue;
+            }
+            next_line_ += scanner.line_breaks() + 1;
+            scanner.Reset();
+            p = record_end + 1;
+            skipping = false;
+        }
+        char* scan_from = p + scanned;
+        while (p < end) {
+            char* record_end = scanner.Find(scan_from, end);
+            if (!record_end) {
+                break;
+            }
+            if (!ProcessRecord(p, record_end, scanner.line_breaks())) {
+                return false;
+            }
+            scanner.Reset();
+            p = scan_from = record_end + 1;
+        }
+
+        size_t rest = static_cast<size_t>(end - p);
+        if (eof) {
+            if (rest > 0 && !ProcessRecord(p, end, scanner.line_breaks())) {
+                return false;
+            }
+            break;
+        }
+        if (rest == buffer.size()) {
+            line_number_ = next_line_;
+            ++report_.lines;
+            Reject("record is longer than the read buffer");
+            skipping = true;
+            filled = 0;
+            scanned = 0;
+            continue;
+        }
+        std::memmove(buffer.data(), p, rest);
+        filled = rest;
+        scanned = rest;
+    }
+    return CommitBatch();
+}
+
+char DetectDelimiter(const std::string& path, std::FILE* file) {
+    if (path.size() >= 4 && EqualsIgnoreCase(std::string_view(path).substr(path.size() - 4),
+                                             ".tsv")) {
+        return '\t';
+    }
+    char sample[4096];
+    size_t read = std::fread(sample, 1, sizeof(sample), file);
+    std::rewind(file);
+    const char* newline = static_cast<const char*>(std::memchr(sample, '\n', read));
+    size_t length = newline ? static_cast<size_t>(newline - sample) : read;
+    return std::memchr(sample, '\t', length) ? '\t' : ',';
+}
+
+size_t FileSize(std::FILE* file) {
+    if (std::fseek(file, 0, SEEK_END) != 0) {
+        return 0;
+    }
+    const long size = std::ftell(file);
+    std::rewind(file);
+    return size > 0 ? static_cast<size_t>(size) : 0;
+}
+
+}  // namespace
+
+bool ImportManifest(Database& database, const std::string& path, const ImportOptions& options,
+                    ImportReport& report, const ImportErrorHandler& on_error,
+                    const ImportDuplicateHandler& on_duplicate) {
+    report = ImportReport();
+    std::FILE* file = std::fopen(path.c_str(), "rb");
+    if (!file) {
+        report.fatal_error = "cannot open " + path;
+        return false;
+    }
+    auto start = std::chrono::steady_clock::now();
+    char delimiter = options.delimiter ? options.delimiter : DetectDelimiter(path, file);
+    ManifestLoader loader(database, options, report, on_error, on_duplicate);
+    bool ok = loader.Run(file, delimiter, FileSize(file));
+    std::fclose(file);
+    report.seconds =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return ok;
+}
+
+}  // namespace inventory
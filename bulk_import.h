@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+
+#include "database.h"
+#include "duplicates.h"
+
+namespace inventory {
+
+// What an import does with rows whose serial number some item already has.
+enum class ImportDuplicates {
+    // Inserts them unchecked.
+    kIgnore,
+    // Inserts them and reports them.
+    kReport,
+    // Reports them and leaves out those with the same part number too; rows
+    // sharing only the serial number are still inserted.
+    kSkip,
+};
+
+struct ImportOptions {
+    // Field separator; 0 picks tab for .tsv files or when the first line
+    // contains a tab, and comma otherwise.
+    char delimiter = 0;
+    size_t batch_size = 50000;
+    size_t buffer_size = 1 << 20;
+    // Rows are compared with the items already stored and the ones inserted
+    // before them from the same file.
+    ImportDuplicates duplicates = ImportDuplicates::kReport;
+};
+
+struct ImportError {
+    // The line the record starts on; a quoted field can span lines.
+    uint64_t line = 0;
+    const char* message = "";
+};
+
+struct ImportDuplicate {
+    uint64_t line = 0;
+    DuplicateKind kind = DuplicateKind::kNone;
+    // The oldest item with the same keys.
+    sqlite3_int64 existing_id = 0;
+    bool skipped = false;
+};
+
+struct ImportReport {
+    uint64_t lines = 0;
+    uint64_t inserted = 0;
+    uint64_t failed = 0;
+    // Duplicate rows, and those of them left out.
+    uint64_t duplicates = 0;
+    uint64_t skipped = 0;
+    uint64_t batches = 0;
+    double seconds = 0.0;
+    std::string fatal_error;
+
+    double RowsPerSecond() const { return seconds > 0.0 ? inserted / seconds : 0.0; }
+};
+
+using ImportErrorHandler = std::function<void(const ImportError&)>;
+using ImportDuplicateHandler = std::function<void(const ImportDuplicate&)>;
+
+// Streams a CSV/TSV manifest into the items table. Columns are taken from a
+// header line naming name, part_number, nsn, serial_number and quantity, or
+// in that order when there is no header. A record ends at a line break
+// outside quotes, so quoted fields can hold line breaks. Rejected records are
+// passed to |on_error| and do not stop the import; duplicates go to
+// |on_duplicate|. False is returned only when the file cannot be read or the
+// database fails, with |report.fatal_error| set.
+bool ImportManifest(Database& database, const std::string& path, const ImportOptions& options,
+                    ImportReport& report, const ImportErrorHandler& on_error,
+                    const ImportDuplicateHandler& on_duplicate = nullptr);
+
+}  // namespace inventory
@@ -0,0 +1,576 @@
+#include "change_journal.h"
+
+#include <algorithm>
+#include <climits>
+
+#include "item_keys.h"
+#include "stock_ledger.h"
+
+namespace inventory {
+namespace {
+
+constexpr int kTextFields = 4;
+
+// One item_journal row; |set| tells a stored value from a NULL.
+struct JournalValue {
+    bool set = false;
+    std::string text;
+    sqlite3_int64 number = 0;
+};
+
+struct JournalEntry {
+    sqlite3_int64 id = 0;
+    sqlite3_int64 item_id = 0;
+    int action = 0;
+    // name, part_number, nsn, serial_number.
+    JournalValue old_text[kTextFields];
+    JournalValue new_text[kTextFields];
+    JournalValue old_quantity;
+    std::string old_created_at;
+};
+
+std::string ColumnString(sqlite3_stmt* statement, int column) {
+    const unsigned char* value = sqlite3_column_text(statement, column);
+    return std::string(value ? reinterpret_cast<const char*>(value) : "",
+                       static_cast<size_t>(sqlite3_column_bytes(statement, column)));
+}
+
+JournalValue ColumnValue(sqlite3_stmt* statement, int column) {
+    JournalValue value;
+    value.set = sqlite3_column_type(statement, column) != SQLITE_NULL;
+    if (value.set) {
+        value.text = ColumnString(statement, column);
+        value.number = sqlite3_column_int64(statement, column);
+    }
+    return value;
+}
+
+void BindText(sqlite3_stmt* statement, int index, const std::string& value) {
+    sqlite3_bind_text(statement, index, value.data(), static_cast<int>(value.size()),
+                      SQLITE_STATIC);
+}
+
+// The newest journal entry and stock movement ids handed out, also inside an
+// open transaction.
+bool JournalHeads(Database& database, sqlite3_int64& entry, sqlite3_int64& movement) {
+    Statement statement = database.Prepare(
+        "SELECT name = 'item_journal', seq FROM sqlite_sequence"
+        " WHERE name IN ('item_journal', 'stock_movements')");
+    if (!statement) {
+        return false;
+    }
+    entry = 0;
+    movement = 0;
+    int step;
+    while ((step = sqlite3_step(statement.get())) == SQLITE_ROW) {
+        (sqlite3_column_int(statement.get(), 0) ? entry : movement) =
+            sqlite3_column_int64(statement.get(), 1);
+    }
+    return step == SQLITE_DONE;
+}
+
+bool ReadEntries(Database& database, const ItemChange& change,
+                 std::vector<JournalEntry>& entries) {
+    Statement statement = database.Prepare(
+        "SELECT id, item_id, action, old_name, old_part_number, old_nsn, old_serial_number,"
+        " old_quantity, old_created_at, new_name, new_part_number, new_nsn,"
+        " new_serial_number FROM item_journal WHERE id BETWEEN ? AND ? ORDER BY id DESC");
+    if (!statement) {
+        return false;
+    }
+    sqlite3_bind_int64(statement.get(), 1, change.first);
+    sqlite3_bind_int64(statement.get(), 2, change.last);
+    int step;
+    while ((step = sqlite3_step(statement.get())) == SQLITE_ROW) {
+        JournalEntry& entry = entries.emplace_back();
+        entry.id = sqlite3_column_int64(statement.get(), 0);
+        entry.item_id = sqlite3_column_int64(statement.get(), 1);
+        entry.action = sqlite3_column_int(statement.get(), 2);
+        for (int field = 0; field < kTextFields; ++field) {
+            entry.old_text[field] = ColumnValue(statement.get(), 3 + field);
+            entry.new_text[field] = ColumnValue(statement.get(), 9 + field);
+        }
+        entry.old_quantity = ColumnValue(statement.get(), 7);
+        entry.old_created_at = ColumnString(statement.get(), 8);
+    }
+    return step == SQLITE_DONE;
+}
+
+// The deltas that put back the quantities |change| moved, one per item, and
+// how many movements they came from.
+bool ReadMovements(Database& database, const ItemChange& change,
+                   std::vector<StockDelta>& reverse, sqlite3_int64& movements) {
+    movements = 0;
+    Statement statement = database.Prepare(
+        "SELECT item_id, -SUM(delta), COUNT(*) FROM stock_movements WHERE id BETWEEN ? AND ?"
+        " GROUP BY item_id");
+    if (!statement) {
+        return false;
+    }
+    sqlite3_bind_int64(statement.get(), 1, change.first_movement);
+    sqlite3_bind_int64(statement.get(), 2, change.last_movement);
+    int step;
+    while ((step = sqlite3_step(statement.get())) == SQLITE_ROW) {
+        const sqlite3_int64 delta = sqlite3_column_int64(statement.get(), 1);
+        if (delta < INT_MIN || delta > INT_MAX) {
+            return false;
+        }
+        if (delta != 0) {
+            const sqlite3_int64 item_id = sqlite3_column_int64(statement.get(), 0);
+            reverse.push_back({item_id, static_cast<int>(delta)});
+        }
+        movements += sqlite3_column_int64(statement.get(), 2);
+    }
+    return step == SQLITE_DONE;
+}
+
+bool RestoreItem(Database& database, const JournalEntry& entry) {
+    for (const JournalValue& value : entry.old_text) {
+        if (!value.set) {
+            return false;
+        }
+    }
+    Statement statement = database.Prepare(
+        "INSERT INTO items (id, name, part_number, nsn, serial_number, quantity, created_at,"
+        " nsn_key, part_key, serial_key) VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?)");
+    if (!statement) {
+        return false;
+    }
+    sqlite3_bind_int64(statement.get(), 1, entry.item_id);
+    for (int field = 0; field < kTextFields; ++field) {
+        BindText(statement.get(), 2 + field, entry.old_text[field].text);
+    }
+    sqlite3_bind_int64(statement.get(), 6, entry.old_quantity.number);
+    BindText(statement.get(), 7, entry.old_created_at);
+    BindItemKeys(statement.get(), 8, entry.old_text[2].text, entry.old_text[1].text,
+                 entry.old_text[3].text);
+    // The insert records the quantity as an opening movement; the checkpoint
+    // through it leaves the movements from before the delete out of the total.
+    return sqlite3_step(statement.get()) == SQLITE_DONE &&
+           RestartStockLedger(database, entry.item_id,
+                              static_cast<int>(entry.old_quantity.number));
+}
+
+bool RevertUpdate(Database& database, const JournalEntry& entry) {
+    Item item;
+    if (!LoadItem(database, entry.item_id, item)) {
+        return false;
+    }
+    std::string* fields[kTextFields] = {&item.name, &item.part_number, &item.nsn,
+                                        &item.serial_number};
+    bool text_changed = false;
+    for (int field = 0; field < kTextFields; ++field) {
+        if (!entry.new_text[field].set) {
+            continue;
+        }
+        // Someone else has written the field since; theirs wins.
+        if (*fields[field] != entry.new_text[field].text) {
+            return false;
+        }
+        *fields[field] = entry.old_text[field].text;
+        text_changed = true;
+    }
+    return !text_changed || UpdateItem(database, item);
+}
+
+bool RevertEntries(Database& database, std::vector<StockDelta> reverse,
+                   const std::vector<JournalEntry>& entries) {
+    // An item whose insert is reverted goes with its opening movement and
+    // whatever moved after it; its tombstone keeps the quantity it had.
+    for (const JournalEntry& entry : entries) {
+        if (static_cast<JournalAction>(entry.action) == JournalAction::kInsert) {
+            reverse.erase(std::remove_if(reverse.begin(), reverse.end(),
+                                         [&](const StockDelta& delta) {
+                                             return delta.item_id == entry.item_id;
+                                         }),
+                          reverse.end());
+        }
+    }
+    if (!reverse.empty() && !ApplyStockDeltas(database, reverse)) {
+        return false;
+    }
+    for (const JournalEntry& entry : entries) {
+        bool ok = false;
+        switch (static_cast<JournalAction>(entry.action)) {
+            case JournalAction::kInsert:
+                ok = DeleteItem(database, entry.item_id) &&
+                     sqlite3_changes(database.handle()) == 1;
+                break;
+            case JournalAction::kUpdate:
+                ok = RevertUpdate(database, entry);
+                break;
+            case JournalAction::kDelete:
+                ok = RestoreItem(database, entry);
+                break;
+        }
+        if (!ok) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// The item as of the cut: each text column from the oldest entry since then
+// that overwrote it, else from the current row.
+std::string AsOfColumn(const char* column) {
+    return std::string("COALESCE((SELECT old_") + column +
+           " FROM item_journal AS entry WHERE entry.item_id = later.item_id AND entry.id >= ?1"
+           " AND entry.old_" + column + " IS NOT NULL ORDER BY entry.id LIMIT 1), items." +
+           column + ")";
+}
+
+// Stock moved from the movement cut ?2 up to |through|, an SQL expression.
+std::string MovedSince(const char* item_id, const char* through) {
+    return std::string("COALESCE((SELECT SUM(delta) FROM stock_movements AS moved"
+                       " WHERE moved.item_id = ") +
+           item_id + " AND moved.id >= ?2" + through + "), 0)";
+}
+
+std::string AsOfSql() {
+    std::string sql =
+        "WITH later AS (SELECT item_id, MIN(id) AS first_id FROM item_journal"
+        " WHERE id >= ?1 GROUP BY item_id) "
+        "SELECT id, name, part_number, nsn, serial_number, quantity - " +
+        MovedSince("items.id", "") +
+        ", created_at FROM items WHERE id NOT IN (SELECT item_id FROM later) "
+        "UNION ALL SELECT later.item_id";
+    for (const char* column : {"name", "part_number", "nsn", "serial_number"}) {
+        sql += ", " + AsOfColumn(column);
+    }
+    // An item deleted since had the quantity of its tombstone less what moved
+    // before the delete; otherwise it has today's less what moved since.
+    sql += ", COALESCE((SELECT entry.old_quantity - " +
+           MovedSince("later.item_id", " AND moved.id <= entry.movement_id") +
+           " FROM item_journal AS entry WHERE entry.item_id = later.item_id"
+           " AND entry.id >= ?1 AND entry.action = 3 ORDER BY entry.id LIMIT 1),"
+           " items.quantity - " +
+           MovedSince("later.item_id", "") + ")";
+    sql += ", " + AsOfColumn("created_at");
+    // Items first inserted after the cut did not exist yet.
+    sql +=
+        " FROM later JOIN item_journal AS first ON first.id = later.first_id"
+        " LEFT JOIN items ON items.id = later.item_id WHERE first.action <> 1 "
+        "ORDER BY created_at DESC, id DESC";
+    return sql;
+}
+
+// The first row of |table| written after |as_of|, or one past the newest.
+// Ids grow with the write time, so this is a binary search over ids.
+bool FindCut(Database& database, const char* table, const char* time_column,
+             const std::string& as_of, sqlite3_int64& cut) {
+    sqlite3_int64 low = 0;
+    sqlite3_int64 high = 0;
+    {
+        Statement bounds =
+            database.Prepare(std::string("SELECT MIN(id), MAX(id) FROM ") + table);
+        if (!bounds || sqlite3_step(bounds.get()) != SQLITE_ROW) {
+            return false;
+        }
+        low = sqlite3_column_int64(bounds.get(), 0);
+        high = sqlite3_column_int64(bounds.get(), 1) + 1;
+    }
+    Statement probe = database.Prepare(std::string("SELECT ") + time_column + " > ? FROM " +
+                                       table + " WHERE id >= ? ORDER BY id LIMIT 1");
+    if (!probe) {
+        return false;
+    }
+    BindText(probe.get(), 1, as_of);
+    while (low < high) {
+        const sqlite3_int64 middle = low + (high - low) / 2;
+        sqlite3_reset(probe.get());
+        sqlite3_bind_int64(probe.get(), 2, middle);
+        const int step = sqlite3_step(probe.get());
+        if (step != SQLITE_ROW && step != SQLITE_DONE) {
+            return false;
+        }
+        if (step == SQLITE_DONE || sqlite3_column_int(probe.get(), 0) != 0) {
+            high = middle;
+        } else {
+            low = middle + 1;
+        }
+    }
+    cut = low;
+    return true;
+}
+
+// Items deleted in the entries up to ?1 that are gone and will have no
+// tombstone left once those entries are dropped.
+constexpr char kUnrestorableItems[] =
+    "SELECT purged.item_id FROM item_journal AS purged WHERE purged.id <= ?1"
+    " AND purged.action = 3 AND NOT EXISTS (SELECT 1 FROM items WHERE items.id = purged.item_id)"
+    " AND NOT EXISTS (SELECT 1 FROM item_journal AS kept WHERE kept.item_id = purged.item_id"
+    " AND kept.action = 3 AND kept.id > ?1)";
+
+}  // namespace
+
+bool RecordChange(Database& database, const std::function<bool(Database& database)>& write,
+                  ItemChange& change) {
+    change = ItemChange();
+    sqlite3_int64 entry = 0;
+    sqlite3_int64 movement = 0;
+    if (!JournalHeads(database, entry, movement)) {
+        return false;
+    }
+    change.first = entry + 1;
+    change.first_movement = movement + 1;
+    return write(database) && JournalHeads(database, change.last, change.last_movement);
+}
+
+bool RevertChange(Database& database, const ItemChange& change, ItemChange& revert) {
+    revert = ItemChange();
+    std::vector<JournalEntry> entries;
+    std::vector<StockDelta> reverse;
+    sqlite3_int64 movements = 0;
+    if (change.empty() || !ReadEntries(database, change, entries) ||
+        !ReadMovements(database, change, reverse, movements)) {
+        return false;
+    }
+    // One write's ids are consecutive, so anything missing has been compacted.
+    const sqlite3_int64 expected_entries =
+        std::max<sqlite3_int64>(change.last - change.first + 1, 0);
+    const sqlite3_int64 expected_movements =
+        std::max<sqlite3_int64>(change.last_movement - change.first_movement + 1, 0);
+    if (static_cast<sqlite3_int64>(entries.size()) != expected_entries ||
+        movements != expected_movements) {
+        return false;
+    }
+    if (!database.Execute("SAVEPOINT journal_revert")) {
+        return false;
+    }
+    const bool ok = RecordChange(
+        database, [&](Database& db) { return RevertEntries(db, reverse, entries); }, revert);
+    if (!ok) {
+        database.Execute("ROLLBACK TO journal_revert");
+        revert = ItemChange();
+    }
+    return database.Execute("RELEASE journal_revert") && ok;
+}
+
+bool ChangedItems(Database& database, const ItemChange& change,
+                  std::vector<sqlite3_int64>& ids) {
+    ids.clear();
+    Statement statement = database.Prepare(
+        "SELECT item_id FROM item_journal WHERE id BETWEEN ?1 AND ?2"
+        " UNION SELECT item_id FROM stock_movements WHERE id BETWEEN ?3 AND ?4");
+    if (!statement) {
+        return false;
+    }
+    sqlite3_bind_int64(statement.get(), 1, change.first);
+    sqlite3_bind_int64(statement.get(), 2, change.last);
+    sqlite3_bind_int64(statement.get(), 3, change.first_movement);
+    sqlite3_bind_int64(statement.get(), 4, change.last_movement);
+    int step;
+    while ((step = sqlite3_step(statement.get())) == SQLITE_ROW) {
+        ids.push_back(sqlite3_column_int64(statement.get(), 0));
+    }
+    return step == SQLITE_DONE;
+}
+
+bool ListDeletedItems(Database& database, size_t limit, std::vector<DeletedItem>& items) {
+    items.clear();
+    // A delete that is still the item's newest entry has not been restored.
+    Statement statement = database.Prepare(
+        "SELECT id, changed_at, item_id, old_name, old_part_number, old_nsn,"
+        " old_serial_number, old_quantity, old_created_at FROM item_journal AS deleted"
+        " WHERE action = 3 AND id = (SELECT MAX(id) FROM item_journal AS later"
+        " WHERE later.item_id = deleted.item_id) ORDER BY id DESC LIMIT ?");
+    if (!statement) {
+        return false;
+    }
+    sqlite3_bind_int64(statement.get(), 1, static_cast<sqlite3_int64>(limit));
+    int step;
+    while ((step = sqlite3_step(statement.get())) == SQLITE_ROW) {
+        DeletedItem& deleted = items.emplace_back();
+        deleted.journal_id = sqlite3_column_int64(statement.get(), 0);
+        deleted.deleted_at = ColumnString(statement.get(), 1);
+        deleted.item.id = sqlite3_column_int64(statement.get(), 2);
+        deleted.item.name = ColumnString(statement.get(), 3);
+        deleted.item.part_number = ColumnString(statement.get(), 4);
+        deleted.item.nsn = ColumnString(statement.get(), 5);
+        deleted.item.serial_number = ColumnString(statement.get(), 6);
+        deleted.item.quantity = sqlite3_column_int(statement.get(), 7);
+        deleted.created_at = ColumnString(statement.get(), 8);
+    }
+    return step == SQLITE_DONE;
+}
+
+bool JournalHorizon(Database& database, std::string& horizon) {
+    Statement statement =
+        database.Prepare("SELECT changed_at FROM item_journal_horizon WHERE id = 1");
+    if (!statement || sqlite3_step(statement.get()) != SQLITE_ROW) {
+        return false;
+    }
+    horizon = ColumnString(statement.get(), 0);
+    return true;
+}
+
+Statement PrepareItemsAsOf(Database& database, const std::string& as_of, std::string& error) {
+    std::string normalized;
+    {
+        Statement parse = database.Prepare("SELECT strftime('%Y-%m-%d %H:%M:%f', ?)");
+        if (!parse) {
+            error = database.last_error();
+            return {};
+        }
+        BindText(parse.get(), 1, as_of);
+        if (sqlite3_step(parse.get()) != SQLITE_ROW ||
+            sqlite3_column_type(parse.get(), 0) == SQLITE_NULL) {
+            error = "not a time: " + as_of;
+            return {};
+        }
+        normalized = ColumnString(parse.get(), 0);
+    }
+    std::string horizon;
+    if (!JournalHorizon(database, horizon)) {
+        error = sqlite3_errmsg(database.handle());
+        return {};
+    }
+    if (normalized < horizon) {
+        error = "the change journal only goes back to " + horizon;
+        return {};
+    }
+    sqlite3_int64 cut = 0;
+    sqlite3_int64 movement_cut = 0;
+    if (!FindCut(database, "item_journal", "changed_at", normalized, cut) ||
+        !FindCut(database, "stock_movements", "created_at", normalized, movement_cut)) {
+        error = sqlite3_errmsg(database.handle());
+        return {};
+    }
+    static const std::string sql = AsOfSql();
+    Statement statement = database.Prepare(sql);
+    if (!statement) {
+        error = database.last_error();
+        return {};
+    }
+    sqlite3_bind_int64(statement.get(), 1, cut);
+    sqlite3_bind_int64(statement.get(), 2, movement_cut);
+    return statement;
+}
+
+bool CompactJournal(Database& database, int keep_seconds, int max_entries,
+                    JournalCompaction* result) {
+    JournalCompaction compaction;
+    if (result) {
+        *result = compaction;
+    }
+    sqlite3_int64 through_id = 0;
+    std::string through_time;
+    {
+        // Entries are dropped oldest first, so the horizon only moves forward.
+        Statement cutoff = database.Prepare(
+            "SELECT MAX(id), MAX(changed_at) FROM (SELECT id, changed_at FROM item_journal"
+            " ORDER BY id LIMIT ?) WHERE changed_at < strftime('%Y-%m-%d %H:%M:%f', 'now', ?)");
+        if (!cutoff) {
+            return false;
+        }
+        const std::string age = std::to_string(-static_cast<long long>(keep_seconds)) +
+                                " seconds";
+        sqlite3_bind_int(cutoff.get(), 1, max_entries);
+        sqlite3_bind_text(cutoff.get(), 2, age.c_str(), -1, SQLITE_TRANSIENT);
+        if (sqlite3_step(cutoff.get()) != SQLITE_ROW) {
+            return false;
+        }
+        through_id = sqlite3_column_int64(cutoff.get(), 0);
+        through_time = ColumnString(cutoff.get(), 1);
+    }
+    if (through_id == 0) {
+        return true;
+    }
+
+    if (!database.Execute("SAVEPOINT journal_compaction")) {
+        return false;
+    }
+    Statement movements = database.Prepare(
+        std::string("DELETE FROM stock_movements WHERE item_id IN (") + kUnrestorableItems + ")");
+    Statement checkpoints = database.Prepare(
+        std::string("DELETE FROM stock_checkpoints WHERE item_id IN (") + kUnrestorableItems +
+        ")");
+    Statement purge = database.Prepare("DELETE FROM item_journal WHERE id <= ?");
+    Statement horizon = database.Prepare(
+        "UPDATE item_journal_horizon SET changed_at = MAX(changed_at, ?) WHERE id = 1");
+    bool ok = movements && checkpoints && purge && horizon;
+    for (Statement* ledger : {&movements, &checkpoints}) {
+        if (ok) {
+            sqlite3_bind_int64(ledger->get(), 1, through_id);
+            ok = sqlite3_step(ledger->get()) == SQLITE_DONE;
+        }
+    }
+    if (ok) {
+        sqlite3_bind_int64(purge.get(), 1, through_id);
+        ok = sqlite3_step(purge.get()) == SQLITE_DONE;
+        compaction.entries = sqlite3_changes(database.handle());
+    }
+    if (ok) {
+        BindText(horizon.get(), 1, through_time);
+        ok = sqlite3_step(horizon.get()) == SQLITE_DONE;
+    }
+    if (!ok) {
+        database.Execute("ROLLBACK TO journal_compaction");
+    }
+    if (!database.Execute("RELEASE journal_compaction") || !ok) {
+        return false;
+    }
+    compaction.more = compaction.entries == max_entries;
+    if (result) {
+        *result = compaction;
+    }
+    return true;
+}
+
+void ChangeHistory::Record(const ItemChange& change) {
+    if (change.empty()) {
+        return;
+    }
+    Push(undo_, change);
+    redo_.clear();
+}
+
+void ChangeHistory::Clear() {
+    undo_.clear();
+    redo_.clear();
+}
+
+bool ChangeHistory::PeekUndo(ItemChange& change) const {
+    if (undo_.empty()) {
+        return false;
+    }
+    change = undo_.back();
+    return true;
+}
+
+bool ChangeHistory::PeekRedo(ItemChange& change) const {
+    if (redo_.empty()) {
+        return false;
+    }
+    change = redo_.back();
+    return true;
+}
+
+void ChangeHistory::FinishUndo(const ItemChange* revert) {
+    if (undo_.empty()) {
+        return;
+    }
+    undo_.pop_back();
+    if (revert && !revert->empty()) {
+        Push(redo_, *revert);
+    }
+}
+
+void ChangeHistory::FinishRedo(const ItemChange* revert) {
+    if (redo_.empty()) {
+        return;
+    }
+    redo_.pop_back();
+    if (revert && !revert->empty()) {
+        Push(undo_, *revert);
+    }
+}
+
+void ChangeHistory::Push(std::vector<ItemChange>& stack, const ItemChange& change) {
+    stack.push_back(change);
+    if (stack.size() > depth_) {
+        stack.erase(stack.begin());
+    }
+}
+
+}  // namespace inventory
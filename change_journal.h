@@ -0,0 +1,125 @@
+#pragma once
+
+#include <sqlite3.h>
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "database.h"
+#include "items.h"
+
+namespace inventory {
+
+// Every insert, delete and change to an item's text is appended to
+// item_journal by triggers, in the transaction of the change itself (see
+// schema.cpp); quantity changes are the stock_movements rows of the ledger.
+enum class JournalAction {
+    kInsert = 1,
+    kUpdate = 2,
+    // The entry keeps the whole row: it is the item's tombstone until
+    // CompactJournal drops it.
+    kDelete = 3,
+};
+
+// The journal entries and stock movements one write appended, first to last;
+// empty when it changed nothing.
+struct ItemChange {
+    sqlite3_int64 first = 0;
+    sqlite3_int64 last = -1;
+    sqlite3_int64 first_movement = 0;
+    sqlite3_int64 last_movement = -1;
+
+    bool empty() const { return last < first && last_movement < first_movement; }
+};
+
+// Runs |write| and reports the entries it appended in |change|. Must run
+// inside the caller's transaction, e.g. a StorageWorker task, so that no
+// other writer appends in between.
+bool RecordChange(Database& database, const std::function<bool(Database& database)>& write,
+                  ItemChange& change);
+
+// Puts every item |change| touched back the way it was before and reports
+// what this appended in |revert|; reverting |revert| in turn redoes |change|.
+// Its stock movements are reversed first through ApplyStockDeltas, so stock
+// moved by others meanwhile is kept; then, newest entry first, a deleted item
+// comes back with its id, created_at and quantity, an inserted one is deleted
+// and an updated one gets its old text back. Fails, and changes nothing, when
+// part of |change| has been compacted away, a text field no longer holds the
+// value |change| wrote or an item to change, delete or restore is missing or
+// present.
+bool RevertChange(Database& database, const ItemChange& change, ItemChange& revert);
+
+// The distinct items |change| touched.
+bool ChangedItems(Database& database, const ItemChange& change,
+                  std::vector<sqlite3_int64>& ids);
+
+struct DeletedItem {
+    // The tombstone; RevertChange({journal_id, journal_id}) restores the item.
+    sqlite3_int64 journal_id = 0;
+    std::string deleted_at;
+    std::string created_at;
+    Item item;
+};
+
+// Deleted items that have not been restored, most recently deleted first.
+bool ListDeletedItems(Database& database, size_t limit, std::vector<DeletedItem>& items);
+
+// The items table as it was at |as_of|, a UTC time in any form SQLite's date
+// functions accept: kItemSelectColumns rows, newest first. It is rebuilt from
+// the current rows, the oldest value each journal entry since then overwrote
+// and the stock movements since then. Fails with |error| set when |as_of| is
+// not a time or lies before the journal horizon.
+Statement PrepareItemsAsOf(Database& database, const std::string& as_of, std::string& error);
+
+// The oldest time PrepareItemsAsOf can rebuild.
+bool JournalHorizon(Database& database, std::string& horizon);
+
+// What the window and the service keep by default, and the segment they
+// compact at a time.
+constexpr int kJournalKeepDays = 30;
+constexpr int kJournalCompactionSegment = 10000;
+
+struct JournalCompaction {
+    sqlite3_int64 entries = 0;
+    // Older entries are left for another call.
+    bool more = false;
+};
+
+// Drops up to |max_entries| of the oldest entries written more than
+// |keep_seconds| ago, tombstones included, along with the stock ledger of
+// items that can no longer be restored, and moves the horizon past them.
+// Bounded so that a background job can run it between other writes. Runs
+// inside the caller's transaction if there is one.
+bool CompactJournal(Database& database, int keep_seconds, int max_entries,
+                    JournalCompaction* result = nullptr);
+
+// The changes one user can undo and redo, newest last. Recording a new change
+// forgets what could be redone. Reverts run elsewhere, e.g. on a storage
+// thread: Peek the change, revert it, then Finish with the revert, or with
+// nullptr when it failed, which drops the change.
+class ChangeHistory {
+public:
+    explicit ChangeHistory(size_t depth = 100) : depth_(depth) {}
+
+    void Record(const ItemChange& change);
+    void Clear();
+
+    bool can_undo() const { return !undo_.empty(); }
+    bool can_redo() const { return !redo_.empty(); }
+
+    bool PeekUndo(ItemChange& change) const;
+    bool PeekRedo(ItemChange& change) const;
+    void FinishUndo(const ItemChange* revert);
+    void FinishRedo(const ItemChange* revert);
+
+private:
+    void Push(std::vector<ItemChange>& stack, const ItemChange& change);
+
+    size_t depth_;
+    std::vector<ItemChange> undo_;
+    std::vector<ItemChange> redo_;
+};
+
+}  // namespace inventory
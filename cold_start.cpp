@@ -0,0 +1,82 @@
+#include "cold_start.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "item_pager.h"
+#include "search_filter.h"
+
+namespace inventory {
+namespace {
+
+// SQLite calls this every few thousand VM steps; non-zero interrupts.
+int OnProgress(void* cancelled) {
+    return static_cast<const std::atomic<bool>*>(cancelled)->load() ? 1 : 0;
+}
+
+}  // namespace
+
+bool CountItemsUpTo(Database& database, sqlite3_int64 limit, sqlite3_int64& count) {
+    Statement statement = database.Prepare("SELECT COUNT(*) FROM (SELECT 1 FROM items LIMIT ?)");
+    if (!statement) {
+        return false;
+    }
+    sqlite3_bind_int64(statement.get(), 1, limit);
+    if (sqlite3_step(statement.get()) != SQLITE_ROW) {
+        return false;
+    }
+    count = sqlite3_column_int64(statement.get(), 0);
+    return true;
+}
+
+bool CountItems(Database& database, sqlite3_int64& count, const std::atomic<bool>* cancelled) {
+    if (!cancelled) {
+        return CountMatches(database, SearchFilter(), count);
+    }
+    // COUNT(*) over the whole table is one VM instruction that walks the
+    // b-tree itself, so a progress handler never runs during it; only
+    // sqlite3_interrupt, which it checks page by page, stops it.
+    std::mutex mutex;
+    std::condition_variable finished;
+    bool done = false;
+    std::thread watcher([&] {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (!done && !cancelled->load()) {
+            finished.wait_for(lock, std::chrono::milliseconds(10));
+        }
+        if (!done) {
+            sqlite3_interrupt(database.handle());
+        }
+    });
+    const bool ok = CountMatches(database, SearchFilter(), count);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        done = true;
+    }
+    finished.notify_one();
+    watcher.join();
+    return ok && !cancelled->load();
+}
+
+bool WarmUp(Database& database, ItemSnapshot& snapshot, const std::atomic<bool>* cancelled) {
+    if (cancelled) {
+        sqlite3_progress_handler(database.handle(), 10000, OnProgress,
+                                 const_cast<std::atomic<bool>*>(cancelled));
+    }
+    bool ok = snapshot.Load(database);
+    if (!ok && !(cancelled && cancelled->load())) {
+        // Too large for a snapshot: the listing and its pages read
+        // idx_items_recent alone, which covers every column.
+        Statement statement =
+            database.Prepare("SELECT SUM(quantity) FROM items INDEXED BY idx_items_recent");
+        ok = statement && sqlite3_step(statement.get()) == SQLITE_ROW;
+    }
+    if (cancelled) {
+        sqlite3_progress_handler(database.handle(), 0, nullptr, nullptr);
+    }
+    return ok && !(cancelled && cancelled->load());
+}
+
+}  // namespace inventory
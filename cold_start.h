@@ -0,0 +1,36 @@
+#pragma once
+
+#include <sqlite3.h>
+
+#include <atomic>
+
+#include "database.h"
+#include "snapshot.h"
+
+namespace inventory {
+
+// The window shows itself before it touches the database. A background thread
+// then opens the connections, reads only the first page of the listing
+// and lets the rows appear. After that it counts the rows and reads the table
+// through once on a connection of its own. inventory_startup times the same
+// steps without a window.
+
+// The number of items, but counting no further than |limit|: as cheap for a
+// million rows as for a hundred, and exact below |limit|.
+bool CountItemsUpTo(Database& database, sqlite3_int64 limit, sqlite3_int64& count);
+
+// The number of items, as CountMatches gives it for an empty filter. Fails
+// when |cancelled| is set meanwhile, which interrupts the count within about
+// 10 ms.
+bool CountItems(Database& database, sqlite3_int64& count,
+                const std::atomic<bool>* cancelled = nullptr);
+
+// Reads idx_items_recent, which the listing and the snapshot read instead of
+// the table, through once, so that later reads on any connection find its
+// pages in the operating system's cache: by loading |snapshot| when the table
+// fits in one, otherwise by scanning the index. Fails when a read fails or
+// |cancelled| is set meanwhile.
+bool WarmUp(Database& database, ItemSnapshot& snapshot,
+            const std::atomic<bool>* cancelled = nullptr);
+
+}  // namespace inventory
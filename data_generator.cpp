@@ -0,0 +1,315 @@
+#include "data_generator.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <iterator>
+
+#include "item_keys.h"
+#include "schema.h"
+
+namespace inventory {
+namespace {
+
+enum SizeKind { kFastener, kElectrical, kFluid, kNone };
+
+struct NounClass {
+    const char* noun;
+    // Federal supply class, the first group of the NSN.
+    int supply_class;
+    SizeKind sizes;
+    const char* qualifiers[5];
+};
+
+constexpr NounClass kNounClasses[] = {
+    {"Screw, cap", 5305, kFastener, {"hexagon head", "socket head", "slotted", nullptr}},
+    {"Screw, machine", 5305, kFastener, {"pan head", "flat countersunk head", nullptr}},
+    {"Bolt", 5306, kFastener, {"machine", "shear", "internally relieved body", "eye"}},
+    {"Nut", 5310, kFastener, {"self-locking, hexagon", "plain, hexagon", "plain, wing",
+                              "castellated"}},
+    {"Washer", 5310, kFastener, {"flat", "lock", "spring tension", "recessed"}},
+    {"Pin", 5315, kFastener, {"cotter", "spring", "straight, headless", "quick release"}},
+    {"Gasket", 5330, kNone, {"flange", "cylinder head", "metallic", nullptr}},
+    {"Packing, preformed", 5330, kFluid, {"O-ring", "square section", nullptr}},
+    {"Seal, plain", 5330, kFluid, {"shaft", "encased", nullptr}},
+    {"Bearing, ball", 3110, kNone, {"annular", "airframe", nullptr}},
+    {"Bearing, roller", 3110, kNone, {"tapered", "needle", "cylindrical", nullptr}},
+    {"Pump", 4320, kFluid, {"hydraulic", "rotary", "fuel, electric", nullptr}},
+    {"Valve", 4820, kFluid, {"check", "gate", "solenoid", "safety relief"}},
+    {"Hose assembly", 4720, kFluid, {"nonmetallic", "metallic", nullptr}},
+    {"Fitting", 4730, kFluid, {"elbow, tube", "tee, pipe", "union", "reducer"}},
+    {"Clamp, hose", 4730, kFluid, {"worm drive", "spring", nullptr}},
+    {"Filter element", 4330, kFluid, {"fluid", "intake air cleaner", nullptr}},
+    {"Relay", 5945, kElectrical, {"electromagnetic", "solid state", "time delay", nullptr}},
+    {"Resistor", 5905, kElectrical, {"fixed, film", "variable, wire wound", nullptr}},
+    {"Capacitor", 5910, kElectrical, {"fixed, ceramic", "fixed, electrolytic", nullptr}},
+    {"Fuse", 5920, kElectrical, {"cartridge", "plug", nullptr}},
+    {"Switch", 5930, kElectrical, {"toggle", "pressure", "rotary", nullptr}},
+    {"Connector, plug", 5935, kElectrical, {"electrical", "coaxial", nullptr}},
+    {"Lamp", 6240, kElectrical, {"incandescent", "LED", nullptr}},
+    {"Battery", 6135, kElectrical, {"nonrechargeable", "storage", nullptr}},
+    {"Cable assembly", 6150, kElectrical, {"special purpose", "radio frequency", nullptr}},
+};
+
+constexpr const char* kSizes[][6] = {
+    {"1/4-20 X 1", "M6 X 1.0", "No. 10-32", "3/8-16 X 2", "M10 X 1.5", "5/16-18"},
+    {"12 V", "24 V DC", "28 V DC", "115 V AC", "5 A", "10 A"},
+    {"1/4 IN", "3/8 IN", "1/2 IN", "3/4 IN", "-6", "-8"},
+};
+
+// Codification bureaus, weighted towards the US ones as in a US depot.
+constexpr int kBureaus[] = {0, 1, 1, 1, 1, 1, 1, 12, 14, 21, 66, 99};
+
+constexpr const char* kSerialPrefixes[] = {"SN", "W", "AA", "LOT", "M", "K", "TX", "S"};
+
+// 2016-01-01 00:00:00 UTC, in days since 1970-01-01.
+constexpr int64_t kFirstDay = 16801;
+
+// Inverse of the snapshot's DaysFromCivil.
+void CivilFromDays(int64_t days, int& year, int& month, int& day) {
+    days += 719468;
+    const int64_t era = (days >= 0 ? days : days - 146096) / 146097;
+    const int64_t day_of_era = days - era * 146097;
+    const int64_t year_of_era =
+        (day_of_era - day_of_era / 1460 + day_of_era / 36524 - day_of_era / 146096) / 365;
+    const int64_t day_of_year =
+        day_of_era - (365 * year_of_era + year_of_era / 4 - year_of_era / 100);
+    const int64_t month_index = (5 * day_of_year + 2) / 153;
+    day = static_cast<int>(day_of_year - (153 * month_index + 2) / 5 + 1);
+    month = static_cast<int>(month_index < 10 ? month_index + 3 : month_index - 9);
+    year = static_cast<int>(year_of_era + era * 400 + (month <= 2));
+}
+
+void BindText(sqlite3_stmt* statement, int index, const std::string& value) {
+    sqlite3_bind_text(statement, index, value.data(), static_cast<int>(value.size()),
+                      SQLITE_STATIC);
+}
+
+// Milliseconds since 1970 as "YYYY-MM-DD HH:MM:SS.SSS", the created_at format.
+void FormatTimestamp(int64_t ms, char (&out)[24]) {
+    int year, month, day;
+    CivilFromDays(ms / 86400000, year, month, day);
+    const int64_t of_day = ms % 86400000;
+    // Unsigned and bounded, so that the compiler can see every field fits.
+    const auto field = [](int64_t value, unsigned bound) {
+        return static_cast<unsigned>(value) % bound;
+    };
+    std::snprintf(out, sizeof(out), "%04u-%02u-%02u %02u:%02u:%02u.%03u", field(year, 10000),
+                  field(month, 100), field(day, 100), field(of_day / 3600000, 100),
+                  field(of_day / 60000, 60), field(of_day / 1000, 60), field(of_day, 1000));
+}
+
+// Draws are taken one per statement: the order in which function arguments
+// are evaluated is unspecified, and the output must not depend on the compiler.
+std::string PartNumber(Random& random) {
+    const uint64_t pattern = random.Below(6);
+    const int a = static_cast<int>(random.Below(100000));
+    const int b = static_cast<int>(random.Below(1000));
+    const int c = static_cast<int>(random.Below(26));
+    char text[32];
+    switch (pattern) {
+        case 0:
+            std::snprintf(text, sizeof(text), "MS%05d-%d", a, b % 200 + 1);
+            break;
+        case 1:
+            std::snprintf(text, sizeof(text), "NAS%04d%c%04d", a % 10000, 'A' + c,
+                          b * 10 + c % 10);
+            break;
+        case 2:
+            std::snprintf(text, sizeof(text), "AN%03d-%d", b, a % 40 + 1);
+            break;
+        case 3:
+            std::snprintf(text, sizeof(text), "M%05d/%d-%03d", a, c + 1, b);
+            break;
+        case 4:
+            std::snprintf(text, sizeof(text), "%03d-%04d-%02d", b, a % 10000, a / 1000);
+            break;
+        default:
+            std::snprintf(text, sizeof(text), "%c%c%05d%c", 'A' + c, 'A' + b % 26, a,
+                          'A' + a % 26);
+            break;
+    }
+    return text;
+}
+
+}  // namespace
+
+ItemGenerator::Zipf::Zipf(size_t n, double exponent) : cumulative_(std::max<size_t>(n, 1)) {
+    double total = 0.0;
+    for (size_t rank = 0; rank < cumulative_.size(); ++rank) {
+        total += std::pow(static_cast<double>(rank + 1), -exponent);
+        cumulative_[rank] = total;
+    }
+    for (double& value : cumulative_) {
+        value /= total;
+    }
+}
+
+size_t ItemGenerator::Zipf::Sample(Random& random) const {
+    const auto found = std::upper_bound(cumulative_.begin(), cumulative_.end(), random.Unit());
+    return std::min(static_cast<size_t>(found - cumulative_.begin()), cumulative_.size() - 1);
+}
+
+ItemGenerator::ItemGenerator(const GeneratorOptions& options)
+    : options_(options),
+      random_(options.seed),
+      stock_number_rank_(
+          static_cast<size_t>(std::max(1.0, std::ceil(options.rows * options.catalogue_ratio))),
+          options.skew) {
+    const int noun_classes = static_cast<int>(std::size(kNounClasses));
+    for (int noun_class = 0; noun_class < noun_classes; ++noun_class) {
+        const NounClass& entry = kNounClasses[noun_class];
+        for (const char* qualifier : entry.qualifiers) {
+            if (!qualifier) {
+                break;
+            }
+            const std::string base = std::string(entry.noun) + ", " + qualifier;
+            names_.push_back(base);
+            name_classes_.push_back(noun_class);
+            if (entry.sizes == kNone) {
+                continue;
+            }
+            for (const char* size : kSizes[entry.sizes]) {
+                names_.push_back(base + " " + size);
+                name_classes_.push_back(noun_class);
+            }
+        }
+    }
+    // Which names are common depends on the seed.
+    for (size_t i = names_.size() - 1; i > 0; --i) {
+        const size_t j = static_cast<size_t>(random_.Below(i + 1));
+        std::swap(names_[i], names_[j]);
+        std::swap(name_classes_[i], name_classes_[j]);
+    }
+
+    const Zipf name_rank(names_.size(), options.skew);
+    const size_t stock_count =
+        static_cast<size_t>(std::max(1.0, std::ceil(options.rows * options.catalogue_ratio)));
+    stock_numbers_.reserve(stock_count);
+    char nsn[24];
+    for (size_t i = 0; i < stock_count; ++i) {
+        StockNumber stock;
+        stock.name = static_cast<uint32_t>(name_rank.Sample(random_));
+        stock.part_number = PartNumber(random_);
+        const int bureau = kBureaus[random_.Below(std::size(kBureaus))];
+        const int group = static_cast<int>(random_.Below(1000));
+        const int item_number = static_cast<int>(random_.Below(10000));
+        std::snprintf(nsn, sizeof(nsn), "%04d-%02d-%03d-%04d",
+                      kNounClasses[name_classes_[stock.name]].supply_class, bureau, group,
+                      item_number);
+        stock.nsn = nsn;
+        stock_numbers_.push_back(std::move(stock));
+    }
+}
+
+void ItemGenerator::AppendSerial(uint64_t index, std::string& out) const {
+    // Multiplying by an odd constant and folding the high half down are both
+    // invertible, so every index keeps a serial of its own.
+    uint32_t mixed = static_cast<uint32_t>(index) * 0x9E3779B1u;
+    mixed ^= mixed >> 16;
+    char text[24];
+    std::snprintf(text, sizeof(text), "%s%010u",
+                  kSerialPrefixes[index % std::size(kSerialPrefixes)], mixed);
+    out = text;
+}
+
+void ItemGenerator::Next(Item& item) {
+    const StockNumber& stock = stock_numbers_[stock_number_rank_.Sample(random_)];
+    item.name = names_[stock.name];
+    item.part_number = stock.part_number;
+    item.nsn = stock.nsn;
+
+    uint64_t serial = serials_issued_;
+    if (serials_issued_ == 0 || random_.Unit() < options_.serial_unique_ratio) {
+        ++serials_issued_;
+    } else {
+        serial = random_.Below(serials_issued_);
+    }
+    AppendSerial(serial, item.serial_number);
+
+    // Mostly small counts, a few bulk lots: pick the number of digits first.
+    static const int kLimits[] = {10, 100, 1000, 10000};
+    const int limit = kLimits[random_.Below(std::size(kLimits))];
+    item.quantity = static_cast<int>(random_.Below(limit));
+}
+
+bool GenerateItems(Database& database, const GeneratorOptions& options, GeneratorReport& report,
+                   const std::function<void(uint64_t rows)>& on_batch) {
+    report = GeneratorReport();
+    const auto start = std::chrono::steady_clock::now();
+    auto fail = [&](const char* what) {
+        report.fatal_error = std::string(what) + ": " + sqlite3_errmsg(database.handle());
+        return false;
+    };
+    if (!SuspendItemIndexes(database)) {
+        return fail("cannot drop the indexes");
+    }
+
+    ItemGenerator generator(options);
+    Item item;
+    const size_t batch_size = std::max<size_t>(options.batch_size, 1);
+    const int64_t span_ms = static_cast<int64_t>(std::max(options.span_days, 0)) * 86400000;
+    char created_at[24];
+    bool ok = true;
+    while (ok && report.inserted < options.rows) {
+        if (!database.Execute("BEGIN IMMEDIATE")) {
+            ok = fail("cannot start a batch");
+            break;
+        }
+        Statement statement = database.Prepare(
+            "INSERT INTO items (name, part_number, nsn, serial_number, quantity, created_at,"
+            " nsn_key, part_key, serial_key) VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?)");
+        sqlite3_stmt* insert = statement.get();
+        const uint64_t last = std::min<uint64_t>(report.inserted + batch_size, options.rows);
+        for (uint64_t row = report.inserted; ok && row < last; ++row) {
+            generator.Next(item);
+            const double offset = options.rows > 1 ? static_cast<double>(row) * span_ms /
+                                                         static_cast<double>(options.rows)
+                                                   : 0.0;
+            FormatTimestamp(kFirstDay * 86400000 + static_cast<int64_t>(offset), created_at);
+            ok = insert != nullptr;
+            if (ok) {
+                sqlite3_reset(insert);
+                BindText(insert, 1, item.name);
+                BindText(insert, 2, item.part_number);
+                BindText(insert, 3, item.nsn);
+                BindText(insert, 4, item.serial_number);
+                sqlite3_bind_int(insert, 5, item.quantity);
+                sqlite3_bind_text(insert, 6, created_at, 23, SQLITE_STATIC);
+                BindItemKeys(insert, 7, item.nsn, item.part_number, item.serial_number);
+                ok = sqlite3_step(insert) == SQLITE_DONE;
+            }
+        }
+        statement.Release();
+        if (ok && database.Execute("COMMIT")) {
+            report.inserted = last;
+            ++report.batches;
+            if (on_batch) {
+                on_batch(report.inserted);
+            }
+            continue;
+        }
+        fail("cannot insert the generated rows");
+        database.Execute("ROLLBACK");
+        ok = false;
+    }
+    const auto loaded = std::chrono::steady_clock::now();
+    report.insert_seconds = std::chrono::duration<double>(loaded - start).count();
+
+    // Put the indexes back even after a failure, so the rows that did land
+    // are searchable.
+    bool restored = database.Execute("BEGIN IMMEDIATE");
+    if (restored && !(restored = RestoreItemIndexes(database) && database.Execute("COMMIT"))) {
+        database.Execute("ROLLBACK");
+    }
+    report.index_seconds =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - loaded).count();
+    if (ok && !restored) {
+        report.fatal_error = "cannot rebuild the indexes: " + database.last_error();
+        return false;
+    }
+    return ok;
+}
+
+}  // namespace inventory
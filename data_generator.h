@@ -0,0 +1,112 @@
+#pragma once
+
+#include <sqlite3.h>
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "database.h"
+#include "items.h"
+
+namespace inventory {
+
+struct GeneratorOptions {
+    uint64_t seed = 1;
+    uint64_t rows = 100000;
+    // Distinct stock numbers (name, part number and NSN) per generated row.
+    double catalogue_ratio = 0.05;
+    // Share of rows whose serial number is new; the rest repeat an earlier one.
+    double serial_unique_ratio = 0.98;
+    // Zipf exponent of how often names and stock numbers occur; 0 is uniform.
+    double skew = 1.1;
+    // created_at runs evenly over this many days from 2016-01-01, oldest first.
+    int span_days = 3650;
+    size_t batch_size = 50000;
+};
+
+struct GeneratorReport {
+    uint64_t inserted = 0;
+    uint64_t batches = 0;
+    double insert_seconds = 0.0;
+    // Recreating the indexes and rebuilding items_fts afterwards.
+    double index_seconds = 0.0;
+    std::string fatal_error;
+
+    double RowsPerSecond() const {
+        const double seconds = insert_seconds + index_seconds;
+        return seconds > 0.0 ? inserted / seconds : 0.0;
+    }
+};
+
+// splitmix64: small, fast and identical on every platform, unlike the
+// standard distributions.
+class Random {
+public:
+    explicit Random(uint64_t seed) : state_(seed) {}
+
+    uint64_t Next() {
+        uint64_t z = (state_ += 0x9E3779B97F4A7C15ull);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+    // [0, bound) for a non-zero bound; the modulo bias is far below anything
+    // a benchmark could notice.
+    uint64_t Below(uint64_t bound) { return Next() % bound; }
+    // Uniform in [0, 1).
+    double Unit() { return static_cast<double>(Next() >> 11) * 0x1.0p-53; }
+
+private:
+    uint64_t state_;
+};
+
+// Realistic-looking items: federal item names ("Screw, cap, hexagon head
+// M6 X 1.0"), NSNs in NNNN-NN-NNN-NNNN form whose supply class matches the
+// name, military and vendor part numbers, and serial numbers. The same seed
+// and options always produce the same sequence.
+class ItemGenerator {
+public:
+    explicit ItemGenerator(const GeneratorOptions& options);
+
+    // Fills |item| with the next row; created_at is set separately by
+    // GenerateItems.
+    void Next(Item& item);
+
+private:
+    struct StockNumber {
+        uint32_t name;
+        std::string part_number;
+        std::string nsn;
+    };
+
+    // Samples ranks 0..n-1 with probability proportional to 1 / (rank + 1)^s.
+    class Zipf {
+    public:
+        Zipf(size_t n, double exponent);
+        size_t Sample(Random& random) const;
+
+    private:
+        std::vector<double> cumulative_;
+    };
+
+    void AppendSerial(uint64_t index, std::string& out) const;
+
+    GeneratorOptions options_;
+    Random random_;
+    std::vector<std::string> names_;
+    std::vector<int> name_classes_;
+    std::vector<StockNumber> stock_numbers_;
+    Zipf stock_number_rank_;
+    uint64_t serials_issued_ = 0;
+};
+
+// Appends |options.rows| generated items to the items table in transactions
+// of batch_size rows. The indexes are suspended during the load and rebuilt
+// at the end, so the database must not be in use by anyone else. Calls
+// |on_batch| with the running row count after every committed batch.
+bool GenerateItems(Database& database, const GeneratorOptions& options, GeneratorReport& report,
+                   const std::function<void(uint64_t rows)>& on_batch = nullptr);
+
+}  // namespace inventory
@@ -0,0 +1,136 @@
+#include "database.h"
+
+#include <chrono>
+
+#include "metrics.h"
+
+namespace inventory {
+
+Statement& Statement::operator=(Statement&& other) noexcept {
+    if (this != &other) {
+        Release();
+        statement_ = other.statement_;
+        other.statement_ = nullptr;
+    }
+    return *this;
+}
+
+void Statement::Release() {
+    if (statement_) {
+        sqlite3_reset(statement_);
+        sqlite3_clear_bindings(statement_);
+        statement_ = nullptr;
+    }
+}
+
+bool Database::Open(const std::string& path) {
+    Close();
+    if (sqlite3_open(path.c_str(), &db_) != SQLITE_OK) {
+        sqlite3_close(db_);
+        db_ = nullptr;
+        return false;
+    }
+    return true;
+}
+
+void Database::Close() {
+    ClearStatements();
+    if (db_) {
+        sqlite3_close(db_);
+        db_ = nullptr;
+    }
+}
+
+bool Database::Configure(const StorageOptions& options) {
+    if (!db_ || sqlite3_busy_timeout(db_, options.busy_timeout_ms) != SQLITE_OK) {
+        return false;
+    }
+    std::string sql = "PRAGMA journal_mode = " + options.journal_mode +
+                      ";PRAGMA synchronous = " + options.synchronous +
+                      ";PRAGMA cache_size = -" + std::to_string(options.cache_size_kib) +
+                      ";PRAGMA mmap_size = " + std::to_string(options.mmap_size);
+    return Execute(sql.c_str());
+}
+
+bool Database::Execute(const char* sql) {
+    char* error_message = nullptr;
+    int result = sqlite3_exec(db_, sql, nullptr, nullptr, &error_message);
+    if (result != SQLITE_OK) {
+        last_error_ = error_message ? error_message : sqlite3_errstr(result);
+    }
+    if (error_message) {
+        sqlite3_free(error_message);
+    }
+    return result == SQLITE_OK;
+}
+
+sqlite3_stmt* Database::PrepareUncached(const std::string& sql) {
+    auto start = std::chrono::steady_clock::now();
+    sqlite3_stmt* statement = nullptr;
+    if (sqlite3_prepare_v3(db_, sql.c_str(), static_cast<int>(sql.size()),
+                           SQLITE_PREPARE_PERSISTENT, &statement, nullptr) != SQLITE_OK) {
+        last_error_ = sqlite3_errmsg(db_);
+        sqlite3_finalize(statement);
+        statement = nullptr;
+    }
+    const uint64_t elapsed_ns = ScopedLatency::ElapsedNs(start);
+    stats_.prepare_ns += elapsed_ns;
+    Metrics().operation(Operation::kPrepare).Record(elapsed_ns);
+    return statement;
+}
+
+void Database::ClearStatements() {
+    for (auto& [sql, statement] : by_sql_) {
+        sqlite3_finalize(statement);
+    }
+    for (auto& [shape, statement] : by_shape_) {
+        sqlite3_finalize(statement);
+    }
+    by_sql_.clear();
+    by_shape_.clear();
+}
+
+void Database::ForEachStatement(const std::function<void(sqlite3_stmt*)>& visit) const {
+    for (const auto& [sql, statement] : by_sql_) {
+        visit(statement);
+    }
+    for (const auto& [shape, statement] : by_shape_) {
+        visit(statement);
+    }
+}
+
+Statement Database::Prepare(const std::string& sql) {
+    if (!db_) {
+        return {};
+    }
+    auto found = by_sql_.find(sql);
+    if (found != by_sql_.end()) {
+        ++stats_.hits;
+        return Statement(found->second);
+    }
+    ++stats_.misses;
+    sqlite3_stmt* statement = PrepareUncached(sql);
+    if (statement) {
+        by_sql_.emplace(sql, statement);
+    }
+    return Statement(statement);
+}
+
+Statement Database::PrepareShape(uint32_t shape, const std::function<std::string()>& build) {
+    if (!db_) {
+        return {};
+    }
+    auto found = by_shape_.find(shape);
+    if (found != by_shape_.end()) {
+        ++stats_.hits;
+        return Statement(found->second);
+    }
+    ++stats_.misses;
+    sqlite3_stmt* statement = PrepareUncached(build());
+    if (statement) {
+        by_shape_.emplace(shape, statement);
+    }
+    return Statement(statement);
+}
+
+}  // namespace inventory
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <sqlite3.h>
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <unordered_map>
+
+namespace inventory {
+
+// Connection settings applied by Database::Configure.
+struct StorageOptions {
+    std::string journal_mode = "WAL";
+    std::string synchronous = "NORMAL";
+    int cache_size_kib = 16 * 1024;
+    long long mmap_size = 256ll * 1024 * 1024;
+    int busy_timeout_ms = 5000;
+    // How long a write waits for others to share its transaction.
+    int group_commit_window_ms = 2;
+    size_t max_group_size = 256;
+};
+
+struct StatementCacheStats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t prepare_ns = 0;
+};
+
+// A prepared statement borrowed from the Database cache. Going out of scope
+// resets it and clears its bindings; it is never finalized by the borrower.
+class Statement {
+public:
+    Statement() = default;
+    explicit Statement(sqlite3_stmt* statement) : statement_(statement) {}
+    ~Statement() { Release(); }
+
+    Statement(Statement&& other) noexcept : statement_(other.statement_) {
+        other.statement_ = nullptr;
+    }
+    Statement& operator=(Statement&& other) noexcept;
+    Statement(const Statement&) = delete;
+    Statement& operator=(const Statement&) = delete;
+
+    sqlite3_stmt* get() const { return statement_; }
+    explicit operator bool() const { return statement_ != nullptr; }
+
+    void Release();
+
+private:
+    sqlite3_stmt* statement_ = nullptr;
+};
+
+// Owns the connection and every statement prepared on it. Statements are kept
+// for the lifetime of the connection and handed out again on later requests
+// for the same SQL text or the same query shape.
+class Database {
+public:
+    Database() = default;
+    ~Database() { Close(); }
+
+    Database(const Database&) = delete;
+    Database& operator=(const Database&) = delete;
+
+    bool Open(const std::string& path);
+    void Close();
+    bool IsOpen() const { return db_ != nullptr; }
+    sqlite3* handle() const { return db_; }
+
+    bool Configure(const StorageOptions& options);
+    bool Execute(const char* sql);
+
+    // Returns the cached statement for |sql|, preparing it on first use.
+    Statement Prepare(const std::string& sql);
+
+    // Same as Prepare, keyed by a caller-defined shape id so that dynamic SQL
+    // is only built on a miss. |build| must always return the same text for
+    // the same |shape|.
+    Statement PrepareShape(uint32_t shape, const std::function<std::string()>& build);
+
+    // Finalizes every cached statement, so that the next Prepare of each one
+    // prepares it again. No Statement may be borrowed at the time.
+    void ClearStatements();
+
+    const StatementCacheStats& cache_stats() const { return stats_; }
+    // Visits every cached statement, e.g. to read sqlite3_stmt_status.
+    void ForEachStatement(const std::function<void(sqlite3_stmt*)>& visit) const;
+
+    // The message of the last Execute or prepare that failed.
+    const std::string& last_error() const { return last_error_; }
+
+private:
+    sqlite3_stmt* PrepareUncached(const std::string& sql);
+
+    sqlite3* db_ = nullptr;
+    std::unordered_map<std::string, sqlite3_stmt*> by_sql_;
+    std::unordered_map<uint32_t, sqlite3_stmt*> by_shape_;
+    StatementCacheStats stats_;
+    std::string last_error_;
+};
+
+}  // namespace inventory
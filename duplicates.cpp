@@ -0,0 +1,355 @@
+#include "duplicates.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <iterator>
+#include <thread>
+#include <tuple>
+
+#include "item_keys.h"
+#include "metrics.h"
+#include "parallel_ranges.h"
+
+namespace inventory {
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr size_t kBlockWords = 8;
+constexpr uint32_t kBlockSalts[kBlockWords] = {0x47b6137bU, 0x44974d91U, 0x8824ad5bU,
+                                                0xa2b7289dU, 0x705495c7U, 0x2df1424bU,
+                                                0x9efc4947U, 0x5c6bfb31U};
+
+// Below this many rows FindDuplicates groups on the calling thread alone.
+constexpr size_t kParallelMinRows = 65536;
+// Partitions per thread, so one partition heavier than the rest evens out.
+constexpr size_t kPartitionsPerThread = 8;
+
+uint64_t Mix(uint64_t hash) {
+    hash ^= hash >> 30;
+    hash *= 0xbf58476d1ce4e5b9ULL;
+    hash ^= hash >> 27;
+    hash *= 0x94d049bb133111ebULL;
+    return hash ^ (hash >> 31);
+}
+
+double SecondsSince(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+std::string_view ColumnView(sqlite3_stmt* statement, int column) {
+    const unsigned char* value = sqlite3_column_text(statement, column);
+    return std::string_view(value ? reinterpret_cast<const char*>(value) : "",
+                            static_cast<size_t>(sqlite3_column_bytes(statement, column)));
+}
+
+void BindView(sqlite3_stmt* statement, int index, std::string_view value) {
+    sqlite3_bind_text(statement, index, value.data(), static_cast<int>(value.size()),
+                      SQLITE_STATIC);
+}
+
+struct KeyRow {
+    sqlite3_int64 id;
+    uint64_t hash;
+    std::string part_key;
+    std::string serial_key;
+};
+
+}  // namespace
+
+void BloomFilter::Reset(size_t capacity) {
+    capacity_ = capacity;
+    blocks_ = std::max<size_t>((capacity * kBloomBitsPerKey + 255) / 256, 1);
+    words_.assign(blocks_ * kBlockWords, 0);
+    size_ = 0;
+}
+
+void BloomFilter::Clear() {
+    words_.clear();
+    words_.shrink_to_fit();
+    blocks_ = 0;
+    size_ = 0;
+    capacity_ = 0;
+}
+
+void BloomFilter::Add(uint64_t hash) {
+    if (blocks_ == 0) {
+        return;
+    }
+    uint32_t* block = words_.data() + ((hash >> 32) * blocks_ >> 32) * kBlockWords;
+    const auto low = static_cast<uint32_t>(hash);
+    for (size_t i = 0; i < kBlockWords; ++i) {
+        block[i] |= uint32_t{1} << ((low * kBlockSalts[i]) >> 27);
+    }
+    ++size_;
+}
+
+bool BloomFilter::MayContain(uint64_t hash) const {
+    if (blocks_ == 0) {
+        return true;
+    }
+    const uint32_t* block = words_.data() + ((hash >> 32) * blocks_ >> 32) * kBlockWords;
+    const auto low = static_cast<uint32_t>(hash);
+    for (size_t i = 0; i < kBlockWords; ++i) {
+        if (!(block[i] & (uint32_t{1} << ((low * kBlockSalts[i]) >> 27)))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+uint64_t HashKey(std::string_view key) {
+    // FNV-1a, then mixed so every bit of the result depends on every byte.
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (const char c : key) {
+        hash = (hash ^ static_cast<unsigned char>(c)) * 0x100000001b3ULL;
+    }
+    return Mix(hash);
+}
+
+uint64_t HashKeyPair(std::string_view part_key, std::string_view serial_key) {
+    return Mix(HashKey(part_key) * 0x9e3779b97f4a7c15ULL ^ HashKey(serial_key));
+}
+
+bool DuplicateDetector::Build(Database& database, size_t new_rows,
+                              const std::atomic<bool>* cancelled) {
+    Clear();
+    Statement count = database.Prepare("SELECT COUNT(*) FROM items");
+    if (!count || sqlite3_step(count.get()) != SQLITE_ROW) {
+        return false;
+    }
+    const auto rows = static_cast<size_t>(sqlite3_column_int64(count.get(), 0));
+    count.Release();
+    const size_t capacity = rows + rows / 4 + new_rows + 1024;
+    serials_.Reset(capacity);
+    pairs_.Reset(capacity);
+
+    Statement statement =
+        database.Prepare("SELECT part_key, serial_key FROM items WHERE serial_key <> ''");
+    if (!statement) {
+        Clear();
+        return false;
+    }
+    int step;
+    size_t read = 0;
+    while ((step = sqlite3_step(statement.get())) == SQLITE_ROW) {
+        if (cancelled && (++read & 0xFFFF) == 0 && cancelled->load()) {
+            Clear();
+            return false;
+        }
+        AddKeys(ColumnView(statement.get(), 0), ColumnView(statement.get(), 1));
+    }
+    if (step != SQLITE_DONE) {
+        Clear();
+        return false;
+    }
+    built_ = true;
+    return true;
+}
+
+void DuplicateDetector::Clear() {
+    built_ = false;
+    serials_.Clear();
+    pairs_.Clear();
+}
+
+void DuplicateDetector::AddKeys(std::string_view part_key, std::string_view serial_key) {
+    if (serial_key.empty()) {
+        return;
+    }
+    serials_.Add(HashKey(serial_key));
+    pairs_.Add(HashKeyPair(part_key, serial_key));
+}
+
+void DuplicateDetector::Add(std::string_view part_number, std::string_view serial_number) {
+    if (built_) {
+        AddKeys(IdentifierKey(part_number), IdentifierKey(serial_number));
+    }
+}
+
+bool DuplicateDetector::Sync(Database& database, sqlite3_int64 id) {
+    if (!built_) {
+        return true;
+    }
+    Statement statement =
+        database.Prepare("SELECT part_key, serial_key FROM items WHERE id = ?");
+    if (!statement) {
+        return false;
+    }
+    sqlite3_bind_int64(statement.get(), 1, id);
+    const int step = sqlite3_step(statement.get());
+    if (step == SQLITE_ROW) {
+        AddKeys(ColumnView(statement.get(), 0), ColumnView(statement.get(), 1));
+    }
+    return step == SQLITE_ROW || step == SQLITE_DONE;
+}
+
+bool DuplicateDetector::Probe(Database& database, const std::string& part_key,
+                              const std::string& serial_key, bool same_part,
+                              sqlite3_int64 exclude_id, DuplicateMatch& match) {
+    ++stats_.probes;
+    // Rows with one key sit in id order in idx_items_serial_key, so the first
+    // one found is the oldest.
+    Statement statement = database.Prepare(
+        same_part ? "SELECT id FROM items WHERE serial_key = ?1 AND part_key = ?2 AND id <> ?3"
+                    " ORDER BY id LIMIT 1"
+                  : "SELECT id FROM items WHERE serial_key = ?1 AND id <> ?3 ORDER BY id LIMIT 1");
+    if (!statement) {
+        return false;
+    }
+    BindView(statement.get(), 1, serial_key);
+    if (same_part) {
+        BindView(statement.get(), 2, part_key);
+    }
+    sqlite3_bind_int64(statement.get(), 3, exclude_id);
+    const int step = sqlite3_step(statement.get());
+    if (step == SQLITE_ROW) {
+        match.id = sqlite3_column_int64(statement.get(), 0);
+        match.kind = same_part ? DuplicateKind::kPartAndSerial : DuplicateKind::kSerial;
+    }
+    return step == SQLITE_ROW || step == SQLITE_DONE;
+}
+
+bool DuplicateDetector::Check(Database& database, std::string_view part_number,
+                              std::string_view serial_number, DuplicateMatch& match,
+                              sqlite3_int64 exclude_id) {
+    ScopedLatency latency(Metrics().operation(Operation::kDuplicateCheck));
+    match = DuplicateMatch();
+    ++stats_.checks;
+    const std::string serial_key = IdentifierKey(serial_number);
+    if (serial_key.empty() || (built_ && !serials_.MayContain(HashKey(serial_key)))) {
+        ++stats_.filtered;
+        return true;
+    }
+    const std::string part_key = IdentifierKey(part_number);
+    if (!built_ || pairs_.MayContain(HashKeyPair(part_key, serial_key))) {
+        if (!Probe(database, part_key, serial_key, true, exclude_id, match)) {
+            return false;
+        }
+        if (match.kind != DuplicateKind::kNone) {
+            return true;
+        }
+    }
+    if (!Probe(database, part_key, serial_key, false, exclude_id, match)) {
+        return false;
+    }
+    stats_.false_positives += match.kind == DuplicateKind::kNone;
+    return true;
+}
+
+bool FindDuplicates(Database& database, const DuplicateScanOptions& options,
+                    std::vector<DuplicateGroup>& groups, DuplicateScanReport& report) {
+    groups.clear();
+    report = DuplicateScanReport();
+    const bool by_part = options.scope == DuplicateScope::kPartAndSerial;
+
+    Clock::time_point start = Clock::now();
+    std::vector<KeyRow> rows;
+    {
+        Statement statement = database.Prepare(
+            "SELECT id, part_key, serial_key FROM items WHERE serial_key <> '' ORDER BY id");
+        if (!statement) {
+            return false;
+        }
+        int step;
+        while ((step = sqlite3_step(statement.get())) == SQLITE_ROW) {
+            KeyRow row;
+            row.id = sqlite3_column_int64(statement.get(), 0);
+            row.serial_key = ColumnView(statement.get(), 2);
+            if (by_part) {
+                row.part_key = ColumnView(statement.get(), 1);
+            }
+            rows.push_back(std::move(row));
+        }
+        if (step != SQLITE_DONE) {
+            return false;
+        }
+    }
+    report.rows = rows.size();
+    report.read_seconds = SecondsSince(start);
+
+    start = Clock::now();
+    size_t threads = options.threads ? options.threads : std::thread::hardware_concurrency();
+    threads = std::max<size_t>(std::min(threads, rows.size() / kParallelMinRows), 1);
+    report.threads = static_cast<unsigned>(threads);
+    const size_t partitions = threads * kPartitionsPerThread;
+
+    // Hash every row and count it towards its partition, per thread.
+    std::vector<std::vector<size_t>> counts(threads, std::vector<size_t>(partitions, 0));
+    ForEachRange(rows.size(), threads, [&](size_t first, size_t last, size_t slot) {
+        std::vector<size_t>& count = counts[slot];
+        for (size_t i = first; i < last; ++i) {
+            KeyRow& row = rows[i];
+            row.hash = by_part ? HashKeyPair(row.part_key, row.serial_key)
+                               : HashKey(row.serial_key);
+            ++count[(row.hash >> 32) * partitions >> 32];
+        }
+    });
+
+    // Each thread's rows of one partition go after the earlier threads' ones,
+    // so every partition stays in id order.
+    std::vector<size_t> begins(partitions + 1, 0);
+    std::vector<std::vector<size_t>> offsets(threads, std::vector<size_t>(partitions));
+    size_t offset = 0;
+    for (size_t partition = 0; partition < partitions; ++partition) {
+        begins[partition] = offset;
+        for (size_t slot = 0; slot < threads; ++slot) {
+            offsets[slot][partition] = offset;
+            offset += counts[slot][partition];
+        }
+    }
+    begins[partitions] = offset;
+    std::vector<uint32_t> order(rows.size());
+    ForEachRange(rows.size(), threads, [&](size_t first, size_t last, size_t slot) {
+        std::vector<size_t>& next = offsets[slot];
+        for (size_t i = first; i < last; ++i) {
+            order[next[(rows[i].hash >> 32) * partitions >> 32]++] = static_cast<uint32_t>(i);
+        }
+    });
+
+    // Group each partition on its own.
+    std::vector<std::vector<DuplicateGroup>> found(threads);
+    ForEachRange(partitions, threads, [&](size_t first, size_t last, size_t slot) {
+        for (size_t partition = first; partition < last; ++partition) {
+            const auto begin = order.begin() + static_cast<ptrdiff_t>(begins[partition]);
+            const auto end = order.begin() + static_cast<ptrdiff_t>(begins[partition + 1]);
+            std::stable_sort(begin, end, [&rows](uint32_t a, uint32_t b) {
+                const KeyRow& x = rows[a];
+                const KeyRow& y = rows[b];
+                return std::tie(x.hash, x.serial_key, x.part_key) <
+                       std::tie(y.hash, y.serial_key, y.part_key);
+            });
+            for (auto run = begin; run != end;) {
+                const KeyRow& key = rows[*run];
+                auto next = run + 1;
+                while (next != end && rows[*next].hash == key.hash &&
+                       rows[*next].serial_key == key.serial_key &&
+                       rows[*next].part_key == key.part_key) {
+                    ++next;
+                }
+                if (next - run > 1) {
+                    DuplicateGroup group;
+                    group.part_key = key.part_key;
+                    group.serial_key = key.serial_key;
+                    for (auto i = run; i != next; ++i) {
+                        group.ids.push_back(rows[*i].id);
+                    }
+                    found[slot].push_back(std::move(group));
+                }
+                run = next;
+            }
+        }
+    });
+
+    for (std::vector<DuplicateGroup>& slot_groups : found) {
+        std::move(slot_groups.begin(), slot_groups.end(), std::back_inserter(groups));
+    }
+    std::sort(groups.begin(), groups.end(), [](const DuplicateGroup& a, const DuplicateGroup& b) {
+        return a.ids.front() < b.ids.front();
+    });
+    report.group_seconds = SecondsSince(start);
+    return true;
+}
+
+}  // namespace inventory
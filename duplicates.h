@@ -0,0 +1,153 @@
+#pragma once
+
+#include <sqlite3.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "database.h"
+
+namespace inventory {
+
+// A split block Bloom filter over 64-bit hashes: each key sets one bit in
+// each of the eight 32-bit words of one 32-byte block, so a lookup reads a
+// single cache line. At kBloomBitsPerKey bits per key about 1 lookup in 1000
+// for a key never added says it may be present.
+constexpr size_t kBloomBitsPerKey = 16;
+
+class BloomFilter {
+public:
+    // Empties the filter and sizes it for |capacity| keys.
+    void Reset(size_t capacity);
+    void Clear();
+
+    void Add(uint64_t hash);
+    bool MayContain(uint64_t hash) const;
+
+    // Keys added; past capacity() the false-positive rate climbs.
+    size_t size() const { return size_; }
+    size_t capacity() const { return capacity_; }
+    size_t bytes() const { return words_.size() * sizeof(uint32_t); }
+
+private:
+    std::vector<uint32_t> words_;
+    size_t blocks_ = 0;
+    size_t size_ = 0;
+    size_t capacity_ = 0;
+};
+
+// A 64-bit hash of a part or serial key (see item_keys.h), and of the two
+// together.
+uint64_t HashKey(std::string_view key);
+uint64_t HashKeyPair(std::string_view part_key, std::string_view serial_key);
+
+enum class DuplicateKind {
+    kNone,
+    // Another item has the serial number under another part number, which
+    // different makers can legitimately share.
+    kSerial,
+    // Another item has the same part and serial number: most likely the same
+    // item entered twice.
+    kPartAndSerial,
+};
+
+struct DuplicateMatch {
+    DuplicateKind kind = DuplicateKind::kNone;
+    // The oldest such item.
+    sqlite3_int64 id = 0;
+};
+
+struct DuplicateStats {
+    uint64_t checks = 0;
+    // Checks the filters answered alone.
+    uint64_t filtered = 0;
+    // Index probes, two at most per check.
+    uint64_t probes = 0;
+    // Checks that probed and found nothing: the filters' false positives, or
+    // every new serial number checked before Build.
+    uint64_t false_positives = 0;
+};
+
+// Finds the items a new or changed one would duplicate, compared by their
+// keys: serial numbers alone and part and serial numbers together. A
+// BloomFilter over every item's serial key rules out almost every new serial
+// number in memory, and one over the pairs most that only share the serial
+// number with another part; what they let through is settled exactly by
+// probes of idx_items_serial_key. Rows without a serial number are never
+// duplicates. Deletes leave their keys in the filters, which only costs
+// probes.
+//
+// Not thread-safe; the owner adds every change it writes through Sync.
+class DuplicateDetector {
+public:
+    // Reads every item's keys into filters sized for a quarter more rows than
+    // the table has, plus |new_rows| about to be added. Fails, leaving no
+    // filters, when a read fails or |cancelled| is set meanwhile.
+    bool Build(Database& database, size_t new_rows = 0,
+               const std::atomic<bool>* cancelled = nullptr);
+    void Clear();
+    bool built() const { return built_; }
+
+    // Adds the keys of a row written since Build.
+    void Add(std::string_view part_number, std::string_view serial_number);
+    // Re-reads one row after a write and adds its keys; a missing row is left
+    // out.
+    bool Sync(Database& database, sqlite3_int64 id);
+
+    // Looks for items other than |exclude_id| with the part and serial
+    // number, or failing that the serial number. Until Build every check
+    // probes the index.
+    bool Check(Database& database, std::string_view part_number, std::string_view serial_number,
+               DuplicateMatch& match, sqlite3_int64 exclude_id = 0);
+
+    const DuplicateStats& stats() const { return stats_; }
+    size_t bytes() const { return serials_.bytes() + pairs_.bytes(); }
+
+private:
+    bool Probe(Database& database, const std::string& part_key, const std::string& serial_key,
+               bool same_part, sqlite3_int64 exclude_id, DuplicateMatch& match);
+    void AddKeys(std::string_view part_key, std::string_view serial_key);
+
+    bool built_ = false;
+    BloomFilter serials_;
+    BloomFilter pairs_;
+    DuplicateStats stats_;
+};
+
+enum class DuplicateScope {
+    kSerial,
+    kPartAndSerial,
+};
+
+struct DuplicateScanOptions {
+    DuplicateScope scope = DuplicateScope::kPartAndSerial;
+    // 0 uses every core.
+    unsigned threads = 0;
+};
+
+// Items sharing one key, oldest first.
+struct DuplicateGroup {
+    std::string part_key;
+    std::string serial_key;
+    std::vector<sqlite3_int64> ids;
+};
+
+struct DuplicateScanReport {
+    uint64_t rows = 0;
+    unsigned threads = 1;
+    double read_seconds = 0.0;
+    double group_seconds = 0.0;
+};
+
+// Every group of items with the same serial key, or part and serial keys,
+// ordered by their oldest item. The keys are read in one pass, then split by
+// hash into partitions on |threads| threads and each partition is grouped on
+// its own, so no two threads ever touch the same key.
+bool FindDuplicates(Database& database, const DuplicateScanOptions& options,
+                    std::vector<DuplicateGroup>& groups, DuplicateScanReport& report);
+
+}  // namespace inventory
@@ -0,0 +1,127 @@
+#include "fuzzy_match.h"
+
+#include <algorithm>
+
+namespace inventory {
+namespace {
+
+unsigned char Fold(char c) {
+    const unsigned char byte = static_cast<unsigned char>(c);
+    return byte >= 'A' && byte <= 'Z' ? byte - 'A' + 'a' : byte;
+}
+
+// The distinct case-folded byte pairs of |text|, sorted.
+void Bigrams(std::string_view text, std::vector<uint16_t>& bigrams) {
+    bigrams.clear();
+    for (size_t i = 1; i < text.size(); ++i) {
+        bigrams.push_back(static_cast<uint16_t>(Fold(text[i - 1]) << 8 | Fold(text[i])));
+    }
+    std::sort(bigrams.begin(), bigrams.end());
+    bigrams.erase(std::unique(bigrams.begin(), bigrams.end()), bigrams.end());
+}
+
+}  // namespace
+
+int FuzzyEditBudget(size_t length) {
+    return length < 4 ? 0 : static_cast<int>(std::clamp<size_t>(length / 5, 1, 3));
+}
+
+FuzzyMatcher::FuzzyMatcher(std::string_view term)
+    : length_(std::min(term.size(), kFuzzyMaxTerm)), budget_(FuzzyEditBudget(length_)) {
+    for (size_t i = 0; i < length_; ++i) {
+        const unsigned char c = Fold(term[i]);
+        masks_[c] |= uint64_t{1} << i;
+        if (c >= 'a' && c <= 'z') {
+            masks_[c - 'a' + 'A'] |= uint64_t{1} << i;
+        }
+    }
+}
+
+int FuzzyMatcher::Distance(std::string_view value) const {
+    if (length_ == 0) {
+        return 0;
+    }
+    // Bit i of vp / vn: the edit table rises / falls from row i to row i + 1
+    // in the current column; d0 marks the diagonal steps that stay level.
+    // Row 0 is all zeros, so a match may start anywhere in |value|.
+    const uint64_t last = uint64_t{1} << (length_ - 1);
+    uint64_t vp = ~uint64_t{0};
+    uint64_t vn = 0;
+    uint64_t d0 = 0;
+    uint64_t previous_mask = 0;
+    int score = static_cast<int>(length_);
+    int best = score;
+    for (char c : value) {
+        const uint64_t mask = masks_[static_cast<unsigned char>(c)];
+        const uint64_t swapped = ((~d0 & mask) << 1) & previous_mask;
+        d0 = (((mask & vp) + vp) ^ vp) | mask | vn | swapped;
+        const uint64_t hp = vn | ~(d0 | vp);
+        const uint64_t hn = vp & d0;
+        score += (hp & last) ? 1 : (hn & last) ? -1 : 0;
+        if (score < best && (best = score) == 0) {
+            break;
+        }
+        const uint64_t shifted = hp << 1;
+        vn = shifted & d0;
+        vp = (hn << 1) | ~(shifted | d0);
+        previous_mask = mask;
+    }
+    return best <= budget_ ? best : -1;
+}
+
+void BigramIndex::Add(std::string_view value) {
+    if (postings_.empty()) {
+        postings_.resize(1 << 16);
+    }
+    std::vector<uint16_t> bigrams;
+    Bigrams(value, bigrams);
+    for (uint16_t bigram : bigrams) {
+        postings_[bigram].push_back(static_cast<uint32_t>(size_));
+    }
+    ++size_;
+}
+
+void BigramIndex::Clear() {
+    postings_.clear();
+    size_ = 0;
+}
+
+bool BigramIndex::Candidates(std::string_view term, int budget,
+                             std::vector<uint32_t>& codes) const {
+    codes.clear();
+    std::vector<uint16_t> bigrams;
+    Bigrams(term.substr(0, kFuzzyMaxTerm), bigrams);
+    int needed = static_cast<int>(bigrams.size()) - 3 * budget;
+    if (needed <= 0) {
+        return false;
+    }
+    if (postings_.empty()) {
+        return true;
+    }
+    // A pair most values hold, like the "P-" of every part number, costs
+    // the most to count and rules out the least: count it as held instead.
+    std::vector<uint16_t> counted;
+    for (uint16_t bigram : bigrams) {
+        if (postings_[bigram].size() > size_ / 4) {
+            --needed;
+        } else {
+            counted.push_back(bigram);
+        }
+    }
+    if (needed <= 0) {
+        return false;
+    }
+    // Each code is taken once, when its count reaches |needed|.
+    std::vector<uint8_t> counts(size_);
+    for (uint16_t bigram : counted) {
+        for (uint32_t code : postings_[bigram]) {
+            if (++counts[code] == needed) {
+                codes.push_back(code);
+            }
+        }
+    }
+    std::sort(codes.begin(), codes.end());
+    return true;
+}
+
+}  // namespace inventory
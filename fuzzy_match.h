@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+namespace inventory {
+
+// Terms longer than this are cut to their first kFuzzyMaxTerm bytes.
+constexpr size_t kFuzzyMaxTerm = 64;
+
+// The edits a term of |length| bytes may be away from a value: none below
+// four bytes, one below ten, then one more per five bytes, up to three.
+int FuzzyEditBudget(size_t length);
+
+// A misspelled search term. Distance finds the fewest edits - inserting,
+// deleting or replacing a byte, or swapping two neighbouring bytes - that
+// turn the term into some part of a value, with ASCII letters compared
+// case-insensitively. It runs Myers' bit-parallel algorithm with Hyyro's
+// transposition step: one column of the edit table per value byte, in a few
+// word operations.
+class FuzzyMatcher {
+public:
+    explicit FuzzyMatcher(std::string_view term);
+
+    size_t length() const { return length_; }
+    int budget() const { return budget_; }
+
+    // The edits, or -1 when more than budget() are needed.
+    int Distance(std::string_view value) const;
+
+private:
+    uint64_t masks_[256] = {};
+    size_t length_ = 0;
+    int budget_ = 0;
+};
+
+// Postings of case-folded byte pairs over a list of values that only grows,
+// to skip the values a FuzzyMatcher cannot accept. An edit breaks at most
+// three of the term's pairs, so a value within |budget| edits holds all but
+// 3 * budget of the term's distinct pairs.
+class BigramIndex {
+public:
+    // Indexes the next value; its code is the previous size().
+    void Add(std::string_view value);
+    void Clear();
+    size_t size() const { return size_; }
+
+    // Codes of the values that pass the count filter for |term|, ascending.
+    // Returns false when the filter rules nothing out for a term this short
+    // and every value has to be checked.
+    bool Candidates(std::string_view term, int budget, std::vector<uint32_t>& codes) const;
+
+private:
+    std::vector<std::vector<uint32_t>> postings_;
+    size_t size_ = 0;
+};
+
+}  // namespace inventory
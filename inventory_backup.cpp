@@ -0,0 +1,122 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include "backup.h"
+
+namespace {
+
+void PrintUsage() {
+    std::fprintf(stderr,
+                 "usage: inventory_backup create [--plain] [--pages N] [--pause-ms N]\n"
+                 "                               DATABASE BACKUP\n"
+                 "       inventory_backup verify BACKUP\n"
+                 "       inventory_backup restore BACKUP DATABASE\n"
+                 "create copies DATABASE while it is in use, N pages (default 256) at a\n"
+                 "time with a pause in between, into a compressed, checksummed BACKUP, or a\n"
+                 "plain SQLite copy with --plain. restore replaces the contents of DATABASE,\n"
+                 "also while it is in use, after verifying BACKUP.\n");
+}
+
+// A whole number in [min, max], or -1.
+int ParseCount(const char* text, int min, int max) {
+    char* end = nullptr;
+    const long value = std::strtol(text, &end, 10);
+    return end != text && *end == '\0' && value >= min && value <= max ? static_cast<int>(value)
+                                                                       : -1;
+}
+
+int Create(const char* database_path, const char* backup_path,
+           const inventory::BackupOptions& options) {
+    inventory::BackupReport report;
+    if (!inventory::BackupDatabase(database_path, backup_path, options, report)) {
+        std::fprintf(stderr, "backup failed: %s\n", report.fatal_error.c_str());
+        return 1;
+    }
+    std::fprintf(stderr,
+                 "backed up %llu page(s), %.1f MB in %.2f s (%.1f MB/s); wrote %.1f MB\n",
+                 static_cast<unsigned long long>(report.pages), report.bytes / 1e6,
+                 report.seconds, report.MegabytesPerSecond(), report.written_bytes / 1e6);
+    return 0;
+}
+
+int Verify(const char* backup_path) {
+    inventory::BackupInfo info;
+    std::string error;
+    if (!inventory::VerifyBackup(backup_path, info, error)) {
+        std::fprintf(stderr, "%s is damaged: %s\n", backup_path, error.c_str());
+        return 1;
+    }
+    std::printf("%s: %s, %llu page(s) of %d bytes (%.1f MB) stored in %.1f MB; ok\n",
+                backup_path,
+                info.format == inventory::BackupFormat::kCompressed ? "compressed" : "plain",
+                static_cast<unsigned long long>(info.pages), info.page_size, info.bytes / 1e6,
+                info.stored_bytes / 1e6);
+    return 0;
+}
+
+int Restore(const char* backup_path, const char* database_path) {
+    inventory::BackupReport report;
+    if (!inventory::RestoreBackup(backup_path, database_path, report)) {
+        std::fprintf(stderr, "restore failed: %s\n", report.fatal_error.c_str());
+        return 1;
+    }
+    std::fprintf(stderr, "restored %llu page(s), %.1f MB in %.2f s\n",
+                 static_cast<unsigned long long>(report.pages), report.bytes / 1e6,
+                 report.seconds);
+    return 0;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        PrintUsage();
+        return 2;
+    }
+    const std::string command = argv[1];
+    if (command == "verify" && argc == 3) {
+        return Verify(argv[2]);
+    }
+    if (command == "restore" && argc == 4) {
+        return Restore(argv[2], argv[3]);
+    }
+    if (command != "create") {
+        PrintUsage();
+        return 2;
+    }
+
+    inventory::BackupOptions options;
+    const char* paths[2] = {};
+    int path_count = 0;
+    for (int i = 2; i < argc; ++i) {
+        const bool has_value = i + 1 < argc;
+        if (std::strcmp(argv[i], "--plain") == 0) {
+            options.format = inventory::BackupFormat::kDatabase;
+        } else if (std::strcmp(argv[i], "--pages") == 0 && has_value) {
+            if ((options.pages_per_step = ParseCount(argv[++i], 1, 1 << 30)) < 0) {
+                PrintUsage();
+                return 2;
+            }
+        } else if (std::strcmp(argv[i], "--pause-ms") == 0 && has_value) {
+            if ((options.pause_ms = ParseCount(argv[++i], 0, 60000)) < 0) {
+                PrintUsage();
+                return 2;
+            }
+        } else if (argv[i][0] == '-' && argv[i][1] != '\0') {
+            PrintUsage();
+            return 2;
+        } else if (path_count < 2) {
+            paths[path_count++] = argv[i];
+        } else {
+            PrintUsage();
+            return 2;
+        }
+    }
+    if (path_count != 2) {
+        PrintUsage();
+        return 2;
+    }
+    return Create(paths[0], paths[1], options);
+}
@@ -0,0 +1,1309 @@
+#include <sqlite3.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <new>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bulk_export.h"
+#include "database.h"
+#include "duplicates.h"
+#include "item_pager.h"
+#include "items.h"
+#include "metrics.h"
+#include "result_set.h"
+#include "rollups.h"
+#include "row_cache.h"
+#include "schema.h"
+#include "search_filter.h"
+#include "snapshot.h"
+#include "stock_ledger.h"
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+// Every allocation in the process goes through these, so a benchmark can
+// report allocations per row next to its time.
+namespace {
+std::atomic<uint64_t> g_allocations{0};
+}  // namespace
+
+void* operator new(size_t size) {
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* block = std::malloc(size ? size : 1)) {
+        return block;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* block) noexcept {
+    std::free(block);
+}
+
+void operator delete(void* block, size_t) noexcept {
+    std::free(block);
+}
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// Writes are committed in groups of this many, like the storage thread does
+// under load.
+constexpr int kWriteBatch = 1000;
+// Write benchmarks touch at most this many rows.
+constexpr int kMaxWrites = 20000;
+
+// Stock deltas are applied this many per call.
+constexpr int kDeltaBatch = 50;
+
+struct Measurement {
+    uint64_t operations = 0;
+    uint64_t allocations = 0;
+    double seconds = 0;
+    // Printed under the result line.
+    std::string note;
+};
+
+class Timer {
+public:
+    explicit Timer(Measurement& measurement)
+        : measurement_(measurement),
+          allocations_(g_allocations.load()),
+          start_(Clock::now()) {}
+
+    void Stop(uint64_t operations) {
+        measurement_.seconds = std::chrono::duration<double>(Clock::now() - start_).count();
+        measurement_.allocations = g_allocations.load() - allocations_;
+        measurement_.operations = operations;
+    }
+
+private:
+    Measurement& measurement_;
+    uint64_t allocations_;
+    Clock::time_point start_;
+};
+
+void PrintUsage() {
+    std::fprintf(stderr, "usage: inventory_bench [--rows N[,N...]] [--repeat N] [--threads N] "
+                         "[--metrics] [BENCHMARK...]\n"
+                         "BENCHMARK selects every benchmark whose name starts with it.\n"
+                         "Several --rows run every benchmark at each table size in turn.\n");
+}
+
+// Parses a comma-separated list of positive row counts.
+bool ParseRowCounts(const char* text, std::vector<int>& counts) {
+    counts.clear();
+    while (true) {
+        char* end = nullptr;
+        const long count = std::strtol(text, &end, 10);
+        if (end == text || count <= 0 || count > 100000000) {
+            return false;
+        }
+        counts.push_back(static_cast<int>(count));
+        if (*end == '\0') {
+            return true;
+        }
+        if (*end != ',') {
+            return false;
+        }
+        text = end + 1;
+    }
+}
+
+// Deterministic item |i| of the generated dataset.
+inventory::Item GeneratedItem(int i) {
+    static const char* const kNames[] = {"Hex bolt", "Lock washer", "Hydraulic pump",
+                                         "O-ring seal", "Gasket, flange", "Ventil Ø12 mm",
+                                         "Relay 24 V", "Bearing assy"};
+    char part[32];
+    char nsn[32];
+    char serial[32];
+    std::snprintf(part, sizeof(part), "P-%07d", i * 7919 % 10000000);
+    std::snprintf(nsn, sizeof(nsn), "%04d-01-%03d-%04d", 5300 + i % 700, i % 1000,
+                  i * 31 % 10000);
+    std::snprintf(serial, sizeof(serial), "SN-%08d", i);
+    inventory::Item item;
+    item.name = kNames[i % 8];
+    item.part_number = part;
+    item.nsn = nsn;
+    item.serial_number = serial;
+    item.quantity = i % 500;
+    return item;
+}
+
+// Runs |write| for 0..count-1 in transactions of kWriteBatch. With
+// |uncached|, every statement is finalized after each write, so that each one
+// prepares its statements again as it did before the statement cache.
+bool RunBatched(inventory::Database& database, int count, const std::function<bool(int)>& write,
+                bool uncached = false) {
+    for (int first = 0; first < count; first += kWriteBatch) {
+        if (!database.Execute("BEGIN")) {
+            return false;
+        }
+        const int last = std::min(first + kWriteBatch, count);
+        for (int i = first; i < last; ++i) {
+            if (!write(i)) {
+                database.Execute("ROLLBACK");
+                return false;
+            }
+            if (uncached) {
+                database.ClearStatements();
+            }
+        }
+        if (!database.Execute("COMMIT")) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Loads the rows with the indexes dropped and rebuilds them afterwards, as
+// inventory_generate does, so that a million-row table takes seconds rather
+// than minutes to set up.
+bool FillItems(inventory::Database& database, int rows) {
+    if (!inventory::SuspendItemIndexes(database)) {
+        return false;
+    }
+    const bool filled = RunBatched(database, rows, [&](int i) {
+        return inventory::InsertItem(database, GeneratedItem(i));
+    });
+    if (!database.Execute("BEGIN")) {
+        return false;
+    }
+    if (!inventory::RestoreItemIndexes(database) || !database.Execute("COMMIT")) {
+        database.Execute("ROLLBACK");
+        return false;
+    }
+    return filled;
+}
+
+bool OpenFilled(inventory::Database& database, int rows) {
+    return database.Open(":memory:") && inventory::EnsureSchema(database) &&
+           FillItems(database, rows);
+}
+
+struct Options {
+    int rows = 100000;
+    int repeat = 5;
+    // Writer threads in stock-stress.
+    int threads = 8;
+    // Print the latency histograms and statement counters after the run.
+    bool metrics = false;
+    // Set by the */uncached benchmarks: statements are prepared and finalized
+    // per operation.
+    bool uncached = false;
+};
+
+// The row representation the window used to build: one string per cell,
+// converted in two passes (size, then convert) like MultiByteToWideChar.
+std::u16string DecodeTwoPass(const unsigned char* text, int size) {
+    if (!text || size == 0) {
+        return {};
+    }
+    std::vector<char16_t> scratch(static_cast<size_t>(size));
+    size_t units = inventory::Utf8ToUtf16(reinterpret_cast<const char*>(text),
+                                          static_cast<size_t>(size), scratch.data());
+    std::u16string result(units, u'\0');
+    inventory::Utf8ToUtf16(reinterpret_cast<const char*>(text), static_cast<size_t>(size),
+                           result.data());
+    return result;
+}
+
+bool DecodePerCell(inventory::Database& database, const Options&, Measurement& measurement) {
+    inventory::Statement statement =
+        database.Prepare(std::string(inventory::kItemSelectColumns) + " ORDER BY id");
+    if (!statement) {
+        return false;
+    }
+    std::vector<std::vector<std::u16string>> rows;
+    Timer timer(measurement);
+    while (sqlite3_step(statement.get()) == SQLITE_ROW) {
+        std::vector<std::u16string> cells;
+        for (int column = 0; column < 7; ++column) {
+            cells.push_back(DecodeTwoPass(sqlite3_column_text(statement.get(), column),
+                                          sqlite3_column_bytes(statement.get(), column)));
+        }
+        rows.push_back(std::move(cells));
+    }
+    timer.Stop(rows.size());
+    return true;
+}
+
+bool DecodeArena(inventory::Database& database, const Options&, Measurement& measurement) {
+    inventory::Statement statement =
+        database.Prepare(std::string(inventory::kItemSelectColumns) + " ORDER BY id");
+    if (!statement) {
+        return false;
+    }
+    inventory::ResultSet rows;
+    Timer timer(measurement);
+    while (sqlite3_step(statement.get()) == SQLITE_ROW) {
+        rows.AppendRow(statement.get());
+    }
+    timer.Stop(rows.size());
+    return true;
+}
+
+// Scrolls the whole result top to bottom through the window's row cache,
+// touching every cell the way LVN_GETDISPINFO does.
+bool ScrollRowCache(inventory::Database& database, const Options&, Measurement& measurement) {
+    inventory::RowCache cache;
+    if (!cache.Reset(database, inventory::SearchFilter())) {
+        return false;
+    }
+    size_t checksum = 0;
+    Timer timer(measurement);
+    for (sqlite3_int64 i = 0; i < cache.total_count(); ++i) {
+        inventory::RowRef row = cache.Row(i);
+        if (!row) {
+            return false;
+        }
+        for (int column = 0; column < inventory::kItemTextColumns; ++column) {
+            checksum += row.text(static_cast<inventory::ItemColumn>(column)).size();
+        }
+    }
+    timer.Stop(static_cast<uint64_t>(cache.total_count()));
+    return checksum > 0;
+}
+
+// A blank search as the window opens it: the count, then the first screen
+// with its prefetch margin, instead of every row.
+bool OpenRowCache(inventory::Database& database, const Options&, Measurement& measurement) {
+    constexpr sqlite3_int64 kScreenRows = 40;
+    inventory::RowCache cache;
+    size_t checksum = 0;
+    Timer timer(measurement);
+    if (!cache.Reset(database, inventory::SearchFilter())) {
+        return false;
+    }
+    cache.Prefetch(0, kScreenRows - 1);
+    for (sqlite3_int64 i = 0; i < std::min(kScreenRows, cache.total_count()); ++i) {
+        inventory::RowRef row = cache.Row(i);
+        if (!row) {
+            return false;
+        }
+        checksum += row.text(inventory::kColumnName).size();
+    }
+    timer.Stop(1);
+    char note[96];
+    std::snprintf(note, sizeof(note), "%lld matches, %zu rows decoded",
+                  static_cast<long long>(cache.total_count()), cache.resident_rows());
+    measurement.note = note;
+    return checksum > 0;
+}
+
+// Drags the scroll thumb: a screen of rows at each of 1000 random places.
+bool JumpRowCache(inventory::Database& database, const Options&, Measurement& measurement) {
+    constexpr int kJumps = 1000;
+    constexpr sqlite3_int64 kScreenRows = 40;
+    inventory::RowCache cache;
+    if (!cache.Reset(database, inventory::SearchFilter()) || cache.total_count() == 0) {
+        return false;
+    }
+    std::mt19937 random(11);
+    size_t checksum = 0;
+    Timer timer(measurement);
+    for (int jump = 0; jump < kJumps; ++jump) {
+        const sqlite3_int64 first = static_cast<sqlite3_int64>(random() % cache.total_count());
+        const sqlite3_int64 last = std::min(first + kScreenRows, cache.total_count()) - 1;
+        cache.Prefetch(first, last);
+        for (sqlite3_int64 i = first; i <= last; ++i) {
+            inventory::RowRef row = cache.Row(i);
+            if (!row) {
+                return false;
+            }
+            checksum += row.text(inventory::kColumnName).size();
+        }
+    }
+    timer.Stop(kJumps);
+    char note[64];
+    std::snprintf(note, sizeof(note), "%lld pages read",
+                  static_cast<long long>(cache.pages_loaded()));
+    measurement.note = note;
+    return checksum > 0;
+}
+
+// Reads the 100 rows that start |percent|% of the way into the default
+// listing, either skipping to them with OFFSET or seeking past the key of the
+// row before them. The depth is clamped to the table's last page.
+bool ReadPageAt(inventory::Database& database, const Options& options, int percent, bool keyset,
+                Measurement& measurement) {
+    constexpr int kPageRows = 100;
+    const inventory::SearchFilter filter;
+    const int last_page = std::max(options.rows - kPageRows, 0);
+    const int depth = std::min(static_cast<int>(int64_t{options.rows} * percent / 100), last_page);
+    measurement.note = "depth " + std::to_string(depth);
+    inventory::PageKey key;
+    const bool keyed = keyset && depth > 0;
+    if (keyed) {
+        inventory::Statement statement =
+            inventory::PreparePage(database, filter, inventory::PageDirection::kOlder, false);
+        if (!statement) {
+            return false;
+        }
+        inventory::BindPage(statement.get(), filter, nullptr, 1, depth - 1);
+        if (sqlite3_step(statement.get()) != SQLITE_ROW) {
+            return false;
+        }
+        inventory::ReadPageKey(statement.get(), key);
+    }
+    inventory::ResultSet rows;
+    Timer timer(measurement);
+    for (int i = 0; i < options.repeat; ++i) {
+        inventory::Statement statement =
+            inventory::PreparePage(database, filter, inventory::PageDirection::kOlder, keyed);
+        if (!statement) {
+            return false;
+        }
+        inventory::BindPage(statement.get(), filter, keyed ? &key : nullptr, kPageRows,
+                            keyed ? 0 : depth);
+        rows.Clear();
+        while (sqlite3_step(statement.get()) == SQLITE_ROW) {
+            rows.AppendRow(statement.get());
+        }
+        if (rows.size() != kPageRows && static_cast<int>(rows.size()) != options.rows) {
+            return false;
+        }
+    }
+    timer.Stop(static_cast<uint64_t>(options.repeat));
+    return true;
+}
+
+// Exports the whole table to a temporary file.
+bool ExportTable(inventory::Database& database, inventory::ExportFormat format,
+                 Measurement& measurement) {
+    std::FILE* out = std::tmpfile();
+    if (!out) {
+        return false;
+    }
+    inventory::ExportOptions options;
+    options.format = format;
+    inventory::ExportReport report;
+    Timer timer(measurement);
+    bool ok = inventory::ExportItems(database, inventory::SearchFilter(), out, options, report);
+    timer.Stop(report.rows);
+    std::fclose(out);
+    char note[64];
+    std::snprintf(note, sizeof(note), "%.1f MB, %.0f MB/s", report.bytes / 1e6,
+                  report.MegabytesPerSecond());
+    measurement.note = note;
+    return ok;
+}
+
+// The triggers a write benchmark drops for its run, to show what they add to
+// each write.
+enum class Dropped {
+    kNone,
+    kJournal,
+    kRollups,
+};
+
+bool DropTriggers(inventory::Database& database, Dropped dropped) {
+    switch (dropped) {
+        case Dropped::kJournal:
+            return inventory::SuspendChangeJournal(database);
+        case Dropped::kRollups:
+            return inventory::SuspendRollups(database);
+        default:
+            return true;
+    }
+}
+
+bool RestoreTriggers(inventory::Database& database, Dropped dropped) {
+    switch (dropped) {
+        case Dropped::kJournal:
+            return inventory::ResumeChangeJournal(database);
+        case Dropped::kRollups:
+            if (!database.Execute("BEGIN IMMEDIATE")) {
+                return false;
+            }
+            if (!inventory::ResumeRollups(database) || !database.Execute("COMMIT")) {
+                database.Execute("ROLLBACK");
+                return false;
+            }
+            return true;
+        default:
+            return true;
+    }
+}
+
+bool InsertItems(inventory::Database&, const Options& options, Dropped dropped,
+                 Measurement& measurement) {
+    inventory::Database database;
+    if (!database.Open(":memory:") || !inventory::EnsureSchema(database) ||
+        !DropTriggers(database, dropped)) {
+        return false;
+    }
+    const int count = std::min(options.rows, kMaxWrites);
+    std::vector<inventory::Item> items;
+    for (int i = 0; i < count; ++i) {
+        items.push_back(GeneratedItem(options.rows + i));
+    }
+    Timer timer(measurement);
+    bool ok = RunBatched(
+        database, count, [&](int i) { return inventory::InsertItem(database, items[i]); },
+        options.uncached);
+    timer.Stop(static_cast<uint64_t>(count));
+    return ok;
+}
+
+// The same inserts into two tables, one with the change journal and one
+// without, a batch at a time each in turn, so that both see the same table
+// sizes and machine load. insert and insert/no-journal run one after the
+// other, and on a busy machine their difference is mostly noise; the median
+// of the per-batch ratios here is not. Timed over the journaled inserts.
+bool JournalOverhead(inventory::Database&, const Options& options, Measurement& measurement) {
+    inventory::Database journaled;
+    inventory::Database plain;
+    if (!journaled.Open(":memory:") || !inventory::EnsureSchema(journaled) ||
+        !plain.Open(":memory:") || !inventory::EnsureSchema(plain) ||
+        !inventory::SuspendChangeJournal(plain)) {
+        return false;
+    }
+    const int count = std::min(options.rows, kMaxWrites);
+    std::vector<inventory::Item> items;
+    for (int i = 0; i < count; ++i) {
+        items.push_back(GeneratedItem(options.rows + i));
+    }
+    std::vector<double> ratios;
+    double journaled_seconds = 0;
+    double plain_seconds = 0;
+    Timer timer(measurement);
+    for (int first = 0; first < count; first += kWriteBatch) {
+        const int last = std::min(first + kWriteBatch, count);
+        double seconds[2] = {};
+        for (int turn = 0; turn < 2; ++turn) {
+            // Alternate which goes first, so neither always runs on a warm cache.
+            const bool journal = (turn == 0) == ((first / kWriteBatch) % 2 == 0);
+            inventory::Database& database = journal ? journaled : plain;
+            const Clock::time_point start = Clock::now();
+            if (!RunBatched(database, last - first, [&](int i) {
+                    return inventory::InsertItem(database, items[first + i]);
+                })) {
+                return false;
+            }
+            seconds[journal ? 0 : 1] = std::chrono::duration<double>(Clock::now() - start).count();
+        }
+        journaled_seconds += seconds[0];
+        plain_seconds += seconds[1];
+        ratios.push_back(seconds[0] / seconds[1]);
+    }
+    timer.Stop(static_cast<uint64_t>(count));
+    measurement.seconds = journaled_seconds;
+    std::sort(ratios.begin(), ratios.end());
+    char note[160];
+    std::snprintf(note, sizeof(note),
+                  "median batch overhead %.1f%%, total %.1f%% (%.1f vs %.1f us/insert)",
+                  (ratios[ratios.size() / 2] - 1) * 100,
+                  (journaled_seconds / plain_seconds - 1) * 100, journaled_seconds * 1e6 / count,
+                  plain_seconds * 1e6 / count);
+    measurement.note = note;
+    return true;
+}
+
+bool UpdateItems(inventory::Database& database, const Options& options, Dropped dropped,
+                 Measurement& measurement) {
+    // Every run writes values the rows do not hold yet, so each update
+    // changes its row.
+    static int round = 0;
+    ++round;
+    const int count = std::min(options.rows, kMaxWrites);
+    std::vector<inventory::Item> items;
+    for (int i = 0; i < count; ++i) {
+        // Spread over the table so the updates do not share pages.
+        const int row = static_cast<int>(static_cast<long long>(i) * 7919 % options.rows);
+        items.push_back(GeneratedItem(row + round * options.rows));
+        items.back().id = row + 1;
+    }
+    if (!DropTriggers(database, dropped)) {
+        return false;
+    }
+    Timer timer(measurement);
+    bool ok = RunBatched(
+        database, count, [&](int i) { return inventory::UpdateItem(database, items[i]); },
+        options.uncached);
+    timer.Stop(static_cast<uint64_t>(count));
+    return RestoreTriggers(database, dropped) && ok;
+}
+
+bool DeleteItems(inventory::Database&, const Options& options, Dropped dropped,
+                 Measurement& measurement) {
+    inventory::Database database;
+    if (!OpenFilled(database, options.rows) || !DropTriggers(database, dropped)) {
+        return false;
+    }
+    const int count = std::min(options.rows, kMaxWrites);
+    Timer timer(measurement);
+    bool ok = RunBatched(
+        database, count,
+        [&](int i) {
+            const long long row = static_cast<long long>(i) * 7919 % options.rows;
+            return inventory::DeleteItem(database, row + 1);
+        },
+        options.uncached);
+    timer.Stop(static_cast<uint64_t>(count));
+    return ok;
+}
+
+bool ApplyDeltas(inventory::Database& database, const Options& options, Dropped dropped,
+                 Measurement& measurement) {
+    const int count = std::min(options.rows, kMaxWrites);
+    std::vector<inventory::StockDelta> deltas;
+    for (int i = 0; i < count; ++i) {
+        const long long row = static_cast<long long>(i) * 7919 % options.rows;
+        deltas.push_back({row + 1, i % 2 ? 1 : -1});
+    }
+    if (!DropTriggers(database, dropped)) {
+        return false;
+    }
+    Timer timer(measurement);
+    bool ok = RunBatched(
+        database, count / kDeltaBatch,
+        [&](int batch) {
+            const auto first = deltas.begin() + batch * kDeltaBatch;
+            return inventory::ApplyStockDeltas(
+                database, std::vector<inventory::StockDelta>(first, first + kDeltaBatch));
+        },
+        options.uncached);
+    timer.Stop(static_cast<uint64_t>(count / kDeltaBatch * kDeltaBatch));
+    return RestoreTriggers(database, dropped) && ok;
+}
+
+// Folds every movement recorded so far, i.e. those of the stock-deltas runs.
+bool CompactMovements(inventory::Database& database, const Options&, Measurement& measurement) {
+    inventory::StockCompaction compaction;
+    Timer timer(measurement);
+    // A negative age takes the movements of the current second too.
+    bool ok = inventory::CompactStockMovements(database, -1, &compaction);
+    timer.Stop(static_cast<uint64_t>(compaction.movements));
+    return ok;
+}
+
+void RemoveDatabaseFiles(const std::filesystem::path& path) {
+    std::error_code ignored;
+    for (const char* suffix : {"", "-wal", "-shm"}) {
+        std::filesystem::remove(path.string() + suffix, ignored);
+    }
+}
+
+// Quantity of every item (by id - 1), or empty on failure.
+std::vector<long long> ReadQuantities(inventory::Database& database) {
+    std::vector<long long> quantities;
+    inventory::Statement statement = database.Prepare("SELECT quantity FROM items ORDER BY id");
+    while (statement && sqlite3_step(statement.get()) == SQLITE_ROW) {
+        quantities.push_back(sqlite3_column_int64(statement.get(), 0));
+    }
+    return quantities;
+}
+
+// True when every item's quantity equals its checkpoint, if it has one, plus
+// the movements recorded after it.
+bool LedgerBalances(inventory::Database& database) {
+    inventory::Statement statement = database.Prepare(
+        "SELECT COUNT(*) FROM items"
+        " LEFT JOIN stock_checkpoints ON stock_checkpoints.item_id = items.id"
+        " WHERE items.quantity <> COALESCE(stock_checkpoints.quantity, 0) +"
+        " (SELECT COALESCE(SUM(delta), 0) FROM stock_movements"
+        "  WHERE item_id = items.id AND id > COALESCE(stock_checkpoints.through_id, 0))");
+    return statement && sqlite3_step(statement.get()) == SQLITE_ROW &&
+           sqlite3_column_int64(statement.get(), 0) == 0;
+}
+
+// Many connections apply random deltas to a few hot items in a file database
+// while the first one also compacts, then the totals are checked against
+// what every thread applied: a lost update makes the benchmark fail.
+bool StockStress(inventory::Database&, const Options& options, Measurement& measurement) {
+    constexpr int kItems = 64;
+    constexpr int kTotalDeltas = 4 * kMaxWrites;
+    const std::filesystem::path path =
+        std::filesystem::temp_directory_path() / "inventory_bench_stress.db";
+    RemoveDatabaseFiles(path);
+
+    std::vector<long long> initial;
+    {
+        inventory::Database database;
+        if (!database.Open(path.string()) || !database.Configure(inventory::StorageOptions()) ||
+            !inventory::EnsureSchema(database) || !FillItems(database, kItems)) {
+            return false;
+        }
+        initial = ReadQuantities(database);
+    }
+
+    const int threads = options.threads;
+    const int batches = std::max(1, kTotalDeltas / kDeltaBatch / threads);
+    std::vector<std::vector<long long>> applied(static_cast<size_t>(threads),
+                                                std::vector<long long>(kItems, 0));
+    std::atomic<bool> failed{false};
+    Timer timer(measurement);
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t] {
+            inventory::Database database;
+            if (!database.Open(path.string()) ||
+                !database.Configure(inventory::StorageOptions())) {
+                failed = true;
+                return;
+            }
+            std::mt19937 random(static_cast<unsigned>(t + 1));
+            std::vector<inventory::StockDelta> deltas(kDeltaBatch);
+            for (int batch = 0; batch < batches && !failed; ++batch) {
+                for (auto& delta : deltas) {
+                    delta.item_id = 1 + static_cast<sqlite3_int64>(random() % kItems);
+                    delta.delta = static_cast<int>(random() % 21) - 10;
+                }
+                bool ok = database.Execute("BEGIN IMMEDIATE");
+                ok = ok && inventory::ApplyStockDeltas(database, deltas);
+                if (ok && t == 0 && batch % 50 == 49) {
+                    ok = inventory::CompactStockMovements(database, -1);
+                }
+                if (!ok || !database.Execute("COMMIT")) {
+                    database.Execute("ROLLBACK");
+                    failed = true;
+                    return;
+                }
+                for (const auto& delta : deltas) {
+                    applied[static_cast<size_t>(t)][delta.item_id - 1] += delta.delta;
+                }
+            }
+        });
+    }
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    const uint64_t total = static_cast<uint64_t>(threads) * batches * kDeltaBatch;
+    timer.Stop(total);
+
+    bool ok = !failed;
+    if (ok) {
+        inventory::Database database;
+        std::vector<long long> quantities;
+        ok = database.Open(path.string());
+        if (ok) {
+            quantities = ReadQuantities(database);
+            ok = quantities.size() == initial.size() && LedgerBalances(database);
+        }
+        long long lost = 0;
+        for (size_t item = 0; ok && item < quantities.size(); ++item) {
+            long long expected = initial[item];
+            for (const auto& thread_applied : applied) {
+                expected += thread_applied[item];
+            }
+            lost += expected != quantities[item] ? 1 : 0;
+        }
+        ok = ok && lost == 0;
+        char note[128];
+        std::snprintf(note, sizeof(note), "%d threads, %.0f deltas/s, %s", threads,
+                      static_cast<double>(total) / measurement.seconds,
+                      ok ? "no lost updates" : "LOST UPDATES");
+        measurement.note = note;
+    }
+    RemoveDatabaseFiles(path);
+    return ok;
+}
+
+// One search the way the window runs it: count the matches, then read the
+// first page.
+bool RunSearch(inventory::Database& database, const Options& options,
+               const inventory::SearchFilter& filter, Measurement& measurement) {
+    inventory::RowCache cache;
+    Timer timer(measurement);
+    for (int i = 0; i < options.repeat; ++i) {
+        if (!cache.Reset(database, filter)) {
+            return false;
+        }
+        const sqlite3_int64 first_page = std::min<sqlite3_int64>(cache.total_count(), 100);
+        for (sqlite3_int64 row = 0; row < first_page; ++row) {
+            if (!cache.Row(row)) {
+                return false;
+            }
+        }
+        if (options.uncached) {
+            database.ClearStatements();
+        }
+    }
+    timer.Stop(static_cast<uint64_t>(options.repeat));
+    return true;
+}
+
+bool LoadSnapshot(inventory::Database& database, const Options& options,
+                  Measurement& measurement) {
+    inventory::SnapshotOptions snapshot_options;
+    snapshot_options.max_rows = options.rows;
+    inventory::ItemSnapshot snapshot(snapshot_options);
+    Timer timer(measurement);
+    bool ok = snapshot.Load(database);
+    timer.Stop(snapshot.size());
+    return ok;
+}
+
+// Loaded on first use, outside any timing, after the write benchmarks.
+inventory::ItemSnapshot& SharedSnapshot(inventory::Database& database) {
+    static inventory::ItemSnapshot snapshot;
+    if (!snapshot.loaded()) {
+        snapshot.Load(database);
+    }
+    return snapshot;
+}
+
+// The same search served from the snapshot: match in memory, then read the
+// first page by id.
+bool RunSnapshotSearch(inventory::Database& database, const Options& options,
+                       const inventory::SearchFilter& filter, Measurement& measurement) {
+    inventory::ItemSnapshot& snapshot = SharedSnapshot(database);
+    if (!snapshot.loaded()) {
+        return false;
+    }
+    inventory::RowCache cache;
+    std::vector<sqlite3_int64> ids;
+    Timer timer(measurement);
+    for (int i = 0; i < options.repeat; ++i) {
+        snapshot.Search(filter, ids);
+        cache.ResetWithIds(database, std::move(ids));
+        const sqlite3_int64 first_page = std::min<sqlite3_int64>(cache.total_count(), 100);
+        for (sqlite3_int64 row = 0; row < first_page; ++row) {
+            if (!cache.Row(row)) {
+                return false;
+            }
+        }
+        ids.clear();
+    }
+    timer.Stop(static_cast<uint64_t>(options.repeat));
+    return true;
+}
+
+// |text| with one typo picked by |random|: two neighbouring characters
+// swapped, one replaced, dropped or doubled.
+std::string WithTypo(std::string text, std::mt19937& random) {
+    if (text.size() < 2) {
+        return text;
+    }
+    const size_t position = random() % (text.size() - 1);
+    switch (random() % 4) {
+    case 0:
+        std::swap(text[position], text[position + 1]);
+        break;
+    case 1:
+        text[position] = text[position] == 'x' ? 'y' : 'x';
+        break;
+    case 2:
+        text.erase(position, 1);
+        break;
+    default:
+        text.insert(position, 1, text[position]);
+        break;
+    }
+    return text;
+}
+
+// Misspelled names and/or part numbers of random rows, searched in the
+// snapshot with FuzzySearch. The note gives the share of searches that found
+// the row at all and within the first 10 results, and the time of the first
+// search, which indexes the values.
+bool RunFuzzySearch(inventory::Database& database, const Options& options, bool name, bool part,
+                    Measurement& measurement) {
+    inventory::ItemSnapshot& snapshot = SharedSnapshot(database);
+    inventory::Statement statement =
+        database.Prepare("SELECT id, name, part_number FROM items WHERE id >= ?1 ORDER BY id "
+                         "LIMIT 1");
+    inventory::Statement last_id = database.Prepare("SELECT MAX(id) FROM items");
+    if (!snapshot.loaded() || !statement || !last_id || sqlite3_step(last_id.get()) != SQLITE_ROW) {
+        return false;
+    }
+    const sqlite3_int64 max_id = sqlite3_column_int64(last_id.get(), 0);
+
+    struct Query {
+        sqlite3_int64 id;
+        inventory::SearchFilter filter;
+    };
+    std::mt19937 random(42);
+    std::vector<Query> queries;
+    const int count = options.repeat * 20;
+    while (static_cast<int>(queries.size()) < count) {
+        sqlite3_reset(statement.get());
+        sqlite3_bind_int64(statement.get(), 1, 1 + random() % max_id);
+        if (sqlite3_step(statement.get()) != SQLITE_ROW) {
+            continue;
+        }
+        Query query;
+        query.id = sqlite3_column_int64(statement.get(), 0);
+        if (name) {
+            query.filter.name = WithTypo(
+                reinterpret_cast<const char*>(sqlite3_column_text(statement.get(), 1)), random);
+        }
+        if (part) {
+            query.filter.part_number = WithTypo(
+                reinterpret_cast<const char*>(sqlite3_column_text(statement.get(), 2)), random);
+        }
+        queries.push_back(std::move(query));
+    }
+
+    // The first search builds the bigram index; time it apart.
+    std::vector<sqlite3_int64> ids;
+    const Clock::time_point start = Clock::now();
+    snapshot.FuzzySearch(queries.front().filter, ids);
+    const double first_seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    int found = 0;
+    int top = 0;
+    Timer timer(measurement);
+    for (const Query& query : queries) {
+        snapshot.FuzzySearch(query.filter, ids);
+        const auto it = std::find(ids.begin(), ids.end(), query.id);
+        found += it != ids.end();
+        top += it != ids.end() && it - ids.begin() < 10;
+    }
+    timer.Stop(queries.size());
+    char note[128];
+    std::snprintf(note, sizeof(note),
+                  "%.0f queries/s, recall %.1f%%, in top 10 %.1f%%, first search %.0f ms",
+                  queries.size() / measurement.seconds, 100.0 * found / count,
+                  100.0 * top / count, first_seconds * 1e3);
+    measurement.note = note;
+    return true;
+}
+
+// Every group of one rollup, read for a report, or added up from the items
+// with the GROUP BY the rollup tables replace.
+bool RunRollupReport(inventory::Database& database, const Options& options,
+                     inventory::RollupKind kind, bool group_by, Measurement& measurement) {
+    const std::string key = inventory::RollupKey(kind);
+    inventory::Statement statement = database.Prepare(
+        "SELECT " + key + ", MIN(" + inventory::RollupColumn(kind) + "), COUNT(*)," +
+        " SUM(quantity), MIN(created_at), MAX(created_at) FROM items GROUP BY " + key);
+    if (!statement) {
+        return false;
+    }
+    inventory::RollupQuery query;
+    query.kind = kind;
+    std::vector<inventory::Rollup> rollups;
+    size_t groups = 0;
+    Timer timer(measurement);
+    for (int i = 0; i < options.repeat; ++i) {
+        if (group_by) {
+            sqlite3_reset(statement.get());
+            for (groups = 0; sqlite3_step(statement.get()) == SQLITE_ROW; ++groups) {
+            }
+        } else if (!inventory::QueryRollups(database, query, rollups)) {
+            return false;
+        } else {
+            groups = rollups.size();
+        }
+    }
+    timer.Stop(static_cast<uint64_t>(options.repeat));
+    measurement.note = std::to_string(groups) + " groups";
+    return groups > 0;
+}
+
+// Adds the items up again and compares every rollup, after the write
+// benchmarks have changed the table: any difference fails it.
+bool RunRollupCheck(inventory::Database& database, const Options&, Measurement& measurement) {
+    inventory::RollupCheck check;
+    Timer timer(measurement);
+    const bool ok = inventory::CheckRollups(database, check);
+    timer.Stop(static_cast<uint64_t>(check.groups));
+    measurement.note = std::to_string(check.mismatches.size()) + " groups differ";
+    return ok && check.mismatches.empty();
+}
+
+// Serial numbers checked for duplicates before saving, with the detector's
+// filters or, unbuilt, by index probes alone: new ones no item has, or those
+// of random existing items. The note gives the share of checks that probed
+// the index and found nothing, the filters' false-positive rate for new ones.
+bool RunDuplicateCheck(inventory::Database& database, const Options& options, bool existing,
+                       bool filtered, Measurement& measurement) {
+    inventory::DuplicateDetector detector;
+    const Clock::time_point start = Clock::now();
+    if (filtered && !detector.Build(database)) {
+        return false;
+    }
+    const double build_seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    // Rows the write benchmarks left, in random order.
+    inventory::Statement statement = database.Prepare(
+        "SELECT part_number, serial_number FROM items ORDER BY random() LIMIT ?");
+    if (!statement) {
+        return false;
+    }
+    const size_t count = static_cast<size_t>(options.repeat) * 20000;
+    sqlite3_bind_int64(statement.get(), 1, static_cast<sqlite3_int64>(count));
+    std::vector<inventory::Item> items;
+    while (sqlite3_step(statement.get()) == SQLITE_ROW) {
+        inventory::Item item;
+        item.part_number = reinterpret_cast<const char*>(sqlite3_column_text(statement.get(), 0));
+        item.serial_number =
+            reinterpret_cast<const char*>(sqlite3_column_text(statement.get(), 1));
+        items.push_back(std::move(item));
+    }
+    for (size_t i = items.size(); i > 0 && i < count; ++i) {
+        items.push_back(items[i % items.size()]);
+    }
+    for (size_t i = 0; !existing && i < items.size(); ++i) {
+        items[i].serial_number = "NEW-" + std::to_string(i);
+    }
+    size_t found = 0;
+    inventory::DuplicateMatch match;
+    Timer timer(measurement);
+    for (const inventory::Item& item : items) {
+        if (!detector.Check(database, item.part_number, item.serial_number, match)) {
+            return false;
+        }
+        found += match.kind != inventory::DuplicateKind::kNone;
+    }
+    timer.Stop(items.size());
+    const inventory::DuplicateStats& stats = detector.stats();
+    char note[192];
+    std::snprintf(note, sizeof(note),
+                  "%.0f checks/s, %zu found, %.3f%% false positives, filters %.1f MB built in"
+                  " %.0f ms",
+                  items.size() / measurement.seconds, found,
+                  100.0 * stats.false_positives / stats.checks, detector.bytes() / 1048576.0,
+                  build_seconds * 1e3);
+    measurement.note = note;
+    return !items.empty() && found == (existing ? items.size() : 0);
+}
+
+// Every group of items sharing a part and serial number.
+bool RunFindDuplicates(inventory::Database& database, const Options&, Measurement& measurement) {
+    std::vector<inventory::DuplicateGroup> groups;
+    inventory::DuplicateScanReport report;
+    Timer timer(measurement);
+    const bool ok = inventory::FindDuplicates(database, inventory::DuplicateScanOptions(),
+                                              groups, report);
+    timer.Stop(report.rows);
+    char note[160];
+    std::snprintf(note, sizeof(note), "%zu groups, read %.0f ms, grouped %.0f ms on %u thread(s)",
+                  groups.size(), report.read_seconds * 1e3, report.group_seconds * 1e3,
+                  report.threads);
+    measurement.note = note;
+    return ok;
+}
+
+struct Benchmark {
+    std::string name;
+    // Operations are rows for the decode benchmarks and searches or writes
+    // for the others.
+    std::function<bool(inventory::Database&, const Options&, Measurement&)> run;
+};
+
+std::vector<Benchmark> AllBenchmarks() {
+    std::vector<Benchmark> benchmarks = {
+        {"decode-per-cell", DecodePerCell},
+        {"decode-arena", DecodeArena},
+        {"scroll-row-cache", ScrollRowCache},
+        {"open-row-cache", OpenRowCache},
+        {"jump-row-cache", JumpRowCache},
+    };
+
+    // Every write with all its triggers, then without the journal's or the
+    // rollups', then with its statements prepared and finalized per write.
+    const struct {
+        const char* name;
+        bool (*run)(inventory::Database&, const Options&, Dropped, Measurement&);
+    } writes[] = {{"insert", InsertItems},
+                  {"update", UpdateItems},
+                  {"delete", DeleteItems},
+                  {"stock-deltas", ApplyDeltas}};
+    const struct {
+        const char* suffix;
+        Dropped dropped;
+        bool uncached;
+    } variants[] = {{"", Dropped::kNone, false},
+                    {"/no-journal", Dropped::kJournal, false},
+                    {"/no-rollups", Dropped::kRollups, false},
+                    {"/uncached", Dropped::kNone, true}};
+    for (const auto& write : writes) {
+        for (const auto& variant : variants) {
+            benchmarks.push_back(
+                {std::string(write.name) + variant.suffix,
+                 [run = write.run, dropped = variant.dropped, uncached = variant.uncached](
+                     inventory::Database& database, const Options& options,
+                     Measurement& measurement) {
+                     Options run_options = options;
+                     run_options.uncached = uncached;
+                     return run(database, run_options, dropped, measurement);
+                 }});
+        }
+    }
+
+    benchmarks.insert(benchmarks.end(), {
+        {"journal-overhead", JournalOverhead},
+        {"rollup-check", RunRollupCheck},
+        {"stock-compact", CompactMovements},
+        {"stock-stress", StockStress},
+        {"snapshot-load", LoadSnapshot},
+        {"fuzzy/name",
+         [](inventory::Database& database, const Options& options, Measurement& measurement) {
+             return RunFuzzySearch(database, options, true, false, measurement);
+         }},
+        {"fuzzy/part",
+         [](inventory::Database& database, const Options& options, Measurement& measurement) {
+             return RunFuzzySearch(database, options, false, true, measurement);
+         }},
+        {"fuzzy/name+part",
+         [](inventory::Database& database, const Options& options, Measurement& measurement) {
+             return RunFuzzySearch(database, options, true, true, measurement);
+         }},
+        {"export-csv",
+         [](inventory::Database& database, const Options&, Measurement& measurement) {
+             return ExportTable(database, inventory::ExportFormat::kCsv, measurement);
+         }},
+        {"export-jsonl",
+         [](inventory::Database& database, const Options&, Measurement& measurement) {
+             return ExportTable(database, inventory::ExportFormat::kJsonLines, measurement);
+         }},
+        {"export-binary",
+         [](inventory::Database& database, const Options&, Measurement& measurement) {
+             return ExportTable(database, inventory::ExportFormat::kBinary, measurement);
+         }},
+    });
+
+    // The totals per group, from the rollup tables and by GROUP BY.
+    const struct {
+        const char* name;
+        inventory::RollupKind kind;
+    } rollups[] = {{"nsn", inventory::RollupKind::kNsn},
+                   {"part", inventory::RollupKind::kPartNumber},
+                   {"name", inventory::RollupKind::kName}};
+    for (const auto& rollup : rollups) {
+        for (const bool group_by : {false, true}) {
+            benchmarks.push_back(
+                {std::string(group_by ? "rollup-group-by/" : "rollup-report/") + rollup.name,
+                 [kind = rollup.kind, group_by](inventory::Database& database,
+                                                const Options& options,
+                                                Measurement& measurement) {
+                     return RunRollupReport(database, options, kind, group_by, measurement);
+                 }});
+        }
+    }
+
+    // Duplicate serial numbers, checked one at a time and found all at once.
+    const struct {
+        const char* name;
+        bool existing;
+        bool filtered;
+    } checks[] = {{"new", false, true}, {"existing", true, true}, {"no-filter", false, false}};
+    for (const auto& check : checks) {
+        benchmarks.push_back(
+            {std::string("duplicates-check/") + check.name,
+             [existing = check.existing, filtered = check.filtered](
+                 inventory::Database& database, const Options& options,
+                 Measurement& measurement) {
+                 return RunDuplicateCheck(database, options, existing, filtered, measurement);
+             }});
+    }
+    benchmarks.push_back({"duplicates-find", RunFindDuplicates});
+
+    // One page of the default listing at increasing depths, as a share of the
+    // table so that every label holds at every --rows, by OFFSET and by key.
+    for (const int percent : {0, 1, 10, 50, 90}) {
+        for (const bool keyset : {false, true}) {
+            benchmarks.push_back(
+                {std::string(keyset ? "page-keyset/" : "page-offset/") +
+                     std::to_string(percent) + "%",
+                 [percent, keyset](inventory::Database& database, const Options& options,
+                                   Measurement& measurement) {
+                     return ReadPageAt(database, options, percent, keyset, measurement);
+                 }});
+        }
+    }
+
+    // Every combination of search fields, with terms that hit the generated
+    // data: scanning, through the trigram index and from the snapshot, and
+    // scanning with the statements prepared and finalized per search.
+    static const char* const kFieldNames[] = {"name", "part", "nsn", "serial", "qty"};
+    const struct {
+        const char* name;
+        inventory::SearchMode mode;
+        bool snapshot;
+        bool uncached;
+    } modes[] = {{"scan", inventory::SearchMode::kScan, false, false},
+                 {"trigram", inventory::SearchMode::kTrigramIndex, false, false},
+                 {"snapshot", inventory::SearchMode::kScan, true, false},
+                 {"uncached", inventory::SearchMode::kScan, false, true}};
+    for (const auto& mode : modes) {
+        for (unsigned mask = 0; mask < inventory::kFilterShapeCount; ++mask) {
+            inventory::SearchFilter filter;
+            filter.mode = mode.mode;
+            std::string name = std::string("search-") + mode.name + "/";
+            if (mask & inventory::kFilterName) {
+                filter.name = "ump";
+            }
+            if (mask & inventory::kFilterPartNumber) {
+                filter.part_number = "P-00";
+            }
+            if (mask & inventory::kFilterNsn) {
+                filter.nsn = "-01-1";
+            }
+            if (mask & inventory::kFilterSerialNumber) {
+                filter.serial_number = "SN-0001";
+            }
+            if (mask & inventory::kFilterQuantity) {
+                filter.has_quantity = true;
+                filter.quantity = 42;
+            }
+            for (int field = 0; field < 5; ++field) {
+                if (mask & (1u << field)) {
+                    name += name.back() == '/' ? "" : "+";
+                    name += kFieldNames[field];
+                }
+            }
+            if (mask == 0) {
+                name += "all";
+            }
+            const bool snapshot = mode.snapshot;
+            const bool uncached = mode.uncached;
+            benchmarks.push_back(
+                {name, [filter, snapshot, uncached](inventory::Database& database,
+                                                    const Options& options,
+                                                    Measurement& measurement) {
+                     Options run_options = options;
+                     run_options.uncached = uncached;
+                     return snapshot
+                                ? RunSnapshotSearch(database, run_options, filter, measurement)
+                                : RunSearch(database, run_options, filter, measurement);
+                 }});
+        }
+    }
+
+    // One pasted identifier of a row in the middle of the table, matched as
+    // text containing it (the '%' keeps a complete NSN off the key lookup)
+    // and as an exact key.
+    const struct {
+        const char* name;
+        bool exact;
+        inventory::SearchMode mode;
+        bool snapshot;
+    } lookups[] = {{"contains-scan", false, inventory::SearchMode::kScan, false},
+                   {"contains-trigram", false, inventory::SearchMode::kTrigramIndex, false},
+                   {"contains-snapshot", false, inventory::SearchMode::kScan, true},
+                   {"exact", true, inventory::SearchMode::kScan, false},
+                   {"exact-snapshot", true, inventory::SearchMode::kScan, true}};
+    for (const auto& lookup : lookups) {
+        for (const unsigned field : {inventory::kFilterNsn, inventory::kFilterSerialNumber}) {
+            const bool nsn = field == inventory::kFilterNsn;
+            const bool exact = lookup.exact;
+            const inventory::SearchMode mode = lookup.mode;
+            const bool snapshot = lookup.snapshot;
+            benchmarks.push_back(
+                {std::string("lookup-") + (nsn ? "nsn/" : "serial/") + lookup.name,
+                 [nsn, exact, mode, snapshot](inventory::Database& database,
+                                              const Options& options, Measurement& measurement) {
+                     const inventory::Item item = GeneratedItem(options.rows / 2);
+                     inventory::SearchFilter filter;
+                     filter.mode = mode;
+                     if (nsn) {
+                         filter.nsn = (exact ? "" : "%") + item.nsn;
+                     } else {
+                         filter.serial_number = (exact ? "=" : "") + item.serial_number;
+                     }
+                     return snapshot ? RunSnapshotSearch(database, options, filter, measurement)
+                                     : RunSearch(database, options, filter, measurement);
+                 }});
+        }
+    }
+    return benchmarks;
+}
+
+// Runs |selected| against a table of |options.rows| generated items.
+int RunBenchmarks(const std::vector<Benchmark>& selected, const Options& options) {
+    inventory::Database database;
+    if (!OpenFilled(database, options.rows)) {
+        std::fprintf(stderr, "cannot build the benchmark database\n");
+        return 1;
+    }
+    if (!inventory::TrigramIndexAvailable(database)) {
+        std::fprintf(stderr, "note: SQLite has no FTS5, trigram searches fall back to scans\n");
+    }
+
+    std::printf("%-40s %10s %14s %12s\n", "benchmark", "ops", "ns/op", "allocs/op");
+    for (const Benchmark& benchmark : selected) {
+        Measurement measurement;
+        if (!benchmark.run(database, options, measurement) || measurement.operations == 0) {
+            std::fprintf(stderr, "%s failed\n", benchmark.name.c_str());
+            return 1;
+        }
+        const double operations = static_cast<double>(measurement.operations);
+        std::printf("%-40s %10llu %14.1f %12.3f\n", benchmark.name.c_str(),
+                    static_cast<unsigned long long>(measurement.operations),
+                    measurement.seconds * 1e9 / operations,
+                    static_cast<double>(measurement.allocations) / operations);
+        if (!measurement.note.empty()) {
+            std::printf("  %s\n", measurement.note.c_str());
+        }
+    }
+    if (options.metrics) {
+        std::string report;
+        inventory::Metrics().Format(report);
+        report += "\n";
+        inventory::FormatDatabaseStats(database, report);
+        std::printf("\n%s", report.c_str());
+    }
+    return 0;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    Options options;
+    std::vector<int> row_counts = {options.rows};
+    std::vector<const char*> prefixes;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--rows") == 0 && i + 1 < argc) {
+            if (!ParseRowCounts(argv[++i], row_counts)) {
+                PrintUsage();
+                return 2;
+            }
+        } else if (std::strcmp(argv[i], "--repeat") == 0 && i + 1 < argc) {
+            options.repeat = std::atoi(argv[++i]);
+        } else if (std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            options.threads = std::atoi(argv[++i]);
+        } else if (std::strcmp(argv[i], "--metrics") == 0) {
+            options.metrics = true;
+        } else if (argv[i][0] == '-') {
+            PrintUsage();
+            return 2;
+        } else {
+            prefixes.push_back(argv[i]);
+        }
+    }
+    if (options.repeat <= 0 || options.threads <= 0) {
+        PrintUsage();
+        return 2;
+    }
+
+    std::vector<Benchmark> selected;
+    for (Benchmark& benchmark : AllBenchmarks()) {
+        bool wanted = prefixes.empty();
+        for (const char* prefix : prefixes) {
+            wanted = wanted || benchmark.name.compare(0, std::strlen(prefix), prefix) == 0;
+        }
+        if (wanted) {
+            selected.push_back(std::move(benchmark));
+        }
+    }
+    if (selected.empty()) {
+        PrintUsage();
+        return 2;
+    }
+
+    for (size_t run = 0; run < row_counts.size(); ++run) {
+        options.rows = row_counts[run];
+        if (row_counts.size() > 1) {
+            std::printf("%s%d rows\n", run > 0 ? "\n" : "", options.rows);
+        }
+        const int status = RunBenchmarks(selected, options);
+        if (status != 0) {
+            return status;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,104 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "database.h"
+#include "duplicates.h"
+#include "schema.h"
+
+namespace {
+
+void PrintUsage() {
+    std::fprintf(stderr,
+                 "usage: inventory_duplicates [--by serial|part-serial] [--threads N]\n"
+                 "                            [--limit N] DATABASE\n"
+                 "Lists every group of items sharing a serial number, or a part and serial\n"
+                 "number (the default), compared the way clerks type them. Prints one line\n"
+                 "per group, the oldest item first, and at most --limit groups (default all).\n"
+                 "Exits with 1 when there is any.\n");
+}
+
+bool ParseCount(const char* value, long long& count) {
+    char* end = nullptr;
+    count = std::strtoll(value, &end, 10);
+    return end != value && *end == '\0' && count >= 0;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    inventory::DuplicateScanOptions options;
+    long long limit = 0;
+    const char* database_path = nullptr;
+    bool valid = true;
+    for (int i = 1; valid && i < argc; ++i) {
+        const std::string option = argv[i];
+        if (option[0] != '-') {
+            valid = !database_path;
+            database_path = argv[i];
+            continue;
+        }
+        const char* value = i + 1 < argc ? argv[++i] : nullptr;
+        long long count = 0;
+        if (!value) {
+            valid = false;
+        } else if (option == "--by") {
+            if (std::strcmp(value, "serial") == 0) {
+                options.scope = inventory::DuplicateScope::kSerial;
+            } else if (std::strcmp(value, "part-serial") == 0) {
+                options.scope = inventory::DuplicateScope::kPartAndSerial;
+            } else {
+                valid = false;
+            }
+        } else if (option == "--threads") {
+            valid = ParseCount(value, count);
+            options.threads = static_cast<unsigned>(count);
+        } else if (option == "--limit") {
+            valid = ParseCount(value, limit);
+        } else {
+            valid = false;
+        }
+    }
+    if (!valid || !database_path) {
+        PrintUsage();
+        return 2;
+    }
+
+    inventory::Database database;
+    if (!database.Open(database_path) || !inventory::EnsureSchema(database)) {
+        std::fprintf(stderr, "cannot open database %s\n", database_path);
+        return 1;
+    }
+    std::vector<inventory::DuplicateGroup> groups;
+    inventory::DuplicateScanReport report;
+    if (!inventory::FindDuplicates(database, options, groups, report)) {
+        std::fprintf(stderr, "cannot read the items: %s\n", sqlite3_errmsg(database.handle()));
+        return 1;
+    }
+
+    unsigned long long items = 0;
+    for (size_t i = 0; i < groups.size(); ++i) {
+        const inventory::DuplicateGroup& group = groups[i];
+        items += group.ids.size();
+        if (limit > 0 && i >= static_cast<size_t>(limit)) {
+            continue;
+        }
+        if (options.scope == inventory::DuplicateScope::kPartAndSerial) {
+            std::printf("%s %s:", group.part_key.c_str(), group.serial_key.c_str());
+        } else {
+            std::printf("%s:", group.serial_key.c_str());
+        }
+        for (sqlite3_int64 id : group.ids) {
+            std::printf(" %lld", static_cast<long long>(id));
+        }
+        std::printf("\n");
+    }
+    std::fprintf(stderr,
+                 "%zu group(s) of %llu item(s) among %llu with a serial number; read in %.0f ms,"
+                 " grouped in %.0f ms on %u thread(s)\n",
+                 groups.size(), items, static_cast<unsigned long long>(report.rows),
+                 report.read_seconds * 1000.0, report.group_seconds * 1000.0, report.threads);
+    return groups.empty() ? 0 : 1;
+}
@@ -0,0 +1,106 @@
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#include "bulk_export.h"
+#include "database.h"
+#include "items.h"
+#include "schema.h"
+
+namespace {
+
+void PrintUsage() {
+    std::fprintf(stderr,
+                 "usage: inventory_export [--csv | --jsonl | --binary] [--trigram]\n"
+                 "                        [--name TEXT] [--part TEXT] [--nsn TEXT]\n"
+                 "                        [--serial TEXT] [--quantity N] [--as-of TIME]\n"
+                 "                        DATABASE [OUTPUT]\n"
+                 "OUTPUT defaults to standard output. --as-of exports the items as they\n"
+                 "were at TIME, in UTC, e.g. \"2024-05-01 12:00\".\n");
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    inventory::ExportOptions options;
+    inventory::ItemInput input;
+    inventory::SearchMode mode = inventory::SearchMode::kScan;
+    const char* database_path = nullptr;
+    const char* output_path = nullptr;
+
+    for (int i = 1; i < argc; ++i) {
+        const bool has_value = i + 1 < argc;
+        if (std::strcmp(argv[i], "--csv") == 0) {
+            options.format = inventory::ExportFormat::kCsv;
+        } else if (std::strcmp(argv[i], "--jsonl") == 0) {
+            options.format = inventory::ExportFormat::kJsonLines;
+        } else if (std::strcmp(argv[i], "--binary") == 0) {
+            options.format = inventory::ExportFormat::kBinary;
+        } else if (std::strcmp(argv[i], "--trigram") == 0) {
+            mode = inventory::SearchMode::kTrigramIndex;
+        } else if (std::strcmp(argv[i], "--name") == 0 && has_value) {
+            input.name = argv[++i];
+        } else if (std::strcmp(argv[i], "--part") == 0 && has_value) {
+            input.part_number = argv[++i];
+        } else if (std::strcmp(argv[i], "--nsn") == 0 && has_value) {
+            input.nsn = argv[++i];
+        } else if (std::strcmp(argv[i], "--serial") == 0 && has_value) {
+            input.serial_number = argv[++i];
+        } else if (std::strcmp(argv[i], "--quantity") == 0 && has_value) {
+            input.quantity = argv[++i];
+        } else if (std::strcmp(argv[i], "--as-of") == 0 && has_value) {
+            options.as_of = argv[++i];
+        } else if (argv[i][0] == '-' && argv[i][1] != '\0') {
+            PrintUsage();
+            return 2;
+        } else if (!database_path) {
+            database_path = argv[i];
+        } else if (!output_path) {
+            output_path = argv[i];
+        } else {
+            PrintUsage();
+            return 2;
+        }
+    }
+    if (!database_path) {
+        PrintUsage();
+        return 2;
+    }
+
+    inventory::Database database;
+    if (!database.Open(database_path) || !inventory::EnsureSchema(database)) {
+        std::fprintf(stderr, "cannot open database %s\n", database_path);
+        return 1;
+    }
+    if (mode == inventory::SearchMode::kTrigramIndex &&
+        !inventory::TrigramIndexAvailable(database)) {
+        mode = inventory::SearchMode::kScan;
+    }
+    // The same rules as the window's search fields.
+    inventory::SearchFilter filter;
+    if (inventory::ParseFilter(input, mode, filter) != inventory::InputProblem::kNone) {
+        std::fprintf(stderr, "quantity must be a whole number\n");
+        return 2;
+    }
+
+    const bool to_stdout = !output_path || std::strcmp(output_path, "-") == 0;
+    std::FILE* out = to_stdout ? stdout : std::fopen(output_path, "wb");
+    if (!out) {
+        std::fprintf(stderr, "cannot create %s\n", output_path);
+        return 1;
+    }
+    inventory::ExportReport report;
+    bool ok = inventory::ExportItems(database, filter, out, options, report);
+    if (!to_stdout && std::fclose(out) != 0) {
+        ok = false;
+        report.fatal_error = "cannot write the output";
+    }
+    if (!ok) {
+        std::fprintf(stderr, "export stopped: %s\n", report.fatal_error.c_str());
+    }
+    // Standard output may be the data itself, so the summary goes to stderr.
+    std::fprintf(stderr, "%llu row(s), %.1f MB in %.3f s (%.1f MB/s)\n",
+                 static_cast<unsigned long long>(report.rows), report.bytes / 1e6,
+                 report.seconds, report.MegabytesPerSecond());
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,103 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include "bulk_import.h"
+#include "database.h"
+#include "schema.h"
+
+namespace {
+
+void PrintUsage() {
+    std::fprintf(stderr,
+                 "usage: inventory_import [--csv | --tsv] [--batch ROWS]\n"
+                 "                        [--duplicates ignore|report|skip] DATABASE MANIFEST\n"
+                 "Rows whose serial number an item already has are reported (the default),\n"
+                 "left out too when the part number also matches (skip), or not looked for.\n");
+}
+
+const char* DuplicateText(const inventory::ImportDuplicate& duplicate) {
+    if (duplicate.kind == inventory::DuplicateKind::kSerial) {
+        return "serial number already used by item";
+    }
+    return duplicate.skipped ? "skipped, same part and serial number as item"
+                             : "same part and serial number as item";
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    inventory::ImportOptions options;
+    const char* database_path = nullptr;
+    const char* manifest_path = nullptr;
+
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--csv") == 0) {
+            options.delimiter = ',';
+        } else if (std::strcmp(argv[i], "--tsv") == 0) {
+            options.delimiter = '\t';
+        } else if (std::strcmp(argv[i], "--batch") == 0 && i + 1 < argc) {
+            long long rows = std::atoll(argv[++i]);
+            if (rows <= 0) {
+                PrintUsage();
+                return 2;
+            }
+            options.batch_size = static_cast<size_t>(rows);
+        } else if (std::strcmp(argv[i], "--duplicates") == 0 && i + 1 < argc) {
+            const char* mode = argv[++i];
+            if (std::strcmp(mode, "ignore") == 0) {
+                options.duplicates = inventory::ImportDuplicates::kIgnore;
+            } else if (std::strcmp(mode, "report") == 0) {
+                options.duplicates = inventory::ImportDuplicates::kReport;
+            } else if (std::strcmp(mode, "skip") == 0) {
+                options.duplicates = inventory::ImportDuplicates::kSkip;
+            } else {
+                PrintUsage();
+                return 2;
+            }
+        } else if (!database_path) {
+            database_path = argv[i];
+        } else if (!manifest_path) {
+            manifest_path = argv[i];
+        } else {
+            PrintUsage();
+            return 2;
+        }
+    }
+    if (!database_path || !manifest_path) {
+        PrintUsage();
+        return 2;
+    }
+
+    inventory::Database database;
+    if (!database.Open(database_path) || !inventory::EnsureSchema(database)) {
+        std::fprintf(stderr, "cannot open database %s\n", database_path);
+        return 1;
+    }
+
+    inventory::ImportReport report;
+    bool ok = inventory::ImportManifest(
+        database, manifest_path, options, report,
+        [](const inventory::ImportError& error) {
+            std::fprintf(stderr, "line %llu: %s\n",
+                         static_cast<unsigned long long>(error.line), error.message);
+        },
+        [](const inventory::ImportDuplicate& duplicate) {
+            std::fprintf(stderr, "line %llu: %s %lld\n",
+                         static_cast<unsigned long long>(duplicate.line), DuplicateText(duplicate),
+                         static_cast<long long>(duplicate.existing_id));
+        });
+    if (!ok) {
+        std::fprintf(stderr, "import stopped: %s\n", report.fatal_error.c_str());
+    }
+    std::printf("%llu row(s) imported, %llu rejected, %llu duplicate(s) of which %llu skipped,"
+                " %llu batch(es) in %.3f s (%.0f rows/s)\n",
+                static_cast<unsigned long long>(report.inserted),
+                static_cast<unsigned long long>(report.failed),
+                static_cast<unsigned long long>(report.duplicates),
+                static_cast<unsigned long long>(report.skipped),
+                static_cast<unsigned long long>(report.batches), report.seconds,
+                report.RowsPerSecond());
+    return ok && report.failed == 0 ? 0 : 1;
+}
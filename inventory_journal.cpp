@@ -0,0 +1,123 @@
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "change_journal.h"
+#include "database.h"
+#include "schema.h"
+
+namespace {
+
+void PrintUsage() {
+    std::fprintf(stderr,
+                 "usage: inventory_journal DATABASE deleted [COUNT]\n"
+                 "       inventory_journal DATABASE revert ENTRY\n"
+                 "       inventory_journal DATABASE compact [--keep-days N]\n"
+                 "deleted lists deleted items with their journal entry; revert puts back\n"
+                 "what an entry changed, e.g. restores a deleted item; compact drops\n"
+                 "entries older than N days (default %d).\n",
+                 inventory::kJournalKeepDays);
+}
+
+// A whole number in [0, max], or -1.
+long long ParseCount(const char* text, long long max) {
+    char* end = nullptr;
+    const long long value = std::strtoll(text, &end, 10);
+    return end != text && *end == '\0' && value >= 0 && value <= max ? value : -1;
+}
+
+int ListDeleted(inventory::Database& database, size_t count) {
+    std::vector<inventory::DeletedItem> items;
+    if (!inventory::ListDeletedItems(database, count, items)) {
+        std::fprintf(stderr, "cannot read the journal: %s\n", sqlite3_errmsg(database.handle()));
+        return 1;
+    }
+    for (const inventory::DeletedItem& deleted : items) {
+        std::printf("%lld\t%s\t%lld\t%s\t%s\t%s\t%s\t%d\n",
+                    static_cast<long long>(deleted.journal_id), deleted.deleted_at.c_str(),
+                    static_cast<long long>(deleted.item.id), deleted.item.name.c_str(),
+                    deleted.item.part_number.c_str(), deleted.item.nsn.c_str(),
+                    deleted.item.serial_number.c_str(), deleted.item.quantity);
+    }
+    std::fprintf(stderr, "%zu deleted item(s)\n", items.size());
+    return 0;
+}
+
+int Revert(inventory::Database& database, sqlite3_int64 entry) {
+    inventory::ItemChange change;
+    change.first = entry;
+    change.last = entry;
+    inventory::ItemChange revert;
+    if (!inventory::RevertChange(database, change, revert)) {
+        std::fprintf(stderr,
+                     "cannot revert entry %lld: it is gone, or the item has changed since\n",
+                     static_cast<long long>(entry));
+        return 1;
+    }
+    std::fprintf(stderr, "reverted entry %lld as entry %lld\n", static_cast<long long>(entry),
+                 static_cast<long long>(revert.first));
+    return 0;
+}
+
+int Compact(inventory::Database& database, int keep_days) {
+    sqlite3_int64 entries = 0;
+    inventory::JournalCompaction compaction;
+    do {
+        // One transaction per segment, so readers and the window's writes
+        // get in between.
+        if (!inventory::CompactJournal(database, keep_days * 24 * 3600,
+                                       inventory::kJournalCompactionSegment, &compaction)) {
+            std::fprintf(stderr, "compaction stopped: %s\n", sqlite3_errmsg(database.handle()));
+            return 1;
+        }
+        entries += compaction.entries;
+    } while (compaction.more);
+    std::string horizon;
+    inventory::JournalHorizon(database, horizon);
+    std::fprintf(stderr, "%lld entr%s dropped; the journal goes back to %s\n",
+                 static_cast<long long>(entries), entries == 1 ? "y" : "ies", horizon.c_str());
+    return 0;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        PrintUsage();
+        return 2;
+    }
+    const char* database_path = argv[1];
+    const std::string command = argv[2];
+    long long count = 50;
+    long long entry = 0;
+    long long keep_days = inventory::kJournalKeepDays;
+    bool valid = false;
+    if (command == "deleted" && argc <= 4) {
+        valid = argc == 3 || (count = ParseCount(argv[3], 1000000000)) >= 0;
+    } else if (command == "revert" && argc == 4) {
+        valid = (entry = ParseCount(argv[3], INT64_MAX)) > 0;
+    } else if (command == "compact" && (argc == 3 || argc == 5)) {
+        valid = argc == 3 || (std::strcmp(argv[3], "--keep-days") == 0 &&
+                              (keep_days = ParseCount(argv[4], 36500)) >= 0);
+    }
+    if (!valid) {
+        PrintUsage();
+        return 2;
+    }
+
+    inventory::Database database;
+    if (!database.Open(database_path) || !inventory::EnsureSchema(database)) {
+        std::fprintf(stderr, "cannot open database %s\n", database_path);
+        return 1;
+    }
+    if (command == "deleted") {
+        return ListDeleted(database, static_cast<size_t>(count));
+    }
+    if (command == "revert") {
+        return Revert(database, entry);
+    }
+    return Compact(database, static_cast<int>(keep_days));
+}
@@ -0,0 +1,313 @@
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "data_generator.h"
+#include "metrics.h"
+#include "service_client.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+enum LoadOp {
+    kLoadCount,
+    kLoadPage,
+    kLoadItem,
+    kLoadInsert,
+    kLoadOpCount,
+};
+
+constexpr const char* kLoadOpNames[kLoadOpCount] = {"count", "page", "load", "insert"};
+
+struct LoadOptions {
+    std::string address = "127.0.0.1:7411";
+    int connections = 4;
+    // Requests each connection keeps in flight.
+    int depth = 8;
+    double seconds = 10.0;
+    // When set, stops after this many requests instead.
+    uint64_t requests = 0;
+    uint64_t seed = 1;
+    unsigned mix[kLoadOpCount] = {30, 40, 25, 5};
+    int page_rows = 40;
+};
+
+struct LoadTotals {
+    inventory::LatencyHistogram latency[kLoadOpCount];
+    std::atomic<uint64_t> failed[kLoadOpCount] = {};
+    std::atomic<uint64_t> started{0};
+    Clock::time_point deadline;
+};
+
+// One client connection and the requests it keeps in flight. Each response
+// sends the next request from the client's receive thread.
+class LoadConnection {
+public:
+    LoadConnection(const LoadOptions& options, LoadTotals& totals, uint64_t seed)
+        : options_(options), totals_(totals), random_(seed), generator_([&] {
+              inventory::GeneratorOptions generator;
+              generator.seed = seed;
+              return generator;
+          }()) {
+        for (unsigned weight : options.mix) {
+            mix_total_ += weight;
+        }
+    }
+
+    bool Connect(std::string& error) { return client_.Connect(options_.address, error); }
+
+    bool Prepare(std::string& error) {
+        if (!client_.Count(inventory::SearchFilter(), rows_)) {
+            error = client_.last_error();
+            return false;
+        }
+        return true;
+    }
+
+    void Run() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            in_flight_ = options_.depth;
+        }
+        for (int i = 0; i < options_.depth; ++i) {
+            Issue();
+        }
+        std::unique_lock<std::mutex> lock(mutex_);
+        idle_.wait(lock, [this] { return in_flight_ == 0; });
+    }
+
+private:
+    bool Finished() {
+        if (options_.requests > 0) {
+            return totals_.started.fetch_add(1, std::memory_order_relaxed) >= options_.requests;
+        }
+        totals_.started.fetch_add(1, std::memory_order_relaxed);
+        return Clock::now() >= totals_.deadline;
+    }
+
+    void Issue() {
+        if (Finished()) {
+            Retire();
+            return;
+        }
+        inventory::ServiceRequest request;
+        LoadOp op;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            op = Choose();
+            Build(op, request);
+        }
+        const Clock::time_point start = Clock::now();
+        auto done = [this, op, start](inventory::ServiceResponse& response) {
+            totals_.latency[op].Record(inventory::ScopedLatency::ElapsedNs(start));
+            if (response.status != inventory::ServiceStatus::kOk &&
+                response.status != inventory::ServiceStatus::kNotFound) {
+                totals_.failed[op].fetch_add(1, std::memory_order_relaxed);
+            }
+            if (client_.connected()) {
+                Issue();
+            } else {
+                Retire();
+            }
+        };
+        const bool posted = client_.Post(std::move(request), std::move(done));
+        if (!posted) {
+            totals_.failed[op].fetch_add(1, std::memory_order_relaxed);
+            Retire();
+        }
+    }
+
+    void Retire() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (--in_flight_ == 0) {
+            idle_.notify_all();
+        }
+    }
+
+    LoadOp Choose() {
+        unsigned pick = static_cast<unsigned>(random_() % mix_total_);
+        for (int op = 0; op < kLoadOpCount; ++op) {
+            if (pick < options_.mix[op]) {
+                return static_cast<LoadOp>(op);
+            }
+            pick -= options_.mix[op];
+        }
+        return kLoadPage;
+    }
+
+    // Searches use a few typed characters of a name or part number, or a
+    // whole NSN, as at the counter.
+    void Terms(inventory::SearchFilter& filter) {
+        generator_.Next(item_);
+        switch (random_() % 4) {
+            case 0:
+                break;
+            case 1:
+                filter.name = item_.name.substr(0, 4);
+                break;
+            case 2:
+                filter.part_number = item_.part_number.substr(0, 5);
+                break;
+            default:
+                filter.nsn = item_.nsn;
+                break;
+        }
+    }
+
+    void Build(LoadOp op, inventory::ServiceRequest& request) {
+        switch (op) {
+            case kLoadCount:
+                request.op = inventory::ServiceOp::kCount;
+                Terms(request.filter);
+                break;
+            case kLoadPage:
+                request.op = inventory::ServiceOp::kPage;
+                Terms(request.filter);
+                request.limit = options_.page_rows;
+                break;
+            case kLoadItem:
+                request.op = inventory::ServiceOp::kLoad;
+                request.item_id =
+                    1 + static_cast<sqlite3_int64>(random_() % static_cast<uint64_t>(rows_ + 1));
+                break;
+            default:
+                request.op = inventory::ServiceOp::kInsert;
+                generator_.Next(request.item);
+                break;
+        }
+    }
+
+    const LoadOptions& options_;
+    LoadTotals& totals_;
+    std::mutex mutex_;
+    std::condition_variable idle_;
+    int in_flight_ = 0;
+    std::mt19937_64 random_;
+    inventory::ItemGenerator generator_;
+    inventory::Item item_;
+    unsigned mix_total_ = 0;
+    sqlite3_int64 rows_ = 0;
+    // Last, so that its receive thread is joined before the rest goes.
+    inventory::ServiceClient client_;
+};
+
+void PrintUsage() {
+    std::fprintf(stderr,
+                 "usage: inventory_loadgen [--connections N] [--depth N] [--seconds S]\n"
+                 "                         [--requests N] [--seed N]\n"
+                 "                         [--mix COUNT,PAGE,LOAD,INSERT] [ADDRESS]\n"
+                 "Drives an inventory_serviced at ADDRESS (default 127.0.0.1:7411).\n");
+}
+
+bool ParseMix(const char* text, unsigned (&mix)[kLoadOpCount]) {
+    unsigned total = 0;
+    for (int i = 0; i < kLoadOpCount; ++i) {
+        char* end = nullptr;
+        const unsigned long weight = std::strtoul(text, &end, 10);
+        const char expected = i + 1 < kLoadOpCount ? ',' : '\0';
+        if (end == text || *end != expected || weight > 1000000) {
+            return false;
+        }
+        mix[i] = static_cast<unsigned>(weight);
+        total += mix[i];
+        text = end + 1;
+    }
+    return total > 0;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    LoadOptions options;
+    bool has_address = false;
+
+    for (int i = 1; i < argc; ++i) {
+        const bool has_value = i + 1 < argc;
+        if (std::strcmp(argv[i], "--connections") == 0 && has_value) {
+            options.connections = std::atoi(argv[++i]);
+        } else if (std::strcmp(argv[i], "--depth") == 0 && has_value) {
+            options.depth = std::atoi(argv[++i]);
+        } else if (std::strcmp(argv[i], "--seconds") == 0 && has_value) {
+            options.seconds = std::atof(argv[++i]);
+        } else if (std::strcmp(argv[i], "--requests") == 0 && has_value) {
+            options.requests = std::strtoull(argv[++i], nullptr, 10);
+        } else if (std::strcmp(argv[i], "--seed") == 0 && has_value) {
+            options.seed = std::strtoull(argv[++i], nullptr, 10);
+        } else if (std::strcmp(argv[i], "--mix") == 0 && has_value) {
+            if (!ParseMix(argv[++i], options.mix)) {
+                PrintUsage();
+                return 2;
+            }
+        } else if (argv[i][0] == '-' && argv[i][1] != '\0') {
+            PrintUsage();
+            return 2;
+        } else if (!has_address) {
+            options.address = argv[i];
+            has_address = true;
+        } else {
+            PrintUsage();
+            return 2;
+        }
+    }
+    if (options.connections < 1 || options.connections > 1024 || options.depth < 1 ||
+        options.depth > 1024 || options.seconds <= 0.0) {
+        PrintUsage();
+        return 2;
+    }
+
+    LoadTotals totals;
+    std::vector<std::unique_ptr<LoadConnection>> connections;
+    for (int i = 0; i < options.connections; ++i) {
+        auto connection = std::make_unique<LoadConnection>(options, totals,
+                                                           options.seed + static_cast<uint64_t>(i));
+        std::string error;
+        if (!connection->Connect(error) || !connection->Prepare(error)) {
+            std::fprintf(stderr, "cannot connect to %s: %s\n", options.address.c_str(),
+                         error.c_str());
+            return 1;
+        }
+        connections.push_back(std::move(connection));
+    }
+
+    const Clock::time_point start = Clock::now();
+    totals.deadline = start + std::chrono::duration_cast<Clock::duration>(
+                                  std::chrono::duration<double>(options.seconds));
+    std::vector<std::thread> threads;
+    for (auto& connection : connections) {
+        threads.emplace_back(&LoadConnection::Run, connection.get());
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    uint64_t completed = 0;
+    uint64_t failed = 0;
+    std::printf("%-8s %10s %8s %10s %10s %10s %10s\n", "op", "requests", "failed", "mean_us",
+                "p50_us", "p99_us", "max_us");
+    for (int op = 0; op < kLoadOpCount; ++op) {
+        const inventory::HistogramSnapshot latency = totals.latency[op].Snapshot();
+        const uint64_t op_failed = totals.failed[op].load();
+        completed += latency.count;
+        failed += op_failed;
+        std::printf("%-8s %10llu %8llu %10.1f %10.1f %10.1f %10.1f\n", kLoadOpNames[op],
+                    static_cast<unsigned long long>(latency.count),
+                    static_cast<unsigned long long>(op_failed), latency.MeanNs() / 1e3,
+                    latency.Percentile(0.50) / 1e3, latency.Percentile(0.99) / 1e3,
+                    latency.max_ns / 1e3);
+    }
+    std::printf("%llu request(s) in %.2f s over %d connection(s) x %d in flight: %.0f req/s\n",
+                static_cast<unsigned long long>(completed), seconds, options.connections,
+                options.depth, seconds > 0.0 ? completed / seconds : 0.0);
+    return failed == 0 ? 0 : 1;
+}
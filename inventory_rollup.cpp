@@ -0,0 +1,157 @@
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "database.h"
+#include "rollups.h"
+#include "schema.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+void PrintUsage() {
+    std::fprintf(stderr,
+                 "usage: inventory_rollup DATABASE report [--by nsn|part|name]\n"
+                 "                        [--order value|quantity|items] [--prefix TEXT]\n"
+                 "                        [--limit N]\n"
+                 "       inventory_rollup DATABASE check\n"
+                 "       inventory_rollup DATABASE rebuild\n"
+                 "report prints the item count, total quantity and first and last creation\n"
+                 "time per NSN, part number or name (default nsn, in value order); check\n"
+                 "adds the items up again and lists the groups whose totals differ;\n"
+                 "rebuild replaces every total with the items added up again.\n");
+}
+
+double MillisecondsSince(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+int Report(inventory::Database& database, const inventory::RollupQuery& query) {
+    std::vector<inventory::Rollup> rollups;
+    const Clock::time_point start = Clock::now();
+    if (!inventory::QueryRollups(database, query, rollups)) {
+        std::fprintf(stderr, "cannot read the totals: %s\n", sqlite3_errmsg(database.handle()));
+        return 1;
+    }
+    const double milliseconds = MillisecondsSince(start);
+    std::string report;
+    inventory::FormatRollups(query.kind, rollups, report);
+    std::fwrite(report.data(), 1, report.size(), stdout);
+    std::fprintf(stderr, "%zu group(s) read in %.2f ms\n", rollups.size(), milliseconds);
+    return 0;
+}
+
+void PrintRollup(const char* side, const inventory::Rollup& rollup) {
+    std::printf("  %-8s %lld item(s), quantity %lld, %s .. %s\n", side,
+                static_cast<long long>(rollup.items), static_cast<long long>(rollup.quantity),
+                rollup.first_created_at.c_str(), rollup.last_created_at.c_str());
+}
+
+int Check(inventory::Database& database) {
+    inventory::RollupCheck check;
+    const Clock::time_point start = Clock::now();
+    if (!inventory::CheckRollups(database, check)) {
+        std::fprintf(stderr, "cannot check the totals: %s\n",
+                     sqlite3_errmsg(database.handle()));
+        return 1;
+    }
+    const double milliseconds = MillisecondsSince(start);
+    for (const inventory::RollupMismatch& mismatch : check.mismatches) {
+        std::printf("%s %s\n", inventory::RollupKindName(mismatch.kind),
+                    (mismatch.stored.items > 0 ? mismatch.stored : mismatch.expected)
+                        .value.c_str());
+        PrintRollup("stored", mismatch.stored);
+        PrintRollup("items", mismatch.expected);
+    }
+    std::fprintf(stderr, "%lld group(s) checked in %.0f ms, %zu differ\n",
+                 static_cast<long long>(check.groups), milliseconds, check.mismatches.size());
+    return check.mismatches.empty() ? 0 : 1;
+}
+
+int Rebuild(inventory::Database& database) {
+    const Clock::time_point start = Clock::now();
+    if (!database.Execute("BEGIN IMMEDIATE")) {
+        std::fprintf(stderr, "cannot start a transaction: %s\n",
+                     sqlite3_errmsg(database.handle()));
+        return 1;
+    }
+    if (!inventory::RebuildRollups(database) || !database.Execute("COMMIT")) {
+        std::fprintf(stderr, "cannot rebuild the totals: %s\n",
+                     sqlite3_errmsg(database.handle()));
+        database.Execute("ROLLBACK");
+        return 1;
+    }
+    std::fprintf(stderr, "totals rebuilt in %.0f ms\n", MillisecondsSince(start));
+    return 0;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        PrintUsage();
+        return 2;
+    }
+    const char* database_path = argv[1];
+    const std::string command = argv[2];
+    inventory::RollupQuery query;
+    bool valid = command == "check" || command == "rebuild" ? argc == 3 : command == "report";
+    for (int i = 3; valid && command == "report" && i < argc; ++i) {
+        const std::string option = argv[i];
+        const char* value = i + 1 < argc ? argv[++i] : nullptr;
+        if (!value) {
+            valid = false;
+        } else if (option == "--by") {
+            if (std::strcmp(value, "nsn") == 0) {
+                query.kind = inventory::RollupKind::kNsn;
+            } else if (std::strcmp(value, "part") == 0) {
+                query.kind = inventory::RollupKind::kPartNumber;
+            } else if (std::strcmp(value, "name") == 0) {
+                query.kind = inventory::RollupKind::kName;
+            } else {
+                valid = false;
+            }
+        } else if (option == "--order") {
+            if (std::strcmp(value, "value") == 0) {
+                query.order = inventory::RollupOrder::kValue;
+            } else if (std::strcmp(value, "quantity") == 0) {
+                query.order = inventory::RollupOrder::kQuantity;
+            } else if (std::strcmp(value, "items") == 0) {
+                query.order = inventory::RollupOrder::kItems;
+            } else {
+                valid = false;
+            }
+        } else if (option == "--prefix") {
+            query.prefix = value;
+        } else if (option == "--limit") {
+            char* end = nullptr;
+            const long long limit = std::strtoll(value, &end, 10);
+            valid = end != value && *end == '\0' && limit >= 0;
+            query.limit = valid ? static_cast<size_t>(limit) : 0;
+        } else {
+            valid = false;
+        }
+    }
+    if (!valid) {
+        PrintUsage();
+        return 2;
+    }
+
+    inventory::Database database;
+    if (!database.Open(database_path) || !inventory::EnsureSchema(database)) {
+        std::fprintf(stderr, "cannot open database %s\n", database_path);
+        return 1;
+    }
+    if (command == "report") {
+        return Report(database, query);
+    }
+    if (command == "check") {
+        return Check(database);
+    }
+    return Rebuild(database);
+}
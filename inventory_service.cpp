@@ -0,0 +1,408 @@
+#include "inventory_service.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <functional>
+#include <future>
+#include <utility>
+
+#include "item_pager.h"
+#include "metrics.h"
+#include "schema.h"
+#include "stock_ledger.h"
+
+namespace inventory {
+namespace {
+
+// Bounds the frame a single page request can produce.
+constexpr sqlite3_int64 kMaxPageRows = 10000;
+
+constexpr std::chrono::minutes kMaintenanceInterval(10);
+
+ServiceResponse Answer(const ServiceRequest& request, ServiceStatus status,
+                       std::string error = {}) {
+    ServiceResponse response;
+    response.id = request.id;
+    response.status = status;
+    response.error = std::move(error);
+    return response;
+}
+
+}  // namespace
+
+// A fixed set of read connections, each on its own thread, taking jobs from
+// one queue.
+class InventoryService::ReaderPool {
+public:
+    using Job = std::function<void(Database& database)>;
+
+    ~ReaderPool() { Stop(); }
+
+    bool Start(const std::string& path, const StorageOptions& options, int count) {
+        for (int i = 0; i < count; ++i) {
+            auto database = std::make_unique<Database>();
+            if (!database->Open(path) || !database->Configure(options)) {
+                Stop();
+                return false;
+            }
+            databases_.push_back(std::move(database));
+        }
+        for (auto& database : databases_) {
+            threads_.emplace_back(&ReaderPool::Run, this, database.get());
+        }
+        return true;
+    }
+
+    // Runs the jobs already queued, then joins the threads.
+    void Stop() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        wake_.notify_all();
+        for (std::thread& thread : threads_) {
+            thread.join();
+        }
+        threads_.clear();
+        databases_.clear();
+    }
+
+    void Post(Job job) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            queue_.push_back(std::move(job));
+        }
+        wake_.notify_one();
+    }
+
+private:
+    void Run(Database* database) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (true) {
+            wake_.wait(lock, [this] { return stopping_ || !queue_.empty(); });
+            if (queue_.empty()) {
+                return;
+            }
+            Job job = std::move(queue_.front());
+            queue_.pop_front();
+            lock.unlock();
+            job(*database);
+            lock.lock();
+        }
+    }
+
+    std::vector<std::unique_ptr<Database>> databases_;
+    std::vector<std::thread> threads_;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::deque<Job> queue_;
+    bool stopping_ = false;
+};
+
+// The socket is closed only when the last request holding the connection has
+// replied, so a late reply can never reach a reused descriptor.
+struct InventoryService::Connection {
+    explicit Connection(SocketHandle socket) : socket(socket) {}
+    ~Connection() { CloseSocket(socket); }
+
+    SocketHandle socket;
+    std::mutex send_mutex;
+    std::thread thread;
+    std::atomic<bool> finished{false};
+};
+
+InventoryService::InventoryService() = default;
+
+InventoryService::~InventoryService() {
+    Stop();
+}
+
+bool InventoryService::Start(const std::string& path, const ServiceOptions& options,
+                             std::string& error) {
+    Stop();
+    options_ = options;
+    if (!storage_.Start(path, options.storage)) {
+        error = "cannot open " + path;
+        return false;
+    }
+    readers_ = std::make_unique<ReaderPool>();
+    if (!readers_->Start(path, options.storage, std::max(options.readers, 1))) {
+        error = "cannot open read connections to " + path;
+        Stop();
+        return false;
+    }
+    {
+        Database probe;
+        if (probe.Open(path) && TrigramIndexAvailable(probe)) {
+            mode_ = SearchMode::kTrigramIndex;
+        }
+    }
+    listener_ = ListenSocket(options.address, error);
+    if (listener_ == kNoSocket) {
+        Stop();
+        return false;
+    }
+    accept_thread_ = std::thread(&InventoryService::AcceptLoop, this);
+    {
+        std::lock_guard<std::mutex> lock(maintenance_mutex_);
+        stopping_ = false;
+    }
+    maintenance_thread_ = std::thread(&InventoryService::MaintenanceLoop, this);
+    return true;
+}
+
+void InventoryService::Stop() {
+    if (maintenance_thread_.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(maintenance_mutex_);
+            stopping_ = true;
+        }
+        maintenance_wake_.notify_all();
+        maintenance_thread_.join();
+    }
+    if (accept_thread_.joinable()) {
+        ShutdownSocket(listener_);
+        accept_thread_.join();
+    }
+    CloseSocket(listener_);
+    if (listener_ != kNoSocket && options_.address.compare(0, 5, "unix:") == 0) {
+        std::remove(options_.address.c_str() + 5);
+    }
+    listener_ = kNoSocket;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const auto& connection : connections_) {
+            ShutdownSocket(connection->socket);
+        }
+    }
+    JoinFinished(true);
+    if (readers_) {
+        readers_->Stop();
+        readers_.reset();
+    }
+    storage_.Stop();
+}
+
+ServiceStats InventoryService::stats() const {
+    ServiceStats stats;
+    stats.connections = connection_count_.load(std::memory_order_relaxed);
+    stats.requests = requests_.load(std::memory_order_relaxed);
+    stats.failed = failed_.load(std::memory_order_relaxed);
+    stats.bad_frames = bad_frames_.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void InventoryService::AcceptLoop() {
+    while (true) {
+        const SocketHandle socket = AcceptSocket(listener_);
+        if (socket == kNoSocket) {
+            return;
+        }
+        connection_count_.fetch_add(1, std::memory_order_relaxed);
+        auto connection = std::make_shared<Connection>(socket);
+        JoinFinished(false);
+        std::lock_guard<std::mutex> lock(mutex_);
+        connection->thread = std::thread(&InventoryService::Serve, this, connection);
+        connections_.push_back(std::move(connection));
+    }
+}
+
+// Joins the threads of connections that have ended, or of every connection.
+void InventoryService::JoinFinished(bool all) {
+    std::vector<std::shared_ptr<Connection>> finished;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto kept = connections_.begin();
+        for (auto& connection : connections_) {
+            if (all || connection->finished.load(std::memory_order_acquire)) {
+                finished.push_back(std::move(connection));
+            } else {
+                *kept++ = std::move(connection);
+            }
+        }
+        connections_.erase(kept, connections_.end());
+    }
+    for (const auto& connection : finished) {
+        connection->thread.join();
+    }
+}
+
+void InventoryService::MaintenanceLoop() {
+    std::unique_lock<std::mutex> lock(maintenance_mutex_);
+    while (!maintenance_wake_.wait_for(lock, kMaintenanceInterval, [this] { return stopping_; })) {
+        lock.unlock();
+        CompactJournalSegments();
+        lock.lock();
+    }
+}
+
+// One segment per write, so that client writes queued meanwhile go in
+// between.
+void InventoryService::CompactJournalSegments() {
+    const int keep_seconds = options_.journal_keep_days * 24 * 3600;
+    while (true) {
+        auto compaction = std::make_shared<JournalCompaction>();
+        std::promise<bool> done;
+        storage_.PostWrite(
+            [keep_seconds, compaction](Database& database) {
+                return CompactJournal(database, keep_seconds, kJournalCompactionSegment,
+                                      compaction.get());
+            },
+            [&done](bool ok) { done.set_value(ok); });
+        if (!done.get_future().get() || !compaction->more) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(maintenance_mutex_);
+        if (stopping_) {
+            return;
+        }
+    }
+}
+
+void InventoryService::Serve(const std::shared_ptr<Connection>& connection) {
+    std::string body;
+    while (ReceiveFrame(connection->socket, body)) {
+        ServiceRequest request;
+        if (!DecodeRequest(body, request)) {
+            bad_frames_.fetch_add(1, std::memory_order_relaxed);
+            Reply(*connection, Answer(request, ServiceStatus::kBadRequest, "malformed request"));
+            break;
+        }
+        requests_.fetch_add(1, std::memory_order_relaxed);
+        Dispatch(connection, std::move(request));
+    }
+    ShutdownSocket(connection->socket);
+    connection->finished.store(true, std::memory_order_release);
+}
+
+void InventoryService::Dispatch(const std::shared_ptr<Connection>& connection,
+                                ServiceRequest request) {
+    // The client's search mode says what its own database had; here the
+    // server's decides.
+    request.filter.mode = mode_;
+    if (request.op == ServiceOp::kPing) {
+        Reply(*connection, Answer(request, ServiceStatus::kOk));
+    } else if (request.IsWrite()) {
+        PostWrite(connection, std::move(request));
+    } else {
+        readers_->Post([this, connection, request = std::move(request)](Database& database) {
+            ServiceResponse response = Answer(request, ServiceStatus::kOk);
+            RunRead(database, request, response);
+            Reply(*connection, response);
+        });
+    }
+}
+
+void InventoryService::RunRead(Database& database, const ServiceRequest& request,
+                               ServiceResponse& response) {
+    auto fail = [&](ServiceStatus status, const char* fallback) {
+        response.status = status;
+        const char* message = sqlite3_errmsg(database.handle());
+        const int code = sqlite3_errcode(database.handle());
+        response.error = code != SQLITE_OK && code != SQLITE_ROW && code != SQLITE_DONE
+                             ? message
+                             : fallback;
+        response.rows.clear();
+    };
+    switch (request.op) {
+        case ServiceOp::kCount:
+            if (!CountMatches(database, request.filter, response.value)) {
+                fail(ServiceStatus::kFailed, "the count failed");
+            }
+            break;
+        case ServiceOp::kPage: {
+            const sqlite3_int64 limit = std::min(request.limit, kMaxPageRows);
+            Statement page = PreparePage(database, request.filter, request.direction,
+                                         request.keyed);
+            if (!page) {
+                fail(ServiceStatus::kFailed, "the page query failed");
+                break;
+            }
+            BindPage(page.get(), request.filter, request.keyed ? &request.after : nullptr, limit,
+                     request.offset);
+            response.rows.reserve(static_cast<size_t>(limit));
+            ScopedLatency latency(
+                Metrics().shape(PageShape(request.filter, request.direction, request.keyed)));
+            int step;
+            while ((step = sqlite3_step(page.get())) == SQLITE_ROW) {
+                ReadServiceRow(page.get(), response.rows.emplace_back());
+            }
+            if (step != SQLITE_DONE) {
+                fail(ServiceStatus::kFailed, "the page query failed");
+            }
+            break;
+        }
+        case ServiceOp::kLoad: {
+            Statement load = database.Prepare(std::string(kItemSelectColumns) + " WHERE id = ?");
+            if (!load) {
+                fail(ServiceStatus::kFailed, "the load failed");
+                break;
+            }
+            sqlite3_bind_int64(load.get(), 1, request.item_id);
+            if (sqlite3_step(load.get()) == SQLITE_ROW) {
+                ReadServiceRow(load.get(), response.rows.emplace_back());
+            } else {
+                fail(ServiceStatus::kNotFound, "no such item");
+            }
+            break;
+        }
+        default:
+            fail(ServiceStatus::kBadRequest, "not a read");
+            break;
+    }
+    if (response.status != ServiceStatus::kOk && response.status != ServiceStatus::kNotFound) {
+        failed_.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void InventoryService::PostWrite(const std::shared_ptr<Connection>& connection,
+                                 ServiceRequest request) {
+    auto id = std::make_shared<sqlite3_int64>(0);
+    StorageWorker::Task task;
+    switch (request.op) {
+        case ServiceOp::kInsert:
+            task = [item = request.item, id](Database& database) {
+                return InsertItem(database, item, id.get());
+            };
+            break;
+        case ServiceOp::kUpdate:
+            // Both changes run in the write's savepoint, so they land together,
+            // as in the window.
+            task = [item = request.item, delta = request.delta](Database& database) {
+                const std::vector<StockDelta> deltas = {{item.id, delta}};
+                return UpdateItem(database, item) &&
+                       (delta == 0 || ApplyStockDeltas(database, deltas));
+            };
+            break;
+        default:
+            task = [item_id = request.item_id](Database& database) {
+                return DeleteItem(database, item_id);
+            };
+            break;
+    }
+    const ServiceResponse answer = Answer(request, ServiceStatus::kOk);
+    storage_.PostWrite(std::move(task), [this, connection, answer, id](bool ok) {
+        ServiceResponse response = answer;
+        if (ok) {
+            response.value = *id;
+        } else {
+            failed_.fetch_add(1, std::memory_order_relaxed);
+            response.status = ServiceStatus::kFailed;
+            response.error = storage_.last_error();
+        }
+        Reply(*connection, response);
+    });
+}
+
+void InventoryService::Reply(Connection& connection, const ServiceResponse& response) {
+    std::string frame;
+    EncodeResponse(response, frame);
+    std::lock_guard<std::mutex> lock(connection.send_mutex);
+    // A client that has gone away just misses its answers.
+    SendAll(connection.socket, frame.data(), frame.size());
+}
+
+}  // namespace inventory
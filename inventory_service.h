@@ -0,0 +1,92 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "change_journal.h"
+#include "database.h"
+#include "search_filter.h"
+#include "service_protocol.h"
+#include "storage_worker.h"
+
+namespace inventory {
+
+struct ServiceOptions {
+    // See ListenSocket.
+    std::string address = "127.0.0.1:7411";
+    // Read connections, each on its own thread.
+    int readers = 4;
+    // Change journal entries are kept this long; a maintenance thread drops
+    // older ones every few minutes.
+    int journal_keep_days = kJournalKeepDays;
+    StorageOptions storage;
+};
+
+struct ServiceStats {
+    uint64_t connections = 0;
+    uint64_t requests = 0;
+    uint64_t failed = 0;
+    uint64_t bad_frames = 0;
+};
+
+// Owns the database for any number of clients: searches, pages and loads run
+// on a pool of read connections, and every write goes through one
+// StorageWorker, so writers never meet on the file lock and clients never see
+// SQLITE_BUSY. Each client connection gets a thread that reads its frames and
+// hands the requests on without waiting for them, so pipelined requests from
+// one client run concurrently.
+class InventoryService {
+public:
+    InventoryService();
+    ~InventoryService();
+
+    InventoryService(const InventoryService&) = delete;
+    InventoryService& operator=(const InventoryService&) = delete;
+
+    // Opens and migrates the database, then starts listening.
+    bool Start(const std::string& path, const ServiceOptions& options, std::string& error);
+    // Disconnects every client, finishes the queued writes and stops.
+    void Stop();
+
+    ServiceStats stats() const;
+    StorageStats storage_stats() const { return storage_.stats(); }
+
+private:
+    class ReaderPool;
+    struct Connection;
+
+    void AcceptLoop();
+    void Serve(const std::shared_ptr<Connection>& connection);
+    void Dispatch(const std::shared_ptr<Connection>& connection, ServiceRequest request);
+    void RunRead(Database& database, const ServiceRequest& request, ServiceResponse& response);
+    void PostWrite(const std::shared_ptr<Connection>& connection, ServiceRequest request);
+    void Reply(Connection& connection, const ServiceResponse& response);
+    void JoinFinished(bool all);
+    void MaintenanceLoop();
+    void CompactJournalSegments();
+
+    ServiceOptions options_;
+    SearchMode mode_ = SearchMode::kScan;
+    StorageWorker storage_;
+    std::unique_ptr<ReaderPool> readers_;
+    SocketHandle listener_ = kNoSocket;
+    std::thread accept_thread_;
+    std::thread maintenance_thread_;
+    std::mutex maintenance_mutex_;
+    std::condition_variable maintenance_wake_;
+    bool stopping_ = false;
+    std::mutex mutex_;
+    std::vector<std::shared_ptr<Connection>> connections_;
+    std::atomic<uint64_t> connection_count_{0};
+    std::atomic<uint64_t> requests_{0};
+    std::atomic<uint64_t> failed_{0};
+    std::atomic<uint64_t> bad_frames_{0};
+};
+
+}  // namespace inventory
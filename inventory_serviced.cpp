@@ -0,0 +1,93 @@
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+
+#include "inventory_service.h"
+
+namespace {
+
+volatile std::sig_atomic_t stop_requested = 0;
+
+void OnSignal(int) {
+    stop_requested = 1;
+}
+
+void PrintUsage() {
+    std::fprintf(stderr,
+                 "usage: inventory_serviced [--listen ADDRESS] [--readers N]\n"
+                 "                          [--journal-days N] DATABASE\n"
+                 "ADDRESS is HOST:PORT, :PORT or unix:PATH (default 127.0.0.1:7411).\n"
+                 "Change journal entries older than N days (default %d) are dropped.\n"
+                 "Serves until interrupted.\n",
+                 inventory::kJournalKeepDays);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    inventory::ServiceOptions options;
+    const char* database_path = nullptr;
+
+    for (int i = 1; i < argc; ++i) {
+        const bool has_value = i + 1 < argc;
+        if (std::strcmp(argv[i], "--listen") == 0 && has_value) {
+            options.address = argv[++i];
+        } else if (std::strcmp(argv[i], "--readers") == 0 && has_value) {
+            options.readers = std::atoi(argv[++i]);
+            if (options.readers < 1 || options.readers > 64) {
+                PrintUsage();
+                return 2;
+            }
+        } else if (std::strcmp(argv[i], "--journal-days") == 0 && has_value) {
+            options.journal_keep_days = std::atoi(argv[++i]);
+            if (options.journal_keep_days < 1 || options.journal_keep_days > 36500) {
+                PrintUsage();
+                return 2;
+            }
+        } else if (argv[i][0] == '-' && argv[i][1] != '\0') {
+            PrintUsage();
+            return 2;
+        } else if (!database_path) {
+            database_path = argv[i];
+        } else {
+            PrintUsage();
+            return 2;
+        }
+    }
+    if (!database_path) {
+        PrintUsage();
+        return 2;
+    }
+
+    inventory::InventoryService service;
+    std::string error;
+    if (!service.Start(database_path, options, error)) {
+        std::fprintf(stderr, "cannot start the service: %s\n", error.c_str());
+        return 1;
+    }
+    std::signal(SIGINT, OnSignal);
+    std::signal(SIGTERM, OnSignal);
+    std::fprintf(stderr, "serving %s on %s with %d reader(s)\n", database_path,
+                 options.address.c_str(), options.readers);
+    while (!stop_requested) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    }
+
+    service.Stop();
+    const inventory::ServiceStats stats = service.stats();
+    const inventory::StorageStats storage = service.storage_stats();
+    std::fprintf(stderr,
+                 "%llu connection(s), %llu request(s), %llu failed, %llu bad frame(s); "
+                 "%llu write(s) in %llu commit(s)\n",
+                 static_cast<unsigned long long>(stats.connections),
+                 static_cast<unsigned long long>(stats.requests),
+                 static_cast<unsigned long long>(stats.failed),
+                 static_cast<unsigned long long>(stats.bad_frames),
+                 static_cast<unsigned long long>(storage.writes),
+                 static_cast<unsigned long long>(storage.commits));
+    return 0;
+}
@@ -0,0 +1,244 @@
+#include <sqlite3.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#if defined(__linux__)
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "cold_start.h"
+#include "database.h"
+#include "metrics.h"
+#include "row_cache.h"
+#include "schema.h"
+#include "search_filter.h"
+#include "snapshot.h"
+#include "storage_worker.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr int kPhases = static_cast<int>(inventory::StartupPhase::kStartupPhaseCount);
+
+void PrintUsage() {
+    std::fprintf(stderr,
+                 "usage: inventory_startup [--repeat N] [--page N] [--warm] DATABASE...\n"
+                 "Times the window's startup on each DATABASE without a window: as it starts\n"
+                 "now, showing the first N rows (default 100) before counting and warming up,\n"
+                 "and as it used to, loading the snapshot and listing every row first. Each\n"
+                 "run starts with the database evicted from the OS cache unless --warm.\n");
+}
+
+// Milliseconds from the start of a run to the end of each phase; negative for
+// phases the run does not have. kWindow is the start itself.
+struct Run {
+    double at[kPhases];
+    sqlite3_int64 rows = 0;
+
+    Run() { std::fill(at, at + kPhases, -1.0); }
+};
+
+class Stopwatch {
+public:
+    explicit Stopwatch(Run& run) : run_(run), start_(Clock::now()) {
+        Mark(inventory::StartupPhase::kWindow);
+    }
+
+    void Mark(inventory::StartupPhase phase) {
+        run_.at[static_cast<int>(phase)] =
+            std::chrono::duration<double, std::milli>(Clock::now() - start_).count();
+    }
+
+private:
+    Run& run_;
+    Clock::time_point start_;
+};
+
+// Drops the database's pages from the operating system's cache, as after a
+// reboot; elsewhere than Linux the runs start warm.
+void Evict(const std::string& path) {
+#if defined(__linux__)
+    for (const std::string& file : {path, path + "-wal"}) {
+        const int fd = open(file.c_str(), O_RDONLY);
+        if (fd >= 0) {
+            posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+            close(fd);
+        }
+    }
+#else
+    (void)path;
+#endif
+}
+
+// Reads the first |count| rows the listing shows.
+bool ReadRows(inventory::RowCache& rows, sqlite3_int64 count) {
+    for (sqlite3_int64 row = 0; row < std::min(count, rows.total_count()); ++row) {
+        if (!rows.Row(row)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// The storage thread's connection checks the schema; the window's own one
+// reads.
+bool Open(const std::string& path, inventory::StorageWorker& storage,
+          inventory::Database& database) {
+    const inventory::StorageOptions options;
+    if (!storage.Start(path, options) || !database.Open(path) || !database.Configure(options)) {
+        return false;
+    }
+    inventory::TrigramIndexAvailable(database);
+    return true;
+}
+
+// What the window does now: the first page, then in the background a count
+// and a warm-up on a connection of their own.
+bool RunLazy(const std::string& path, int page, Run& run) {
+    Stopwatch stopwatch(run);
+    inventory::StorageWorker storage;
+    inventory::Database database;
+    if (!Open(path, storage, database)) {
+        return false;
+    }
+    stopwatch.Mark(inventory::StartupPhase::kOpen);
+
+    sqlite3_int64 first_rows = 0;
+    inventory::RowCache rows;
+    if (!inventory::CountItemsUpTo(database, page, first_rows) ||
+        !rows.Reset(database, inventory::SearchFilter(), first_rows) ||
+        !ReadRows(rows, first_rows)) {
+        return false;
+    }
+    stopwatch.Mark(inventory::StartupPhase::kFirstRows);
+
+    inventory::Database background;
+    if (!background.Open(path) || !background.Configure(inventory::StorageOptions()) ||
+        !inventory::CountItems(background, run.rows)) {
+        return false;
+    }
+    stopwatch.Mark(inventory::StartupPhase::kCount);
+    inventory::ItemSnapshot snapshot;
+    if (!inventory::WarmUp(background, snapshot)) {
+        return false;
+    }
+    stopwatch.Mark(inventory::StartupPhase::kWarmUp);
+    return true;
+}
+
+// What the window used to do before it showed itself: load the snapshot,
+// list every row and read the first page.
+bool RunEager(const std::string& path, int page, Run& run) {
+    Stopwatch stopwatch(run);
+    inventory::StorageWorker storage;
+    inventory::Database database;
+    if (!Open(path, storage, database)) {
+        return false;
+    }
+    stopwatch.Mark(inventory::StartupPhase::kOpen);
+
+    inventory::ItemSnapshot snapshot;
+    inventory::RowCache rows;
+    if (snapshot.Load(database)) {
+        std::vector<sqlite3_int64> ids;
+        snapshot.Search(inventory::SearchFilter(), ids);
+        rows.ResetWithIds(database, std::move(ids));
+    } else if (!rows.Reset(database, inventory::SearchFilter())) {
+        return false;
+    }
+    if (!ReadRows(rows, page)) {
+        return false;
+    }
+    run.rows = rows.total_count();
+    stopwatch.Mark(inventory::StartupPhase::kFirstRows);
+    return true;
+}
+
+double Median(std::vector<double> values) {
+    std::sort(values.begin(), values.end());
+    return values[values.size() / 2];
+}
+
+void PrintRuns(const char* path, const char* kind, const std::vector<Run>& runs) {
+    std::printf("%-32s %10lld %-6s", path, static_cast<long long>(runs.front().rows), kind);
+    for (int phase = 1; phase < kPhases; ++phase) {
+        std::vector<double> times;
+        for (const Run& run : runs) {
+            times.push_back(run.at[phase]);
+        }
+        const double median = Median(times);
+        if (median < 0) {
+            std::printf(" %12s", "-");
+        } else {
+            std::printf(" %12.1f", median);
+        }
+    }
+    std::printf("\n");
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    int repeat = 3;
+    int page = 100;
+    bool warm = false;
+    std::vector<const char*> paths;
+    for (int i = 1; i < argc; ++i) {
+        const bool has_value = i + 1 < argc;
+        if (std::strcmp(argv[i], "--repeat") == 0 && has_value) {
+            repeat = std::atoi(argv[++i]);
+        } else if (std::strcmp(argv[i], "--page") == 0 && has_value) {
+            page = std::atoi(argv[++i]);
+        } else if (std::strcmp(argv[i], "--warm") == 0) {
+            warm = true;
+        } else if (argv[i][0] == '-' && argv[i][1] != '\0') {
+            PrintUsage();
+            return 2;
+        } else {
+            paths.push_back(argv[i]);
+        }
+    }
+    if (paths.empty() || repeat <= 0 || page <= 0) {
+        PrintUsage();
+        return 2;
+    }
+
+    // Milliseconds since the start of the run, medians of --repeat runs.
+    std::printf("%-32s %10s %-6s", "database", "rows", "start");
+    for (int phase = 1; phase < kPhases; ++phase) {
+        const auto name = static_cast<inventory::StartupPhase>(phase);
+        std::printf(" %12s", inventory::StartupPhaseName(name));
+    }
+    std::printf("\n");
+    for (const char* path : paths) {
+        std::vector<Run> lazy(repeat);
+        std::vector<Run> eager(repeat);
+        for (int i = 0; i < repeat; ++i) {
+            if (!warm) {
+                Evict(path);
+            }
+            if (!RunLazy(path, page, lazy[i])) {
+                std::fprintf(stderr, "%s: cannot start\n", path);
+                return 1;
+            }
+            if (!warm) {
+                Evict(path);
+            }
+            if (!RunEager(path, page, eager[i])) {
+                std::fprintf(stderr, "%s: cannot start\n", path);
+                return 1;
+            }
+        }
+        PrintRuns(path, "lazy", lazy);
+        PrintRuns(path, "eager", eager);
+    }
+    return 0;
+}
@@ -0,0 +1,100 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include "database.h"
+#include "workload.h"
+
+namespace {
+
+void PrintUsage() {
+    std::fprintf(stderr,
+                 "usage: inventory_workload [--operations N] [--seed N]\n"
+                 "                          [--mix SEARCH,SCROLL,SAVE,UPDATE,DELETE]\n"
+                 "                          [--no-snapshot] [--backup PATH [--backup-pages N]\n"
+                 "                          [--backup-pause-ms N]] DATABASE [REPORT]\n"
+                 "Writes a JSON report to REPORT, or to standard output. --backup backs the\n"
+                 "database up to PATH over and over meanwhile, N pages per step.\n");
+}
+
+bool ParseMix(const char* text, unsigned (&mix)[inventory::kWorkloadOperationCount]) {
+    for (int i = 0; i < inventory::kWorkloadOperationCount; ++i) {
+        char* end = nullptr;
+        const unsigned long weight = std::strtoul(text, &end, 10);
+        const char expected = i + 1 < inventory::kWorkloadOperationCount ? ',' : '\0';
+        if (end == text || *end != expected || weight > 1000000) {
+            return false;
+        }
+        mix[i] = static_cast<unsigned>(weight);
+        text = end + 1;
+    }
+    return true;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    inventory::WorkloadOptions options;
+    const char* database_path = nullptr;
+    const char* report_path = nullptr;
+
+    for (int i = 1; i < argc; ++i) {
+        const bool has_value = i + 1 < argc;
+        if (std::strcmp(argv[i], "--operations") == 0 && has_value) {
+            options.operations = std::strtoull(argv[++i], nullptr, 10);
+        } else if (std::strcmp(argv[i], "--seed") == 0 && has_value) {
+            options.seed = std::strtoull(argv[++i], nullptr, 10);
+        } else if (std::strcmp(argv[i], "--mix") == 0 && has_value) {
+            if (!ParseMix(argv[++i], options.mix)) {
+                PrintUsage();
+                return 2;
+            }
+        } else if (std::strcmp(argv[i], "--no-snapshot") == 0) {
+            options.use_snapshot = false;
+        } else if (std::strcmp(argv[i], "--backup") == 0 && has_value) {
+            options.backup_path = argv[++i];
+        } else if (std::strcmp(argv[i], "--backup-pages") == 0 && has_value) {
+            options.backup.pages_per_step = std::atoi(argv[++i]);
+        } else if (std::strcmp(argv[i], "--backup-pause-ms") == 0 && has_value) {
+            options.backup.pause_ms = std::atoi(argv[++i]);
+        } else if (argv[i][0] == '-' && argv[i][1] != '\0') {
+            PrintUsage();
+            return 2;
+        } else if (!database_path) {
+            database_path = argv[i];
+        } else if (!report_path) {
+            report_path = argv[i];
+        } else {
+            PrintUsage();
+            return 2;
+        }
+    }
+    if (!database_path || options.backup.pages_per_step < 1 || options.backup.pause_ms < 0) {
+        PrintUsage();
+        return 2;
+    }
+
+    inventory::WorkloadReport report;
+    if (!inventory::RunWorkload(database_path, inventory::StorageOptions(), options, report)) {
+        std::fprintf(stderr, "workload stopped: %s\n", report.fatal_error.c_str());
+        return 1;
+    }
+    std::string json;
+    inventory::FormatWorkloadJson(report, json);
+    const bool to_stdout = !report_path || std::strcmp(report_path, "-") == 0;
+    std::FILE* out = to_stdout ? stdout : std::fopen(report_path, "wb");
+    if (!out || std::fwrite(json.data(), 1, json.size(), out) != json.size() ||
+        (!to_stdout && std::fclose(out) != 0)) {
+        std::fprintf(stderr, "cannot write %s\n", report_path ? report_path : "the report");
+        return 1;
+    }
+    std::fprintf(stderr, "%llu operation(s), %llu failed, %.1f ops/s on the %s path\n",
+                 static_cast<unsigned long long>(report.operations),
+                 static_cast<unsigned long long>(report.failed), report.OperationsPerSecond(),
+                 report.search_path);
+    if (!report.backup_error.empty()) {
+        std::fprintf(stderr, "backup failed: %s\n", report.backup_error.c_str());
+    }
+    return report.failed == 0 && report.backup_error.empty() ? 0 : 1;
+}
@@ -0,0 +1,87 @@
+#include "item_keys.h"
+
+namespace inventory {
+namespace {
+
+constexpr int kNsnDigits = 13;
+constexpr int kFscDigits = 4;
+
+// Pasted identifiers often carry a tab or line break along.
+bool IsSeparator(char c) {
+    return c == '-' || c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+void BindKey(sqlite3_stmt* statement, int index, std::string_view text) {
+    const std::string key = IdentifierKey(text);
+    sqlite3_bind_text(statement, index, key.data(), static_cast<int>(key.size()),
+                      SQLITE_TRANSIENT);
+}
+
+}  // namespace
+
+bool ParseNsn(std::string_view text, int64_t& key) {
+    int fsc = 0;
+    int64_t niin = 0;
+    int digits = 0;
+    for (char c : text) {
+        if (IsSeparator(c)) {
+            continue;
+        }
+        if (c < '0' || c > '9' || digits == kNsnDigits) {
+            return false;
+        }
+        if (digits < kFscDigits) {
+            fsc = fsc * 10 + (c - '0');
+        } else {
+            niin = niin * 10 + (c - '0');
+        }
+        ++digits;
+    }
+    if (digits != kNsnDigits) {
+        return false;
+    }
+    key = PackNsn(fsc, niin);
+    return true;
+}
+
+std::string IdentifierKey(std::string_view text) {
+    std::string key;
+    key.reserve(text.size());
+    for (char c : text) {
+        if (IsSeparator(c)) {
+            continue;
+        }
+        key += c >= 'a' && c <= 'z' ? static_cast<char>(c - 'a' + 'A') : c;
+    }
+    return key;
+}
+
+bool IdentifierKeyEquals(std::string_view text, std::string_view key) {
+    size_t matched = 0;
+    for (char c : text) {
+        if (IsSeparator(c)) {
+            continue;
+        }
+        const char upper = c >= 'a' && c <= 'z' ? static_cast<char>(c - 'a' + 'A') : c;
+        if (matched == key.size() || key[matched] != upper) {
+            return false;
+        }
+        ++matched;
+    }
+    return matched == key.size();
+}
+
+int BindItemKeys(sqlite3_stmt* statement, int index, std::string_view nsn,
+                 std::string_view part_number, std::string_view serial_number) {
+    int64_t key = 0;
+    if (ParseNsn(nsn, key)) {
+        sqlite3_bind_int64(statement, index, key);
+    } else {
+        sqlite3_bind_null(statement, index);
+    }
+    BindKey(statement, index + 1, part_number);
+    BindKey(statement, index + 2, serial_number);
+    return index + 3;
+}
+
+}  // namespace inventory
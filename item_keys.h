@@ -0,0 +1,39 @@
+#pragma once
+
+#include <sqlite3.h>
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace inventory {
+
+// An NSN packed into 64 bits: the four-digit federal supply class above the
+// nine-digit NIIN. Keys sort by supply class first, so one class is a range.
+constexpr int kNiinBits = 30;
+
+constexpr int64_t PackNsn(int fsc, int64_t niin) {
+    return static_cast<int64_t>(fsc) << kNiinBits | niin;
+}
+constexpr int NsnSupplyClass(int64_t key) { return static_cast<int>(key >> kNiinBits); }
+constexpr int64_t NsnNiin(int64_t key) { return key & ((int64_t{1} << kNiinBits) - 1); }
+
+// Parses the 13 digits of an NSN however they are grouped: "5305-00-123-4567",
+// "5305001234567" and "5305 00 123 4567" give the same key. Only digits,
+// dashes and whitespace are allowed. Returns false for anything else.
+bool ParseNsn(std::string_view text, int64_t& key);
+
+// Part and serial numbers compared the way clerks type them: ASCII letters
+// upper-cased, whitespace and dashes dropped, everything else kept.
+std::string IdentifierKey(std::string_view text);
+
+// Same as IdentifierKey(text) == key, without building the key.
+bool IdentifierKeyEquals(std::string_view text, std::string_view key);
+
+// Binds nsn_key, part_key and serial_key for a row with these values at
+// |index|, |index| + 1 and |index| + 2. nsn_key is NULL when the NSN does not
+// parse. Returns the next free parameter index.
+int BindItemKeys(sqlite3_stmt* statement, int index, std::string_view nsn,
+                 std::string_view part_number, std::string_view serial_number);
+
+}  // namespace inventory
@@ -0,0 +1,137 @@
+#include "item_pager.h"
+
+#include <algorithm>
+#include <utility>
+
+#include "metrics.h"
+
+namespace inventory {
+namespace {
+
+// Position of created_at in kItemSelectColumns.
+constexpr int kCreatedAtColumn = 6;
+
+}  // namespace
+
+bool CountMatches(Database& database, const SearchFilter& filter, sqlite3_int64& count) {
+    const uint32_t shape = SearchShape(kSearchCount, filter.Shape());
+    Statement statement = database.PrepareShape(shape, [&filter] {
+        std::string sql = "SELECT COUNT(*) FROM items";
+        AppendFilterConditions(filter, sql);
+        return sql;
+    });
+    if (!statement) {
+        return false;
+    }
+    BindFilter(statement.get(), filter, 1);
+    ScopedLatency latency(Metrics().shape(shape));
+    if (sqlite3_step(statement.get()) != SQLITE_ROW) {
+        return false;
+    }
+    count = sqlite3_column_int64(statement.get(), 0);
+    return true;
+}
+
+uint32_t PageShape(const SearchFilter& filter, PageDirection direction, bool keyed) {
+    const bool older = direction == PageDirection::kOlder;
+    const SearchQuery query = older ? (keyed ? kSearchPageForwardKeyed : kSearchPageForward)
+                                    : (keyed ? kSearchPageBackwardKeyed : kSearchPageBackward);
+    return SearchShape(query, filter.Shape());
+}
+
+Statement PreparePage(Database& database, const SearchFilter& filter, PageDirection direction,
+                      bool keyed) {
+    const bool older = direction == PageDirection::kOlder;
+    return database.PrepareShape(PageShape(filter, direction, keyed), [&filter, older, keyed] {
+        std::string sql = kItemSelectColumns;
+        const char* key_condition = nullptr;
+        if (keyed) {
+            key_condition = older ? "(created_at, id) < (?, ?)" : "(created_at, id) > (?, ?)";
+        }
+        AppendFilterConditions(filter, sql, key_condition);
+        sql += older ? " ORDER BY created_at DESC, id DESC" : " ORDER BY created_at ASC, id ASC";
+        sql += " LIMIT ? OFFSET ?";
+        return sql;
+    });
+}
+
+void BindPage(sqlite3_stmt* statement, const SearchFilter& filter, const PageKey* after,
+              sqlite3_int64 limit, sqlite3_int64 offset) {
+    int index = BindFilter(statement, filter, 1);
+    if (after) {
+        sqlite3_bind_text(statement, index++, after->created_at.c_str(),
+                          static_cast<int>(after->created_at.size()), SQLITE_TRANSIENT);
+        sqlite3_bind_int64(statement, index++, after->id);
+    }
+    sqlite3_bind_int64(statement, index++, limit);
+    sqlite3_bind_int64(statement, index++, offset);
+}
+
+void ReadPageKey(sqlite3_stmt* statement, PageKey& key) {
+    const unsigned char* text = sqlite3_column_text(statement, kCreatedAtColumn);
+    key.created_at.assign(text ? reinterpret_cast<const char*>(text) : "",
+                          static_cast<size_t>(sqlite3_column_bytes(statement, kCreatedAtColumn)));
+    key.id = sqlite3_column_int64(statement, 0);
+}
+
+ItemPager::ItemPager(int page_size) : page_size_(std::max(page_size, 1)) {}
+
+void ItemPager::Reset(const SearchFilter& filter) {
+    filter_ = filter;
+    has_page_ = false;
+}
+
+bool ItemPager::Next(Database& database, ResultSet& rows) {
+    return Fetch(database, PageDirection::kOlder, rows);
+}
+
+bool ItemPager::Previous(Database& database, ResultSet& rows) {
+    return Fetch(database, PageDirection::kNewer, rows);
+}
+
+bool ItemPager::Fetch(Database& database, PageDirection direction, ResultSet& rows) {
+    rows.Clear();
+    if (direction == PageDirection::kNewer && !has_page_) {
+        return true;
+    }
+    Statement statement = PreparePage(database, filter_, direction, has_page_);
+    if (!statement) {
+        return false;
+    }
+    const PageKey* anchor = nullptr;
+    if (has_page_) {
+        anchor = direction == PageDirection::kOlder ? &last_ : &first_;
+    }
+    BindPage(statement.get(), filter_, anchor, page_size_, 0);
+
+    PageKey first;
+    PageKey last;
+    int result;
+    {
+        ScopedLatency latency(Metrics().shape(PageShape(filter_, direction, has_page_)));
+        while ((result = sqlite3_step(statement.get())) == SQLITE_ROW) {
+            ReadPageKey(statement.get(), rows.empty() ? first : last);
+            rows.AppendRow(statement.get());
+        }
+    }
+    if (result != SQLITE_DONE) {
+        rows.Clear();
+        return false;
+    }
+    if (rows.empty()) {
+        return true;
+    }
+    if (rows.size() == 1) {
+        last = first;
+    }
+    if (direction == PageDirection::kNewer) {
+        rows.Reverse();
+        std::swap(first, last);
+    }
+    first_ = std::move(first);
+    last_ = std::move(last);
+    has_page_ = true;
+    return true;
+}
+
+}  // namespace inventory
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <sqlite3.h>
+
+#include <string>
+
+#include "database.h"
+#include "result_set.h"
+#include "search_filter.h"
+
+namespace inventory {
+
+// A row's place in the listing order: created_at, then id, both descending.
+// created_at is fixed-width "YYYY-MM-DD HH:MM:SS.SSS" text, so it compares
+// correctly as stored.
+struct PageKey {
+    std::string created_at;
+    sqlite3_int64 id = 0;
+};
+
+enum class PageDirection {
+    // Towards older rows; the page comes out newest first.
+    kOlder,
+    // Towards newer rows; the page comes out oldest first.
+    kNewer,
+};
+
+// Counts the matches of |filter|.
+bool CountMatches(Database& database, const SearchFilter& filter, sqlite3_int64& count);
+
+// The SearchShape id of the page query below.
+uint32_t PageShape(const SearchFilter& filter, PageDirection direction, bool keyed);
+
+// The page query for |filter|'s shape: kItemSelectColumns rows in |direction|
+// order, starting strictly past a key when |keyed| is set. idx_items_recent
+// serves it as a range scan, so a page costs the same at any depth.
+Statement PreparePage(Database& database, const SearchFilter& filter, PageDirection direction,
+                      bool keyed);
+// Binds the filter, then |after| when the statement is keyed, then the limit
+// and offset.
+void BindPage(sqlite3_stmt* statement, const SearchFilter& filter, const PageKey* after,
+              sqlite3_int64 limit, sqlite3_int64 offset);
+// Reads the current row's key, reusing |key|'s buffer.
+void ReadPageKey(sqlite3_stmt* statement, PageKey& key);
+
+// Walks the matches of a search one page at a time, newest first, remembering
+// only the keys of the current page's first and last rows.
+class ItemPager {
+public:
+    explicit ItemPager(int page_size = 100);
+
+    // Starts over before the newest match of |filter|.
+    void Reset(const SearchFilter& filter);
+
+    // Replace |rows| with the page after or before the current one; the first
+    // Next after Reset reads the first page. At either end |rows| comes back
+    // empty and the current page stays put; a page shorter than page_size is
+    // the last one. False only on a database error.
+    bool Next(Database& database, ResultSet& rows);
+    bool Previous(Database& database, ResultSet& rows);
+
+    int page_size() const { return page_size_; }
+
+private:
+    bool Fetch(Database& database, PageDirection direction, ResultSet& rows);
+
+    SearchFilter filter_;
+    int page_size_;
+    bool has_page_ = false;
+    PageKey first_;
+    PageKey last_;
+};
+
+}  // namespace inventory
@@ -0,0 +1,160 @@
+#include "items.h"
+
+#include <climits>
+
+#include "item_keys.h"
+
+namespace inventory {
+namespace {
+
+bool IsSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\v' || c == '\f' || c == '\r';
+}
+
+void BindText(sqlite3_stmt* statement, int index, const std::string& value) {
+    sqlite3_bind_text(statement, index, value.data(), static_cast<int>(value.size()),
+                      SQLITE_STATIC);
+}
+
+}  // namespace
+
+bool ParseQuantity(std::string_view text, int& out) {
+    size_t i = 0;
+    while (i < text.size() && IsSpace(text[i])) {
+        ++i;
+    }
+    bool negative = false;
+    if (i < text.size() && (text[i] == '+' || text[i] == '-')) {
+        negative = text[i] == '-';
+        ++i;
+    }
+    if (i == text.size()) {
+        return false;
+    }
+    long long value = 0;
+    for (; i < text.size(); ++i) {
+        if (text[i] < '0' || text[i] > '9') {
+            return false;
+        }
+        value = value * 10 + (text[i] - '0');
+        if (value > static_cast<long long>(INT_MAX) + 1) {
+            return false;
+        }
+    }
+    if (negative) {
+        value = -value;
+    }
+    if (value > INT_MAX) {
+        return false;
+    }
+    out = static_cast<int>(value);
+    return true;
+}
+
+InputProblem ParseItem(const ItemInput& input, Item& item) {
+    if (input.name.empty() || input.part_number.empty() || input.nsn.empty() ||
+        input.serial_number.empty()) {
+        return InputProblem::kMissingField;
+    }
+    int quantity = 0;
+    if (!ParseQuantity(input.quantity, quantity)) {
+        return InputProblem::kBadQuantity;
+    }
+    item.name = input.name;
+    item.part_number = input.part_number;
+    item.nsn = input.nsn;
+    item.serial_number = input.serial_number;
+    item.quantity = quantity;
+    return InputProblem::kNone;
+}
+
+InputProblem ParseFilter(const ItemInput& input, SearchMode mode, SearchFilter& filter) {
+    filter = SearchFilter();
+    filter.mode = mode;
+    filter.name = input.name;
+    filter.part_number = input.part_number;
+    filter.nsn = input.nsn;
+    filter.serial_number = input.serial_number;
+    if (!input.quantity.empty()) {
+        if (!ParseQuantity(input.quantity, filter.quantity)) {
+            return InputProblem::kBadQuantity;
+        }
+        filter.has_quantity = true;
+    }
+    return InputProblem::kNone;
+}
+
+bool InsertItem(Database& database, const Item& item, sqlite3_int64* id) {
+    Statement statement = database.Prepare(
+        "INSERT INTO items (name, part_number, nsn, serial_number, quantity,"
+        " nsn_key, part_key, serial_key) VALUES (?, ?, ?, ?, ?, ?, ?, ?)");
+    if (!statement) {
+        return false;
+    }
+    BindText(statement.get(), 1, item.name);
+    BindText(statement.get(), 2, item.part_number);
+    BindText(statement.get(), 3, item.nsn);
+    BindText(statement.get(), 4, item.serial_number);
+    sqlite3_bind_int(statement.get(), 5, item.quantity);
+    BindItemKeys(statement.get(), 6, item.nsn, item.part_number, item.serial_number);
+    if (sqlite3_step(statement.get()) != SQLITE_DONE) {
+        return false;
+    }
+    if (id) {
+        *id = sqlite3_last_insert_rowid(database.handle());
+    }
+    return true;
+}
+
+bool UpdateItem(Database& database, const Item& item) {
+    Statement statement = database.Prepare(
+        "UPDATE items SET name = ?, part_number = ?, nsn = ?, serial_number = ?,"
+        " nsn_key = ?, part_key = ?, serial_key = ? WHERE id = ?");
+    if (!statement) {
+        return false;
+    }
+    BindText(statement.get(), 1, item.name);
+    BindText(statement.get(), 2, item.part_number);
+    BindText(statement.get(), 3, item.nsn);
+    BindText(statement.get(), 4, item.serial_number);
+    BindItemKeys(statement.get(), 5, item.nsn, item.part_number, item.serial_number);
+    sqlite3_bind_int64(statement.get(), 8, item.id);
+    // No row has the id: the item was deleted after it was read.
+    return sqlite3_step(statement.get()) == SQLITE_DONE &&
+           sqlite3_changes(database.handle()) > 0;
+}
+
+bool DeleteItem(Database& database, sqlite3_int64 id) {
+    Statement statement = database.Prepare("DELETE FROM items WHERE id = ?");
+    if (!statement) {
+        return false;
+    }
+    sqlite3_bind_int64(statement.get(), 1, id);
+    return sqlite3_step(statement.get()) == SQLITE_DONE;
+}
+
+bool LoadItem(Database& database, sqlite3_int64 id, Item& item) {
+    Statement statement = database.Prepare(
+        "SELECT name, part_number, nsn, serial_number, quantity FROM items WHERE id = ?");
+    if (!statement) {
+        return false;
+    }
+    sqlite3_bind_int64(statement.get(), 1, id);
+    if (sqlite3_step(statement.get()) != SQLITE_ROW) {
+        return false;
+    }
+    auto text = [&](int column) {
+        const unsigned char* value = sqlite3_column_text(statement.get(), column);
+        return std::string(value ? reinterpret_cast<const char*>(value) : "",
+                           static_cast<size_t>(sqlite3_column_bytes(statement.get(), column)));
+    };
+    item.id = id;
+    item.name = text(0);
+    item.part_number = text(1);
+    item.nsn = text(2);
+    item.serial_number = text(3);
+    item.quantity = sqlite3_column_int(statement.get(), 4);
+    return true;
+}
+
+}  // namespace inventory
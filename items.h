@@ -0,0 +1,56 @@
+#pragma once
+
+#include <sqlite3.h>
+
+#include <string>
+#include <string_view>
+
+#include "database.h"
+#include "search_filter.h"
+
+namespace inventory {
+
+struct Item {
+    sqlite3_int64 id = 0;
+    std::string name;
+    std::string part_number;
+    std::string nsn;
+    std::string serial_number;
+    int quantity = 0;
+};
+
+// The item fields as typed, in UTF-8, before validation.
+struct ItemInput {
+    std::string name;
+    std::string part_number;
+    std::string nsn;
+    std::string serial_number;
+    std::string quantity;
+};
+
+enum class InputProblem {
+    kNone,
+    kMissingField,
+    kBadQuantity,
+};
+
+// Parses a quantity exactly like the quantity edit box does: optional leading
+// whitespace, an optional sign and digits that fit in an int, nothing after.
+bool ParseQuantity(std::string_view text, int& out);
+
+// Every text field is required and the quantity must parse. |item.id| is
+// left unchanged.
+InputProblem ParseItem(const ItemInput& input, Item& item);
+// Empty fields are left out of the search; a non-empty quantity must parse.
+InputProblem ParseFilter(const ItemInput& input, SearchMode mode, SearchFilter& filter);
+
+// The quantity is recorded as the item's opening stock movement in the same
+// statement.
+bool InsertItem(Database& database, const Item& item, sqlite3_int64* id = nullptr);
+// Rewrites the text fields only; quantities change through ApplyStockDeltas.
+// Fails if no item has |item.id|.
+bool UpdateItem(Database& database, const Item& item);
+bool DeleteItem(Database& database, sqlite3_int64 id);
+bool LoadItem(Database& database, sqlite3_int64 id, Item& item);
+
+}  // namespace inventory
@@ -0,0 +1,133 @@
+#include "like_match.h"
+
+namespace inventory {
+namespace {
+
+// Decodes one UTF-8 character starting at |position| and advances past it.
+// Bytes that do not form valid UTF-8 are taken one at a time, as SQLite does.
+unsigned NextChar(std::string_view text, size_t& position) {
+    unsigned char lead = static_cast<unsigned char>(text[position++]);
+    if (lead < 0xC0) {
+        return lead;
+    }
+    unsigned value = lead;
+    while (position < text.size() &&
+           (static_cast<unsigned char>(text[position]) & 0xC0) == 0x80) {
+        value = (value << 6) | (static_cast<unsigned char>(text[position++]) & 0x3F);
+    }
+    return value;
+}
+
+unsigned Fold(unsigned c) {
+    return c >= 'A' && c <= 'Z' ? c - 'A' + 'a' : c;
+}
+
+// Matches |pattern| from |p| against |text| from |t| to the end, with
+// single-level backtracking to the most recent '%'.
+bool MatchFrom(std::string_view pattern, size_t p, std::string_view text, size_t t,
+               bool anchored_end) {
+    size_t star_pattern = std::string_view::npos;
+    size_t star_text = 0;
+    while (true) {
+        if (p < pattern.size() && pattern[p] == '%') {
+            while (p < pattern.size() && pattern[p] == '%') {
+                ++p;
+            }
+            if (p == pattern.size()) {
+                return true;
+            }
+            star_pattern = p;
+            star_text = t;
+            continue;
+        }
+        if (p == pattern.size()) {
+            if (!anchored_end || t == text.size()) {
+                return true;
+            }
+        } else if (t < text.size()) {
+            size_t next_p = p;
+            size_t next_t = t;
+            unsigned pc = NextChar(pattern, next_p);
+            unsigned tc = NextChar(text, next_t);
+            if (pc == '_' || Fold(pc) == Fold(tc)) {
+                p = next_p;
+                t = next_t;
+                continue;
+            }
+        }
+        if (star_pattern == std::string_view::npos || star_text >= text.size()) {
+            return false;
+        }
+        NextChar(text, star_text);
+        p = star_pattern;
+        t = star_text;
+    }
+}
+
+constexpr size_t kMaxPlainTerm = 64;
+
+// A term of ASCII characters other than '%' and '_' can only match ASCII
+// bytes, which never sit inside a multi-byte character, so a byte-wise
+// case-folded search gives the same answer as the general matcher.
+bool FoldPlainTerm(std::string_view term, unsigned char* folded) {
+    if (term.size() > kMaxPlainTerm) {
+        return false;
+    }
+    for (size_t i = 0; i < term.size(); ++i) {
+        const auto c = static_cast<unsigned char>(term[i]);
+        if (c >= 0x80 || c == '%' || c == '_') {
+            return false;
+        }
+        folded[i] = static_cast<unsigned char>(Fold(c));
+    }
+    return true;
+}
+
+bool ContainsFolded(const unsigned char* term, size_t size, std::string_view text) {
+    if (size > text.size()) {
+        return false;
+    }
+    const auto* bytes = reinterpret_cast<const unsigned char*>(text.data());
+    const size_t last = text.size() - size;
+    for (size_t i = 0; i <= last; ++i) {
+        if (Fold(bytes[i]) != term[0]) {
+            continue;
+        }
+        size_t k = 1;
+        while (k < size && Fold(bytes[i + k]) == term[k]) {
+            ++k;
+        }
+        if (k == size) {
+            return true;
+        }
+    }
+    return false;
+}
+
+}  // namespace
+
+bool LikeMatch(std::string_view pattern, std::string_view text) {
+    return MatchFrom(pattern, 0, text, 0, true);
+}
+
+bool LikeContains(std::string_view term, std::string_view text) {
+    if (term.empty()) {
+        return true;
+    }
+    unsigned char folded[kMaxPlainTerm];
+    if (FoldPlainTerm(term, folded)) {
+        return ContainsFolded(folded, term.size(), text);
+    }
+    // '%term%': try every start position; the end is not anchored.
+    for (size_t start = 0;;) {
+        if (MatchFrom(term, 0, text, start, false)) {
+            return true;
+        }
+        if (start >= text.size()) {
+            return false;
+        }
+        NextChar(text, start);
+    }
+}
+
+}  // namespace inventory
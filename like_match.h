@@ -0,0 +1,16 @@
+#pragma once
+
+#include <string_view>
+
+namespace inventory {
+
+// Evaluates |text| LIKE |pattern| the way SQLite does by default: '%' matches
+// any run of characters, '_' matches one UTF-8 character, and letters compare
+// case-insensitively for ASCII only. There is no escape character.
+bool LikeMatch(std::string_view pattern, std::string_view text);
+
+// Same as LikeMatch(std::string("%") + term + "%", text), without building
+// the pattern.
+bool LikeContains(std::string_view term, std::string_view text);
+
+}  // namespace inventory
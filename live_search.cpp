@@ -0,0 +1,272 @@
+#include "live_search.h"
+
+#include "metrics.h"
+
+namespace inventory {
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// How many SQLite VM steps run between cancellation checks.
+constexpr int kProgressSteps = 4096;
+
+uint64_t MicrosecondsSince(Clock::time_point start) {
+    return static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start).count());
+}
+
+std::string ColumnText(sqlite3_stmt* statement, int column) {
+    const unsigned char* text = sqlite3_column_text(statement, column);
+    if (!text) {
+        return {};
+    }
+    return std::string(reinterpret_cast<const char*>(text),
+                       static_cast<size_t>(sqlite3_column_bytes(statement, column)));
+}
+
+// A term that contains the previous term can only match a subset of the
+// rows the previous term matched, and the same goes for adding a field. An
+// exact identifier matches spellings that do not contain it, so it only
+// narrows itself.
+bool Narrows(const std::string& previous, const std::string& next, bool exact) {
+    if (exact) {
+        return previous == next;
+    }
+    return previous.empty() || next.find(previous) != std::string::npos;
+}
+
+bool Narrows(const SearchFilter& previous, const SearchFilter& next) {
+    if (previous.has_quantity &&
+        (!next.has_quantity || next.quantity != previous.quantity)) {
+        return false;
+    }
+    const unsigned exact = previous.ExactMask() | next.ExactMask();
+    return Narrows(previous.name, next.name, false) &&
+           Narrows(previous.part_number, next.part_number, exact & kFilterPartNumber) &&
+           Narrows(previous.nsn, next.nsn, exact & kFilterNsn) &&
+           Narrows(previous.serial_number, next.serial_number, exact & kFilterSerialNumber);
+}
+
+}  // namespace
+
+bool LiveSearch::Start(const std::string& path, const StorageOptions& storage,
+                       const LiveSearchOptions& options, ResultHandler on_result) {
+    Stop();
+    options_ = options;
+    on_result_ = std::move(on_result);
+    if (!database_.Open(path) || !database_.Configure(storage)) {
+        database_.Close();
+        return false;
+    }
+    sqlite3_progress_handler(database_.handle(), kProgressSteps, &LiveSearch::OnProgress, this);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = false;
+        has_pending_ = false;
+    }
+    thread_ = std::thread(&LiveSearch::Run, this);
+    return true;
+}
+
+void LiveSearch::Stop() {
+    if (!thread_.joinable()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    latest_generation_.fetch_add(1, std::memory_order_relaxed);
+    wake_.notify_all();
+    thread_.join();
+    previous_.clear();
+    have_previous_ = false;
+    database_.Close();
+}
+
+uint64_t LiveSearch::Submit(const SearchFilter& filter) {
+    uint64_t generation;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        pending_ = filter;
+        pending_at_ = Clock::now();
+        has_pending_ = true;
+        generation = latest_generation_.fetch_add(1, std::memory_order_relaxed) + 1;
+    }
+    keystrokes_.fetch_add(1, std::memory_order_relaxed);
+    wake_.notify_one();
+    return generation;
+}
+
+void LiveSearch::Cancel() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    has_pending_ = false;
+    latest_generation_.fetch_add(1, std::memory_order_relaxed);
+}
+
+LiveSearchStats LiveSearch::stats() const {
+    LiveSearchStats stats;
+    stats.keystrokes = keystrokes_.load(std::memory_order_relaxed);
+    stats.queries = queries_.load(std::memory_order_relaxed);
+    stats.refinements = refinements_.load(std::memory_order_relaxed);
+    stats.cancelled = cancelled_.load(std::memory_order_relaxed);
+    stats.busy_us = busy_us_.load(std::memory_order_relaxed);
+    stats.last_latency_us = last_latency_us_.load(std::memory_order_relaxed);
+    return stats;
+}
+
+bool LiveSearch::Superseded() const {
+    return latest_generation_.load(std::memory_order_relaxed) != running_generation_;
+}
+
+int LiveSearch::OnProgress(void* context) {
+    return static_cast<LiveSearch*>(context)->Superseded() ? 1 : 0;
+}
+
+void LiveSearch::Run() {
+    const auto debounce = std::chrono::milliseconds(options_.debounce_ms);
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        wake_.wait(lock, [this] { return stopping_ || has_pending_; });
+        // Every Submit moves pending_at_, so typing keeps pushing this out.
+        while (!stopping_ && Clock::now() < pending_at_ + debounce) {
+            wake_.wait_until(lock, pending_at_ + debounce);
+        }
+        if (stopping_) {
+            return;
+        }
+        // Cancel can drop the search while it waits out the debounce.
+        if (!has_pending_) {
+            continue;
+        }
+
+        SearchFilter filter = pending_;
+        const Clock::time_point submitted_at = pending_at_;
+        running_generation_ = latest_generation_.load(std::memory_order_relaxed);
+        has_pending_ = false;
+        lock.unlock();
+
+        if (invalidated_.exchange(false, std::memory_order_relaxed)) {
+            have_previous_ = false;
+            previous_.clear();
+        }
+        const Clock::time_point started_at = Clock::now();
+        LiveSearchResult result;
+        result.generation = running_generation_;
+        result.filter = filter;
+        bool done = have_previous_ && Narrows(previous_filter_, filter) ? Refine(filter, result)
+                                                                          : Query(filter, result);
+        busy_us_.fetch_add(MicrosecondsSince(started_at), std::memory_order_relaxed);
+
+        if (done && !Superseded()) {
+            result.latency_us = MicrosecondsSince(submitted_at);
+            last_latency_us_.store(result.latency_us, std::memory_order_relaxed);
+            on_result_(std::move(result));
+        } else {
+            cancelled_.fetch_add(1, std::memory_order_relaxed);
+        }
+        lock.lock();
+    }
+}
+
+bool LiveSearch::Query(const SearchFilter& filter, LiveSearchResult& result) {
+    queries_.fetch_add(1, std::memory_order_relaxed);
+    have_previous_ = false;
+    previous_.clear();
+
+    Statement statement = database_.PrepareShape(SearchShape(kSearchLive, filter.Shape()), [&] {
+        std::string sql =
+            "SELECT id, name, part_number, nsn, serial_number, quantity FROM items";
+        AppendFilterConditions(filter, sql);
+        sql += " ORDER BY created_at DESC, id DESC";
+        return sql;
+    });
+    if (!statement) {
+        return false;
+    }
+    BindFilter(statement.get(), filter, 1);
+
+    std::vector<Candidate> candidates;
+    sqlite3_int64 count = 0;
+    const Clock::time_point start = Clock::now();
+    int step;
+    while ((step = sqlite3_step(statement.get())) == SQLITE_ROW) {
+        if (candidates.size() < options_.refine_limit) {
+            Candidate candidate;
+            candidate.id = sqlite3_column_int64(statement.get(), 0);
+            candidate.name = ColumnText(statement.get(), 1);
+            candidate.part_number = ColumnText(statement.get(), 2);
+            candidate.nsn = ColumnText(statement.get(), 3);
+            candidate.serial_number = ColumnText(statement.get(), 4);
+            candidate.quantity = sqlite3_column_int(statement.get(), 5);
+            candidates.push_back(std::move(candidate));
+        } else if (!candidates.empty() && static_cast<size_t>(count) == candidates.size()) {
+            // Too many to keep; from here on only the count matters.
+            candidates.clear();
+            candidates.shrink_to_fit();
+        }
+        ++count;
+    }
+    if (step != SQLITE_DONE) {
+        return false;
+    }
+    // Interrupted queries are left out so that they do not pull the figures down.
+    Metrics()
+        .shape(SearchShape(kSearchLive, filter.Shape()))
+        .Record(ScopedLatency::ElapsedNs(start));
+
+    result.total_count = count;
+    result.complete = static_cast<size_t>(count) <= options_.refine_limit;
+    if (result.complete) {
+        result.ids.reserve(candidates.size());
+        for (const auto& candidate : candidates) {
+            result.ids.push_back(candidate.id);
+        }
+        previous_ = std::move(candidates);
+        previous_filter_ = filter;
+        have_previous_ = true;
+    }
+    return true;
+}
+
+bool LiveSearch::Refine(const SearchFilter& filter, LiveSearchResult& result) {
+    refinements_.fetch_add(1, std::memory_order_relaxed);
+    const TermMatcher name(kFilterName, filter.name);
+    const TermMatcher part_number(kFilterPartNumber, filter.part_number);
+    const TermMatcher nsn(kFilterNsn, filter.nsn);
+    const TermMatcher serial_number(kFilterSerialNumber, filter.serial_number);
+    // Survivors are only moved out once the pass is complete: a superseded
+    // pass must leave previous_ whole for the next keystroke to refine.
+    std::vector<size_t> matches;
+    for (size_t i = 0; i < previous_.size(); ++i) {
+        if (((i + 1) & 1023) == 0 && Superseded()) {
+            return false;
+        }
+        const Candidate& candidate = previous_[i];
+        if (filter.has_quantity && candidate.quantity != filter.quantity) {
+            continue;
+        }
+        if (name.Matches(candidate.name) && part_number.Matches(candidate.part_number) &&
+            nsn.Matches(candidate.nsn) && serial_number.Matches(candidate.serial_number)) {
+            matches.push_back(i);
+        }
+    }
+    std::vector<Candidate> kept;
+    kept.reserve(matches.size());
+    for (const size_t i : matches) {
+        kept.push_back(std::move(previous_[i]));
+    }
+
+    result.refined = true;
+    result.complete = true;
+    result.total_count = static_cast<sqlite3_int64>(kept.size());
+    result.ids.reserve(kept.size());
+    for (const auto& candidate : kept) {
+        result.ids.push_back(candidate.id);
+    }
+    previous_ = std::move(kept);
+    previous_filter_ = filter;
+    return true;
+}
+
+}  // namespace inventory
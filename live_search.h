@@ -0,0 +1,122 @@
+#pragma once
+
+#include <sqlite3.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "database.h"
+#include "search_filter.h"
+
+namespace inventory {
+
+struct LiveSearchOptions {
+    int debounce_ms = 150;
+    // Results up to this size are kept in memory so that a narrower search
+    // can be answered from them without touching the database.
+    size_t refine_limit = 20000;
+};
+
+struct LiveSearchResult {
+    uint64_t generation = 0;
+    SearchFilter filter;
+    // True when |ids| holds every match in display order; otherwise only
+    // |total_count| is known.
+    bool complete = false;
+    bool refined = false;
+    sqlite3_int64 total_count = 0;
+    std::vector<sqlite3_int64> ids;
+    // From the last Submit to the result being ready, debounce included.
+    uint64_t latency_us = 0;
+};
+
+struct LiveSearchStats {
+    uint64_t keystrokes = 0;
+    uint64_t queries = 0;
+    uint64_t refinements = 0;
+    uint64_t cancelled = 0;
+    // Time the search thread spent working, i.e. its CPU cost.
+    uint64_t busy_us = 0;
+    uint64_t last_latency_us = 0;
+};
+
+// Search-as-you-type on a dedicated thread with its own read connection.
+// Each Submit restarts the debounce timer and cancels a search that is
+// already running; only the newest filter ever produces a result.
+class LiveSearch {
+public:
+    // Runs on the search thread.
+    using ResultHandler = std::function<void(LiveSearchResult result)>;
+
+    LiveSearch() = default;
+    ~LiveSearch() { Stop(); }
+
+    LiveSearch(const LiveSearch&) = delete;
+    LiveSearch& operator=(const LiveSearch&) = delete;
+
+    bool Start(const std::string& path, const StorageOptions& storage,
+               const LiveSearchOptions& options, ResultHandler on_result);
+    void Stop();
+
+    // Returns the generation that the matching result will carry.
+    uint64_t Submit(const SearchFilter& filter);
+    // Drops the pending search and interrupts a running one.
+    void Cancel();
+    // Forgets the in-memory result, e.g. after a write changed the items.
+    void Invalidate() { invalidated_.store(true, std::memory_order_relaxed); }
+
+    LiveSearchStats stats() const;
+
+private:
+    struct Candidate {
+        sqlite3_int64 id = 0;
+        std::string name;
+        std::string part_number;
+        std::string nsn;
+        std::string serial_number;
+        int quantity = 0;
+    };
+
+    void Run();
+    bool Query(const SearchFilter& filter, LiveSearchResult& result);
+    bool Refine(const SearchFilter& filter, LiveSearchResult& result);
+    bool Superseded() const;
+    static int OnProgress(void* context);
+
+    Database database_;
+    LiveSearchOptions options_;
+    ResultHandler on_result_;
+    std::thread thread_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable wake_;
+    bool stopping_ = false;
+    bool has_pending_ = false;
+    SearchFilter pending_;
+    std::chrono::steady_clock::time_point pending_at_;
+
+    std::atomic<uint64_t> latest_generation_{0};
+    std::atomic<bool> invalidated_{false};
+    uint64_t running_generation_ = 0;
+
+    // Last complete result, owned by the search thread.
+    bool have_previous_ = false;
+    SearchFilter previous_filter_;
+    std::vector<Candidate> previous_;
+
+    std::atomic<uint64_t> keystrokes_{0};
+    std::atomic<uint64_t> queries_{0};
+    std::atomic<uint64_t> refinements_{0};
+    std::atomic<uint64_t> cancelled_{0};
+    std::atomic<uint64_t> busy_us_{0};
+    std::atomic<uint64_t> last_latency_us_{0};
+};
+
+}  // namespace inventory
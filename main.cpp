@@ -1,593 +1,1472 @@
-#define UNICODE
-#define _UNICODE
-#include <windows.h>
-
-#include <commctrl.h>
-#include <sqlite3.h>
-
-#include <sstream>
-#include <string>
-#include <vector>
-
-namespace {
-constexpr wchar_t kWindowClassName[] = L"InventoryDatabaseWindow";
-constexpr wchar_t kWindowTitle[] = L"Inventory Database";
-
-enum ControlId {
-    kNameEdit = 1001,
-    kPartEdit,
-    kNsnEdit,
-    kSerialEdit,
-    kQuantityEdit,
-    kSaveButton,
-    kUpdateButton,
-    kDeleteButton,
-    kSearchButton,
-    kClearButton,
-    kResultsView,
-    kStatusLabel,
-};
-
-struct AppState {
-    sqlite3* db = nullptr;
-    int selected_id = -1;
-    HWND name_edit = nullptr;
-    HWND part_edit = nullptr;
-    HWND nsn_edit = nullptr;
-    HWND serial_edit = nullptr;
-    HWND quantity_edit = nullptr;
-    HWND results_view = nullptr;
-    HWND status_label = nullptr;
-};
-
-AppState g_state;
-
-std::wstring GetText(HWND handle) {
-    int length = GetWindowTextLengthW(handle);
-    std::wstring text(static_cast<size_t>(length), L'\0');
-    if (length > 0) {
-        GetWindowTextW(handle, text.data(), length + 1);
-    }
-    return text;
-}
-
-void SetText(HWND handle, const std::wstring& text) {
-    SetWindowTextW(handle, text.c_str());
-}
-
-std::string ToUtf8(const std::wstring& value) {
-    if (value.empty()) {
-        return {};
-    }
-    int size = WideCharToMultiByte(CP_UTF8, 0, value.c_str(), -1, nullptr, 0, nullptr, nullptr);
-    std::string result(static_cast<size_t>(size - 1), '\0');
-    WideCharToMultiByte(CP_UTF8, 0, value.c_str(), -1, result.data(), size, nullptr, nullptr);
-    return result;
-}
-
-std::wstring FromUtf8(const unsigned char* value) {
-    if (!value) {
-        return {};
-    }
-    int size =
-        MultiByteToWideChar(CP_UTF8, 0, reinterpret_cast<const char*>(value), -1, nullptr, 0);
-    std::wstring result(static_cast<size_t>(size - 1), L'\0');
-    MultiByteToWideChar(
-        CP_UTF8, 0, reinterpret_cast<const char*>(value), -1, result.data(), size);
-    return result;
-}
-
-bool ParseInt(const std::wstring& value, int& out) {
-    if (value.empty()) {
-        return false;
-    }
-    std::wistringstream stream(value);
-    stream >> out;
-    return !stream.fail() && stream.eof();
-}
-
-void SetStatus(const std::wstring& message) {
-    SetText(g_state.status_label, message);
-}
-
-std::wstring GetDatabasePath() {
-    wchar_t buffer[MAX_PATH] = {};
-    GetModuleFileNameW(nullptr, buffer, MAX_PATH);
-    std::wstring path(buffer);
-    size_t position = path.find_last_of(L"\\/");
-    if (position != std::wstring::npos) {
-        path.erase(position + 1);
-    }
-    path += L"inventory.db";
-    return path;
-}
-
-bool ExecuteSql(const std::string& sql) {
-    char* error_message = nullptr;
-    int result = sqlite3_exec(g_state.db, sql.c_str(), nullptr, nullptr, &error_message);
-    if (result != SQLITE_OK) {
-        if (error_message) {
-            sqlite3_free(error_message);
-        }
-        return false;
-    }
-    return true;
-}
-
-bool InitDatabase() {
-    std::wstring db_path = GetDatabasePath();
-    if (sqlite3_open(ToUtf8(db_path).c_str(), &g_state.db) != SQLITE_OK) {
-        return false;
-    }
-    return ExecuteSql(
-        "CREATE TABLE IF NOT EXISTS items ("
-        "id INTEGER PRIMARY KEY AUTOINCREMENT,"
-        "name TEXT NOT NULL,"
-        "part_number TEXT NOT NULL,"
-        "nsn TEXT NOT NULL,"
-        "serial_number TEXT NOT NULL,"
-        "quantity INTEGER NOT NULL DEFAULT 0,"
-        "created_at TEXT NOT NULL DEFAULT (datetime('now'))"
-        ")");
-}
-
-void ClearInputs() {
-    SetText(g_state.name_edit, L"");
-    SetText(g_state.part_edit, L"");
-    SetText(g_state.nsn_edit, L"");
-    SetText(g_state.serial_edit, L"");
-    SetText(g_state.quantity_edit, L"");
-    g_state.selected_id = -1;
-    SetStatus(L"Ready");
-}
-
-void ConfigureListViewColumns(HWND list_view) {
-    LVCOLUMNW column = {};
-    column.mask = LVCF_TEXT | LVCF_WIDTH | LVCF_SUBITEM;
-
-    const std::vector<std::wstring> headers = {
-        L"ID", L"Name", L"Part Number", L"NSN", L"Serial Number", L"Quantity", L"Created"};
-    const std::vector<int> widths = {0, 180, 160, 140, 160, 90, 160};
-
-    for (size_t i = 0; i < headers.size(); ++i) {
-        column.pszText = const_cast<wchar_t*>(headers[i].c_str());
-        column.cx = widths[i];
-        column.iSubItem = static_cast<int>(i);
-        ListView_InsertColumn(list_view, static_cast<int>(i), &column);
-    }
-}
-
-void RefreshResults() {
-    std::wstring name = GetText(g_state.name_edit);
-    std::wstring part = GetText(g_state.part_edit);
-    std::wstring nsn = GetText(g_state.nsn_edit);
-    std::wstring serial = GetText(g_state.serial_edit);
-    std::wstring quantity_text = GetText(g_state.quantity_edit);
-
-    std::vector<std::string> conditions;
-    std::vector<std::string> parameters;
-    int quantity_value = 0;
-
-    if (!name.empty()) {
-        conditions.push_back("name LIKE ?");
-        parameters.push_back("%" + ToUtf8(name) + "%");
-    }
-    if (!part.empty()) {
-        conditions.push_back("part_number LIKE ?");
-        parameters.push_back("%" + ToUtf8(part) + "%");
-    }
-    if (!nsn.empty()) {
-        conditions.push_back("nsn LIKE ?");
-        parameters.push_back("%" + ToUtf8(nsn) + "%");
-    }
-    if (!serial.empty()) {
-        conditions.push_back("serial_number LIKE ?");
-        parameters.push_back("%" + ToUtf8(serial) + "%");
-    }
-    if (!quantity_text.empty()) {
-        if (!ParseInt(quantity_text, quantity_value)) {
-            SetStatus(L"Quantity must be a whole number.");
-            return;
-        }
-        conditions.push_back("quantity = ?");
-    }
-
-    std::string query =
-        "SELECT id, name, part_number, nsn, serial_number, quantity, created_at FROM items";
-    if (!conditions.empty()) {
-        query += " WHERE ";
-        for (size_t i = 0; i < conditions.size(); ++i) {
-            if (i > 0) {
-                query += " AND ";
-            }
-            query += conditions[i];
-        }
-    }
-    query += " ORDER BY created_at DESC";
-
-    sqlite3_stmt* statement = nullptr;
-    if (sqlite3_prepare_v2(g_state.db, query.c_str(), -1, &statement, nullptr) != SQLITE_OK) {
-        SetStatus(L"Search failed.");
-        return;
-    }
-
-    int index = 1;
-    for (const auto& value : parameters) {
-        sqlite3_bind_text(statement, index++, value.c_str(), -1, SQLITE_TRANSIENT);
-    }
-    if (!quantity_text.empty()) {
-        sqlite3_bind_int(statement, index++, quantity_value);
-    }
-
-    ListView_DeleteAllItems(g_state.results_view);
-    int row_count = 0;
-    while (sqlite3_step(statement) == SQLITE_ROW) {
-        LVITEMW item = {};
-        item.mask = LVIF_TEXT;
-        std::wstring id_text = std::to_wstring(sqlite3_column_int(statement, 0));
-        item.iItem = row_count;
-        item.pszText = id_text.data();
-        int row_index = ListView_InsertItem(g_state.results_view, &item);
-
-        std::vector<std::wstring> values = {
-            id_text,
-            FromUtf8(sqlite3_column_text(statement, 1)),
-            FromUtf8(sqlite3_column_text(statement, 2)),
-            FromUtf8(sqlite3_column_text(statement, 3)),
-            FromUtf8(sqlite3_column_text(statement, 4)),
-            std::to_wstring(sqlite3_column_int(statement, 5)),
-            FromUtf8(sqlite3_column_text(statement, 6)),
-        };
-
-        for (size_t column = 1; column < values.size(); ++column) {
-            ListView_SetItemText(
-                g_state.results_view, row_index, static_cast<int>(column),
-                const_cast<wchar_t*>(values[column].c_str()));
-        }
-        ++row_count;
-    }
-    sqlite3_finalize(statement);
-    SetStatus(std::to_wstring(row_count) + L" record(s) found.");
-}
-
-void SaveRecord() {
-    std::wstring name = GetText(g_state.name_edit);
-    std::wstring part = GetText(g_state.part_edit);
-    std::wstring nsn = GetText(g_state.nsn_edit);
-    std::wstring serial = GetText(g_state.serial_edit);
-    std::wstring quantity_text = GetText(g_state.quantity_edit);
-
-    if (name.empty() || part.empty() || nsn.empty() || serial.empty()) {
-        SetStatus(L"Please fill out all fields before saving.");
-        return;
-    }
-    int quantity_value = 0;
-    if (!ParseInt(quantity_text, quantity_value)) {
-        SetStatus(L"Quantity must be a whole number.");
-        return;
-    }
-
-    const char* sql =
-        "INSERT INTO items (name, part_number, nsn, serial_number, quantity)"
-        " VALUES (?, ?, ?, ?, ?)";
-    sqlite3_stmt* statement = nullptr;
-    if (sqlite3_prepare_v2(g_state.db, sql, -1, &statement, nullptr) != SQLITE_OK) {
-        SetStatus(L"Save failed.");
-        return;
-    }
-    sqlite3_bind_text(statement, 1, ToUtf8(name).c_str(), -1, SQLITE_TRANSIENT);
-    sqlite3_bind_text(statement, 2, ToUtf8(part).c_str(), -1, SQLITE_TRANSIENT);
-    sqlite3_bind_text(statement, 3, ToUtf8(nsn).c_str(), -1, SQLITE_TRANSIENT);
-    sqlite3_bind_text(statement, 4, ToUtf8(serial).c_str(), -1, SQLITE_TRANSIENT);
-    sqlite3_bind_int(statement, 5, quantity_value);
-
-    if (sqlite3_step(statement) != SQLITE_DONE) {
-        sqlite3_finalize(statement);
-        SetStatus(L"Save failed.");
-        return;
-    }
-    sqlite3_finalize(statement);
-    SetStatus(L"Record saved.");
-    ClearInputs();
-    RefreshResults();
-}
-
-void UpdateRecord() {
-    if (g_state.selected_id < 0) {
-        SetStatus(L"Select a record to update.");
-        return;
-    }
-
-    std::wstring name = GetText(g_state.name_edit);
-    std::wstring part = GetText(g_state.part_edit);
-    std::wstring nsn = GetText(g_state.nsn_edit);
-    std::wstring serial = GetText(g_state.serial_edit);
-    std::wstring quantity_text = GetText(g_state.quantity_edit);
-
-    if (name.empty() || part.empty() || nsn.empty() || serial.empty()) {
-        SetStatus(L"Please fill out all fields before updating.");
-        return;
-    }
-    int quantity_value = 0;
-    if (!ParseInt(quantity_text, quantity_value)) {
-        SetStatus(L"Quantity must be a whole number.");
-        return;
-    }
-
-    const char* sql =
-        "UPDATE items SET name = ?, part_number = ?, nsn = ?, serial_number = ?, quantity = ? "
-        "WHERE id = ?";
-    sqlite3_stmt* statement = nullptr;
-    if (sqlite3_prepare_v2(g_state.db, sql, -1, &statement, nullptr) != SQLITE_OK) {
-        SetStatus(L"Update failed.");
-        return;
-    }
-    sqlite3_bind_text(statement, 1, ToUtf8(name).c_str(), -1, SQLITE_TRANSIENT);
-    sqlite3_bind_text(statement, 2, ToUtf8(part).c_str(), -1, SQLITE_TRANSIENT);
-    sqlite3_bind_text(statement, 3, ToUtf8(nsn).c_str(), -1, SQLITE_TRANSIENT);
-    sqlite3_bind_text(statement, 4, ToUtf8(serial).c_str(), -1, SQLITE_TRANSIENT);
-    sqlite3_bind_int(statement, 5, quantity_value);
-    sqlite3_bind_int(statement, 6, g_state.selected_id);
-
-    if (sqlite3_step(statement) != SQLITE_DONE) {
-        sqlite3_finalize(statement);
-        SetStatus(L"Update failed.");
-        return;
-    }
-    sqlite3_finalize(statement);
-    SetStatus(L"Record updated.");
-    ClearInputs();
-    RefreshResults();
-}
-
-void DeleteRecord(HWND window) {
-    if (g_state.selected_id < 0) {
-        SetStatus(L"Select a record to delete.");
-        return;
-    }
-    if (MessageBoxW(window, L"Delete the selected record?", L"Delete Record",
-                    MB_ICONWARNING | MB_YESNO) != IDYES) {
-        SetStatus(L"Delete cancelled.");
-        return;
-    }
-
-    const char* sql = "DELETE FROM items WHERE id = ?";
-    sqlite3_stmt* statement = nullptr;
-    if (sqlite3_prepare_v2(g_state.db, sql, -1, &statement, nullptr) != SQLITE_OK) {
-        SetStatus(L"Delete failed.");
-        return;
-    }
-    sqlite3_bind_int(statement, 1, g_state.selected_id);
-
-    if (sqlite3_step(statement) != SQLITE_DONE) {
-        sqlite3_finalize(statement);
-        SetStatus(L"Delete failed.");
-        return;
-    }
-    sqlite3_finalize(statement);
-    SetStatus(L"Record deleted.");
-    ClearInputs();
-    RefreshResults();
-}
-
-void OnListViewSelect() {
-    int selected = ListView_GetNextItem(g_state.results_view, -1, LVNI_SELECTED);
-    if (selected < 0) {
-        return;
-    }
-
-    wchar_t buffer[256] = {};
-    ListView_GetItemText(g_state.results_view, selected, 0, buffer, 256);
-    g_state.selected_id = _wtoi(buffer);
-
-    ListView_GetItemText(g_state.results_view, selected, 1, buffer, 256);
-    SetText(g_state.name_edit, buffer);
-    ListView_GetItemText(g_state.results_view, selected, 2, buffer, 256);
-    SetText(g_state.part_edit, buffer);
-    ListView_GetItemText(g_state.results_view, selected, 3, buffer, 256);
-    SetText(g_state.nsn_edit, buffer);
-    ListView_GetItemText(g_state.results_view, selected, 4, buffer, 256);
-    SetText(g_state.serial_edit, buffer);
-    ListView_GetItemText(g_state.results_view, selected, 5, buffer, 256);
-    SetText(g_state.quantity_edit, buffer);
-}
-
-void LayoutControls(HWND window, int width, int height) {
-    const int margin = 16;
-    const int label_width = 110;
-    const int edit_height = 24;
-    const int row_gap = 12;
-    const int column_gap = 24;
-    const int column_width = (width - margin * 2 - column_gap) / 2;
-    const int edit_width = column_width - label_width - 10;
-
-    int left_x = margin;
-    int right_x = margin + column_width + column_gap;
-    int y = margin;
-
-    auto place_field = [&](HWND label, HWND edit, int x, int y_pos) {
-        MoveWindow(label, x, y_pos, label_width, edit_height, TRUE);
-        MoveWindow(edit, x + label_width + 8, y_pos, edit_width, edit_height, TRUE);
-    };
-
-    HWND name_label = GetDlgItem(window, kNameEdit - 100);
-    HWND part_label = GetDlgItem(window, kPartEdit - 100);
-    HWND nsn_label = GetDlgItem(window, kNsnEdit - 100);
-    HWND serial_label = GetDlgItem(window, kSerialEdit - 100);
-    HWND quantity_label = GetDlgItem(window, kQuantityEdit - 100);
-
-    place_field(name_label, g_state.name_edit, left_x, y);
-    place_field(serial_label, g_state.serial_edit, right_x, y);
-    y += edit_height + row_gap;
-    place_field(part_label, g_state.part_edit, left_x, y);
-    place_field(quantity_label, g_state.quantity_edit, right_x, y);
-    y += edit_height + row_gap;
-    place_field(nsn_label, g_state.nsn_edit, left_x, y);
-
-    int button_y = y + edit_height + row_gap;
-    const int button_width = 110;
-    const int button_height = 28;
-    const int button_gap = 10;
-
-    int button_x = margin;
-    const int buttons[] = {kSaveButton, kUpdateButton, kDeleteButton, kSearchButton, kClearButton};
-    for (int id : buttons) {
-        HWND button = GetDlgItem(window, id);
-        MoveWindow(button, button_x, button_y, button_width, button_height, TRUE);
-        button_x += button_width + button_gap;
-    }
-
-    int list_y = button_y + button_height + row_gap;
-    int status_height = 22;
-    int list_height = height - list_y - status_height - margin;
-    MoveWindow(g_state.results_view, margin, list_y, width - margin * 2, list_height, TRUE);
-    MoveWindow(g_state.status_label, margin, height - status_height - margin,
-               width - margin * 2, status_height, TRUE);
-}
-
-LRESULT CALLBACK WindowProc(HWND window, UINT message, WPARAM wparam, LPARAM lparam) {
-    switch (message) {
-        case WM_CREATE: {
-            CreateWindowW(L"STATIC", L"Name:", WS_CHILD | WS_VISIBLE, 0, 0, 0, 0, window,
-                          reinterpret_cast<HMENU>(kNameEdit - 100), nullptr, nullptr);
-            CreateWindowW(L"STATIC", L"Part Number:", WS_CHILD | WS_VISIBLE, 0, 0, 0, 0, window,
-                          reinterpret_cast<HMENU>(kPartEdit - 100), nullptr, nullptr);
-            CreateWindowW(L"STATIC", L"NSN:", WS_CHILD | WS_VISIBLE, 0, 0, 0, 0, window,
-                          reinterpret_cast<HMENU>(kNsnEdit - 100), nullptr, nullptr);
-            CreateWindowW(L"STATIC", L"Serial Number:", WS_CHILD | WS_VISIBLE, 0, 0, 0, 0, window,
-                          reinterpret_cast<HMENU>(kSerialEdit - 100), nullptr, nullptr);
-            CreateWindowW(L"STATIC", L"Quantity:", WS_CHILD | WS_VISIBLE, 0, 0, 0, 0, window,
-                          reinterpret_cast<HMENU>(kQuantityEdit - 100), nullptr, nullptr);
-
-            g_state.name_edit = CreateWindowW(L"EDIT", L"", WS_CHILD | WS_VISIBLE | WS_BORDER,
-                                              0, 0, 0, 0, window,
-                                              reinterpret_cast<HMENU>(kNameEdit), nullptr,
-                                              nullptr);
-            g_state.part_edit = CreateWindowW(L"EDIT", L"", WS_CHILD | WS_VISIBLE | WS_BORDER,
-                                              0, 0, 0, 0, window,
-                                              reinterpret_cast<HMENU>(kPartEdit), nullptr,
-                                              nullptr);
-            g_state.nsn_edit = CreateWindowW(L"EDIT", L"", WS_CHILD | WS_VISIBLE | WS_BORDER,
-                                             0, 0, 0, 0, window,
-                                             reinterpret_cast<HMENU>(kNsnEdit), nullptr, nullptr);
-            g_state.serial_edit = CreateWindowW(L"EDIT", L"", WS_CHILD | WS_VISIBLE | WS_BORDER,
-                                                0, 0, 0, 0, window,
-                                                reinterpret_cast<HMENU>(kSerialEdit), nullptr,
-                                                nullptr);
-            g_state.quantity_edit = CreateWindowW(
-                L"EDIT", L"", WS_CHILD | WS_VISIBLE | WS_BORDER, 0, 0, 0, 0, window,
-                reinterpret_cast<HMENU>(kQuantityEdit), nullptr, nullptr);
-
-            CreateWindowW(L"BUTTON", L"Save", WS_CHILD | WS_VISIBLE | BS_PUSHBUTTON, 0, 0, 0, 0,
-                          window, reinterpret_cast<HMENU>(kSaveButton), nullptr, nullptr);
-            CreateWindowW(L"BUTTON", L"Update", WS_CHILD | WS_VISIBLE | BS_PUSHBUTTON, 0, 0, 0,
-                          0, window, reinterpret_cast<HMENU>(kUpdateButton), nullptr, nullptr);
-            CreateWindowW(L"BUTTON", L"Delete", WS_CHILD | WS_VISIBLE | BS_PUSHBUTTON, 0, 0, 0,
-                          0, window, reinterpret_cast<HMENU>(kDeleteButton), nullptr, nullptr);
-            CreateWindowW(L"BUTTON", L"Search", WS_CHILD | WS_VISIBLE | BS_PUSHBUTTON, 0, 0, 0,
-                          0, window, reinterpret_cast<HMENU>(kSearchButton), nullptr, nullptr);
-            CreateWindowW(L"BUTTON", L"Clear", WS_CHILD | WS_VISIBLE | BS_PUSHBUTTON, 0, 0, 0, 0,
-                          window, reinterpret_cast<HMENU>(kClearButton), nullptr, nullptr);
-
-            g_state.results_view = CreateWindowW(
-                WC_LISTVIEWW, L"", WS_CHILD | WS_VISIBLE | LVS_REPORT | LVS_SINGLESEL, 0, 0, 0,
-                0, window, reinterpret_cast<HMENU>(kResultsView), nullptr, nullptr);
-            ListView_SetExtendedListViewStyle(
-                g_state.results_view, LVS_EX_FULLROWSELECT | LVS_EX_GRIDLINES);
-            ConfigureListViewColumns(g_state.results_view);
-
-            g_state.status_label = CreateWindowW(L"STATIC", L"Ready",
-                                                 WS_CHILD | WS_VISIBLE | SS_LEFT, 0, 0, 0, 0,
-                                                 window, reinterpret_cast<HMENU>(kStatusLabel),
-                                                 nullptr, nullptr);
-
-            RefreshResults();
-            return 0;
-        }
-        case WM_SIZE: {
-            int width = LOWORD(lparam);
-            int height = HIWORD(lparam);
-            LayoutControls(window, width, height);
-            return 0;
-        }
-        case WM_COMMAND: {
-            switch (LOWORD(wparam)) {
-                case kSaveButton:
-                    SaveRecord();
-                    return 0;
-                case kUpdateButton:
-                    UpdateRecord();
-                    return 0;
-                case kDeleteButton:
-                    DeleteRecord(window);
-                    return 0;
-                case kSearchButton:
-                    RefreshResults();
-                    return 0;
-                case kClearButton:
-                    ClearInputs();
-                    RefreshResults();
-                    return 0;
-                default:
-                    return 0;
-            }
-        }
-        case WM_NOTIFY: {
-            auto* header = reinterpret_cast<NMHDR*>(lparam);
-            if (header->idFrom == kResultsView && header->code == LVN_ITEMCHANGED) {
-                OnListViewSelect();
-            }
-            return 0;
-        }
-        case WM_DESTROY: {
-            if (g_state.db) {
-                sqlite3_close(g_state.db);
-                g_state.db = nullptr;
-            }
-            PostQuitMessage(0);
-            return 0;
-        }
-        default:
-            return DefWindowProcW(window, message, wparam, lparam);
-    }
-}
-}  // namespace
-
-int APIENTRY wWinMain(_In_ HINSTANCE instance, _In_opt_ HINSTANCE, _In_ LPWSTR, _In_ int) {
-    INITCOMMONCONTROLSEX controls = {};
-    controls.dwSize = sizeof(controls);
-    controls.dwICC = ICC_LISTVIEW_CLASSES;
-    InitCommonControlsEx(&controls);
-
-    if (!InitDatabase()) {
-        MessageBoxW(nullptr, L"Failed to initialize the database.", L"Error", MB_ICONERROR);
-        return 1;
-    }
-
-    WNDCLASSEXW wc = {};
-    wc.cbSize = sizeof(wc);
-    wc.lpfnWndProc = WindowProc;
-    wc.hInstance = instance;
-    wc.hCursor = LoadCursor(nullptr, IDC_ARROW);
-    wc.hbrBackground = reinterpret_cast<HBRUSH>(COLOR_WINDOW + 1);
-    wc.lpszClassName = kWindowClassName;
-    RegisterClassExW(&wc);
-
-    HWND window = CreateWindowExW(
-        0, kWindowClassName, kWindowTitle, WS_OVERLAPPEDWINDOW, CW_USEDEFAULT, CW_USEDEFAULT,
-        1200, 720, nullptr, nullptr, instance, nullptr);
-    if (!window) {
-        MessageBoxW(nullptr, L"Failed to create the main window.", L"Error", MB_ICONERROR);
-        return 1;
-    }
-
-    ShowWindow(window, SW_MAXIMIZE);
-    UpdateWindow(window);
-
-    MSG msg = {};
-    while (GetMessageW(&msg, nullptr, 0, 0)) {
-        TranslateMessage(&msg);
-        DispatchMessageW(&msg);
-    }
-    return static_cast<int>(msg.wParam);
+#define UNICODE
+#define _UNICODE
+#include <windows.h>
+
+#include <commctrl.h>
+#include <shellapi.h>
+#include <sqlite3.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <cstring>
+#include <cwchar>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "backup.h"
+#include "change_journal.h"
+#include "cold_start.h"
+#include "database.h"
+#include "duplicates.h"
+#include "item_pager.h"
+#include "items.h"
+#include "live_search.h"
+#include "metrics.h"
+#include "rollups.h"
+#include "row_cache.h"
+#include "schema.h"
+#include "search_filter.h"
+#include "service_client.h"
+#include "snapshot.h"
+#include "stock_ledger.h"
+#include "storage_worker.h"
+
+namespace {
+constexpr wchar_t kWindowClassName[] = L"InventoryDatabaseWindow";
+constexpr wchar_t kWindowTitle[] = L"Inventory Database";
+constexpr wchar_t kDiagnosticsClassName[] = L"InventoryDiagnosticsWindow";
+constexpr wchar_t kTotalsClassName[] = L"InventoryTotalsWindow";
+constexpr wchar_t kMetricsFileName[] = L"inventory-metrics.txt";
+constexpr wchar_t kBackupFileName[] = L"inventory-backup.invbak";
+
+enum ControlId {
+    kNameEdit = 1001,
+    kPartEdit,
+    kNsnEdit,
+    kSerialEdit,
+    kQuantityEdit,
+    kSaveButton,
+    kUpdateButton,
+    kDeleteButton,
+    kUndoButton,
+    kRedoButton,
+    kSearchButton,
+    kClearButton,
+    kDiagnosticsButton,
+    kBackupButton,
+    kTotalsButton,
+    kResultsView,
+    kStatusLabel,
+    kDiagnosticsText,
+    kDiagnosticsRefresh,
+    kDiagnosticsSave,
+    kTotalsText,
+    kTotalsByNsn,
+    kTotalsByPart,
+    kTotalsByName,
+};
+
+// Posted by the storage thread when a write finishes; lparam owns a heap
+// WriteResult.
+constexpr UINT kStorageDoneMessage = WM_APP + 1;
+
+// Posted by the live search thread; lparam owns a heap LiveSearchResult.
+constexpr UINT kLiveSearchMessage = WM_APP + 2;
+
+// Posted by the storage thread after a change journal segment has been
+// compacted; wparam is 1 when older entries are left.
+constexpr UINT kJournalCompactedMessage = WM_APP + 3;
+
+// Posted by the backup thread; wparam is the percentage copied so far.
+constexpr UINT kBackupProgressMessage = WM_APP + 4;
+
+// Posted by the backup thread when it is done; lparam owns a heap
+// BackupReport.
+constexpr UINT kBackupDoneMessage = WM_APP + 5;
+
+// Posted by the startup thread as each phase ends; lparam owns a heap
+// StartupResult.
+constexpr UINT kStartupMessage = WM_APP + 6;
+
+// The listing shows this many rows before the startup thread has counted
+// them all.
+constexpr sqlite3_int64 kFirstPageRows = 100;
+
+constexpr UINT_PTR kJournalTimer = 1;
+constexpr UINT kJournalCompactionIntervalMs = 10 * 60 * 1000;
+
+enum StorageOperation {
+    kSaveOperation,
+    kUpdateOperation,
+    kDeleteOperation,
+    kUndoOperation,
+    kRedoOperation,
+};
+
+struct WriteResult {
+    StorageOperation operation = kSaveOperation;
+    bool ok = false;
+    // The written row.
+    sqlite3_int64 id = 0;
+    // What the write journaled; left empty in service mode.
+    inventory::ItemChange change;
+    // Every item an undo or redo touched.
+    std::vector<sqlite3_int64> items;
+    // Shown after the status once the write is done.
+    std::wstring warning;
+};
+
+struct StartupResult {
+    inventory::StartupPhase phase = inventory::StartupPhase::kOpen;
+    bool ok = false;
+    bool trigram_index = false;
+    // kOpen: the rows, counted no further than kFirstPageRows; kCount: all.
+    sqlite3_int64 rows = 0;
+    // kWarmUp: loaded, unless the table is too large for it.
+    std::unique_ptr<inventory::ItemSnapshot> snapshot;
+    // kWarmUp: built, unless startup was cancelled.
+    std::unique_ptr<inventory::DuplicateDetector> duplicates;
+};
+
+struct AppState {
+    // With --service ADDRESS every search and write goes to an
+    // inventory_serviced instead, and the local members below stay unused.
+    std::string service_address;
+    inventory::ServiceClient service;
+    inventory::StorageWorker storage;
+    inventory::LiveSearch live_search;
+    inventory::Database database;
+    inventory::RowCache rows;
+    // Serves searches from memory when it is loaded; otherwise they go to
+    // SQLite.
+    inventory::ItemSnapshot snapshot;
+    inventory::SearchMode search_mode = inventory::SearchMode::kScan;
+    // Looks up serial numbers before local saves and updates; probes SQLite
+    // for each until the startup thread has filled its filters.
+    inventory::DuplicateDetector duplicates;
+    // The window shows itself first; a thread then opens the database,
+    // and none of the members above is used until it reports kOpen. It goes
+    // on to count the rows and warm up on a connection of its own.
+    std::chrono::steady_clock::time_point started;
+    std::thread startup_thread;
+    std::atomic<bool> startup_cancelled{false};
+    bool opened = false;
+    // Until the count arrives, the unfiltered listing is its first page.
+    bool counting_rows = false;
+    sqlite3_int64 first_page_rows = 0;
+    // Items written while the startup thread loads the snapshot and the
+    // duplicate filters, synced into them when they arrive.
+    bool warming_up = false;
+    std::vector<sqlite3_int64> unsynced_items;
+    sqlite3_int64 selected_id = -1;
+    // The quantity shown when the row was selected; an update applies the
+    // difference, so stock moved by others in the meantime is kept.
+    int selected_quantity = 0;
+    uint64_t live_generation = 0;
+    // Set while the program fills the edits, so that only typing searches.
+    bool suppress_live_search = false;
+    // Local changes only: the service does not report what it journaled.
+    inventory::ChangeHistory history;
+    // Writes whose completion has not arrived yet; undo waits for them, so
+    // that it always takes back the newest change.
+    int writes_in_flight = 0;
+    bool journal_compacting = false;
+    // Copies the database to kBackupFileName a few pages at a time, on its
+    // own connection, while the window keeps working.
+    std::thread backup_thread;
+    std::atomic<bool> backup_cancelled{false};
+    HWND name_edit = nullptr;
+    HWND part_edit = nullptr;
+    HWND nsn_edit = nullptr;
+    HWND serial_edit = nullptr;
+    HWND quantity_edit = nullptr;
+    HWND results_view = nullptr;
+    HWND status_label = nullptr;
+    HWND undo_button = nullptr;
+    HWND redo_button = nullptr;
+    HWND backup_button = nullptr;
+    HWND diagnostics_window = nullptr;
+    HWND totals_window = nullptr;
+    inventory::RollupKind totals_kind = inventory::RollupKind::kNsn;
+};
+
+AppState g_state;
+
+std::wstring GetText(HWND handle) {
+    int length = GetWindowTextLengthW(handle);
+    std::wstring text(static_cast<size_t>(length), L'\0');
+    if (length > 0) {
+        GetWindowTextW(handle, text.data(), length + 1);
+    }
+    return text;
+}
+
+void SetText(HWND handle, const std::wstring& text) {
+    SetWindowTextW(handle, text.c_str());
+}
+
+std::string ToUtf8(const std::wstring& value) {
+    if (value.empty()) {
+        return {};
+    }
+    int size = WideCharToMultiByte(CP_UTF8, 0, value.c_str(), -1, nullptr, 0, nullptr, nullptr);
+    std::string result(static_cast<size_t>(size - 1), '\0');
+    WideCharToMultiByte(CP_UTF8, 0, value.c_str(), -1, result.data(), size, nullptr, nullptr);
+    return result;
+}
+
+// Result text is decoded to UTF-16 once, when its page is loaded; on Windows
+// that is already the wchar_t layout, so cells are copied without conversion.
+static_assert(sizeof(wchar_t) == sizeof(char16_t), "wchar_t must be UTF-16");
+
+std::wstring FromUtf8(const std::string& value) {
+    if (value.empty()) {
+        return {};
+    }
+    int size = MultiByteToWideChar(CP_UTF8, 0, value.c_str(), -1, nullptr, 0);
+    std::wstring result(static_cast<size_t>(size - 1), L'\0');
+    MultiByteToWideChar(CP_UTF8, 0, value.c_str(), -1, result.data(), size);
+    return result;
+}
+
+std::wstring FromUtf16(std::u16string_view value) {
+    return std::wstring(reinterpret_cast<const wchar_t*>(value.data()), value.size());
+}
+
+void CopyText(std::u16string_view value, wchar_t* buffer, int capacity) {
+    size_t length = std::min(value.size(), static_cast<size_t>(capacity - 1));
+    std::memcpy(buffer, value.data(), length * sizeof(wchar_t));
+    buffer[length] = L'\0';
+}
+
+void SetStatus(const std::wstring& message) {
+    SetText(g_state.status_label, message);
+}
+
+// |file_name| in the directory of the executable.
+std::wstring GetProgramFilePath(const wchar_t* file_name) {
+    wchar_t buffer[MAX_PATH] = {};
+    GetModuleFileNameW(nullptr, buffer, MAX_PATH);
+    std::wstring path(buffer);
+    size_t position = path.find_last_of(L"\\/");
+    if (position != std::wstring::npos) {
+        path.erase(position + 1);
+    }
+    path += file_name;
+    return path;
+}
+
+std::wstring GetDatabasePath() {
+    return GetProgramFilePath(L"inventory.db");
+}
+
+void RecordStartup(inventory::StartupPhase phase) {
+    inventory::Metrics().RecordStartup(phase,
+                                       inventory::ScopedLatency::ElapsedNs(g_state.started));
+}
+
+void PostStartupResult(HWND window, std::unique_ptr<StartupResult> result) {
+    if (PostMessageW(window, kStartupMessage, 0, reinterpret_cast<LPARAM>(result.get()))) {
+        result.release();
+    }
+}
+
+// The startup thread. Only the first page of the listing is read before the
+// window gets the database; the count and the snapshot follow from another
+// connection, which also brings the pages later searches read into the
+// operating system's cache.
+void RunStartup(HWND window, std::string db_path) {
+    auto opened = std::make_unique<StartupResult>();
+    if (!g_state.service_address.empty()) {
+        std::string error;
+        opened->ok =
+            g_state.service.Connect(g_state.service_address, error) && g_state.service.Ping();
+        PostStartupResult(window, std::move(opened));
+        return;
+    }
+    const inventory::StorageOptions options;
+    opened->ok = g_state.storage.Start(db_path, options) && g_state.database.Open(db_path) &&
+                 g_state.database.Configure(options) &&
+                 inventory::CountItemsUpTo(g_state.database, kFirstPageRows, opened->rows);
+    opened->trigram_index = opened->ok && inventory::TrigramIndexAvailable(g_state.database);
+    const bool ok = opened->ok;
+    PostStartupResult(window, std::move(opened));
+    if (!ok) {
+        return;
+    }
+
+    inventory::Database database;
+    auto counted = std::make_unique<StartupResult>();
+    counted->phase = inventory::StartupPhase::kCount;
+    counted->ok = database.Open(db_path) && database.Configure(options) &&
+                  inventory::CountItems(database, counted->rows, &g_state.startup_cancelled);
+    PostStartupResult(window, std::move(counted));
+
+    auto warmed = std::make_unique<StartupResult>();
+    warmed->phase = inventory::StartupPhase::kWarmUp;
+    warmed->snapshot = std::make_unique<inventory::ItemSnapshot>();
+    warmed->ok = database.IsOpen() &&
+                 inventory::WarmUp(database, *warmed->snapshot, &g_state.startup_cancelled);
+    warmed->duplicates = std::make_unique<inventory::DuplicateDetector>();
+    if (database.IsOpen()) {
+        warmed->duplicates->Build(database, 0, &g_state.startup_cancelled);
+    }
+    PostStartupResult(window, std::move(warmed));
+}
+
+void StartLiveSearch(HWND window) {
+    if (!g_state.service_address.empty()) {
+        return;
+    }
+    g_state.live_search.Start(
+        ToUtf8(GetDatabasePath()), inventory::StorageOptions(), inventory::LiveSearchOptions(),
+        [window](inventory::LiveSearchResult result) {
+            auto* posted = new inventory::LiveSearchResult(std::move(result));
+            if (!PostMessageW(window, kLiveSearchMessage, 0, reinterpret_cast<LPARAM>(posted))) {
+                delete posted;
+            }
+        });
+}
+
+void ClearInputs() {
+    g_state.suppress_live_search = true;
+    SetText(g_state.name_edit, L"");
+    SetText(g_state.part_edit, L"");
+    SetText(g_state.nsn_edit, L"");
+    SetText(g_state.serial_edit, L"");
+    SetText(g_state.quantity_edit, L"");
+    g_state.suppress_live_search = false;
+    g_state.selected_id = -1;
+    SetStatus(L"Ready");
+}
+
+void ConfigureListViewColumns(HWND list_view) {
+    LVCOLUMNW column = {};
+    column.mask = LVCF_TEXT | LVCF_WIDTH | LVCF_SUBITEM;
+
+    const std::vector<std::wstring> headers = {
+        L"ID", L"Name", L"Part Number", L"NSN", L"Serial Number", L"Quantity", L"Created"};
+    const std::vector<int> widths = {0, 180, 160, 140, 160, 90, 160};
+
+    for (size_t i = 0; i < headers.size(); ++i) {
+        column.pszText = const_cast<wchar_t*>(headers[i].c_str());
+        column.cx = widths[i];
+        column.iSubItem = static_cast<int>(i);
+        ListView_InsertColumn(list_view, static_cast<int>(i), &column);
+    }
+}
+
+inventory::ItemInput ReadInput() {
+    inventory::ItemInput input;
+    input.name = ToUtf8(GetText(g_state.name_edit));
+    input.part_number = ToUtf8(GetText(g_state.part_edit));
+    input.nsn = ToUtf8(GetText(g_state.nsn_edit));
+    input.serial_number = ToUtf8(GetText(g_state.serial_edit));
+    input.quantity = ToUtf8(GetText(g_state.quantity_edit));
+    return input;
+}
+
+bool ReadFilter(inventory::SearchFilter& filter) {
+    return inventory::ParseFilter(ReadInput(), g_state.search_mode, filter) ==
+           inventory::InputProblem::kNone;
+}
+
+void ShowResultCount() {
+    sqlite3_int64 row_count = g_state.rows.total_count();
+    ListView_SetItemCountEx(g_state.results_view,
+                            static_cast<int>(row_count < INT_MAX ? row_count : INT_MAX), 0);
+    SetStatus(std::to_wstring(row_count) + L" record(s) found.");
+}
+
+void RefreshResults() {
+    if (!g_state.opened) {
+        SetStatus(L"Opening the database...");
+        return;
+    }
+    inventory::SearchFilter filter;
+    if (!ReadFilter(filter)) {
+        SetStatus(L"Quantity must be a whole number.");
+        return;
+    }
+
+    // A live search still in flight would otherwise overwrite these results.
+    g_state.live_search.Cancel();
+    g_state.live_generation = 0;
+    ListView_DeleteAllItems(g_state.results_view);
+    // A whole identifier is one probe of its key index, faster than any scan.
+    if (!g_state.service_address.empty()) {
+        if (!g_state.rows.Reset(g_state.service, filter)) {
+            SetStatus(L"Search failed. " + FromUtf8(g_state.service.last_error()));
+            return;
+        }
+    } else if (g_state.snapshot.loaded() && !filter.ExactMask()) {
+        std::vector<sqlite3_int64> ids;
+        g_state.snapshot.Search(filter, ids);
+        // Nothing found may be a typo in the name or part number.
+        if (ids.empty()) {
+            g_state.snapshot.FuzzySearch(filter, ids);
+            if (!ids.empty()) {
+                const size_t count = ids.size();
+                g_state.rows.ResetWithIds(g_state.database, std::move(ids));
+                ListView_SetItemCountEx(g_state.results_view, static_cast<int>(count), 0);
+                SetStatus(L"No exact match; " + std::to_wstring(count) +
+                          L" close match(es), best first.");
+                return;
+            }
+        }
+        g_state.rows.ResetWithIds(g_state.database, std::move(ids));
+    } else if (g_state.counting_rows && !filter.Mask()) {
+        g_state.rows.Reset(g_state.database, filter, g_state.first_page_rows);
+        ShowResultCount();
+        SetStatus(L"Showing the newest " + std::to_wstring(g_state.first_page_rows) +
+                  L" records; counting the rest...");
+        return;
+    } else if (!g_state.rows.Reset(g_state.database, filter)) {
+        SetStatus(L"Search failed.");
+        return;
+    }
+    ShowResultCount();
+}
+
+void OnSearchTextChanged() {
+    // A service is searched with the Search button, not on every keystroke;
+    // what is typed before the database is open is searched once it is.
+    if (g_state.suppress_live_search || !g_state.service_address.empty() || !g_state.opened) {
+        return;
+    }
+    // The snapshot answers fast enough to search on every keystroke.
+    if (g_state.snapshot.loaded()) {
+        RefreshResults();
+        return;
+    }
+    inventory::SearchFilter filter;
+    if (!ReadFilter(filter)) {
+        SetStatus(L"Quantity must be a whole number.");
+        return;
+    }
+    g_state.live_generation = g_state.live_search.Submit(filter);
+}
+
+void OnLiveSearchResult(LPARAM lparam) {
+    std::unique_ptr<inventory::LiveSearchResult> result(
+        reinterpret_cast<inventory::LiveSearchResult*>(lparam));
+    if (result->generation != g_state.live_generation) {
+        return;
+    }
+
+    ListView_DeleteAllItems(g_state.results_view);
+    if (result->complete) {
+        g_state.rows.ResetWithIds(g_state.database, std::move(result->ids));
+    } else if (!g_state.rows.Reset(g_state.database, result->filter, result->total_count)) {
+        SetStatus(L"Search failed.");
+        return;
+    }
+    ShowResultCount();
+}
+
+void OnGetDisplayInfo(NMLVDISPINFOW* info) {
+    LVITEMW& item = info->item;
+    if (!(item.mask & LVIF_TEXT) || !item.pszText || item.cchTextMax <= 0) {
+        return;
+    }
+    item.pszText[0] = L'\0';
+    inventory::RowRef row = g_state.rows.Row(item.iItem);
+    if (!row) {
+        return;
+    }
+    switch (item.iSubItem) {
+        case 0:
+            swprintf(item.pszText, static_cast<size_t>(item.cchTextMax), L"%lld",
+                     static_cast<long long>(row.id()));
+            break;
+        case 1:
+            CopyText(row.text(inventory::kColumnName), item.pszText, item.cchTextMax);
+            break;
+        case 2:
+            CopyText(row.text(inventory::kColumnPartNumber), item.pszText, item.cchTextMax);
+            break;
+        case 3:
+            CopyText(row.text(inventory::kColumnNsn), item.pszText, item.cchTextMax);
+            break;
+        case 4:
+            CopyText(row.text(inventory::kColumnSerialNumber), item.pszText, item.cchTextMax);
+            break;
+        case 5:
+            swprintf(item.pszText, static_cast<size_t>(item.cchTextMax), L"%d", row.quantity());
+            break;
+        case 6:
+            CopyText(row.text(inventory::kColumnCreatedAt), item.pszText, item.cchTextMax);
+            break;
+        default:
+            break;
+    }
+}
+
+// The write task fills in |result| before the completion runs; both run on
+// the storage thread. The latency is measured from here, when the write is
+// posted.
+inventory::StorageWorker::Completion NotifyWindow(HWND window,
+                                                  std::shared_ptr<WriteResult> result) {
+    static const inventory::Operation kMetrics[] = {
+        inventory::Operation::kSave, inventory::Operation::kUpdate, inventory::Operation::kDelete,
+        inventory::Operation::kUndo, inventory::Operation::kRedo};
+    const auto start = std::chrono::steady_clock::now();
+    return [window, result, start](bool ok) {
+        if (ok) {
+            inventory::Metrics()
+                .operation(kMetrics[result->operation])
+                .Record(inventory::ScopedLatency::ElapsedNs(start));
+        }
+        auto* posted = new WriteResult(*result);
+        posted->ok = ok;
+        if (!PostMessageW(window, kStorageDoneMessage, 0, reinterpret_cast<LPARAM>(posted))) {
+            delete posted;
+        }
+    };
+}
+
+// Runs a write on the storage thread, journaling what it changed in
+// |result|, or sends it to the service as |request|. |done| runs on the
+// storage or receive thread either way; for an insert through the service it
+// first stores the new row's id in |result|.
+void PostItemWrite(inventory::StorageWorker::Task task, inventory::ServiceRequest request,
+                   std::shared_ptr<WriteResult> result,
+                   inventory::StorageWorker::Completion done) {
+    ++g_state.writes_in_flight;
+    if (g_state.service_address.empty()) {
+        g_state.storage.PostWrite(
+            [task = std::move(task), result](inventory::Database& database) {
+                return inventory::RecordChange(database, task, result->change);
+            },
+            std::move(done));
+        return;
+    }
+    const bool insert = request.op == inventory::ServiceOp::kInsert;
+    auto answered = [result, insert, done](inventory::ServiceResponse& response) {
+        const bool ok = response.status == inventory::ServiceStatus::kOk;
+        if (ok && insert) {
+            result->id = response.value;
+        }
+        done(ok);
+    };
+    if (!g_state.service.Post(std::move(request), std::move(answered))) {
+        done(false);
+    }
+}
+
+// Reads and validates the edits; reports the problem in the status bar.
+bool ReadItem(const wchar_t* missing_message, inventory::Item& item) {
+    switch (inventory::ParseItem(ReadInput(), item)) {
+        case inventory::InputProblem::kNone:
+            return true;
+        case inventory::InputProblem::kMissingField:
+            SetStatus(missing_message);
+            return false;
+        case inventory::InputProblem::kBadQuantity:
+            SetStatus(L"Quantity must be a whole number.");
+            return false;
+    }
+    return false;
+}
+
+// Looks for other items with the serial number before a local |action|. One
+// with the same part number too asks whether to go on; one with only the
+// serial number leaves a |warning| for the status bar. A failed lookup never
+// stops the write.
+bool ConfirmNotDuplicate(HWND window, const wchar_t* action, const inventory::Item& item,
+                         sqlite3_int64 exclude_id, std::wstring& warning) {
+    inventory::DuplicateMatch match;
+    if (!g_state.service_address.empty() ||
+        !g_state.duplicates.Check(g_state.database, item.part_number, item.serial_number, match,
+                                  exclude_id) ||
+        match.kind == inventory::DuplicateKind::kNone) {
+        return true;
+    }
+    wchar_t text[192];
+    if (match.kind == inventory::DuplicateKind::kSerial) {
+        std::swprintf(text, 192, L" Record %lld has the same serial number.",
+                      static_cast<long long>(match.id));
+        warning = text;
+        return true;
+    }
+    std::swprintf(text, 192,
+                  L"Record %lld already has this part and serial number.\n\n%ls anyway?",
+                  static_cast<long long>(match.id), action);
+    if (MessageBoxW(window, text, L"Possible Duplicate", MB_ICONWARNING | MB_YESNO) == IDYES) {
+        return true;
+    }
+    SetStatus(std::wstring(action) + L" cancelled.");
+    return false;
+}
+
+void SaveRecord(HWND window) {
+    inventory::Item item;
+    if (!ReadItem(L"Please fill out all fields before saving.", item)) {
+        return;
+    }
+    std::wstring warning;
+    if (!ConfirmNotDuplicate(window, L"Save", item, 0, warning)) {
+        return;
+    }
+    auto result = std::make_shared<WriteResult>();
+    result->operation = kSaveOperation;
+    result->warning = std::move(warning);
+    inventory::ServiceRequest request;
+    request.op = inventory::ServiceOp::kInsert;
+    request.item = item;
+    PostItemWrite(
+        [item = std::move(item), result](inventory::Database& database) {
+            return inventory::InsertItem(database, item, &result->id);
+        },
+        std::move(request), result, NotifyWindow(window, result));
+    SetStatus(L"Saving...");
+}
+
+void UpdateRecord(HWND window) {
+    if (g_state.selected_id < 0) {
+        SetStatus(L"Select a record to update.");
+        return;
+    }
+    inventory::Item item;
+    if (!ReadItem(L"Please fill out all fields before updating.", item)) {
+        return;
+    }
+    const long long change = static_cast<long long>(item.quantity) - g_state.selected_quantity;
+    if (change < INT_MIN || change > INT_MAX) {
+        SetStatus(L"Quantity change is too large.");
+        return;
+    }
+    item.id = g_state.selected_id;
+    std::wstring warning;
+    if (!ConfirmNotDuplicate(window, L"Update", item, item.id, warning)) {
+        return;
+    }
+    // Both changes run in the write's savepoint, so they land together.
+    const std::vector<inventory::StockDelta> deltas = {
+        {item.id, static_cast<int>(change)}};
+    auto result = std::make_shared<WriteResult>();
+    result->operation = kUpdateOperation;
+    result->id = item.id;
+    result->warning = std::move(warning);
+    inventory::ServiceRequest request;
+    request.op = inventory::ServiceOp::kUpdate;
+    request.item = item;
+    request.delta = deltas[0].delta;
+    PostItemWrite(
+        [item = std::move(item), deltas](inventory::Database& database) {
+            return inventory::UpdateItem(database, item) &&
+                   (deltas[0].delta == 0 || inventory::ApplyStockDeltas(database, deltas));
+        },
+        std::move(request), result, NotifyWindow(window, result));
+    SetStatus(L"Updating...");
+}
+
+void DeleteRecord(HWND window) {
+    if (g_state.selected_id < 0) {
+        SetStatus(L"Select a record to delete.");
+        return;
+    }
+    // A local delete can be undone, so only one through the service asks.
+    if (!g_state.service_address.empty() &&
+        MessageBoxW(window, L"Delete the selected record?", L"Delete Record",
+                    MB_ICONWARNING | MB_YESNO) != IDYES) {
+        SetStatus(L"Delete cancelled.");
+        return;
+    }
+
+    auto result = std::make_shared<WriteResult>();
+    result->operation = kDeleteOperation;
+    result->id = g_state.selected_id;
+    inventory::ServiceRequest request;
+    request.op = inventory::ServiceOp::kDelete;
+    request.item_id = result->id;
+    PostItemWrite(
+        [id = result->id](inventory::Database& database) {
+            return inventory::DeleteItem(database, id);
+        },
+        std::move(request), result, NotifyWindow(window, result));
+    SetStatus(L"Deleting...");
+}
+
+void UpdateHistoryButtons() {
+    const bool local = g_state.service_address.empty();
+    EnableWindow(g_state.undo_button, local && g_state.history.can_undo());
+    EnableWindow(g_state.redo_button, local && g_state.history.can_redo());
+}
+
+// Reverts the newest change on the undo or redo stack. The revert is
+// journaled like any write, so it lands on the other stack.
+void RevertLastChange(HWND window, bool redo) {
+    if (!g_state.service_address.empty()) {
+        return;
+    }
+    if (g_state.writes_in_flight > 0) {
+        SetStatus(L"Wait for the last change to be saved.");
+        return;
+    }
+    inventory::ItemChange change;
+    if (!(redo ? g_state.history.PeekRedo(change) : g_state.history.PeekUndo(change))) {
+        SetStatus(redo ? L"Nothing to redo." : L"Nothing to undo.");
+        return;
+    }
+    auto result = std::make_shared<WriteResult>();
+    result->operation = redo ? kRedoOperation : kUndoOperation;
+    ++g_state.writes_in_flight;
+    g_state.storage.PostWrite(
+        [change, result](inventory::Database& database) {
+            return inventory::RevertChange(database, change, result->change) &&
+                   inventory::ChangedItems(database, result->change, result->items);
+        },
+        NotifyWindow(window, result));
+    SetStatus(redo ? L"Redoing..." : L"Undoing...");
+}
+
+// Drops journal entries older than kJournalKeepDays, one segment per write,
+// so that the window's own writes get in between.
+void CompactJournal(HWND window) {
+    if (!g_state.service_address.empty() || g_state.journal_compacting) {
+        return;
+    }
+    g_state.journal_compacting = true;
+    auto compaction = std::make_shared<inventory::JournalCompaction>();
+    g_state.storage.PostWrite(
+        [compaction](inventory::Database& database) {
+            return inventory::CompactJournal(database, inventory::kJournalKeepDays * 24 * 3600,
+                                             inventory::kJournalCompactionSegment,
+                                             compaction.get());
+        },
+        [window, compaction](bool ok) {
+            PostMessageW(window, kJournalCompactedMessage, ok && compaction->more ? 1 : 0, 0);
+        });
+}
+
+void OnJournalCompacted(HWND window, WPARAM more) {
+    g_state.journal_compacting = false;
+    if (more) {
+        CompactJournal(window);
+    }
+}
+
+void StartBackup(HWND window) {
+    if (!g_state.service_address.empty() || g_state.backup_thread.joinable()) {
+        return;
+    }
+    EnableWindow(g_state.backup_button, FALSE);
+    g_state.backup_cancelled = false;
+    g_state.backup_thread = std::thread(
+        [window, source = ToUtf8(GetDatabasePath()),
+         target = ToUtf8(GetProgramFilePath(kBackupFileName))] {
+            auto report = std::make_unique<inventory::BackupReport>();
+            int shown = -1;
+            inventory::BackupDatabase(
+                source, target, inventory::BackupOptions(), *report,
+                [window, &shown](int copied, int total) {
+                    const int percent = total > 0 ? static_cast<int>(copied * 100LL / total) : 0;
+                    if (percent != shown) {
+                        shown = percent;
+                        PostMessageW(window, kBackupProgressMessage, percent, 0);
+                    }
+                    return !g_state.backup_cancelled.load();
+                });
+            if (PostMessageW(window, kBackupDoneMessage, 0,
+                             reinterpret_cast<LPARAM>(report.get()))) {
+                report.release();
+            }
+        });
+    SetStatus(L"Backing up...");
+}
+
+void OnBackupDone(LPARAM lparam) {
+    std::unique_ptr<inventory::BackupReport> report(
+        reinterpret_cast<inventory::BackupReport*>(lparam));
+    g_state.backup_thread.join();
+    EnableWindow(g_state.backup_button, TRUE);
+    if (!report->fatal_error.empty()) {
+        SetStatus(L"Backup failed: " + FromUtf8(report->fatal_error));
+        return;
+    }
+    wchar_t summary[128];
+    std::swprintf(summary, 128, L" (%.1f MB in %.1f s).", report->written_bytes / 1e6,
+                  report->seconds);
+    SetStatus(L"Backed up to " + GetProgramFilePath(kBackupFileName) + summary);
+}
+
+void SyncSnapshot(const std::vector<sqlite3_int64>& items) {
+    for (sqlite3_int64 id : items) {
+        if (!g_state.snapshot.Sync(g_state.database, id)) {
+            // Fall back to SQLite rather than show stale results.
+            g_state.snapshot.Clear();
+            return;
+        }
+    }
+}
+
+void SyncDuplicates(const std::vector<sqlite3_int64>& items) {
+    for (sqlite3_int64 id : items) {
+        if (!g_state.duplicates.Sync(g_state.database, id)) {
+            // Probing every check is slower but never misses a duplicate.
+            g_state.duplicates.Clear();
+            return;
+        }
+    }
+}
+
+void OnStorageDone(LPARAM lparam) {
+    static const wchar_t* const kDone[] = {L"Record saved.", L"Record updated.",
+                                           L"Record deleted.", L"Change undone.",
+                                           L"Change redone."};
+    static const wchar_t* const kFailed[] = {L"Save failed.", L"Update failed.",
+                                             L"Delete failed.", L"Undo failed.",
+                                             L"Redo failed."};
+    std::unique_ptr<WriteResult> result(reinterpret_cast<WriteResult*>(lparam));
+    const StorageOperation operation = result->operation;
+    --g_state.writes_in_flight;
+    if (operation == kUndoOperation || operation == kRedoOperation) {
+        // A change that cannot be reverted now never can be, so it is
+        // dropped from the history.
+        const inventory::ItemChange* revert = result->ok ? &result->change : nullptr;
+        if (operation == kUndoOperation) {
+            g_state.history.FinishUndo(revert);
+        } else {
+            g_state.history.FinishRedo(revert);
+        }
+    } else if (result->ok) {
+        g_state.history.Record(result->change);
+    }
+    UpdateHistoryButtons();
+    if (!result->ok) {
+        std::wstring reason;
+        if (operation == kUndoOperation || operation == kRedoOperation) {
+            reason = L"The records have changed since, or the change is too old.";
+        } else {
+            reason = FromUtf8(g_state.service_address.empty() ? g_state.storage.last_error()
+                                                              : g_state.service.last_error());
+        }
+        SetStatus(reason.empty() ? kFailed[operation]
+                                 : std::wstring(kFailed[operation]) + L" " + reason);
+        return;
+    }
+    SetStatus(kDone[operation]);
+    g_state.live_search.Invalidate();
+    if (result->items.empty()) {
+        result->items.push_back(result->id);
+    }
+    if (g_state.snapshot.loaded()) {
+        SyncSnapshot(result->items);
+    }
+    SyncDuplicates(result->items);
+    if (g_state.warming_up) {
+        g_state.unsynced_items.insert(g_state.unsynced_items.end(), result->items.begin(),
+                                      result->items.end());
+    }
+    ClearInputs();
+    RefreshResults();
+    if (!result->warning.empty()) {
+        SetStatus(kDone[operation] + result->warning);
+    }
+}
+
+void OnStartupResult(HWND window, LPARAM lparam) {
+    std::unique_ptr<StartupResult> result(reinterpret_cast<StartupResult*>(lparam));
+    switch (result->phase) {
+        case inventory::StartupPhase::kOpen:
+            if (!result->ok) {
+                MessageBoxW(window,
+                            g_state.service_address.empty()
+                                ? L"Failed to initialize the database."
+                                : L"Cannot reach the inventory service.",
+                            L"Error", MB_ICONERROR);
+                DestroyWindow(window);
+                return;
+            }
+            g_state.opened = true;
+            if (g_state.service_address.empty()) {
+                // Each search still scans unless its terms are ones the
+                // index beats a scan for; see SearchFilter::IndexedMask.
+                if (result->trigram_index) {
+                    g_state.search_mode = inventory::SearchMode::kTrigramIndex;
+                }
+                // Fewer rows than a page is already the count.
+                g_state.first_page_rows = result->rows;
+                g_state.counting_rows = result->rows == kFirstPageRows;
+                g_state.warming_up = true;
+                StartLiveSearch(window);
+                SetTimer(window, kJournalTimer, kJournalCompactionIntervalMs, nullptr);
+            }
+            RefreshResults();
+            UpdateWindow(g_state.results_view);
+            RecordStartup(inventory::StartupPhase::kFirstRows);
+            return;
+        case inventory::StartupPhase::kCount:
+            RecordStartup(inventory::StartupPhase::kCount);
+            // The window counts again on its own connection, which now reads
+            // the cached pages, since writes may have landed meanwhile.
+            if (g_state.counting_rows) {
+                g_state.counting_rows = false;
+                RefreshResults();
+            }
+            return;
+        case inventory::StartupPhase::kWarmUp:
+            g_state.startup_thread.join();
+            RecordStartup(inventory::StartupPhase::kWarmUp);
+            g_state.warming_up = false;
+            if (result->ok && result->snapshot->loaded()) {
+                g_state.snapshot = std::move(*result->snapshot);
+                SyncSnapshot(g_state.unsynced_items);
+            }
+            if (result->duplicates->built()) {
+                g_state.duplicates = std::move(*result->duplicates);
+                SyncDuplicates(g_state.unsynced_items);
+            }
+            g_state.unsynced_items.clear();
+            return;
+        default:
+            return;
+    }
+}
+
+void OnListViewSelect() {
+    int selected = ListView_GetNextItem(g_state.results_view, -1, LVNI_SELECTED);
+    if (selected < 0) {
+        return;
+    }
+
+    inventory::RowRef row = g_state.rows.Row(selected);
+    if (!row) {
+        return;
+    }
+    g_state.selected_id = row.id();
+    g_state.selected_quantity = row.quantity();
+    g_state.suppress_live_search = true;
+    SetText(g_state.name_edit, FromUtf16(row.text(inventory::kColumnName)));
+    SetText(g_state.part_edit, FromUtf16(row.text(inventory::kColumnPartNumber)));
+    SetText(g_state.nsn_edit, FromUtf16(row.text(inventory::kColumnNsn)));
+    SetText(g_state.serial_edit, FromUtf16(row.text(inventory::kColumnSerialNumber)));
+    SetText(g_state.quantity_edit, std::to_wstring(row.quantity()));
+    g_state.suppress_live_search = false;
+}
+
+void LayoutControls(HWND window, int width, int height) {
+    const int margin = 16;
+    const int label_width = 110;
+    const int edit_height = 24;
+    const int row_gap = 12;
+    const int column_gap = 24;
+    const int column_width = (width - margin * 2 - column_gap) / 2;
+    const int edit_width = column_width - label_width - 10;
+
+    int left_x = margin;
+    int right_x = margin + column_width + column_gap;
+    int y = margin;
+
+    auto place_field = [&](HWND label, HWND edit, int x, int y_pos) {
+        MoveWindow(label, x, y_pos, label_width, edit_height, TRUE);
+        MoveWindow(edit, x + label_width + 8, y_pos, edit_width, edit_height, TRUE);
+    };
+
+    HWND name_label = GetDlgItem(window, kNameEdit - 100);
+    HWND part_label = GetDlgItem(window, kPartEdit - 100);
+    HWND nsn_label = GetDlgItem(window, kNsnEdit - 100);
+    HWND serial_label = GetDlgItem(window, kSerialEdit - 100);
+    HWND quantity_label = GetDlgItem(window, kQuantityEdit - 100);
+
+    place_field(name_label, g_state.name_edit, left_x, y);
+    place_field(serial_label, g_state.serial_edit, right_x, y);
+    y += edit_height + row_gap;
+    place_field(part_label, g_state.part_edit, left_x, y);
+    place_field(quantity_label, g_state.quantity_edit, right_x, y);
+    y += edit_height + row_gap;
+    place_field(nsn_label, g_state.nsn_edit, left_x, y);
+
+    int button_y = y + edit_height + row_gap;
+    const int button_width = 110;
+    const int button_height = 28;
+    const int button_gap = 10;
+
+    int button_x = margin;
+    const int buttons[] = {kSaveButton, kUpdateButton, kDeleteButton, kUndoButton,
+                           kRedoButton, kSearchButton, kClearButton,  kDiagnosticsButton,
+                           kBackupButton, kTotalsButton};
+    for (int id : buttons) {
+        HWND button = GetDlgItem(window, id);
+        MoveWindow(button, button_x, button_y, button_width, button_height, TRUE);
+        button_x += button_width + button_gap;
+    }
+
+    int list_y = button_y + button_height + row_gap;
+    int status_height = 22;
+    int list_height = height - list_y - status_height - margin;
+    MoveWindow(g_state.results_view, margin, list_y, width - margin * 2, list_height, TRUE);
+    MoveWindow(g_state.status_label, margin, height - status_height - margin,
+               width - margin * 2, status_height, TRUE);
+}
+
+// |report| with Windows line breaks, for a multiline edit.
+std::wstring WithLineBreaks(const std::string& report) {
+    std::wstring text;
+    text.reserve(report.size() + report.size() / 32);
+    for (wchar_t c : FromUtf8(report)) {
+        if (c == L'\n') {
+            text += L'\r';
+        }
+        text += c;
+    }
+    return text;
+}
+
+// The metrics report, for the diagnostics edit.
+std::wstring DiagnosticsText() {
+    std::string report;
+    inventory::Metrics().Format(report);
+    report += "\n";
+    if (!g_state.service_address.empty()) {
+        // The database figures belong to the service's process.
+        report += "service: " + g_state.service_address +
+                  (g_state.service.connected() ? ", connected\n" : ", disconnected\n");
+    } else if (g_state.opened) {
+        inventory::FormatDatabaseStats(g_state.database, report);
+        const inventory::StorageStats stats = g_state.storage.stats();
+        report += "\nstorage thread: " + std::to_string(stats.writes) + " writes, " +
+                  std::to_string(stats.failed_writes) + " failed, " +
+                  std::to_string(stats.commits) + " commits\n";
+    }
+    return WithLineBreaks(report);
+}
+
+void SaveDiagnostics() {
+    const std::wstring path = GetProgramFilePath(kMetricsFileName);
+    const std::string text = ToUtf8(DiagnosticsText());
+    HANDLE file = CreateFileW(path.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS,
+                              FILE_ATTRIBUTE_NORMAL, nullptr);
+    DWORD written = 0;
+    const bool saved = file != INVALID_HANDLE_VALUE &&
+                       WriteFile(file, text.data(), static_cast<DWORD>(text.size()), &written,
+                                 nullptr) &&
+                       written == text.size();
+    if (file != INVALID_HANDLE_VALUE) {
+        CloseHandle(file);
+    }
+    SetStatus(saved ? L"Metrics saved to " + path : L"Could not write " + path);
+}
+
+LRESULT CALLBACK DiagnosticsProc(HWND window, UINT message, WPARAM wparam, LPARAM lparam) {
+    switch (message) {
+        case WM_CREATE: {
+            HWND text = CreateWindowW(
+                L"EDIT", L"",
+                WS_CHILD | WS_VISIBLE | WS_BORDER | WS_VSCROLL | WS_HSCROLL | ES_MULTILINE |
+                    ES_READONLY | ES_AUTOVSCROLL | ES_AUTOHSCROLL,
+                0, 0, 0, 0, window, reinterpret_cast<HMENU>(kDiagnosticsText), nullptr, nullptr);
+            // The report is laid out in columns.
+            SendMessageW(text, WM_SETFONT,
+                         reinterpret_cast<WPARAM>(GetStockObject(ANSI_FIXED_FONT)), TRUE);
+            CreateWindowW(L"BUTTON", L"Refresh", WS_CHILD | WS_VISIBLE | BS_PUSHBUTTON, 0, 0, 0,
+                          0, window, reinterpret_cast<HMENU>(kDiagnosticsRefresh), nullptr,
+                          nullptr);
+            CreateWindowW(L"BUTTON", L"Save to File", WS_CHILD | WS_VISIBLE | BS_PUSHBUTTON, 0,
+                          0, 0, 0, window, reinterpret_cast<HMENU>(kDiagnosticsSave), nullptr,
+                          nullptr);
+            SetText(text, DiagnosticsText());
+            return 0;
+        }
+        case WM_SIZE: {
+            const int width = LOWORD(lparam);
+            const int height = HIWORD(lparam);
+            const int margin = 8;
+            const int button_width = 110;
+            const int button_height = 28;
+            const int button_y = height - margin - button_height;
+            MoveWindow(GetDlgItem(window, kDiagnosticsText), margin, margin, width - margin * 2,
+                       button_y - margin * 2, TRUE);
+            MoveWindow(GetDlgItem(window, kDiagnosticsRefresh), margin, button_y, button_width,
+                       button_height, TRUE);
+            MoveWindow(GetDlgItem(window, kDiagnosticsSave), margin * 2 + button_width, button_y,
+                       button_width, button_height, TRUE);
+            return 0;
+        }
+        case WM_COMMAND:
+            switch (LOWORD(wparam)) {
+                case kDiagnosticsRefresh:
+                    SetText(GetDlgItem(window, kDiagnosticsText), DiagnosticsText());
+                    return 0;
+                case kDiagnosticsSave:
+                    SaveDiagnostics();
+                    return 0;
+                default:
+                    return 0;
+            }
+        case WM_DESTROY:
+            g_state.diagnostics_window = nullptr;
+            return 0;
+        default:
+            return DefWindowProcW(window, message, wparam, lparam);
+    }
+}
+
+void ShowDiagnostics(HWND owner) {
+    if (g_state.diagnostics_window) {
+        SetText(GetDlgItem(g_state.diagnostics_window, kDiagnosticsText), DiagnosticsText());
+        SetForegroundWindow(g_state.diagnostics_window);
+        return;
+    }
+    g_state.diagnostics_window = CreateWindowExW(
+        0, kDiagnosticsClassName, L"Diagnostics", WS_OVERLAPPEDWINDOW, CW_USEDEFAULT,
+        CW_USEDEFAULT, 960, 540, owner, nullptr, nullptr, nullptr);
+    if (g_state.diagnostics_window) {
+        ShowWindow(g_state.diagnostics_window, SW_SHOW);
+    }
+}
+
+// Every group of the chosen rollup, most stock first, read from its table.
+std::wstring TotalsText() {
+    inventory::RollupQuery query;
+    query.kind = g_state.totals_kind;
+    query.order = inventory::RollupOrder::kQuantity;
+    std::vector<inventory::Rollup> rollups;
+    if (!inventory::QueryRollups(g_state.database, query, rollups)) {
+        return L"Could not read the totals: " + FromUtf8(g_state.database.last_error());
+    }
+    std::string report;
+    inventory::FormatRollups(query.kind, rollups, report);
+    return WithLineBreaks(report);
+}
+
+void RefreshTotals(inventory::RollupKind kind) {
+    g_state.totals_kind = kind;
+    SetText(GetDlgItem(g_state.totals_window, kTotalsText), TotalsText());
+}
+
+LRESULT CALLBACK TotalsProc(HWND window, UINT message, WPARAM wparam, LPARAM lparam) {
+    static const struct {
+        int id;
+        const wchar_t* label;
+        inventory::RollupKind kind;
+    } kKinds[] = {{kTotalsByNsn, L"By NSN", inventory::RollupKind::kNsn},
+                  {kTotalsByPart, L"By Part Number", inventory::RollupKind::kPartNumber},
+                  {kTotalsByName, L"By Name", inventory::RollupKind::kName}};
+    switch (message) {
+        case WM_CREATE: {
+            HWND text = CreateWindowW(
+                L"EDIT", L"",
+                WS_CHILD | WS_VISIBLE | WS_BORDER | WS_VSCROLL | WS_HSCROLL | ES_MULTILINE |
+                    ES_READONLY | ES_AUTOVSCROLL | ES_AUTOHSCROLL,
+                0, 0, 0, 0, window, reinterpret_cast<HMENU>(kTotalsText), nullptr, nullptr);
+            SendMessageW(text, WM_SETFONT,
+                         reinterpret_cast<WPARAM>(GetStockObject(ANSI_FIXED_FONT)), TRUE);
+            for (const auto& kind : kKinds) {
+                CreateWindowW(L"BUTTON", kind.label, WS_CHILD | WS_VISIBLE | BS_PUSHBUTTON, 0, 0,
+                              0, 0, window, reinterpret_cast<HMENU>(kind.id), nullptr, nullptr);
+            }
+            SetText(text, TotalsText());
+            return 0;
+        }
+        case WM_SIZE: {
+            const int width = LOWORD(lparam);
+            const int height = HIWORD(lparam);
+            const int margin = 8;
+            const int button_width = 110;
+            const int button_height = 28;
+            const int button_y = height - margin - button_height;
+            MoveWindow(GetDlgItem(window, kTotalsText), margin, margin, width - margin * 2,
+                       button_y - margin * 2, TRUE);
+            int button_x = margin;
+            for (const auto& kind : kKinds) {
+                MoveWindow(GetDlgItem(window, kind.id), button_x, button_y, button_width,
+                           button_height, TRUE);
+                button_x += button_width + margin;
+            }
+            return 0;
+        }
+        case WM_COMMAND:
+            for (const auto& kind : kKinds) {
+                if (LOWORD(wparam) == kind.id) {
+                    RefreshTotals(kind.kind);
+                }
+            }
+            return 0;
+        case WM_DESTROY:
+            g_state.totals_window = nullptr;
+            return 0;
+        default:
+            return DefWindowProcW(window, message, wparam, lparam);
+    }
+}
+
+// The rollup tables answer in time proportional to the groups, so the report
+// is read again each time it is shown.
+void ShowTotals(HWND owner) {
+    if (g_state.totals_window) {
+        RefreshTotals(g_state.totals_kind);
+        SetForegroundWindow(g_state.totals_window);
+        return;
+    }
+    g_state.totals_window = CreateWindowExW(0, kTotalsClassName, L"Totals", WS_OVERLAPPEDWINDOW,
+                                            CW_USEDEFAULT, CW_USEDEFAULT, 960, 540, owner,
+                                            nullptr, nullptr, nullptr);
+    if (g_state.totals_window) {
+        ShowWindow(g_state.totals_window, SW_SHOW);
+    }
+}
+
+LRESULT CALLBACK WindowProc(HWND window, UINT message, WPARAM wparam, LPARAM lparam) {
+    switch (message) {
+        case WM_CREATE: {
+            CreateWindowW(L"STATIC", L"Name:", WS_CHILD | WS_VISIBLE, 0, 0, 0, 0, window,
+                          reinterpret_cast<HMENU>(kNameEdit - 100), nullptr, nullptr);
+            CreateWindowW(L"STATIC", L"Part Number:", WS_CHILD | WS_VISIBLE, 0, 0, 0, 0, window,
+                          reinterpret_cast<HMENU>(kPartEdit - 100), nullptr, nullptr);
+            CreateWindowW(L"STATIC", L"NSN:", WS_CHILD | WS_VISIBLE, 0, 0, 0, 0, window,
+                          reinterpret_cast<HMENU>(kNsnEdit - 100), nullptr, nullptr);
+            CreateWindowW(L"STATIC", L"Serial Number:", WS_CHILD | WS_VISIBLE, 0, 0, 0, 0, window,
+                          reinterpret_cast<HMENU>(kSerialEdit - 100), nullptr, nullptr);
+            CreateWindowW(L"STATIC", L"Quantity:", WS_CHILD | WS_VISIBLE, 0, 0, 0, 0, window,
+                          reinterpret_cast<HMENU>(kQuantityEdit - 100), nullptr, nullptr);
+
+            g_state.name_edit = CreateWindowW(L"EDIT", L"", WS_CHILD | WS_VISIBLE | WS_BORDER,
+                                              0, 0, 0, 0, window,
+                                              reinterpret_cast<HMENU>(kNameEdit), nullptr,
+                                              nullptr);
+            g_state.part_edit = CreateWindowW(L"EDIT", L"", WS_CHILD | WS_VISIBLE | WS_BORDER,
+                                              0, 0, 0, 0, window,
+                                              reinterpret_cast<HMENU>(kPartEdit), nullptr,
+                                              nullptr);
+            g_state.nsn_edit = CreateWindowW(L"EDIT", L"", WS_CHILD | WS_VISIBLE | WS_BORDER,
+                                             0, 0, 0, 0, window,
+                                             reinterpret_cast<HMENU>(kNsnEdit), nullptr, nullptr);
+            g_state.serial_edit = CreateWindowW(L"EDIT", L"", WS_CHILD | WS_VISIBLE | WS_BORDER,
+                                                0, 0, 0, 0, window,
+                                                reinterpret_cast<HMENU>(kSerialEdit), nullptr,
+                                                nullptr);
+            g_state.quantity_edit = CreateWindowW(
+                L"EDIT", L"", WS_CHILD | WS_VISIBLE | WS_BORDER, 0, 0, 0, 0, window,
+                reinterpret_cast<HMENU>(kQuantityEdit), nullptr, nullptr);
+
+            CreateWindowW(L"BUTTON", L"Save", WS_CHILD | WS_VISIBLE | BS_PUSHBUTTON, 0, 0, 0, 0,
+                          window, reinterpret_cast<HMENU>(kSaveButton), nullptr, nullptr);
+            CreateWindowW(L"BUTTON", L"Update", WS_CHILD | WS_VISIBLE | BS_PUSHBUTTON, 0, 0, 0,
+                          0, window, reinterpret_cast<HMENU>(kUpdateButton), nullptr, nullptr);
+            CreateWindowW(L"BUTTON", L"Delete", WS_CHILD | WS_VISIBLE | BS_PUSHBUTTON, 0, 0, 0,
+                          0, window, reinterpret_cast<HMENU>(kDeleteButton), nullptr, nullptr);
+            g_state.undo_button = CreateWindowW(
+                L"BUTTON", L"Undo", WS_CHILD | WS_VISIBLE | WS_DISABLED | BS_PUSHBUTTON, 0, 0, 0,
+                0, window, reinterpret_cast<HMENU>(kUndoButton), nullptr, nullptr);
+            g_state.redo_button = CreateWindowW(
+                L"BUTTON", L"Redo", WS_CHILD | WS_VISIBLE | WS_DISABLED | BS_PUSHBUTTON, 0, 0, 0,
+                0, window, reinterpret_cast<HMENU>(kRedoButton), nullptr, nullptr);
+            CreateWindowW(L"BUTTON", L"Search", WS_CHILD | WS_VISIBLE | BS_PUSHBUTTON, 0, 0, 0,
+                          0, window, reinterpret_cast<HMENU>(kSearchButton), nullptr, nullptr);
+            CreateWindowW(L"BUTTON", L"Clear", WS_CHILD | WS_VISIBLE | BS_PUSHBUTTON, 0, 0, 0, 0,
+                          window, reinterpret_cast<HMENU>(kClearButton), nullptr, nullptr);
+            CreateWindowW(L"BUTTON", L"Diagnostics", WS_CHILD | WS_VISIBLE | BS_PUSHBUTTON, 0, 0,
+                          0, 0, window, reinterpret_cast<HMENU>(kDiagnosticsButton), nullptr,
+                          nullptr);
+            // The service's database is backed up on its own machine.
+            g_state.backup_button = CreateWindowW(
+                L"BUTTON", L"Back Up",
+                WS_CHILD | WS_VISIBLE | BS_PUSHBUTTON |
+                    (g_state.service_address.empty() ? 0 : WS_DISABLED),
+                0, 0, 0, 0, window, reinterpret_cast<HMENU>(kBackupButton), nullptr, nullptr);
+            // So are its totals.
+            CreateWindowW(L"BUTTON", L"Totals",
+                          WS_CHILD | WS_VISIBLE | BS_PUSHBUTTON |
+                              (g_state.service_address.empty() ? 0 : WS_DISABLED),
+                          0, 0, 0, 0, window, reinterpret_cast<HMENU>(kTotalsButton), nullptr,
+                          nullptr);
+
+            g_state.results_view = CreateWindowW(
+                WC_LISTVIEWW, L"",
+                WS_CHILD | WS_VISIBLE | LVS_REPORT | LVS_SINGLESEL | LVS_OWNERDATA, 0, 0, 0, 0,
+                window, reinterpret_cast<HMENU>(kResultsView), nullptr, nullptr);
+            ListView_SetExtendedListViewStyle(
+                g_state.results_view, LVS_EX_FULLROWSELECT | LVS_EX_GRIDLINES);
+            ConfigureListViewColumns(g_state.results_view);
+
+            g_state.status_label = CreateWindowW(L"STATIC", L"Ready",
+                                                 WS_CHILD | WS_VISIBLE | SS_LEFT, 0, 0, 0, 0,
+                                                 window, reinterpret_cast<HMENU>(kStatusLabel),
+                                                 nullptr, nullptr);
+
+            SetStatus(L"Opening the database...");
+            g_state.startup_thread = std::thread(RunStartup, window, ToUtf8(GetDatabasePath()));
+            return 0;
+        }
+        case WM_SIZE: {
+            int width = LOWORD(lparam);
+            int height = HIWORD(lparam);
+            LayoutControls(window, width, height);
+            return 0;
+        }
+        case WM_COMMAND: {
+            if (HIWORD(wparam) == EN_CHANGE) {
+                OnSearchTextChanged();
+                return 0;
+            }
+            if (!g_state.opened && LOWORD(wparam) != kClearButton &&
+                LOWORD(wparam) != kDiagnosticsButton) {
+                SetStatus(L"Opening the database...");
+                return 0;
+            }
+            switch (LOWORD(wparam)) {
+                case kSaveButton:
+                    SaveRecord(window);
+                    return 0;
+                case kUpdateButton:
+                    UpdateRecord(window);
+                    return 0;
+                case kDeleteButton:
+                    DeleteRecord(window);
+                    return 0;
+                case kUndoButton:
+                    RevertLastChange(window, false);
+                    return 0;
+                case kRedoButton:
+                    RevertLastChange(window, true);
+                    return 0;
+                case kSearchButton:
+                    RefreshResults();
+                    return 0;
+                case kClearButton:
+                    ClearInputs();
+                    RefreshResults();
+                    return 0;
+                case kDiagnosticsButton:
+                    ShowDiagnostics(window);
+                    return 0;
+                case kBackupButton:
+                    StartBackup(window);
+                    return 0;
+                case kTotalsButton:
+                    ShowTotals(window);
+                    return 0;
+                default:
+                    return 0;
+            }
+        }
+        case WM_NOTIFY: {
+            auto* header = reinterpret_cast<NMHDR*>(lparam);
+            if (header->idFrom != kResultsView) {
+                return 0;
+            }
+            switch (header->code) {
+                case LVN_ITEMCHANGED:
+                    OnListViewSelect();
+                    break;
+                case LVN_GETDISPINFOW:
+                    OnGetDisplayInfo(reinterpret_cast<NMLVDISPINFOW*>(lparam));
+                    break;
+                case LVN_ODCACHEHINT: {
+                    auto* hint = reinterpret_cast<NMLVCACHEHINT*>(lparam);
+                    g_state.rows.Prefetch(hint->iFrom, hint->iTo);
+                    break;
+                }
+                default:
+                    break;
+            }
+            return 0;
+        }
+        case kStorageDoneMessage:
+            OnStorageDone(lparam);
+            return 0;
+        case kJournalCompactedMessage:
+            OnJournalCompacted(window, wparam);
+            return 0;
+        case WM_TIMER:
+            if (wparam == kJournalTimer) {
+                CompactJournal(window);
+            }
+            return 0;
+        case kLiveSearchMessage:
+            OnLiveSearchResult(lparam);
+            return 0;
+        case kBackupProgressMessage:
+            SetStatus(L"Backing up... " + std::to_wstring(wparam) + L"%");
+            return 0;
+        case kBackupDoneMessage:
+            OnBackupDone(lparam);
+            return 0;
+        case kStartupMessage:
+            OnStartupResult(window, lparam);
+            return 0;
+        case WM_DESTROY: {
+            KillTimer(window, kJournalTimer);
+            // Closing during the count or the warm-up interrupts it.
+            g_state.startup_cancelled = true;
+            if (g_state.startup_thread.joinable()) {
+                g_state.startup_thread.join();
+            }
+            // A backup in progress is abandoned; the last complete one stays.
+            g_state.backup_cancelled = true;
+            if (g_state.backup_thread.joinable()) {
+                g_state.backup_thread.join();
+            }
+            g_state.live_search.Stop();
+            g_state.storage.Stop();
+            g_state.rows.Clear();
+            g_state.service.Close();
+            g_state.snapshot.Clear();
+            g_state.database.Close();
+            PostQuitMessage(0);
+            return 0;
+        }
+        default:
+            return DefWindowProcW(window, message, wparam, lparam);
+    }
+}
+}  // namespace
+
+int APIENTRY wWinMain(_In_ HINSTANCE instance, _In_opt_ HINSTANCE, _In_ LPWSTR, _In_ int) {
+    g_state.started = std::chrono::steady_clock::now();
+    int argc = 0;
+    if (LPWSTR* argv = CommandLineToArgvW(GetCommandLineW(), &argc)) {
+        for (int i = 1; i + 1 < argc; ++i) {
+            if (std::wcscmp(argv[i], L"--service") == 0) {
+                g_state.service_address = ToUtf8(argv[i + 1]);
+            }
+        }
+        LocalFree(argv);
+    }
+
+    INITCOMMONCONTROLSEX controls = {};
+    controls.dwSize = sizeof(controls);
+    controls.dwICC = ICC_LISTVIEW_CLASSES;
+    InitCommonControlsEx(&controls);
+
+    WNDCLASSEXW wc = {};
+    wc.cbSize = sizeof(wc);
+    wc.lpfnWndProc = WindowProc;
+    wc.hInstance = instance;
+    wc.hCursor = LoadCursor(nullptr, IDC_ARROW);
+    wc.hbrBackground = reinterpret_cast<HBRUSH>(COLOR_WINDOW + 1);
+    wc.lpszClassName = kWindowClassName;
+    RegisterClassExW(&wc);
+    wc.lpfnWndProc = DiagnosticsProc;
+    wc.lpszClassName = kDiagnosticsClassName;
+    RegisterClassExW(&wc);
+    wc.lpfnWndProc = TotalsProc;
+    wc.lpszClassName = kTotalsClassName;
+    RegisterClassExW(&wc);
+
+    HWND window = CreateWindowExW(
+        0, kWindowClassName, kWindowTitle, WS_OVERLAPPEDWINDOW, CW_USEDEFAULT, CW_USEDEFAULT,
+        1200, 720, nullptr, nullptr, instance, nullptr);
+    if (!window) {
+        MessageBoxW(nullptr, L"Failed to create the main window.", L"Error", MB_ICONERROR);
+        return 1;
+    }
+
+    ShowWindow(window, SW_MAXIMIZE);
+    UpdateWindow(window);
+    RecordStartup(inventory::StartupPhase::kWindow);
+
+    MSG msg = {};
+    while (GetMessageW(&msg, nullptr, 0, 0)) {
+        TranslateMessage(&msg);
+        DispatchMessageW(&msg);
+    }
+    return static_cast<int>(msg.wParam);
 }
\ No newline at end of file
@@ -0,0 +1,265 @@
+#include "metrics.h"
+
+#include <sqlite3.h>
+
+#include <algorithm>
+#include <bit>
+#include <cinttypes>
+#include <cstdarg>
+#include <cstdio>
+
+#include "database.h"
+
+namespace inventory {
+namespace {
+
+constexpr const char* kOperationNames[] = {"save",    "update",          "delete",      "undo",
+                                           "redo",    "commit",          "prepare",
+                                           "snapshot search", "fuzzy search", "rollup report",
+                                           "duplicate check"};
+static_assert(sizeof(kOperationNames) / sizeof(kOperationNames[0]) ==
+                  static_cast<size_t>(Operation::kOperationCount),
+              "every operation needs a name");
+
+constexpr const char* kStartupPhaseNames[] = {"window", "open", "first rows", "count",
+                                              "warm-up"};
+static_assert(sizeof(kStartupPhaseNames) / sizeof(kStartupPhaseNames[0]) ==
+                  static_cast<size_t>(StartupPhase::kStartupPhaseCount),
+              "every startup phase needs a name");
+
+constexpr const char* kQueryNames[] = {"count",     "page",            "page keyed",
+                                       "page back", "page back keyed", "live"};
+constexpr const char* kFieldNames[] = {"name", "part", "nsn", "serial", "qty"};
+
+void AppendFormat(std::string& out, const char* format, ...) {
+    char line[512];
+    va_list arguments;
+    va_start(arguments, format);
+    int size = std::vsnprintf(line, sizeof(line), format, arguments);
+    va_end(arguments);
+    if (size > 0) {
+        out.append(line, std::min(static_cast<size_t>(size), sizeof(line) - 1));
+    }
+}
+
+// "page keyed name+nsn+qty, fts name, exact nsn" for a search shape id.
+std::string ShapeName(uint32_t id) {
+    const uint32_t query = id / kSearchShapeStride;
+    const uint32_t shape = id % kSearchShapeStride;
+    std::string name = query < sizeof(kQueryNames) / sizeof(kQueryNames[0]) ? kQueryNames[query]
+                                                                            : "other";
+    auto append_fields = [&](unsigned mask) {
+        bool first = true;
+        for (unsigned field = 0; field < 5; ++field) {
+            if (mask & (1u << field)) {
+                name += first ? " " : "+";
+                name += kFieldNames[field];
+                first = false;
+            }
+        }
+        if (first) {
+            name += " all";
+        }
+    };
+    append_fields(shape & (kFilterShapeCount - 1));
+    if (const unsigned indexed = shape / kFilterShapeCount % 16) {
+        name += ", fts";
+        append_fields(indexed);
+    }
+    if (const unsigned exact = shape / (kFilterShapeCount * 16)) {
+        name += ", exact";
+        append_fields(exact);
+    }
+    return name;
+}
+
+void FormatHistogram(const char* name, const HistogramSnapshot& snapshot, std::string& out) {
+    AppendFormat(out, "%10" PRIu64 " %10.1f %10.1f %10.1f %10.1f %10.1f  %s\n", snapshot.count,
+                 snapshot.MeanNs() / 1e3, snapshot.Percentile(0.50) / 1e3,
+                 snapshot.Percentile(0.90) / 1e3, snapshot.Percentile(0.99) / 1e3,
+                 snapshot.max_ns / 1e3, name);
+}
+
+}  // namespace
+
+uint64_t HistogramSnapshot::Percentile(double quantile) const {
+    if (count == 0) {
+        return 0;
+    }
+    const double clamped = quantile < 0.0 ? 0.0 : (quantile > 1.0 ? 1.0 : quantile);
+    uint64_t rank = static_cast<uint64_t>(clamped * static_cast<double>(count) + 0.5);
+    rank = rank == 0 ? 1 : rank;
+    uint64_t seen = 0;
+    for (size_t i = 0; i < buckets.size(); ++i) {
+        seen += buckets[i];
+        if (seen >= rank) {
+            return std::min(LatencyHistogram::BucketUpperBound(static_cast<int>(i)), max_ns);
+        }
+    }
+    return max_ns;
+}
+
+int LatencyHistogram::BucketIndex(uint64_t ns) {
+    if (ns < kHistogramSubBuckets) {
+        return static_cast<int>(ns);
+    }
+    const int exponent = static_cast<int>(std::bit_width(ns)) - 1;
+    const int sub = static_cast<int>((ns >> (exponent - 4)) & (kHistogramSubBuckets - 1));
+    return (exponent - 3) * kHistogramSubBuckets + sub;
+}
+
+uint64_t LatencyHistogram::BucketUpperBound(int index) {
+    if (index < kHistogramSubBuckets) {
+        return static_cast<uint64_t>(index);
+    }
+    const int exponent = index / kHistogramSubBuckets + 3;
+    const uint64_t sub = static_cast<uint64_t>(index % kHistogramSubBuckets);
+    const uint64_t width = uint64_t{1} << (exponent - 4);
+    return (kHistogramSubBuckets + sub) * width + (width - 1);
+}
+
+void LatencyHistogram::Record(uint64_t ns) {
+    buckets_[BucketIndex(ns)].fetch_add(1, std::memory_order_relaxed);
+    count_.fetch_add(1, std::memory_order_relaxed);
+    sum_ns_.fetch_add(ns, std::memory_order_relaxed);
+    uint64_t max = max_ns_.load(std::memory_order_relaxed);
+    while (ns > max && !max_ns_.compare_exchange_weak(max, ns, std::memory_order_relaxed)) {
+    }
+}
+
+HistogramSnapshot LatencyHistogram::Snapshot() const {
+    HistogramSnapshot snapshot;
+    snapshot.buckets.resize(kHistogramBuckets);
+    for (int i = 0; i < kHistogramBuckets; ++i) {
+        snapshot.buckets[i] = buckets_[i].load(std::memory_order_relaxed);
+        snapshot.count += snapshot.buckets[i];
+    }
+    snapshot.sum_ns = sum_ns_.load(std::memory_order_relaxed);
+    snapshot.max_ns = max_ns_.load(std::memory_order_relaxed);
+    return snapshot;
+}
+
+MetricsRegistry::MetricsRegistry() : shapes_(new std::atomic<LatencyHistogram*>[kShapeSlots]) {
+    for (uint32_t i = 0; i < kShapeSlots; ++i) {
+        shapes_[i].store(nullptr, std::memory_order_relaxed);
+    }
+}
+
+MetricsRegistry::~MetricsRegistry() {
+    for (uint32_t i = 0; i < kShapeSlots; ++i) {
+        delete shapes_[i].load(std::memory_order_relaxed);
+    }
+    delete[] shapes_;
+}
+
+LatencyHistogram& MetricsRegistry::shape(uint32_t shape) {
+    std::atomic<LatencyHistogram*>& slot = shapes_[std::min(shape, kShapeSlots - 1)];
+    LatencyHistogram* histogram = slot.load(std::memory_order_acquire);
+    if (histogram) {
+        return *histogram;
+    }
+    // Two threads may both allocate; the loser frees its copy.
+    auto* created = new LatencyHistogram();
+    if (slot.compare_exchange_strong(histogram, created, std::memory_order_acq_rel)) {
+        return *created;
+    }
+    delete created;
+    return *histogram;
+}
+
+void MetricsRegistry::Format(std::string& out) const {
+    AppendFormat(out, "%10s %10s %10s %10s %10s %10s  %s\n", "count", "mean us", "p50 us",
+                 "p90 us", "p99 us", "max us", "operation");
+    for (int i = 0; i < static_cast<int>(Operation::kOperationCount); ++i) {
+        HistogramSnapshot snapshot = operations_[i].Snapshot();
+        if (snapshot.count > 0) {
+            FormatHistogram(kOperationNames[i], snapshot, out);
+        }
+    }
+    for (uint32_t i = 0; i < kShapeSlots; ++i) {
+        const LatencyHistogram* histogram = shapes_[i].load(std::memory_order_acquire);
+        if (!histogram) {
+            continue;
+        }
+        HistogramSnapshot snapshot = histogram->Snapshot();
+        if (snapshot.count > 0) {
+            FormatHistogram(("search " + ShapeName(i)).c_str(), snapshot, out);
+        }
+    }
+    std::string startup;
+    for (int i = 0; i < static_cast<int>(StartupPhase::kStartupPhaseCount); ++i) {
+        const uint64_t ns = startup_ns_[i].load(std::memory_order_relaxed);
+        if (ns > 0) {
+            AppendFormat(startup, "%s%s %.1f ms", startup.empty() ? "" : ", ",
+                         kStartupPhaseNames[i], ns / 1e6);
+        }
+    }
+    if (!startup.empty()) {
+        out += "\nstartup: " + startup + "\n";
+    }
+}
+
+const char* StartupPhaseName(StartupPhase phase) {
+    return kStartupPhaseNames[static_cast<int>(phase)];
+}
+
+MetricsRegistry& Metrics() {
+    static MetricsRegistry registry;
+    return registry;
+}
+
+void FormatDatabaseStats(Database& database, std::string& out) {
+    if (!database.IsOpen()) {
+        return;
+    }
+    int hits = 0;
+    int misses = 0;
+    int used = 0;
+    int unused = 0;
+    sqlite3_db_status(database.handle(), SQLITE_DBSTATUS_CACHE_HIT, &hits, &unused, 0);
+    sqlite3_db_status(database.handle(), SQLITE_DBSTATUS_CACHE_MISS, &misses, &unused, 0);
+    sqlite3_db_status(database.handle(), SQLITE_DBSTATUS_CACHE_USED, &used, &unused, 0);
+    const double lookups = static_cast<double>(hits) + misses;
+    AppendFormat(out, "page cache: %d hits, %d misses (%.1f%% hit), %.1f MB used\n", hits,
+                 misses, lookups > 0 ? 100.0 * hits / lookups : 0.0, used / 1e6);
+    const StatementCacheStats& cache = database.cache_stats();
+    AppendFormat(out,
+                 "statement cache: %" PRIu64 " hits, %" PRIu64 " prepares, %.1f ms preparing\n",
+                 cache.hits, cache.misses, cache.prepare_ns / 1e6);
+
+    // Busiest statements first.
+    struct Counters {
+        int runs;
+        int vm_steps;
+        int scan_steps;
+        int sorts;
+        int automatic_indexes;
+        const char* sql;
+    };
+    std::vector<Counters> statements;
+    database.ForEachStatement([&](sqlite3_stmt* statement) {
+        const int runs = sqlite3_stmt_status(statement, SQLITE_STMTSTATUS_RUN, 0);
+        if (runs == 0) {
+            return;
+        }
+        Counters counters;
+        counters.runs = runs;
+        counters.vm_steps = sqlite3_stmt_status(statement, SQLITE_STMTSTATUS_VM_STEP, 0);
+        counters.scan_steps = sqlite3_stmt_status(statement, SQLITE_STMTSTATUS_FULLSCAN_STEP, 0);
+        counters.sorts = sqlite3_stmt_status(statement, SQLITE_STMTSTATUS_SORT, 0);
+        counters.automatic_indexes = sqlite3_stmt_status(statement, SQLITE_STMTSTATUS_AUTOINDEX, 0);
+        counters.sql = sqlite3_sql(statement);
+        statements.push_back(counters);
+    });
+    std::sort(statements.begin(), statements.end(),
+              [](const Counters& a, const Counters& b) { return a.vm_steps > b.vm_steps; });
+    AppendFormat(out, "%10s %12s %12s %8s %8s  %s\n", "runs", "vm steps", "scan steps",
+                 "sorts", "autoidx", "statement");
+    for (const Counters& counters : statements) {
+        AppendFormat(out, "%10d %12d %12d %8d %8d  %.400s\n", counters.runs, counters.vm_steps,
+                     counters.scan_steps, counters.sorts, counters.automatic_indexes,
+                     counters.sql);
+    }
+}
+
+}  // namespace inventory
@@ -0,0 +1,152 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "search_filter.h"
+
+namespace inventory {
+
+class Database;
+
+// Log-linear buckets: values below 16 ns get one bucket each, and every
+// power of two above that is split into 16, so a bucket is at most 1/16 of
+// its value wide, as in an HDR histogram with a little over one significant
+// digit.
+constexpr int kHistogramSubBuckets = 16;
+constexpr int kHistogramBuckets = 61 * kHistogramSubBuckets;
+
+struct HistogramSnapshot {
+    uint64_t count = 0;
+    uint64_t sum_ns = 0;
+    uint64_t max_ns = 0;
+    std::vector<uint64_t> buckets;
+
+    // Upper bound of the bucket holding the |quantile| (0..1) value; 0 when
+    // nothing was recorded.
+    uint64_t Percentile(double quantile) const;
+    double MeanNs() const { return count ? static_cast<double>(sum_ns) / count : 0.0; }
+};
+
+// Latencies in nanoseconds. Record is wait-free and can be called from any
+// thread; Snapshot reads without stopping writers, so a value recorded at
+// the same moment may be counted in some fields and not yet in others.
+class LatencyHistogram {
+public:
+    void Record(uint64_t ns);
+    HistogramSnapshot Snapshot() const;
+
+    static int BucketIndex(uint64_t ns);
+    static uint64_t BucketUpperBound(int index);
+
+private:
+    std::atomic<uint64_t> buckets_[kHistogramBuckets] = {};
+    std::atomic<uint64_t> count_{0};
+    std::atomic<uint64_t> sum_ns_{0};
+    std::atomic<uint64_t> max_ns_{0};
+};
+
+enum class Operation {
+    // From the click to the write's completion, queueing and commit included.
+    kSave,
+    kUpdate,
+    kDelete,
+    kUndo,
+    kRedo,
+    // One storage-thread transaction, from BEGIN to COMMIT.
+    kCommit,
+    // sqlite3_prepare of a statement missing from the cache.
+    kPrepare,
+    kSnapshotSearch,
+    kFuzzySearch,
+    // QueryRollups, for a report.
+    kRollupReport,
+    // DuplicateDetector::Check, probes included.
+    kDuplicateCheck,
+    kOperationCount,
+};
+
+// The window's cold start, in the order the phases end.
+enum class StartupPhase {
+    // The window is on screen; the database has not been touched.
+    kWindow,
+    // The connections are open and the schema is checked or upgraded.
+    kOpen,
+    // The first page of the listing is on screen, before the rows are counted.
+    kFirstRows,
+    kCount,
+    // The table has been read through once, into the snapshot when it fits.
+    kWarmUp,
+    kStartupPhaseCount,
+};
+
+const char* StartupPhaseName(StartupPhase phase);
+
+// Every latency the program records: one histogram per Operation, and one
+// per search statement shape (SearchShape ids) measuring the time spent
+// stepping it. Shape histograms are allocated on first use, also lock-free.
+class MetricsRegistry {
+public:
+    MetricsRegistry();
+    ~MetricsRegistry();
+
+    MetricsRegistry(const MetricsRegistry&) = delete;
+    MetricsRegistry& operator=(const MetricsRegistry&) = delete;
+
+    LatencyHistogram& operation(Operation operation) {
+        return operations_[static_cast<int>(operation)];
+    }
+    // Ids past the search shapes are all counted in the last slot.
+    LatencyHistogram& shape(uint32_t shape);
+
+    // When |phase| ended, in nanoseconds since the program started.
+    void RecordStartup(StartupPhase phase, uint64_t ns) {
+        startup_ns_[static_cast<int>(phase)].store(ns, std::memory_order_relaxed);
+    }
+
+    // A text report with count, mean, p50, p90, p99 and max per histogram
+    // that has recorded anything, then the startup phases that have ended.
+    void Format(std::string& out) const;
+
+private:
+    static constexpr uint32_t kShapeSlots = SearchShape(kSearchLive, 0) + kSearchShapeStride;
+
+    LatencyHistogram operations_[static_cast<int>(Operation::kOperationCount)];
+    std::atomic<uint64_t> startup_ns_[static_cast<int>(StartupPhase::kStartupPhaseCount)] = {};
+    std::atomic<LatencyHistogram*>* shapes_;
+};
+
+// The registry the library records into.
+MetricsRegistry& Metrics();
+
+// Records the time from construction to destruction.
+class ScopedLatency {
+public:
+    explicit ScopedLatency(LatencyHistogram& histogram)
+        : histogram_(histogram), start_(std::chrono::steady_clock::now()) {}
+    ~ScopedLatency() { histogram_.Record(ElapsedNs(start_)); }
+
+    ScopedLatency(const ScopedLatency&) = delete;
+    ScopedLatency& operator=(const ScopedLatency&) = delete;
+
+    static uint64_t ElapsedNs(std::chrono::steady_clock::time_point start) {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                         std::chrono::steady_clock::now() - start)
+                                         .count());
+    }
+
+private:
+    LatencyHistogram& histogram_;
+    std::chrono::steady_clock::time_point start_;
+};
+
+// Per-connection figures for |database|, which must be used from the calling
+// thread: page-cache hits and misses, statement-cache counters, and for every
+// cached statement that has run, sqlite3_stmt_status counters (runs, VM steps,
+// full-scan steps, sorts, automatic indexes).
+void FormatDatabaseStats(Database& database, std::string& out);
+
+}  // namespace inventory
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+namespace inventory {
+
+// Calls work(first, last, slot) for |slots| contiguous ranges of [0, size),
+// one per thread; the calling thread takes slot 0. With one slot or none, the
+// whole range runs on the calling thread.
+template <typename Work>
+void ForEachRange(size_t size, size_t slots, const Work& work) {
+    if (slots <= 1) {
+        work(size_t{0}, size, size_t{0});
+        return;
+    }
+    std::vector<std::thread> threads;
+    threads.reserve(slots - 1);
+    for (size_t slot = 1; slot < slots; ++slot) {
+        threads.emplace_back([&work, size, slots, slot] {
+            work(size * slot / slots, size * (slot + 1) / slots, slot);
+        });
+    }
+    work(size_t{0}, size / slots, size_t{0});
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+}
+
+}  // namespace inventory
@@ -0,0 +1,136 @@
+#include "result_set.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace inventory {
+namespace {
+
+constexpr char16_t kReplacement = 0xFFFD;
+constexpr int kTextColumnIndex[kItemTextColumns] = {1, 2, 3, 4, 6};
+
+bool IsContinuation(unsigned char byte) {
+    return (byte & 0xC0) == 0x80;
+}
+
+}  // namespace
+
+size_t Utf8ToUtf16(const char* text, size_t size, char16_t* out) {
+    const auto* in = reinterpret_cast<const unsigned char*>(text);
+    size_t i = 0;
+    size_t written = 0;
+    while (i < size) {
+        // Most item text is ASCII: widen eight bytes at a time.
+        if (i + 8 <= size) {
+            uint64_t block;
+            std::memcpy(&block, in + i, sizeof(block));
+            if ((block & 0x8080808080808080ull) == 0) {
+                for (int k = 0; k < 8; ++k) {
+                    out[written++] = in[i + k];
+                }
+                i += 8;
+                continue;
+            }
+        }
+
+        const unsigned char lead = in[i];
+        if (lead < 0x80) {
+            out[written++] = lead;
+            ++i;
+            continue;
+        }
+        uint32_t code = 0;
+        size_t length = 0;
+        uint32_t minimum = 0;
+        if (lead >= 0xC2 && lead <= 0xDF) {
+            code = lead & 0x1F;
+            length = 2;
+            minimum = 0x80;
+        } else if (lead >= 0xE0 && lead <= 0xEF) {
+            code = lead & 0x0F;
+            length = 3;
+            minimum = 0x800;
+        } else if (lead >= 0xF0 && lead <= 0xF4) {
+            code = lead & 0x07;
+            length = 4;
+            minimum = 0x10000;
+        }
+        bool valid = length != 0 && i + length <= size;
+        for (size_t k = 1; valid && k < length; ++k) {
+            valid = IsContinuation(in[i + k]);
+            code = (code << 6) | (in[i + k] & 0x3F);
+        }
+        if (!valid || code < minimum || code > 0x10FFFF || (code >= 0xD800 && code <= 0xDFFF)) {
+            out[written++] = kReplacement;
+            ++i;
+            continue;
+        }
+        if (code >= 0x10000) {
+            code -= 0x10000;
+            out[written++] = static_cast<char16_t>(0xD800 + (code >> 10));
+            out[written++] = static_cast<char16_t>(0xDC00 + (code & 0x3FF));
+        } else {
+            out[written++] = static_cast<char16_t>(code);
+        }
+        i += length;
+    }
+    return written;
+}
+
+void ResultSet::Clear() {
+    rows_.clear();
+    arena_.clear();
+}
+
+void ResultSet::Reserve(size_t rows, size_t text_units) {
+    rows_.reserve(rows);
+    arena_.reserve(text_units);
+}
+
+void ResultSet::AppendRow(sqlite3_stmt* statement) {
+    std::string_view text[kItemTextColumns];
+    for (int column = 0; column < kItemTextColumns; ++column) {
+        const int index = kTextColumnIndex[column];
+        const auto* value = reinterpret_cast<const char*>(sqlite3_column_text(statement, index));
+        if (value) {
+            text[column] = {value, static_cast<size_t>(sqlite3_column_bytes(statement, index))};
+        }
+    }
+    AppendRow(sqlite3_column_int64(statement, 0), sqlite3_column_int(statement, 5), text);
+}
+
+void ResultSet::AppendRow(sqlite3_int64 id, int quantity,
+                          const std::string_view (&text)[kItemTextColumns]) {
+    Row& row = rows_.emplace_back();
+    row.id = id;
+    row.quantity = quantity;
+
+    for (int column = 0; column < kItemTextColumns; ++column) {
+        const size_t size = text[column].size();
+        const size_t offset = arena_.size();
+        row.offset[column] = static_cast<uint32_t>(offset);
+        if (size == 0) {
+            continue;
+        }
+        // A UTF-16 string never has more units than its UTF-8 form has bytes,
+        // so the cell is decoded straight into the arena and then trimmed.
+        if (arena_.capacity() < offset + size) {
+            arena_.reserve(std::max(offset + size, arena_.capacity() * 2));
+        }
+        arena_.resize(offset + size);
+        const size_t written = Utf8ToUtf16(text[column].data(), size, arena_.data() + offset);
+        arena_.resize(offset + written);
+        row.length[column] = static_cast<uint32_t>(written);
+    }
+}
+
+void ResultSet::AppendBlankRow() {
+    Row& row = rows_.emplace_back();
+    std::fill(std::begin(row.offset), std::end(row.offset), static_cast<uint32_t>(arena_.size()));
+}
+
+void ResultSet::Reverse() {
+    std::reverse(rows_.begin(), rows_.end());
+}
+
+}  // namespace inventory
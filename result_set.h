@@ -0,0 +1,83 @@
+#pragma once
+
+#include <sqlite3.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+namespace inventory {
+
+// Text columns of an item, in the order they are stored in a ResultSet.
+enum ItemColumn {
+    kColumnName,
+    kColumnPartNumber,
+    kColumnNsn,
+    kColumnSerialNumber,
+    kColumnCreatedAt,
+    kItemTextColumns,
+};
+
+// The columns a ResultSet reads, in AppendRow order.
+constexpr char kItemSelectColumns[] =
+    "SELECT id, name, part_number, nsn, serial_number, quantity, created_at FROM items";
+
+// Decodes UTF-8 into |out|, which must have room for |size| units, and
+// returns the number written. Invalid sequences become U+FFFD.
+size_t Utf8ToUtf16(const char* text, size_t size, char16_t* out);
+
+// Rows of a query with every text cell decoded to UTF-16 into one arena and
+// addressed by offset and length. Clear keeps the capacity, so a set that is
+// reused for pages of similar size stops allocating.
+class ResultSet {
+public:
+    void Clear();
+    void Reserve(size_t rows, size_t text_units);
+
+    // Appends the current row of a statement that selects kItemSelectColumns.
+    void AppendRow(sqlite3_stmt* statement);
+    // Appends a row from its values; |text| is UTF-8, in ItemColumn order.
+    void AppendRow(sqlite3_int64 id, int quantity,
+                   const std::string_view (&text)[kItemTextColumns]);
+    // Appends a placeholder for a row that could not be read; its id is 0.
+    void AppendBlankRow();
+    void Reverse();
+
+    size_t size() const { return rows_.size(); }
+    bool empty() const { return rows_.empty(); }
+
+    sqlite3_int64 id(size_t row) const { return rows_[row].id; }
+    int quantity(size_t row) const { return rows_[row].quantity; }
+    // Valid until the set is changed.
+    std::u16string_view text(size_t row, ItemColumn column) const {
+        const Row& entry = rows_[row];
+        return {arena_.data() + entry.offset[column], entry.length[column]};
+    }
+
+    size_t arena_units() const { return arena_.size(); }
+
+private:
+    struct Row {
+        sqlite3_int64 id = 0;
+        int quantity = 0;
+        uint32_t offset[kItemTextColumns] = {};
+        uint32_t length[kItemTextColumns] = {};
+    };
+
+    std::vector<Row> rows_;
+    std::vector<char16_t> arena_;
+};
+
+// One row of a ResultSet, as handed to the display layer.
+struct RowRef {
+    const ResultSet* set = nullptr;
+    size_t index = 0;
+
+    explicit operator bool() const { return set != nullptr; }
+    sqlite3_int64 id() const { return set->id(index); }
+    int quantity() const { return set->quantity(index); }
+    std::u16string_view text(ItemColumn column) const { return set->text(index, column); }
+};
+
+}  // namespace inventory
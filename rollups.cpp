@@ -0,0 +1,273 @@
+#include "rollups.h"
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+
+#include "item_keys.h"
+#include "metrics.h"
+
+namespace inventory {
+namespace {
+
+struct RollupTableInfo {
+    const char* name;
+    const char* table;
+    const char* column;
+    // The key column the groups are keyed by, falling back to |column| where
+    // it is NULL; none to key them by |column| itself.
+    const char* key_column;
+};
+
+constexpr RollupTableInfo kRollupTables[] = {
+    {"nsn", "rollup_nsn", "nsn", "nsn_key"},
+    {"part number", "rollup_part_number", "part_number", "part_key"},
+    {"name", "rollup_name", "name", nullptr},
+};
+static_assert(sizeof(kRollupTables) / sizeof(kRollupTables[0]) ==
+                  static_cast<size_t>(RollupKind::kRollupKindCount),
+              "every rollup needs a table");
+
+constexpr char kRollupColumns[] = "value, items, quantity, first_created_at, last_created_at";
+
+const RollupTableInfo& Info(RollupKind kind) {
+    return kRollupTables[static_cast<int>(kind)];
+}
+
+// Binds the key of the group |value| belongs to.
+void BindRollupKey(sqlite3_stmt* statement, int index, RollupKind kind,
+                   std::string_view value) {
+    int64_t nsn_key = 0;
+    if (kind == RollupKind::kNsn && ParseNsn(value, nsn_key)) {
+        sqlite3_bind_int64(statement, index, nsn_key);
+        return;
+    }
+    const std::string key =
+        kind == RollupKind::kPartNumber ? IdentifierKey(value) : std::string(value);
+    sqlite3_bind_text(statement, index, key.data(), static_cast<int>(key.size()),
+                      SQLITE_TRANSIENT);
+}
+
+std::string ColumnString(sqlite3_stmt* statement, int column) {
+    const unsigned char* value = sqlite3_column_text(statement, column);
+    return std::string(value ? reinterpret_cast<const char*>(value) : "",
+                       static_cast<size_t>(sqlite3_column_bytes(statement, column)));
+}
+
+// Reads the five kRollupColumns starting at |column|.
+void ReadRollup(sqlite3_stmt* statement, int column, Rollup& rollup) {
+    rollup.value = ColumnString(statement, column);
+    rollup.items = sqlite3_column_int64(statement, column + 1);
+    rollup.quantity = sqlite3_column_int64(statement, column + 2);
+    rollup.first_created_at = ColumnString(statement, column + 3);
+    rollup.last_created_at = ColumnString(statement, column + 4);
+}
+
+bool SameTotals(const Rollup& a, const Rollup& b) {
+    return a.value == b.value && a.items == b.items && a.quantity == b.quantity &&
+           a.first_created_at == b.first_created_at && a.last_created_at == b.last_created_at;
+}
+
+// The smallest string above every string that starts with |prefix|, or empty
+// when there is none.
+std::string PrefixEnd(std::string prefix) {
+    while (!prefix.empty() && static_cast<unsigned char>(prefix.back()) == 0xFF) {
+        prefix.pop_back();
+    }
+    if (!prefix.empty()) {
+        ++prefix.back();
+    }
+    return prefix;
+}
+
+// Every group the items add up to, in the rollup table's columns.
+std::string GroupTotalsSql(RollupKind kind) {
+    const std::string key = RollupKey(kind);
+    return std::string("SELECT group_key, (SELECT ") + Info(kind).column + " FROM items WHERE " +
+           key + " = totals.group_key ORDER BY created_at, id LIMIT 1) AS value, items," +
+           " quantity, first_created_at, last_created_at FROM (SELECT " + key +
+           " AS group_key, COUNT(*) AS items, SUM(quantity) AS quantity," +
+           " MIN(created_at) AS first_created_at, MAX(created_at) AS last_created_at" +
+           " FROM items GROUP BY " + key + ") AS totals";
+}
+
+bool CheckKind(Database& database, RollupKind kind, RollupCheck& check) {
+    const RollupTableInfo& info = Info(kind);
+    const std::string key = RollupKey(kind);
+    // Every group the items add up to, next to the stored one.
+    Statement statement = database.Prepare(
+        std::string("SELECT expected.value, expected.items, expected.quantity,"
+                    " expected.first_created_at, expected.last_created_at,"
+                    " stored.value, stored.items, stored.quantity,"
+                    " stored.first_created_at, stored.last_created_at FROM (") +
+        GroupTotalsSql(kind) + ") AS expected LEFT JOIN " + info.table +
+        " AS stored ON stored.group_key = expected.group_key");
+    if (!statement) {
+        return false;
+    }
+    int step;
+    while ((step = sqlite3_step(statement.get())) == SQLITE_ROW) {
+        ++check.groups;
+        RollupMismatch mismatch;
+        mismatch.kind = kind;
+        ReadRollup(statement.get(), 0, mismatch.expected);
+        if (sqlite3_column_type(statement.get(), 5) != SQLITE_NULL) {
+            ReadRollup(statement.get(), 5, mismatch.stored);
+            if (SameTotals(mismatch.stored, mismatch.expected)) {
+                continue;
+            }
+        }
+        check.mismatches.push_back(std::move(mismatch));
+    }
+    if (step != SQLITE_DONE) {
+        return false;
+    }
+
+    // Stored groups that no item holds any more.
+    statement = database.Prepare(std::string("SELECT ") + kRollupColumns + " FROM " +
+                                 info.table + " WHERE NOT EXISTS (SELECT 1 FROM items WHERE " +
+                                 key + " = " + info.table + ".group_key)");
+    if (!statement) {
+        return false;
+    }
+    while ((step = sqlite3_step(statement.get())) == SQLITE_ROW) {
+        RollupMismatch mismatch;
+        mismatch.kind = kind;
+        ReadRollup(statement.get(), 0, mismatch.stored);
+        check.mismatches.push_back(std::move(mismatch));
+    }
+    return step == SQLITE_DONE;
+}
+
+}  // namespace
+
+const char* RollupKindName(RollupKind kind) {
+    return Info(kind).name;
+}
+
+const char* RollupTable(RollupKind kind) {
+    return Info(kind).table;
+}
+
+const char* RollupColumn(RollupKind kind) {
+    return Info(kind).column;
+}
+
+std::string RollupKey(RollupKind kind, const char* row) {
+    const RollupTableInfo& info = Info(kind);
+    if (!info.key_column) {
+        return std::string(row) + info.column;
+    }
+    return std::string("COALESCE(") + row + info.key_column + ", " + row + info.column + ")";
+}
+
+bool QueryRollups(Database& database, const RollupQuery& query, std::vector<Rollup>& rollups) {
+    ScopedLatency latency(Metrics().operation(Operation::kRollupReport));
+    rollups.clear();
+    const std::string end = PrefixEnd(query.prefix);
+    std::string sql = std::string("SELECT ") + kRollupColumns + " FROM " +
+                      RollupTable(query.kind) + " WHERE value >= ?1";
+    if (!end.empty()) {
+        sql += " AND value < ?2";
+    }
+    switch (query.order) {
+        case RollupOrder::kValue:
+            sql += " ORDER BY value";
+            break;
+        case RollupOrder::kQuantity:
+            sql += " ORDER BY quantity DESC, value";
+            break;
+        case RollupOrder::kItems:
+            sql += " ORDER BY items DESC, value";
+            break;
+    }
+    sql += " LIMIT ?3";
+    Statement statement = database.Prepare(sql);
+    if (!statement) {
+        return false;
+    }
+    sqlite3_bind_text(statement.get(), 1, query.prefix.data(),
+                      static_cast<int>(query.prefix.size()), SQLITE_STATIC);
+    if (!end.empty()) {
+        sqlite3_bind_text(statement.get(), 2, end.data(), static_cast<int>(end.size()),
+                          SQLITE_STATIC);
+    }
+    sqlite3_bind_int64(statement.get(), 3,
+                       query.limit ? static_cast<sqlite3_int64>(query.limit) : -1);
+    int step;
+    while ((step = sqlite3_step(statement.get())) == SQLITE_ROW) {
+        rollups.emplace_back();
+        ReadRollup(statement.get(), 0, rollups.back());
+    }
+    return step == SQLITE_DONE;
+}
+
+bool LoadRollup(Database& database, RollupKind kind, std::string_view value, Rollup& rollup) {
+    Statement statement = database.Prepare(std::string("SELECT ") + kRollupColumns + " FROM " +
+                                           RollupTable(kind) + " WHERE group_key = ?");
+    if (!statement) {
+        return false;
+    }
+    BindRollupKey(statement.get(), 1, kind, value);
+    if (sqlite3_step(statement.get()) != SQLITE_ROW) {
+        return false;
+    }
+    ReadRollup(statement.get(), 0, rollup);
+    return true;
+}
+
+void FormatRollups(RollupKind kind, const std::vector<Rollup>& rollups, std::string& out) {
+    constexpr int kMaxValueWidth = 48;
+    int width = 20;
+    for (const Rollup& rollup : rollups) {
+        width = std::max(width, static_cast<int>(std::min<size_t>(rollup.value.size(),
+                                                                  kMaxValueWidth)));
+    }
+    Rollup total;
+    char line[256];
+    std::snprintf(line, sizeof(line), "%-*s %10s %14s  %-23s  %s\n", width,
+                  RollupKindName(kind), "items", "quantity", "first created",
+                  "last created");
+    out += line;
+    for (const Rollup& rollup : rollups) {
+        std::snprintf(line, sizeof(line), "%-*.*s %10" PRId64 " %14" PRId64 "  %-23s  %s\n",
+                      width, kMaxValueWidth, rollup.value.c_str(),
+                      static_cast<int64_t>(rollup.items), static_cast<int64_t>(rollup.quantity),
+                      rollup.first_created_at.c_str(), rollup.last_created_at.c_str());
+        out += line;
+        total.items += rollup.items;
+        total.quantity += rollup.quantity;
+    }
+    std::snprintf(line, sizeof(line), "%-*s %10" PRId64 " %14" PRId64 "\n", width,
+                  (std::to_string(rollups.size()) + " groups").c_str(),
+                  static_cast<int64_t>(total.items), static_cast<int64_t>(total.quantity));
+    out += line;
+}
+
+bool CheckRollups(Database& database, RollupCheck& check) {
+    check = RollupCheck();
+    if (!database.Execute("BEGIN")) {
+        return false;
+    }
+    bool ok = true;
+    for (int kind = 0; ok && kind < static_cast<int>(RollupKind::kRollupKindCount); ++kind) {
+        ok = CheckKind(database, static_cast<RollupKind>(kind), check);
+    }
+    database.Execute("COMMIT");
+    return ok;
+}
+
+bool RebuildRollups(Database& database) {
+    for (int kind = 0; kind < static_cast<int>(RollupKind::kRollupKindCount); ++kind) {
+        const char* table = kRollupTables[kind].table;
+        const std::string sql = std::string("DELETE FROM ") + table + "; INSERT INTO " + table +
+                                " (group_key, " + kRollupColumns + ") " +
+                                GroupTotalsSql(static_cast<RollupKind>(kind));
+        if (!database.Execute(sql.c_str())) {
+            return false;
+        }
+    }
+    return true;
+}
+
+}  // namespace inventory
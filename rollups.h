@@ -0,0 +1,96 @@
+#pragma once
+
+#include <sqlite3.h>
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "database.h"
+
+namespace inventory {
+
+// Totals of the items grouped by one of their text columns. Each grouping
+// has a table of its own, one row per distinct value, kept up to date by
+// triggers on items in the transaction of every write (see schema.cpp), so
+// a report reads the groups and never the items.
+enum class RollupKind {
+    kNsn,
+    kPartNumber,
+    kName,
+    kRollupKindCount,
+};
+
+// "nsn", "part number" and "name".
+const char* RollupKindName(RollupKind kind);
+// The table holding the groups, and the items column shown for them.
+const char* RollupTable(RollupKind kind);
+const char* RollupColumn(RollupKind kind);
+// The expression over an items row that groups are keyed by, with columns
+// qualified by |row| ("new.", "old." or none): nsn_key, or the NSN as stored
+// when it does not parse; part_key; and the name as stored.
+std::string RollupKey(RollupKind kind, const char* row = "");
+
+struct Rollup {
+    // The spelling of the group's oldest item. NSNs and part numbers typed
+    // with or without dashes are one group (see item_keys.h).
+    std::string value;
+    sqlite3_int64 items = 0;
+    sqlite3_int64 quantity = 0;
+    std::string first_created_at;
+    std::string last_created_at;
+};
+
+enum class RollupOrder {
+    kValue,
+    // Largest first, then by value.
+    kQuantity,
+    kItems,
+};
+
+struct RollupQuery {
+    RollupKind kind = RollupKind::kNsn;
+    RollupOrder order = RollupOrder::kValue;
+    // Only the groups whose value starts with these bytes.
+    std::string prefix;
+    // At most this many groups; 0 for all of them.
+    size_t limit = 0;
+};
+
+// The groups |query| selects, read from the rollup table: O(groups) however
+// many items they hold, and a range of the table's key for a prefix in value
+// order.
+bool QueryRollups(Database& database, const RollupQuery& query, std::vector<Rollup>& rollups);
+
+// The group of |value|, however it is spelled. False when no item holds
+// it, or on failure.
+bool LoadRollup(Database& database, RollupKind kind, std::string_view value, Rollup& rollup);
+
+// A report of |rollups| in columns, with their sum on the last line.
+void FormatRollups(RollupKind kind, const std::vector<Rollup>& rollups, std::string& out);
+
+// A group whose stored totals differ from the items' own. |stored| has no
+// value when the table lacks the group, |expected| none when no item holds
+// it any more.
+struct RollupMismatch {
+    RollupKind kind = RollupKind::kNsn;
+    Rollup stored;
+    Rollup expected;
+};
+
+struct RollupCheck {
+    // Groups the items add up to, over every grouping.
+    sqlite3_int64 groups = 0;
+    std::vector<RollupMismatch> mismatches;
+};
+
+// Adds the items up again from scratch, in one read transaction, and
+// compares every grouping with its table.
+bool CheckRollups(Database& database, RollupCheck& check);
+
+// Replaces the contents of every rollup table with the items added up from
+// scratch. Must run inside the caller's transaction.
+bool RebuildRollups(Database& database);
+
+}  // namespace inventory
@@ -0,0 +1,280 @@
+#include "row_cache.h"
+
+#include <algorithm>
+
+#include "metrics.h"
+#include "service_client.h"
+
+namespace inventory {
+
+RowCache::RowCache(int page_size, int max_pages)
+    : page_size_(std::max(page_size, 1)), max_pages_(std::max(max_pages, 3)) {}
+
+void RowCache::Clear() {
+    for (auto& [index, page] : pages_) {
+        Recycle(std::move(page.rows));
+    }
+    pages_.clear();
+    bounds_.clear();
+    ids_.clear();
+    use_ids_ = false;
+    total_count_ = 0;
+    database_ = nullptr;
+    client_ = nullptr;
+}
+
+void RowCache::ResetWithIds(Database& database, std::vector<sqlite3_int64> ids) {
+    Clear();
+    use_ids_ = true;
+    ids_ = std::move(ids);
+    total_count_ = static_cast<sqlite3_int64>(ids_.size());
+    database_ = &database;
+}
+
+bool RowCache::Reset(Database& database, const SearchFilter& filter,
+                     sqlite3_int64 known_count) {
+    Clear();
+    filter_ = filter;
+    if (known_count >= 0) {
+        total_count_ = known_count;
+        database_ = &database;
+        return true;
+    }
+
+    if (!CountMatches(database, filter_, total_count_)) {
+        return false;
+    }
+    database_ = &database;
+    return true;
+}
+
+bool RowCache::Reset(ServiceClient& client, const SearchFilter& filter) {
+    Clear();
+    filter_ = filter;
+    if (!client.Count(filter_, total_count_)) {
+        return false;
+    }
+    client_ = &client;
+    return true;
+}
+
+ResultSet RowCache::TakeSpare() {
+    if (spare_.empty()) {
+        return {};
+    }
+    ResultSet rows = std::move(spare_.back());
+    spare_.pop_back();
+    rows.Clear();
+    return rows;
+}
+
+void RowCache::Recycle(ResultSet rows) {
+    if (static_cast<int>(spare_.size()) < max_pages_) {
+        spare_.push_back(std::move(rows));
+    }
+}
+
+RowCache::Page* RowCache::LoadIdPage(sqlite3_int64 page) {
+    const sqlite3_int64 start = page * page_size_;
+    const sqlite3_int64 end = std::min<sqlite3_int64>(start + page_size_, total_count_);
+    Statement statement = database_->Prepare(std::string(kItemSelectColumns) + " WHERE id = ?");
+    if (!statement || start >= end) {
+        return nullptr;
+    }
+    // Rows deleted since the id list was built keep their slot, left blank.
+    ResultSet rows = TakeSpare();
+    rows.Reserve(static_cast<size_t>(end - start), 0);
+    for (sqlite3_int64 i = start; i < end; ++i) {
+        sqlite3_reset(statement.get());
+        sqlite3_bind_int64(statement.get(), 1, ids_[static_cast<size_t>(i)]);
+        const int result = sqlite3_step(statement.get());
+        if (result == SQLITE_ROW) {
+            rows.AppendRow(statement.get());
+        } else if (result == SQLITE_DONE) {
+            rows.AppendBlankRow();
+        } else {
+            Recycle(std::move(rows));
+            return nullptr;
+        }
+    }
+    ++pages_loaded_;
+    Page& entry = pages_[page];
+    entry.rows = std::move(rows);
+    return &entry;
+}
+
+RowCache::Page* RowCache::LoadPage(sqlite3_int64 page) {
+    const sqlite3_int64 start = page * page_size_;
+    const sqlite3_int64 count = std::min<sqlite3_int64>(page_size_, total_count_ - start);
+    if ((!database_ && !client_) || count <= 0) {
+        return nullptr;
+    }
+    if (use_ids_) {
+        return LoadIdPage(page);
+    }
+
+    // Pick the cheapest starting point: the top or bottom of the result, or
+    // the boundary of the nearest page that has already been fetched.
+    PageDirection direction = PageDirection::kOlder;
+    const PageKey* anchor = nullptr;
+    sqlite3_int64 offset = start;
+
+    auto consider = [&](PageDirection candidate, const PageKey* key, sqlite3_int64 skip) {
+        if (skip >= 0 && skip < offset) {
+            direction = candidate;
+            anchor = key;
+            offset = skip;
+        }
+    };
+    consider(PageDirection::kNewer, nullptr, total_count_ - (start + count));
+    auto upper = bounds_.upper_bound(page);
+    if (upper != bounds_.end()) {
+        consider(PageDirection::kNewer, &upper->second.first,
+                 upper->first * page_size_ - (start + count));
+    }
+    if (upper != bounds_.begin()) {
+        auto lower = std::prev(upper);
+        if (lower->first < page) {
+            consider(PageDirection::kOlder, &lower->second.last,
+                     start - (lower->first + 1) * page_size_);
+        }
+    }
+
+    ResultSet rows = TakeSpare();
+    rows.Reserve(static_cast<size_t>(count), 0);
+    PageKey first_key;
+    PageKey last_key;
+    const bool fetched = client_ ? FetchRemotePage(direction, anchor, count, offset, rows,
+                                                   first_key, last_key)
+                                 : FetchPage(direction, anchor, count, offset, rows, first_key,
+                                             last_key);
+    if (!fetched || rows.empty()) {
+        Recycle(std::move(rows));
+        return nullptr;
+    }
+    if (rows.size() == 1) {
+        last_key = first_key;
+    }
+    if (direction == PageDirection::kNewer) {
+        rows.Reverse();
+        std::swap(first_key, last_key);
+    }
+
+    bounds_[page] = Bounds{std::move(first_key), std::move(last_key)};
+    ++pages_loaded_;
+    Page& entry = pages_[page];
+    entry.rows = std::move(rows);
+    return &entry;
+}
+
+bool RowCache::FetchPage(PageDirection direction, const PageKey* anchor, sqlite3_int64 count,
+                         sqlite3_int64 offset, ResultSet& rows, PageKey& first_key,
+                         PageKey& last_key) {
+    Statement page_statement = PreparePage(*database_, filter_, direction, anchor != nullptr);
+    if (!page_statement) {
+        return false;
+    }
+    sqlite3_stmt* statement = page_statement.get();
+    BindPage(statement, filter_, anchor, count, offset);
+
+    // The keys come straight from the statement so that they are bound back
+    // exactly as SQLite returned them.
+    ScopedLatency latency(Metrics().shape(PageShape(filter_, direction, anchor != nullptr)));
+    int result;
+    while ((result = sqlite3_step(statement)) == SQLITE_ROW) {
+        ReadPageKey(statement, rows.empty() ? first_key : last_key);
+        rows.AppendRow(statement);
+    }
+    // A busy, interrupted or failed read would leave a short page and wrong
+    // bounds behind; nothing is cached and the page is read again next time.
+    if (result != SQLITE_DONE) {
+        rows.Clear();
+        return false;
+    }
+    return true;
+}
+
+bool RowCache::FetchRemotePage(PageDirection direction, const PageKey* anchor,
+                               sqlite3_int64 count, sqlite3_int64 offset, ResultSet& rows,
+                               PageKey& first_key, PageKey& last_key) {
+    std::vector<ServiceRow> fetched;
+    if (!client_->Page(filter_, direction, anchor, count, offset, fetched)) {
+        return false;
+    }
+    for (const ServiceRow& row : fetched) {
+        PageKey& key = rows.empty() ? first_key : last_key;
+        key.created_at = row.created_at;
+        key.id = row.item.id;
+        const std::string_view text[kItemTextColumns] = {
+            row.item.name, row.item.part_number, row.item.nsn, row.item.serial_number,
+            row.created_at};
+        rows.AppendRow(row.item.id, row.item.quantity, text);
+    }
+    return true;
+}
+
+void RowCache::EvictPages(sqlite3_int64 keep_first, sqlite3_int64 keep_last) {
+    while (static_cast<int>(pages_.size()) > max_pages_) {
+        auto victim = pages_.end();
+        for (auto it = pages_.begin(); it != pages_.end(); ++it) {
+            if (it->first >= keep_first && it->first <= keep_last) {
+                continue;
+            }
+            if (victim == pages_.end() || it->second.last_used < victim->second.last_used) {
+                victim = it;
+            }
+        }
+        if (victim == pages_.end()) {
+            return;
+        }
+        Recycle(std::move(victim->second.rows));
+        pages_.erase(victim);
+    }
+}
+
+RowRef RowCache::Row(sqlite3_int64 index) {
+    if (index < 0 || index >= total_count_) {
+        return {};
+    }
+    const sqlite3_int64 page = index / page_size_;
+    auto found = pages_.find(page);
+    Page* entry = found != pages_.end() ? &found->second : LoadPage(page);
+    if (!entry) {
+        return {};
+    }
+    entry->last_used = ++clock_;
+    const auto offset = static_cast<size_t>(index % page_size_);
+    RowRef row;
+    if (offset < entry->rows.size() && entry->rows.id(offset) != 0) {
+        row = RowRef{&entry->rows, offset};
+    }
+    EvictPages(page, page);
+    return row;
+}
+
+void RowCache::Prefetch(sqlite3_int64 first, sqlite3_int64 last) {
+    if (total_count_ == 0 || last < first) {
+        return;
+    }
+    const sqlite3_int64 first_page = std::max<sqlite3_int64>(first / page_size_ - 1, 0);
+    const sqlite3_int64 last_page =
+        std::min<sqlite3_int64>(last / page_size_ + 1, (total_count_ - 1) / page_size_);
+    for (sqlite3_int64 page = first_page; page <= last_page; ++page) {
+        auto found = pages_.find(page);
+        Page* entry = found != pages_.end() ? &found->second : LoadPage(page);
+        if (entry) {
+            entry->last_used = ++clock_;
+        }
+    }
+    EvictPages(first_page, last_page);
+}
+
+size_t RowCache::resident_rows() const {
+    size_t rows = 0;
+    for (const auto& [index, page] : pages_) {
+        rows += page.rows.size();
+    }
+    return rows;
+}
+
+}  // namespace inventory
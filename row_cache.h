@@ -0,0 +1,87 @@
+#pragma once
+
+#include <sqlite3.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "database.h"
+#include "item_pager.h"
+#include "result_set.h"
+#include "search_filter.h"
+
+namespace inventory {
+
+class ServiceClient;
+
+// Window over the result of a search, ordered newest first. Only the pages
+// around the rows the caller asks for are kept decoded; pages are fetched with
+// keyset queries anchored on the nearest page that has already been seen, so
+// scrolling never re-reads the rows in front of the window. Evicted pages are
+// recycled, so scrolling does not allocate once the window has filled.
+class RowCache {
+public:
+    explicit RowCache(int page_size = 100, int max_pages = 8);
+
+    RowCache(const RowCache&) = delete;
+    RowCache& operator=(const RowCache&) = delete;
+
+    // Starts a new search and drops every cached page. The matches are
+    // counted unless the caller already knows |known_count|.
+    bool Reset(Database& database, const SearchFilter& filter, sqlite3_int64 known_count = -1);
+    // The same, with the count and the pages fetched from an inventory service.
+    bool Reset(ServiceClient& client, const SearchFilter& filter);
+    // Shows exactly |ids|, in that order, instead of a query result.
+    void ResetWithIds(Database& database, std::vector<sqlite3_int64> ids);
+    void Clear();
+
+    sqlite3_int64 total_count() const { return total_count_; }
+
+    // Returns the row at |index| in display order, or an empty RowRef when it
+    // is out of range or cannot be read. The row is valid until the next call.
+    RowRef Row(sqlite3_int64 index);
+
+    // Makes sure rows [first, last] plus one page on either side are loaded.
+    void Prefetch(sqlite3_int64 first, sqlite3_int64 last);
+
+    size_t resident_rows() const;
+    sqlite3_int64 pages_loaded() const { return pages_loaded_; }
+
+private:
+    struct Bounds {
+        PageKey first;
+        PageKey last;
+    };
+    struct Page {
+        ResultSet rows;
+        sqlite3_int64 last_used = 0;
+    };
+
+    Page* LoadPage(sqlite3_int64 page);
+    Page* LoadIdPage(sqlite3_int64 page);
+    bool FetchPage(PageDirection direction, const PageKey* anchor, sqlite3_int64 count,
+                   sqlite3_int64 offset, ResultSet& rows, PageKey& first_key, PageKey& last_key);
+    bool FetchRemotePage(PageDirection direction, const PageKey* anchor, sqlite3_int64 count,
+                         sqlite3_int64 offset, ResultSet& rows, PageKey& first_key,
+                         PageKey& last_key);
+    ResultSet TakeSpare();
+    void Recycle(ResultSet rows);
+    void EvictPages(sqlite3_int64 keep_first, sqlite3_int64 keep_last);
+
+    Database* database_ = nullptr;
+    ServiceClient* client_ = nullptr;
+    SearchFilter filter_;
+    int page_size_;
+    int max_pages_;
+    sqlite3_int64 total_count_ = 0;
+    sqlite3_int64 clock_ = 0;
+    sqlite3_int64 pages_loaded_ = 0;
+    std::map<sqlite3_int64, Page> pages_;
+    std::map<sqlite3_int64, Bounds> bounds_;
+    std::vector<ResultSet> spare_;
+    bool use_ids_ = false;
+    std::vector<sqlite3_int64> ids_;
+};
+
+}  // namespace inventory
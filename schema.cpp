@@ -0,0 +1,604 @@
+#include "schema.h"
+
+#include <string>
+#include <vector>
+
+#include "item_keys.h"
+#include "rollups.h"
+
+namespace inventory {
+namespace {
+
+// items_fts is an external-content FTS5 table over the four text columns,
+// kept in step with items by triggers so every writer updates it.
+constexpr char kCreateTrigramTriggers[] =
+    "CREATE TRIGGER items_fts_insert AFTER INSERT ON items BEGIN "
+    "INSERT INTO items_fts(rowid, name, part_number, nsn, serial_number) "
+    "VALUES (new.id, new.name, new.part_number, new.nsn, new.serial_number); "
+    "END;"
+    "CREATE TRIGGER items_fts_delete AFTER DELETE ON items BEGIN "
+    "INSERT INTO items_fts(items_fts, rowid, name, part_number, nsn, serial_number) "
+    "VALUES ('delete', old.id, old.name, old.part_number, old.nsn, old.serial_number); "
+    "END;"
+    "CREATE TRIGGER items_fts_update "
+    "AFTER UPDATE OF name, part_number, nsn, serial_number ON items BEGIN "
+    "INSERT INTO items_fts(items_fts, rowid, name, part_number, nsn, serial_number) "
+    "VALUES ('delete', old.id, old.name, old.part_number, old.nsn, old.serial_number); "
+    "INSERT INTO items_fts(rowid, name, part_number, nsn, serial_number) "
+    "VALUES (new.id, new.name, new.part_number, new.nsn, new.serial_number); "
+    "END;";
+
+constexpr char kDropTrigramTriggers[] =
+    "DROP TRIGGER IF EXISTS items_fts_insert;"
+    "DROP TRIGGER IF EXISTS items_fts_delete;"
+    "DROP TRIGGER IF EXISTS items_fts_update;";
+
+constexpr char kRebuildTrigramTable[] = "INSERT INTO items_fts(items_fts) VALUES ('rebuild');";
+
+constexpr char kCreateTrigramTable[] =
+    "CREATE VIRTUAL TABLE items_fts USING fts5("
+    "name, part_number, nsn, serial_number,"
+    "content='items', content_rowid='id', tokenize='trigram');"
+    "INSERT INTO items_fts(items_fts) VALUES ('rebuild');";
+
+constexpr char kCreateItems[] =
+    "CREATE TABLE IF NOT EXISTS items ("
+    "id INTEGER PRIMARY KEY AUTOINCREMENT,"
+    "name TEXT NOT NULL,"
+    "part_number TEXT NOT NULL,"
+    "nsn TEXT NOT NULL,"
+    "serial_number TEXT NOT NULL,"
+    "quantity INTEGER NOT NULL DEFAULT 0,"
+    "created_at TEXT NOT NULL DEFAULT (datetime('now'))"
+    ")";
+
+// created_at defaults to millisecond resolution so rows added in the same
+// second still list in insertion order; the text stays fixed-width and sorts
+// as stored. SQLite cannot change a column default in place, so the table is
+// rebuilt, keeping ids and the AUTOINCREMENT counter. Dropping items drops its
+// indexes and triggers, which are created again afterwards.
+constexpr char kRebuildItems[] =
+    "DROP TRIGGER IF EXISTS stock_ledger_delete;"
+    "CREATE TABLE items_rebuild ("
+    "id INTEGER PRIMARY KEY AUTOINCREMENT,"
+    "name TEXT NOT NULL,"
+    "part_number TEXT NOT NULL,"
+    "nsn TEXT NOT NULL,"
+    "serial_number TEXT NOT NULL,"
+    "quantity INTEGER NOT NULL DEFAULT 0,"
+    "created_at TEXT NOT NULL DEFAULT (strftime('%Y-%m-%d %H:%M:%f', 'now'))"
+    ");"
+    "INSERT INTO items_rebuild (id, name, part_number, nsn, serial_number, quantity, created_at)"
+    " SELECT id, name, part_number, nsn, serial_number, quantity,"
+    " COALESCE(strftime('%Y-%m-%d %H:%M:%f', created_at), created_at) FROM items;"
+    "UPDATE sqlite_sequence SET seq ="
+    " (SELECT MAX(seq) FROM sqlite_sequence WHERE name IN ('items', 'items_rebuild'))"
+    " WHERE name = 'items_rebuild';"
+    "INSERT INTO sqlite_sequence (name, seq) SELECT 'items_rebuild', seq FROM sqlite_sequence"
+    " WHERE name = 'items' AND NOT EXISTS"
+    " (SELECT 1 FROM sqlite_sequence WHERE name = 'items_rebuild');"
+    "DROP TABLE items;"
+    "ALTER TABLE items_rebuild RENAME TO items;";
+
+// Exact lookups on the identifier columns, and the recent-first listing.
+// idx_items_recent carries every listed column so a page of the default
+// listing is read from the index alone, in (created_at, id) order.
+constexpr char kCreateIndexes[] =
+    "CREATE INDEX IF NOT EXISTS idx_items_nsn ON items(nsn);"
+    "CREATE INDEX IF NOT EXISTS idx_items_part_number ON items(part_number);"
+    "CREATE INDEX IF NOT EXISTS idx_items_serial_number ON items(serial_number);"
+    "CREATE INDEX IF NOT EXISTS idx_items_recent ON items("
+    "created_at, id, name, part_number, nsn, serial_number, quantity);"
+    "ANALYZE;";
+
+// Identifiers normalized by item_keys.h, written next to the text by every
+// writer, so that a pasted NSN, part or serial number is one index probe
+// however it is spelled.
+constexpr char kAddItemKeys[] =
+    "ALTER TABLE items ADD COLUMN nsn_key INTEGER;"
+    "ALTER TABLE items ADD COLUMN part_key TEXT;"
+    "ALTER TABLE items ADD COLUMN serial_key TEXT;";
+
+constexpr char kCreateKeyIndexes[] =
+    "CREATE INDEX IF NOT EXISTS idx_items_nsn_key ON items(nsn_key);"
+    "CREATE INDEX IF NOT EXISTS idx_items_part_key ON items(part_key);"
+    "CREATE INDEX IF NOT EXISTS idx_items_serial_key ON items(serial_key);";
+
+constexpr char kDropIndexes[] =
+    "DROP INDEX IF EXISTS idx_items_nsn;"
+    "DROP INDEX IF EXISTS idx_items_part_number;"
+    "DROP INDEX IF EXISTS idx_items_serial_number;"
+    "DROP INDEX IF EXISTS idx_items_recent;"
+    "DROP INDEX IF EXISTS idx_items_nsn_key;"
+    "DROP INDEX IF EXISTS idx_items_part_key;"
+    "DROP INDEX IF EXISTS idx_items_serial_key;"
+    "DROP INDEX IF EXISTS idx_items_nsn_created;"
+    "DROP INDEX IF EXISTS idx_items_part_created;"
+    "DROP INDEX IF EXISTS idx_items_name_created;"
+    "DROP INDEX IF EXISTS idx_items_nsn_group;"
+    "DROP INDEX IF EXISTS idx_items_part_group;";
+
+// Rows are read in id ranges and written after each range, so that no
+// statement reads the table while it is being changed.
+constexpr int kKeyBackfillBatch = 10000;
+
+// Every quantity change is a row in stock_movements; CompactStockMovements
+// folds old rows into one checkpoint per item. AUTOINCREMENT keeps movement
+// ids increasing after compaction deletes the newest ones.
+constexpr char kCreateStockLedger[] =
+    "CREATE TABLE stock_movements ("
+    "id INTEGER PRIMARY KEY AUTOINCREMENT,"
+    "item_id INTEGER NOT NULL,"
+    "delta INTEGER NOT NULL,"
+    "created_at TEXT NOT NULL DEFAULT (strftime('%Y-%m-%d %H:%M:%f', 'now'))"
+    ");"
+    "CREATE INDEX idx_stock_movements_item ON stock_movements(item_id, id);"
+    "CREATE TABLE stock_checkpoints ("
+    "item_id INTEGER PRIMARY KEY,"
+    "quantity INTEGER NOT NULL,"
+    "through_id INTEGER NOT NULL,"
+    "created_at TEXT NOT NULL DEFAULT (strftime('%Y-%m-%d %H:%M:%f', 'now'))"
+    ");";
+
+constexpr char kCreateStockLedgerTrigger[] =
+    "CREATE TRIGGER stock_ledger_delete AFTER DELETE ON items BEGIN "
+    "DELETE FROM stock_movements WHERE item_id = old.id; "
+    "DELETE FROM stock_checkpoints WHERE item_id = old.id; "
+    "END;";
+
+// Migration 10 records the quantity a row is inserted with as its opening
+// movement, in the statement that inserts it, so that every insert path
+// (InsertItem, the importer, the generator, a restored item) enters the
+// ledger and an item's quantity is always its checkpoint plus the movements
+// after it. Items from before it get the quantity their movements do not
+// account for as a checkpoint through movement 0.
+constexpr char kCreateOpeningStockTrigger[] =
+    "CREATE TRIGGER stock_ledger_insert AFTER INSERT ON items WHEN new.quantity <> 0 BEGIN "
+    "INSERT INTO stock_movements (item_id, delta) VALUES (new.id, new.quantity); "
+    "END;";
+
+constexpr char kBackfillOpeningStock[] =
+    "INSERT INTO stock_checkpoints (item_id, quantity, through_id)"
+    " SELECT id, opening, 0 FROM (SELECT items.id, items.quantity - COALESCE((SELECT"
+    " SUM(delta) FROM stock_movements WHERE item_id = items.id), 0) AS opening FROM items"
+    " WHERE items.id NOT IN (SELECT item_id FROM stock_checkpoints)) WHERE opening <> 0;";
+
+// Every change to an item's text, every insert and every delete appends one
+// item_journal row in the same statement, through triggers, so no writer can
+// skip it. An update stores the old and new values of the text columns it
+// changed and NULL for the rest; a delete stores the whole row, which is what
+// RevertChange restores it from, and movement_id, the newest stock movement
+// at the time. Quantity changes are not journaled again: stock_movements
+// already records each of them. The key columns are left out, being derived
+// from the text. item_journal_horizon holds the newest change time that
+// CompactJournal or CompactStockMovements has dropped, first the time the
+// journal was created: views are only rebuilt from there on. action is a
+// JournalAction.
+//
+// A deleted item keeps its stock movements and checkpoint, instead of the
+// ledger dropping them with the row, until CompactJournal drops its
+// tombstone: the views need them, and a restored item carries on with them.
+constexpr char kCreateChangeJournal[] =
+    "DROP TRIGGER IF EXISTS stock_ledger_delete;"
+    "CREATE TABLE item_journal ("
+    "id INTEGER PRIMARY KEY AUTOINCREMENT,"
+    "item_id INTEGER NOT NULL,"
+    "action INTEGER NOT NULL,"
+    "changed_at TEXT NOT NULL DEFAULT (strftime('%Y-%m-%d %H:%M:%f', 'now')),"
+    "old_name TEXT, old_part_number TEXT, old_nsn TEXT, old_serial_number TEXT,"
+    "old_quantity INTEGER, old_created_at TEXT, movement_id INTEGER,"
+    "new_name TEXT, new_part_number TEXT, new_nsn TEXT, new_serial_number TEXT"
+    ");"
+    "CREATE INDEX idx_item_journal_item ON item_journal(item_id, id);"
+    "CREATE INDEX idx_item_journal_deletes ON item_journal(item_id) WHERE action = 3;"
+    "CREATE TABLE item_journal_horizon ("
+    "id INTEGER PRIMARY KEY CHECK (id = 1),"
+    "changed_at TEXT NOT NULL"
+    ");"
+    "INSERT INTO item_journal_horizon (id, changed_at)"
+    " VALUES (1, strftime('%Y-%m-%d %H:%M:%f', 'now'));";
+
+constexpr char kCreateJournalTriggers[] =
+    "CREATE TRIGGER item_journal_insert AFTER INSERT ON items BEGIN "
+    "INSERT INTO item_journal (item_id, action) VALUES (new.id, 1); "
+    "END;"
+    "CREATE TRIGGER item_journal_update "
+    "AFTER UPDATE OF name, part_number, nsn, serial_number ON items "
+    "WHEN old.name <> new.name OR old.part_number <> new.part_number OR old.nsn <> new.nsn"
+    " OR old.serial_number <> new.serial_number BEGIN "
+    "INSERT INTO item_journal (item_id, action, old_name, old_part_number, old_nsn,"
+    " old_serial_number, new_name, new_part_number, new_nsn, new_serial_number)"
+    " VALUES (new.id, 2,"
+    " CASE WHEN old.name <> new.name THEN old.name END,"
+    " CASE WHEN old.part_number <> new.part_number THEN old.part_number END,"
+    " CASE WHEN old.nsn <> new.nsn THEN old.nsn END,"
+    " CASE WHEN old.serial_number <> new.serial_number THEN old.serial_number END,"
+    " CASE WHEN old.name <> new.name THEN new.name END,"
+    " CASE WHEN old.part_number <> new.part_number THEN new.part_number END,"
+    " CASE WHEN old.nsn <> new.nsn THEN new.nsn END,"
+    " CASE WHEN old.serial_number <> new.serial_number THEN new.serial_number END); "
+    "END;"
+    "CREATE TRIGGER item_journal_delete AFTER DELETE ON items BEGIN "
+    "INSERT INTO item_journal (item_id, action, old_name, old_part_number, old_nsn,"
+    " old_serial_number, old_quantity, old_created_at, movement_id) VALUES (old.id, 3,"
+    " old.name, old.part_number, old.nsn, old.serial_number, old.quantity, old.created_at,"
+    " (SELECT COALESCE(MAX(seq), 0) FROM sqlite_sequence WHERE name = 'stock_movements')); "
+    "END;";
+
+constexpr char kDropJournalTriggers[] =
+    "DROP TRIGGER IF EXISTS item_journal_insert;"
+    "DROP TRIGGER IF EXISTS item_journal_update;"
+    "DROP TRIGGER IF EXISTS item_journal_delete;";
+
+// One row per distinct value of the grouped column (see rollups.h).
+constexpr char kCreateRollupTables[] =
+    "CREATE TABLE rollup_nsn ("
+    "value TEXT PRIMARY KEY, items INTEGER NOT NULL, quantity INTEGER NOT NULL,"
+    "first_created_at TEXT NOT NULL, last_created_at TEXT NOT NULL) WITHOUT ROWID;"
+    "CREATE TABLE rollup_part_number ("
+    "value TEXT PRIMARY KEY, items INTEGER NOT NULL, quantity INTEGER NOT NULL,"
+    "first_created_at TEXT NOT NULL, last_created_at TEXT NOT NULL) WITHOUT ROWID;"
+    "CREATE TABLE rollup_name ("
+    "value TEXT PRIMARY KEY, items INTEGER NOT NULL, quantity INTEGER NOT NULL,"
+    "first_created_at TEXT NOT NULL, last_created_at TEXT NOT NULL) WITHOUT ROWID;";
+
+// When the item with a group's first or last created_at leaves it, the rollup
+// triggers look the new one up in these, in one probe. They take over from
+// idx_items_nsn and idx_items_part_number, which they start with.
+constexpr char kCreateRollupIndexes[] =
+    "DROP INDEX IF EXISTS idx_items_nsn;"
+    "DROP INDEX IF EXISTS idx_items_part_number;"
+    "CREATE INDEX IF NOT EXISTS idx_items_nsn_created ON items(nsn, created_at);"
+    "CREATE INDEX IF NOT EXISTS idx_items_part_created ON items(part_number, created_at);"
+    "CREATE INDEX IF NOT EXISTS idx_items_name_created ON items(name, created_at);";
+
+// Migration 9 keys the NSN and part number rollups on nsn_key and part_key,
+// falling back to the column as stored where the key is NULL (RollupKey),
+// and keeps the spelling of each group's oldest item for display. The group look-ups
+// go through these expression indexes, which replace the first two of
+// kCreateRollupIndexes.
+constexpr char kCreateKeyedRollupTables[] =
+    "DROP TABLE rollup_nsn;"
+    "DROP TABLE rollup_part_number;"
+    "DROP TABLE rollup_name;"
+    "CREATE TABLE rollup_nsn ("
+    "group_key PRIMARY KEY, value TEXT NOT NULL, items INTEGER NOT NULL,"
+    "quantity INTEGER NOT NULL, first_created_at TEXT NOT NULL,"
+    "last_created_at TEXT NOT NULL) WITHOUT ROWID;"
+    "CREATE INDEX rollup_nsn_value ON rollup_nsn(value);"
+    "CREATE TABLE rollup_part_number ("
+    "group_key PRIMARY KEY, value TEXT NOT NULL, items INTEGER NOT NULL,"
+    "quantity INTEGER NOT NULL, first_created_at TEXT NOT NULL,"
+    "last_created_at TEXT NOT NULL) WITHOUT ROWID;"
+    "CREATE INDEX rollup_part_number_value ON rollup_part_number(value);"
+    "CREATE TABLE rollup_name ("
+    "group_key PRIMARY KEY, value TEXT NOT NULL, items INTEGER NOT NULL,"
+    "quantity INTEGER NOT NULL, first_created_at TEXT NOT NULL,"
+    "last_created_at TEXT NOT NULL) WITHOUT ROWID;"
+    "CREATE INDEX rollup_name_value ON rollup_name(value);";
+
+constexpr char kCreateKeyedRollupIndexes[] =
+    "DROP INDEX IF EXISTS idx_items_nsn_created;"
+    "DROP INDEX IF EXISTS idx_items_part_created;"
+    "CREATE INDEX IF NOT EXISTS idx_items_nsn_group ON items("
+    "COALESCE(nsn_key, nsn), created_at);"
+    "CREATE INDEX IF NOT EXISTS idx_items_part_group ON items("
+    "COALESCE(part_key, part_number), created_at);"
+    "CREATE INDEX IF NOT EXISTS idx_items_name_created ON items(name, created_at);";
+
+// The rest of kCreateIndexes, as migration 8 leaves it.
+constexpr char kCreateListingIndexes[] =
+    "CREATE INDEX IF NOT EXISTS idx_items_serial_number ON items(serial_number);"
+    "CREATE INDEX IF NOT EXISTS idx_items_recent ON items("
+    "created_at, id, name, part_number, nsn, serial_number, quantity);";
+
+constexpr char kDropRollupTriggers[] =
+    "DROP TRIGGER IF EXISTS rollup_insert;"
+    "DROP TRIGGER IF EXISTS rollup_delete;"
+    "DROP TRIGGER IF EXISTS rollup_update;"
+    "DROP TRIGGER IF EXISTS rollup_quantity;";
+
+// The triggers that keep the rollup tables in step with items. A group goes
+// with its last item. Its first and last created_at only move outwards on
+// insert, and its value changes with the first; when the item holding one of
+// them leaves, the next one is looked up through kCreateKeyedRollupIndexes. A
+// quantity change alone, as made by every stock delta, adds the difference.
+std::string RollupTriggerSql() {
+    std::string insert;
+    std::string remove;
+    std::string quantity;
+    for (int i = 0; i < static_cast<int>(RollupKind::kRollupKindCount); ++i) {
+        const auto kind = static_cast<RollupKind>(i);
+        const std::string table = RollupTable(kind);
+        const std::string column = RollupColumn(kind);
+        const std::string key = RollupKey(kind);
+        const std::string old_key = RollupKey(kind, "old.");
+        const std::string new_key = RollupKey(kind, "new.");
+        const std::string in_group = " FROM items WHERE " + key + " = " + old_key + ")";
+        // Items created in the same millisecond are told apart by id.
+        auto oldest = [&](const std::string& group) {
+            return "(SELECT " + column + " FROM items WHERE " + key + " = " + group +
+                   " ORDER BY created_at, id LIMIT 1)";
+        };
+        // value is set on its own, and only when the oldest item changes, so
+        // the value index is not rewritten on every write.
+        insert += "UPDATE " + table + " SET value = " + oldest(new_key) +
+                  " WHERE group_key = " + new_key +
+                  " AND first_created_at >= new.created_at; INSERT INTO " + table +
+                  " (group_key, value, items, quantity, first_created_at, last_created_at)"
+                  " VALUES (" +
+                  new_key + ", new." + column +
+                  ", 1, new.quantity, new.created_at, new.created_at)"
+                  " ON CONFLICT (group_key) DO UPDATE SET"
+                  " items = items + 1, quantity = quantity + excluded.quantity,"
+                  " first_created_at = MIN(first_created_at, excluded.first_created_at),"
+                  " last_created_at = MAX(last_created_at, excluded.last_created_at); ";
+        remove += "DELETE FROM " + table + " WHERE group_key = " + old_key +
+                  " AND items = 1; UPDATE " + table +
+                  " SET items = items - 1, quantity = quantity - old.quantity,"
+                  " first_created_at = CASE WHEN first_created_at < old.created_at"
+                  " THEN first_created_at ELSE (SELECT MIN(created_at)" +
+                  in_group +
+                  " END,"
+                  " last_created_at = CASE WHEN last_created_at > old.created_at"
+                  " THEN last_created_at ELSE (SELECT MAX(created_at)" +
+                  in_group + " END WHERE group_key = " + old_key + "; UPDATE " + table +
+                  " SET value = " + oldest(old_key) + " WHERE group_key = " + old_key +
+                  " AND first_created_at >= old.created_at; ";
+        quantity += "UPDATE " + table +
+                    " SET quantity = quantity + new.quantity - old.quantity WHERE group_key = " +
+                    new_key + "; ";
+    }
+    // An updated item leaves its old groups before it joins the new ones, so
+    // the look-ups see it where it is now.
+    return "CREATE TRIGGER rollup_insert AFTER INSERT ON items BEGIN " + insert +
+           "END;"
+           "CREATE TRIGGER rollup_delete AFTER DELETE ON items BEGIN " +
+           remove +
+           "END;"
+           "CREATE TRIGGER rollup_update AFTER UPDATE OF name, part_number, nsn, quantity,"
+           " created_at, nsn_key, part_key ON items"
+           " WHEN old.name <> new.name OR old.part_number <> new.part_number"
+           " OR old.nsn <> new.nsn OR old.created_at <> new.created_at"
+           " OR old.nsn_key IS NOT new.nsn_key OR old.part_key IS NOT new.part_key BEGIN " +
+           remove + insert +
+           "END;"
+           "CREATE TRIGGER rollup_quantity AFTER UPDATE OF quantity ON items"
+           " WHEN old.quantity <> new.quantity AND old.name = new.name"
+           " AND old.part_number = new.part_number AND old.nsn = new.nsn"
+           " AND old.created_at = new.created_at AND old.nsn_key IS new.nsn_key"
+           " AND old.part_key IS new.part_key BEGIN " +
+           quantity + "END;";
+}
+
+bool CreateItems(Database& database) {
+    return database.Execute(kCreateItems);
+}
+
+// A missing trigram index only costs search speed, so a failure here leaves
+// the database usable in scan mode.
+bool CreateTrigramIndex(Database& database) {
+    if (TrigramIndexAvailable(database) || !sqlite3_compileoption_used("ENABLE_FTS5")) {
+        return true;
+    }
+    if (!database.Execute("SAVEPOINT trigram_index")) {
+        return false;
+    }
+    if (!database.Execute(kCreateTrigramTable) || !database.Execute(kCreateTrigramTriggers)) {
+        database.Execute("ROLLBACK TO trigram_index");
+    }
+    return database.Execute("RELEASE trigram_index");
+}
+
+bool CreateIndexes(Database& database) {
+    return database.Execute(kCreateIndexes);
+}
+
+bool CreateStockLedgerTrigger(Database& database) {
+    return database.Execute(kCreateStockLedgerTrigger);
+}
+
+bool CreateStockLedger(Database& database) {
+    return database.Execute(kCreateStockLedger) && CreateStockLedgerTrigger(database);
+}
+
+bool RebuildItemsWithMilliseconds(Database& database) {
+    if (!database.Execute(kDropTrigramTriggers) || !database.Execute(kRebuildItems) ||
+        !CreateIndexes(database) || !CreateStockLedgerTrigger(database)) {
+        return false;
+    }
+    return !TrigramIndexAvailable(database) || database.Execute(kCreateTrigramTriggers);
+}
+
+std::string ColumnString(sqlite3_stmt* statement, int column) {
+    const unsigned char* value = sqlite3_column_text(statement, column);
+    return std::string(value ? reinterpret_cast<const char*>(value) : "",
+                       static_cast<size_t>(sqlite3_column_bytes(statement, column)));
+}
+
+bool BackfillItemKeys(Database& database) {
+    struct Row {
+        sqlite3_int64 id;
+        std::string nsn;
+        std::string part_number;
+        std::string serial_number;
+    };
+    std::vector<Row> rows;
+    sqlite3_int64 after = 0;
+    while (true) {
+        rows.clear();
+        {
+            Statement select = database.Prepare(
+                "SELECT id, nsn, part_number, serial_number FROM items WHERE id > ?"
+                " ORDER BY id LIMIT ?");
+            if (!select) {
+                return false;
+            }
+            sqlite3_bind_int64(select.get(), 1, after);
+            sqlite3_bind_int(select.get(), 2, kKeyBackfillBatch);
+            int step;
+            while ((step = sqlite3_step(select.get())) == SQLITE_ROW) {
+                rows.push_back({sqlite3_column_int64(select.get(), 0),
+                                ColumnString(select.get(), 1), ColumnString(select.get(), 2),
+                                ColumnString(select.get(), 3)});
+            }
+            if (step != SQLITE_DONE) {
+                return false;
+            }
+        }
+        if (rows.empty()) {
+            return true;
+        }
+        Statement update = database.Prepare(
+            "UPDATE items SET nsn_key = ?, part_key = ?, serial_key = ? WHERE id = ?");
+        if (!update) {
+            return false;
+        }
+        for (const Row& row : rows) {
+            sqlite3_reset(update.get());
+            BindItemKeys(update.get(), 1, row.nsn, row.part_number, row.serial_number);
+            sqlite3_bind_int64(update.get(), 4, row.id);
+            if (sqlite3_step(update.get()) != SQLITE_DONE) {
+                return false;
+            }
+        }
+        after = rows.back().id;
+    }
+}
+
+bool AddItemKeys(Database& database) {
+    return database.Execute(kAddItemKeys) && BackfillItemKeys(database) &&
+           database.Execute(kCreateKeyIndexes) && database.Execute("ANALYZE");
+}
+
+bool CreateChangeJournal(Database& database) {
+    return database.Execute(kCreateChangeJournal) && database.Execute(kCreateJournalTriggers);
+}
+
+bool CreateRollupTriggers(Database& database) {
+    return database.Execute(kDropRollupTriggers) && database.Execute(RollupTriggerSql().c_str());
+}
+
+// The tables as migration 8 shipped them, filled in and kept up to date by
+// RekeyRollups, which always runs straight after.
+bool CreateRollups(Database& database) {
+    return database.Execute(kCreateRollupIndexes) && database.Execute(kCreateRollupTables);
+}
+
+bool RekeyRollups(Database& database) {
+    return database.Execute(kDropRollupTriggers) && database.Execute(kCreateKeyedRollupTables) &&
+           database.Execute(kCreateKeyedRollupIndexes) && RebuildRollups(database) &&
+           CreateRollupTriggers(database) && database.Execute("ANALYZE");
+}
+
+bool RecordOpeningStock(Database& database) {
+    return database.Execute(kBackfillOpeningStock) &&
+           database.Execute(kCreateOpeningStockTrigger);
+}
+
+struct Migration {
+    int version;
+    bool (*apply)(Database& database);
+};
+
+// Applied in order to bring user_version up to kSchemaVersion. Append new
+// steps; never change or reorder one that has shipped.
+constexpr Migration kMigrations[] = {
+    {1, CreateItems},
+    {2, CreateTrigramIndex},
+    {3, CreateIndexes},
+    {4, CreateStockLedger},
+    {5, RebuildItemsWithMilliseconds},
+    {6, AddItemKeys},
+    {7, CreateChangeJournal},
+    {8, CreateRollups},
+    {9, RekeyRollups},
+    {10, RecordOpeningStock},
+};
+
+static_assert(sizeof(kMigrations) / sizeof(kMigrations[0]) == kSchemaVersion,
+              "every schema version needs a migration");
+
+bool SetSchemaVersion(Database& database, int version) {
+    std::string sql = "PRAGMA user_version = " + std::to_string(version);
+    return database.Execute(sql.c_str());
+}
+
+}  // namespace
+
+int SchemaVersion(Database& database) {
+    Statement statement = database.Prepare("PRAGMA user_version");
+    if (!statement || sqlite3_step(statement.get()) != SQLITE_ROW) {
+        return -1;
+    }
+    return sqlite3_column_int(statement.get(), 0);
+}
+
+bool EnsureSchema(Database& database) {
+    int version = SchemaVersion(database);
+    if (version < 0 || version > kSchemaVersion) {
+        return false;
+    }
+    for (const auto& migration : kMigrations) {
+        if (migration.version <= version) {
+            continue;
+        }
+        if (!database.Execute("BEGIN IMMEDIATE")) {
+            return false;
+        }
+        if (!migration.apply(database) || !SetSchemaVersion(database, migration.version)) {
+            database.Execute("ROLLBACK");
+            return false;
+        }
+        if (!database.Execute("COMMIT")) {
+            database.Execute("ROLLBACK");
+            return false;
+        }
+        version = migration.version;
+    }
+    // Databases migrated by a build without FTS5 get the index once FTS5 is
+    // available.
+    return CreateTrigramIndex(database);
+}
+
+bool TrigramIndexAvailable(Database& database) {
+    Statement statement = database.Prepare(
+        "SELECT 1 FROM sqlite_master WHERE type = 'table' AND name = 'items_fts'");
+    return statement && sqlite3_step(statement.get()) == SQLITE_ROW;
+}
+
+bool SuspendItemIndexes(Database& database) {
+    return database.Execute(kDropTrigramTriggers) && database.Execute(kDropIndexes) &&
+           SuspendRollups(database);
+}
+
+bool SuspendChangeJournal(Database& database) {
+    return database.Execute(kDropJournalTriggers);
+}
+
+bool ResumeChangeJournal(Database& database) {
+    return database.Execute(kDropJournalTriggers) && database.Execute(kCreateJournalTriggers);
+}
+
+bool SuspendRollups(Database& database) {
+    return database.Execute(kDropRollupTriggers);
+}
+
+bool ResumeRollups(Database& database) {
+    return RebuildRollups(database) && CreateRollupTriggers(database);
+}
+
+bool RestoreItemIndexes(Database& database) {
+    if (!database.Execute(kCreateKeyIndexes) || !database.Execute(kCreateListingIndexes) ||
+        !database.Execute(kCreateKeyedRollupIndexes) || !database.Execute("ANALYZE") ||
+        !ResumeRollups(database)) {
+        return false;
+    }
+    if (!TrigramIndexAvailable(database)) {
+        return true;
+    }
+    return database.Execute(kDropTrigramTriggers) && database.Execute(kCreateTrigramTriggers) &&
+           database.Execute(kRebuildTrigramTable);
+}
+
+}  // namespace inventory
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "database.h"
+
+namespace inventory {
+
+// Version stored in PRAGMA user_version once every migration has run.
+constexpr int kSchemaVersion = 10;
+
+// Returns PRAGMA user_version, or -1 when it cannot be read.
+int SchemaVersion(Database& database);
+
+// Upgrades the database in place to kSchemaVersion, one migration per
+// transaction. A new database goes through every step. Fails on databases
+// written by a newer build.
+bool EnsureSchema(Database& database);
+
+// True when items_fts exists, i.e. SearchMode::kTrigramIndex can be used.
+bool TrigramIndexAvailable(Database& database);
+
+// Drops the items_fts and rollup triggers and the indexes on items, so that a
+// bulk load writes the table alone. RestoreItemIndexes creates them again and
+// rebuilds items_fts and the rollups from the table, which is far cheaper
+// than indexing row by row.
+// Searches miss the loaded rows in between, so nobody else may be writing.
+bool SuspendItemIndexes(Database& database);
+bool RestoreItemIndexes(Database& database);
+
+// Drops the item_journal triggers and creates them again. Changes made in
+// between are missing from the journal, so undo and point-in-time views are
+// wrong across them; the benchmarks use this to measure what journaling
+// costs.
+bool SuspendChangeJournal(Database& database);
+bool ResumeChangeJournal(Database& database);
+
+// Drops the rollup triggers; ResumeRollups rebuilds the rollups from the
+// table and creates the triggers again, in the caller's transaction. Reports
+// read stale totals in between; the benchmarks use this to measure what the
+// rollups cost.
+bool SuspendRollups(Database& database);
+bool ResumeRollups(Database& database);
+
+}  // namespace inventory
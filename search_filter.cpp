@@ -0,0 +1,227 @@
+#include "search_filter.h"
+
+#include <algorithm>
+
+#include "item_keys.h"
+#include "like_match.h"
+
+namespace inventory {
+namespace {
+
+struct TextField {
+    unsigned bit;
+    const char* condition;
+    // Null for fields that are never an identifier.
+    const char* exact_condition;
+    std::string SearchFilter::*value;
+};
+
+constexpr TextField kTextFields[] = {
+    {kFilterName, "name LIKE ?", nullptr, &SearchFilter::name},
+    {kFilterPartNumber, "part_number LIKE ?", "part_key = ?", &SearchFilter::part_number},
+    {kFilterNsn, "nsn LIKE ?", "nsn_key = ?", &SearchFilter::nsn},
+    {kFilterSerialNumber, "serial_number LIKE ?", "serial_key = ?", &SearchFilter::serial_number},
+};
+
+std::string_view WithoutPrefix(const std::string& term) {
+    std::string_view view = term;
+    if (!view.empty() && view.front() == kExactTermPrefix) {
+        view.remove_prefix(1);
+    }
+    return view;
+}
+
+// A complete NSN, with or without the prefix.
+bool ExactNsn(const std::string& term, int64_t& key) {
+    return ParseNsn(WithoutPrefix(term), key);
+}
+
+// A prefixed term with something left to compare once normalized.
+bool ExactIdentifier(const std::string& term, std::string& key) {
+    if (term.empty() || term.front() != kExactTermPrefix) {
+        return false;
+    }
+    key = IdentifierKey(WithoutPrefix(term));
+    return !key.empty();
+}
+
+bool IsExact(unsigned bit, const std::string& term) {
+    int64_t nsn_key = 0;
+    std::string key;
+    switch (bit) {
+        case kFilterNsn:
+            return ExactNsn(term, nsn_key);
+        case kFilterPartNumber:
+        case kFilterSerialNumber:
+            return ExactIdentifier(term, key);
+        default:
+            return false;
+    }
+}
+
+// The longest run of characters in |term| without LIKE wildcards. Runs
+// shorter than kTrigramMinTerm find no rows at all in an FTS5 trigram index.
+size_t LiteralRun(const std::string& term) {
+    size_t longest = 0;
+    size_t run = 0;
+    for (unsigned char c : term) {
+        if (c == '%' || c == '_') {
+            run = 0;
+        } else if ((c & 0xC0) != 0x80) {
+            longest = std::max(longest, ++run);
+        }
+    }
+    return longest;
+}
+
+void BindPattern(sqlite3_stmt* statement, int index, const std::string& value) {
+    std::string pattern = "%" + value + "%";
+    sqlite3_bind_text(statement, index, pattern.c_str(), static_cast<int>(pattern.size()),
+                      SQLITE_TRANSIENT);
+}
+
+}  // namespace
+
+unsigned SearchFilter::Mask() const {
+    unsigned mask = 0;
+    for (const auto& field : kTextFields) {
+        if (!(this->*field.value).empty()) {
+            mask |= field.bit;
+        }
+    }
+    if (has_quantity) {
+        mask |= kFilterQuantity;
+    }
+    return mask;
+}
+
+unsigned SearchFilter::IndexedMask() const {
+    if (mode != SearchMode::kTrigramIndex) {
+        return 0;
+    }
+    const unsigned exact = ExactMask();
+    unsigned mask = 0;
+    unsigned selective = 0;
+    int terms = 0;
+    for (const auto& field : kTextFields) {
+        const size_t run = exact & field.bit ? 0 : LiteralRun(this->*field.value);
+        if (run >= kTrigramMinTerm) {
+            mask |= field.bit;
+            ++terms;
+            if (run >= kTrigramSelectiveTerm) {
+                selective |= field.bit;
+            }
+        }
+    }
+    return terms >= 2 ? mask : selective;
+}
+
+unsigned SearchFilter::ExactMask() const {
+    unsigned mask = 0;
+    for (const auto& field : kTextFields) {
+        if (IsExact(field.bit, this->*field.value)) {
+            mask |= field.bit;
+        }
+    }
+    return mask;
+}
+
+TermMatcher::TermMatcher(FilterField field, const std::string& term) {
+    if (term.empty()) {
+        return;
+    }
+    if (field == kFilterNsn && ExactNsn(term, nsn_key_)) {
+        kind_ = Kind::kNsn;
+    } else if ((field == kFilterPartNumber || field == kFilterSerialNumber) &&
+               ExactIdentifier(term, term_)) {
+        kind_ = Kind::kIdentifier;
+    } else {
+        kind_ = Kind::kContains;
+        term_ = term;
+    }
+}
+
+bool TermMatcher::Matches(std::string_view value) const {
+    int64_t key = 0;
+    switch (kind_) {
+        case Kind::kAll:
+            return true;
+        case Kind::kContains:
+            return LikeContains(term_, value);
+        case Kind::kNsn:
+            return ParseNsn(value, key) && key == nsn_key_;
+        case Kind::kIdentifier:
+            return IdentifierKeyEquals(value, term_);
+    }
+    return false;
+}
+
+void AppendFilterConditions(const SearchFilter& filter, std::string& sql, const char* extra) {
+    const unsigned mask = filter.Mask();
+    const unsigned indexed = filter.IndexedMask();
+    const unsigned exact = filter.ExactMask();
+    bool first = true;
+    auto append = [&](const char* condition) {
+        sql += first ? " WHERE " : " AND ";
+        sql += condition;
+        first = false;
+    };
+    // The trigram index only narrows the candidate rows. The plain LIKE is
+    // still applied to them so results match a scan exactly.
+    if (indexed) {
+        std::string lookup;
+        for (const auto& field : kTextFields) {
+            if (indexed & field.bit) {
+                lookup += lookup.empty() ? "id IN (SELECT rowid FROM items_fts WHERE "
+                                         : " AND ";
+                lookup += field.condition;
+            }
+        }
+        lookup += ")";
+        append(lookup.c_str());
+    }
+    for (const auto& field : kTextFields) {
+        if (mask & field.bit) {
+            append(exact & field.bit ? field.exact_condition : field.condition);
+        }
+    }
+    if (mask & kFilterQuantity) {
+        append("quantity = ?");
+    }
+    if (extra) {
+        append(extra);
+    }
+}
+
+int BindFilter(sqlite3_stmt* statement, const SearchFilter& filter, int index) {
+    const unsigned indexed = filter.IndexedMask();
+    const unsigned exact = filter.ExactMask();
+    for (const auto& field : kTextFields) {
+        if (indexed & field.bit) {
+            BindPattern(statement, index++, filter.*field.value);
+        }
+    }
+    for (const auto& field : kTextFields) {
+        const std::string& value = filter.*field.value;
+        int64_t nsn_key = 0;
+        std::string key;
+        if (value.empty()) {
+            continue;
+        }
+        if (!(exact & field.bit)) {
+            BindPattern(statement, index++, value);
+        } else if (field.bit == kFilterNsn && ExactNsn(value, nsn_key)) {
+            sqlite3_bind_int64(statement, index++, nsn_key);
+        } else {
+            ExactIdentifier(value, key);
+            sqlite3_bind_text(statement, index++, key.data(), static_cast<int>(key.size()),
+                              SQLITE_TRANSIENT);
+        }
+    }
+    if (filter.has_quantity) {
+        sqlite3_bind_int(statement, index++, filter.quantity);
+    }
+    return index;
+}
+
+}  // namespace inventory
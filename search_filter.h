@@ -0,0 +1,108 @@
+#pragma once
+
+#include <sqlite3.h>
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace inventory {
+
+enum FilterField : unsigned {
+    kFilterName = 1u << 0,
+    kFilterPartNumber = 1u << 1,
+    kFilterNsn = 1u << 2,
+    kFilterSerialNumber = 1u << 3,
+    kFilterQuantity = 1u << 4,
+};
+
+constexpr unsigned kFilterShapeCount = 1u << 5;
+
+// Terms without this many consecutive non-wildcard characters cannot be
+// looked up in a trigram index and are always scanned.
+constexpr size_t kTrigramMinTerm = 3;
+
+// A lone term goes to the trigram index only with a run at least this long,
+// such as a pasted identifier. Shorter terms are mostly common, and reading
+// their trigrams' row lists costs more than scanning; two or more terms are
+// looked up together, and the intersection of their lists is what pays.
+constexpr size_t kTrigramSelectiveTerm = 8;
+
+enum class SearchMode {
+    kScan,
+    kTrigramIndex,
+};
+
+// A part or serial number term starting with this character is a whole
+// identifier: it matches values with the same IdentifierKey instead of every
+// value that contains it. A complete NSN needs no prefix.
+constexpr char kExactTermPrefix = '=';
+
+// Statement-cache shape ids for search queries: one slot per query kind and
+// SearchFilter::Shape(). Scan searches use at most kFilterShapeCount plans per
+// kind; trigram searches add one bit per text field that goes to the index,
+// and exact identifiers one bit per field looked up by key.
+enum SearchQuery : unsigned {
+    kSearchCount = 0,
+    kSearchPageForward,
+    kSearchPageForwardKeyed,
+    kSearchPageBackward,
+    kSearchPageBackwardKeyed,
+    kSearchLive,
+};
+
+constexpr uint32_t kSearchShapeStride = kFilterShapeCount * 16 * 16;
+
+constexpr uint32_t SearchShape(SearchQuery query, unsigned shape) {
+    return static_cast<uint32_t>(query) * kSearchShapeStride + shape;
+}
+
+// The five search fields of the main window, as UTF-8. Empty text fields and
+// has_quantity == false are not part of the search.
+struct SearchFilter {
+    std::string name;
+    std::string part_number;
+    std::string nsn;
+    std::string serial_number;
+    bool has_quantity = false;
+    int quantity = 0;
+    SearchMode mode = SearchMode::kScan;
+
+    unsigned Mask() const;
+    // Text fields whose term is narrowed through items_fts before the LIKE:
+    // none unless the mode is kTrigramIndex, and then only where the index
+    // beats a scan (see kTrigramSelectiveTerm).
+    unsigned IndexedMask() const;
+    // Text fields holding a whole identifier, matched on its key column
+    // through an index; these never go to items_fts.
+    unsigned ExactMask() const;
+    unsigned Shape() const { return Mask() | IndexedMask() << 5 | ExactMask() << 9; }
+};
+
+// One text term of a SearchFilter evaluated in memory, with the same result
+// as the SQL condition AppendFilterConditions writes for it.
+class TermMatcher {
+public:
+    TermMatcher(FilterField field, const std::string& term);
+
+    bool Matches(std::string_view value) const;
+
+private:
+    enum class Kind { kAll, kContains, kNsn, kIdentifier };
+
+    Kind kind_ = Kind::kAll;
+    std::string term_;
+    int64_t nsn_key_ = 0;
+};
+
+// Appends " WHERE ..." for |filter|, followed by |extra| when it is non-null.
+// Nothing is appended when there is no condition at all. Only the shape of
+// |filter| is used, never its values.
+void AppendFilterConditions(const SearchFilter& filter, std::string& sql,
+                            const char* extra = nullptr);
+
+// Binds the parameters written by AppendFilterConditions starting at |index|.
+// Returns the next free parameter index.
+int BindFilter(sqlite3_stmt* statement, const SearchFilter& filter, int index);
+
+}  // namespace inventory
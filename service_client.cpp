@@ -0,0 +1,172 @@
+#include "service_client.h"
+
+#include <future>
+#include <utility>
+
+namespace inventory {
+
+bool ServiceClient::Connect(const std::string& address, std::string& error) {
+    Close();
+    socket_ = ConnectSocket(address, error);
+    if (socket_ == kNoSocket) {
+        return false;
+    }
+    connected_.store(true, std::memory_order_release);
+    receiver_ = std::thread(&ServiceClient::Receive, this);
+    return true;
+}
+
+void ServiceClient::Close() {
+    if (receiver_.joinable()) {
+        ShutdownSocket(socket_);
+        receiver_.join();
+    }
+    CloseSocket(socket_);
+    socket_ = kNoSocket;
+    connected_.store(false, std::memory_order_release);
+}
+
+bool ServiceClient::Post(ServiceRequest request, Callback done) {
+    {
+        // Checked under the lock that FailPending takes, so a request is
+        // either failed by it or refused here.
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!connected()) {
+            last_error_ = "not connected to the inventory service";
+            return false;
+        }
+        request.id = next_id_++;
+        pending_[request.id] = std::move(done);
+    }
+    std::string frame;
+    EncodeRequest(request, frame);
+    bool sent;
+    {
+        std::lock_guard<std::mutex> lock(send_mutex_);
+        sent = SendAll(socket_, frame.data(), frame.size());
+    }
+    if (!sent) {
+        // The receive thread may already have failed it along with the rest.
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (pending_.erase(request.id) == 0) {
+            return true;
+        }
+        last_error_ = "lost the connection to the inventory service";
+        return false;
+    }
+    return true;
+}
+
+bool ServiceClient::Call(ServiceRequest request, ServiceResponse& response) {
+    std::promise<void> answered;
+    std::future<void> wait = answered.get_future();
+    if (!Post(std::move(request), [&](ServiceResponse& received) {
+            response = std::move(received);
+            answered.set_value();
+        })) {
+        return false;
+    }
+    wait.get();
+    return response.status == ServiceStatus::kOk;
+}
+
+bool ServiceClient::Ping() {
+    ServiceRequest request;
+    request.op = ServiceOp::kPing;
+    ServiceResponse response;
+    return Call(std::move(request), response);
+}
+
+bool ServiceClient::Count(const SearchFilter& filter, sqlite3_int64& count) {
+    ServiceRequest request;
+    request.op = ServiceOp::kCount;
+    request.filter = filter;
+    ServiceResponse response;
+    if (!Call(std::move(request), response)) {
+        return false;
+    }
+    count = response.value;
+    return true;
+}
+
+bool ServiceClient::Page(const SearchFilter& filter, PageDirection direction,
+                         const PageKey* after, sqlite3_int64 limit, sqlite3_int64 offset,
+                         std::vector<ServiceRow>& rows) {
+    ServiceRequest request;
+    request.op = ServiceOp::kPage;
+    request.filter = filter;
+    request.direction = direction;
+    request.keyed = after != nullptr;
+    if (after) {
+        request.after = *after;
+    }
+    request.limit = limit;
+    request.offset = offset;
+    ServiceResponse response;
+    if (!Call(std::move(request), response)) {
+        return false;
+    }
+    rows = std::move(response.rows);
+    return true;
+}
+
+bool ServiceClient::Load(sqlite3_int64 id, ServiceRow& row) {
+    ServiceRequest request;
+    request.op = ServiceOp::kLoad;
+    request.item_id = id;
+    ServiceResponse response;
+    if (!Call(std::move(request), response) || response.rows.size() != 1) {
+        return false;
+    }
+    row = std::move(response.rows.front());
+    return true;
+}
+
+std::string ServiceClient::last_error() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return last_error_;
+}
+
+void ServiceClient::Receive() {
+    std::string body;
+    ServiceResponse response;
+    while (ReceiveFrame(socket_, body)) {
+        if (!DecodeResponse(body, response)) {
+            break;
+        }
+        Callback done;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto found = pending_.find(response.id);
+            if (found == pending_.end()) {
+                continue;
+            }
+            done = std::move(found->second);
+            pending_.erase(found);
+            if (response.status != ServiceStatus::kOk) {
+                last_error_ = response.error;
+            }
+        }
+        done(response);
+    }
+    FailPending("lost the connection to the inventory service");
+}
+
+void ServiceClient::FailPending(const std::string& reason) {
+    std::unordered_map<uint32_t, Callback> pending;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        connected_.store(false, std::memory_order_release);
+        pending.swap(pending_);
+        last_error_ = reason;
+    }
+    for (auto& [id, done] : pending) {
+        ServiceResponse response;
+        response.id = id;
+        response.status = ServiceStatus::kFailed;
+        response.error = reason;
+        done(response);
+    }
+}
+
+}  // namespace inventory
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "item_pager.h"
+#include "items.h"
+#include "search_filter.h"
+#include "service_protocol.h"
+
+namespace inventory {
+
+// One connection to an InventoryService. Requests are pipelined: Post sends
+// without waiting and a receive thread matches each response to its request
+// by id. The blocking calls below are Post plus a wait, and may be used from
+// several threads at once.
+class ServiceClient {
+public:
+    using Callback = std::function<void(ServiceResponse& response)>;
+
+    ServiceClient() = default;
+    ~ServiceClient() { Close(); }
+
+    ServiceClient(const ServiceClient&) = delete;
+    ServiceClient& operator=(const ServiceClient&) = delete;
+
+    bool Connect(const std::string& address, std::string& error);
+    // Fails every request still waiting for its response.
+    void Close();
+    bool connected() const { return connected_.load(std::memory_order_acquire); }
+
+    // Assigns |request| an id and sends it. |done| runs on the receive
+    // thread, also with kFailed when the connection is lost first. Returns
+    // false, without calling |done|, when the request could not be sent.
+    bool Post(ServiceRequest request, Callback done);
+    bool Call(ServiceRequest request, ServiceResponse& response);
+
+    bool Ping();
+    bool Count(const SearchFilter& filter, sqlite3_int64& count);
+    bool Page(const SearchFilter& filter, PageDirection direction, const PageKey* after,
+              sqlite3_int64 limit, sqlite3_int64 offset, std::vector<ServiceRow>& rows);
+    bool Load(sqlite3_int64 id, ServiceRow& row);
+
+    // Why the most recent request failed, as set before its callback runs.
+    std::string last_error() const;
+
+private:
+    void Receive();
+    void FailPending(const std::string& reason);
+
+    SocketHandle socket_ = kNoSocket;
+    std::thread receiver_;
+    std::atomic<bool> connected_{false};
+    std::mutex send_mutex_;
+    mutable std::mutex mutex_;
+    uint32_t next_id_ = 1;
+    std::unordered_map<uint32_t, Callback> pending_;
+    std::string last_error_;
+};
+
+}  // namespace inventory
@@ -0,0 +1,580 @@
+#include "service_protocol.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <mutex>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace inventory {
+namespace {
+
+// Columns of kItemSelectColumns.
+constexpr int kIdColumn = 0;
+constexpr int kQuantityColumn = 5;
+constexpr int kCreatedAtColumn = 6;
+
+constexpr uint8_t kHasQuantity = 1;
+constexpr uint8_t kTrigramMode = 2;
+
+class WireWriter {
+public:
+    explicit WireWriter(std::string& out) : out_(out), start_(out.size()) {
+        out_.append(4, '\0');
+    }
+
+    // Fills in the length reserved by the constructor.
+    void Finish() {
+        PutFixed32(static_cast<uint32_t>(out_.size() - start_ - 4), start_);
+    }
+
+    void PutFixed32(uint32_t value) {
+        out_.append(4, '\0');
+        PutFixed32(value, out_.size() - 4);
+    }
+    void PutByte(uint8_t value) { out_ += static_cast<char>(value); }
+    void PutVarint(uint64_t value) {
+        while (value >= 0x80) {
+            out_ += static_cast<char>(value | 0x80);
+            value >>= 7;
+        }
+        out_ += static_cast<char>(value);
+    }
+    void PutSigned(int64_t value) {
+        PutVarint((static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63));
+    }
+    void PutString(std::string_view value) {
+        PutVarint(value.size());
+        out_.append(value.data(), value.size());
+    }
+
+private:
+    void PutFixed32(uint32_t value, size_t at) {
+        for (int i = 0; i < 4; ++i) {
+            out_[at + static_cast<size_t>(i)] = static_cast<char>(value >> (8 * i));
+        }
+    }
+
+    std::string& out_;
+    size_t start_;
+};
+
+// Every getter fails once the input has run out, so a decoder can read all
+// its fields and check ok() once.
+class WireReader {
+public:
+    explicit WireReader(std::string_view in) : in_(in) {}
+
+    bool ok() const { return ok_; }
+    bool done() const { return ok_ && in_.empty(); }
+
+    uint32_t Fixed32() {
+        if (in_.size() < 4) {
+            return Fail();
+        }
+        uint32_t value = 0;
+        for (size_t i = 0; i < 4; ++i) {
+            value |= static_cast<uint32_t>(static_cast<unsigned char>(in_[i])) << (8 * i);
+        }
+        in_.remove_prefix(4);
+        return value;
+    }
+    uint8_t Byte() {
+        if (in_.empty()) {
+            return Fail();
+        }
+        const auto value = static_cast<uint8_t>(in_.front());
+        in_.remove_prefix(1);
+        return value;
+    }
+    uint64_t Varint() {
+        uint64_t value = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            const uint8_t byte = Byte();
+            value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+            if (!(byte & 0x80)) {
+                return value;
+            }
+        }
+        return Fail();
+    }
+    int64_t Signed() {
+        const uint64_t value = Varint();
+        return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+    }
+    int Int() {
+        const int64_t value = Signed();
+        if (value < INT32_MIN || value > INT32_MAX) {
+            return Fail();
+        }
+        return static_cast<int>(value);
+    }
+    void String(std::string& out) {
+        const uint64_t size = Varint();
+        if (size > in_.size()) {
+            Fail();
+            out.clear();
+            return;
+        }
+        out.assign(in_.data(), static_cast<size_t>(size));
+        in_.remove_prefix(static_cast<size_t>(size));
+    }
+
+private:
+    uint8_t Fail() {
+        ok_ = false;
+        in_ = {};
+        return 0;
+    }
+
+    std::string_view in_;
+    bool ok_ = true;
+};
+
+void PutFilter(WireWriter& out, const SearchFilter& filter) {
+    out.PutString(filter.name);
+    out.PutString(filter.part_number);
+    out.PutString(filter.nsn);
+    out.PutString(filter.serial_number);
+    out.PutByte(static_cast<uint8_t>((filter.has_quantity ? kHasQuantity : 0) |
+                                     (filter.mode == SearchMode::kTrigramIndex ? kTrigramMode
+                                                                               : 0)));
+    if (filter.has_quantity) {
+        out.PutSigned(filter.quantity);
+    }
+}
+
+void GetFilter(WireReader& in, SearchFilter& filter) {
+    in.String(filter.name);
+    in.String(filter.part_number);
+    in.String(filter.nsn);
+    in.String(filter.serial_number);
+    const uint8_t flags = in.Byte();
+    filter.has_quantity = (flags & kHasQuantity) != 0;
+    filter.mode = flags & kTrigramMode ? SearchMode::kTrigramIndex : SearchMode::kScan;
+    filter.quantity = filter.has_quantity ? in.Int() : 0;
+}
+
+void PutItemFields(WireWriter& out, const Item& item) {
+    out.PutString(item.name);
+    out.PutString(item.part_number);
+    out.PutString(item.nsn);
+    out.PutString(item.serial_number);
+    out.PutSigned(item.quantity);
+}
+
+void GetItemFields(WireReader& in, Item& item) {
+    in.String(item.name);
+    in.String(item.part_number);
+    in.String(item.nsn);
+    in.String(item.serial_number);
+    item.quantity = in.Int();
+}
+
+std::string ColumnString(sqlite3_stmt* statement, int column) {
+    const unsigned char* value = sqlite3_column_text(statement, column);
+    return std::string(value ? reinterpret_cast<const char*>(value) : "",
+                       static_cast<size_t>(sqlite3_column_bytes(statement, column)));
+}
+
+void InitSockets() {
+#ifdef _WIN32
+    static std::once_flag once;
+    std::call_once(once, [] {
+        WSADATA data;
+        WSAStartup(MAKEWORD(2, 2), &data);
+    });
+#endif
+}
+
+std::string SocketError(const char* what) {
+#ifdef _WIN32
+    return std::string(what) + " failed (" + std::to_string(WSAGetLastError()) + ")";
+#else
+    return std::string(what) + " failed: " + std::strerror(errno);
+#endif
+}
+
+// Splits "host:port"; an empty host is the wildcard when listening and
+// localhost when connecting.
+bool ResolveTcp(const std::string& address, bool listening, addrinfo** found,
+                std::string& error) {
+    const size_t colon = address.rfind(':');
+    if (colon == std::string::npos || colon + 1 == address.size()) {
+        error = "expected host:port or unix:path, got \"" + address + "\"";
+        return false;
+    }
+    const std::string host = address.substr(0, colon);
+    const std::string port = address.substr(colon + 1);
+    addrinfo hints = {};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = listening ? AI_PASSIVE : 0;
+    const char* node = host.empty() ? (listening ? nullptr : "localhost") : host.c_str();
+    const int result = getaddrinfo(node, port.c_str(), &hints, found);
+    if (result != 0) {
+        error = "cannot resolve " + address + ": " + gai_strerror(result);
+        return false;
+    }
+    return true;
+}
+
+void SetNoDelay(SocketHandle socket) {
+    // Pipelined requests are small; do not hold them back for a full segment.
+    int enable = 1;
+    setsockopt(socket, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&enable),
+               sizeof(enable));
+}
+
+bool ReceiveAll(SocketHandle socket, char* data, size_t size) {
+    while (size > 0) {
+#ifdef _WIN32
+        const int received =
+            recv(socket, data, static_cast<int>(std::min<size_t>(size, 1 << 30)), 0);
+#else
+        const ssize_t received = recv(socket, data, size, 0);
+        if (received < 0 && errno == EINTR) {
+            continue;
+        }
+#endif
+        if (received <= 0) {
+            return false;
+        }
+        data += received;
+        size -= static_cast<size_t>(received);
+    }
+    return true;
+}
+
+#ifndef _WIN32
+constexpr char kUnixPrefix[] = "unix:";
+
+bool UnixAddress(const std::string& address, sockaddr_un& out, std::string& error) {
+    const std::string path = address.substr(sizeof(kUnixPrefix) - 1);
+    out = {};
+    out.sun_family = AF_UNIX;
+    if (path.empty() || path.size() >= sizeof(out.sun_path)) {
+        error = "bad unix socket path \"" + path + "\"";
+        return false;
+    }
+    std::memcpy(out.sun_path, path.c_str(), path.size() + 1);
+    return true;
+}
+
+bool IsUnixAddress(const std::string& address) {
+    return address.compare(0, sizeof(kUnixPrefix) - 1, kUnixPrefix) == 0;
+}
+#endif
+
+}  // namespace
+
+void EncodeRequest(const ServiceRequest& request, std::string& frame) {
+    WireWriter out(frame);
+    out.PutFixed32(request.id);
+    out.PutByte(static_cast<uint8_t>(request.op));
+    switch (request.op) {
+        case ServiceOp::kCount:
+            PutFilter(out, request.filter);
+            break;
+        case ServiceOp::kPage:
+            PutFilter(out, request.filter);
+            out.PutByte(request.direction == PageDirection::kNewer ? 1 : 0);
+            out.PutByte(request.keyed ? 1 : 0);
+            if (request.keyed) {
+                out.PutString(request.after.created_at);
+                out.PutSigned(request.after.id);
+            }
+            out.PutVarint(static_cast<uint64_t>(request.limit));
+            out.PutVarint(static_cast<uint64_t>(request.offset));
+            break;
+        case ServiceOp::kLoad:
+        case ServiceOp::kDelete:
+            out.PutSigned(request.item_id);
+            break;
+        case ServiceOp::kInsert:
+            PutItemFields(out, request.item);
+            break;
+        case ServiceOp::kUpdate:
+            out.PutSigned(request.item.id);
+            PutItemFields(out, request.item);
+            out.PutSigned(request.delta);
+            break;
+        default:
+            break;
+    }
+    out.Finish();
+}
+
+bool DecodeRequest(std::string_view body, ServiceRequest& request) {
+    WireReader in(body);
+    request = ServiceRequest();
+    request.id = in.Fixed32();
+    const uint8_t op = in.Byte();
+    if (op >= static_cast<uint8_t>(ServiceOp::kOpCount)) {
+        return false;
+    }
+    request.op = static_cast<ServiceOp>(op);
+    switch (request.op) {
+        case ServiceOp::kCount:
+            GetFilter(in, request.filter);
+            break;
+        case ServiceOp::kPage:
+            GetFilter(in, request.filter);
+            request.direction = in.Byte() ? PageDirection::kNewer : PageDirection::kOlder;
+            request.keyed = in.Byte() != 0;
+            if (request.keyed) {
+                in.String(request.after.created_at);
+                request.after.id = in.Signed();
+            }
+            request.limit = static_cast<sqlite3_int64>(in.Varint());
+            request.offset = static_cast<sqlite3_int64>(in.Varint());
+            if (request.limit < 0 || request.offset < 0) {
+                return false;
+            }
+            break;
+        case ServiceOp::kLoad:
+        case ServiceOp::kDelete:
+            request.item_id = in.Signed();
+            break;
+        case ServiceOp::kInsert:
+            GetItemFields(in, request.item);
+            break;
+        case ServiceOp::kUpdate:
+            request.item.id = in.Signed();
+            GetItemFields(in, request.item);
+            request.delta = in.Int();
+            break;
+        default:
+            break;
+    }
+    return in.done();
+}
+
+void EncodeResponse(const ServiceResponse& response, std::string& frame) {
+    WireWriter out(frame);
+    out.PutFixed32(response.id);
+    out.PutByte(static_cast<uint8_t>(response.status));
+    out.PutString(response.error);
+    out.PutSigned(response.value);
+    out.PutVarint(response.rows.size());
+    for (const ServiceRow& row : response.rows) {
+        out.PutSigned(row.item.id);
+        PutItemFields(out, row.item);
+        out.PutString(row.created_at);
+    }
+    out.Finish();
+}
+
+bool DecodeResponse(std::string_view body, ServiceResponse& response) {
+    WireReader in(body);
+    response.id = in.Fixed32();
+    const uint8_t status = in.Byte();
+    if (status > static_cast<uint8_t>(ServiceStatus::kBadRequest)) {
+        return false;
+    }
+    response.status = static_cast<ServiceStatus>(status);
+    in.String(response.error);
+    response.value = in.Signed();
+    const uint64_t count = in.Varint();
+    // Every row takes at least seven bytes, which bounds the allocation.
+    if (count > body.size() / 7) {
+        return false;
+    }
+    response.rows.resize(static_cast<size_t>(count));
+    for (ServiceRow& row : response.rows) {
+        row.item.id = in.Signed();
+        GetItemFields(in, row.item);
+        in.String(row.created_at);
+    }
+    return in.done();
+}
+
+void ReadServiceRow(sqlite3_stmt* statement, ServiceRow& row) {
+    row.item.id = sqlite3_column_int64(statement, kIdColumn);
+    row.item.name = ColumnString(statement, 1);
+    row.item.part_number = ColumnString(statement, 2);
+    row.item.nsn = ColumnString(statement, 3);
+    row.item.serial_number = ColumnString(statement, 4);
+    row.item.quantity = sqlite3_column_int(statement, kQuantityColumn);
+    row.created_at = ColumnString(statement, kCreatedAtColumn);
+}
+
+SocketHandle ListenSocket(const std::string& address, std::string& error) {
+    InitSockets();
+#ifndef _WIN32
+    if (IsUnixAddress(address)) {
+        sockaddr_un local;
+        if (!UnixAddress(address, local, error)) {
+            return kNoSocket;
+        }
+        // A socket file left by a previous run would make bind fail.
+        unlink(local.sun_path);
+        const SocketHandle listener = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (listener == kNoSocket) {
+            error = SocketError("socket");
+            return kNoSocket;
+        }
+        if (bind(listener, reinterpret_cast<const sockaddr*>(&local), sizeof(local)) != 0 ||
+            listen(listener, SOMAXCONN) != 0) {
+            error = SocketError("bind");
+            CloseSocket(listener);
+            return kNoSocket;
+        }
+        return listener;
+    }
+#endif
+    addrinfo* found = nullptr;
+    if (!ResolveTcp(address, true, &found, error)) {
+        return kNoSocket;
+    }
+    SocketHandle listener = kNoSocket;
+    for (addrinfo* candidate = found; candidate; candidate = candidate->ai_next) {
+        listener = static_cast<SocketHandle>(
+            socket(candidate->ai_family, candidate->ai_socktype, candidate->ai_protocol));
+        if (listener == kNoSocket) {
+            continue;
+        }
+        int reuse = 1;
+        setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&reuse),
+                   sizeof(reuse));
+        if (bind(listener, candidate->ai_addr, static_cast<int>(candidate->ai_addrlen)) == 0 &&
+            listen(listener, SOMAXCONN) == 0) {
+            break;
+        }
+        error = SocketError("bind");
+        CloseSocket(listener);
+        listener = kNoSocket;
+    }
+    freeaddrinfo(found);
+    return listener;
+}
+
+SocketHandle ConnectSocket(const std::string& address, std::string& error) {
+    InitSockets();
+#ifndef _WIN32
+    if (IsUnixAddress(address)) {
+        sockaddr_un remote;
+        if (!UnixAddress(address, remote, error)) {
+            return kNoSocket;
+        }
+        const SocketHandle connection = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (connection == kNoSocket ||
+            connect(connection, reinterpret_cast<const sockaddr*>(&remote), sizeof(remote)) !=
+                0) {
+            error = SocketError("connect");
+            CloseSocket(connection);
+            return kNoSocket;
+        }
+        return connection;
+    }
+#endif
+    addrinfo* found = nullptr;
+    if (!ResolveTcp(address, false, &found, error)) {
+        return kNoSocket;
+    }
+    SocketHandle connection = kNoSocket;
+    for (addrinfo* candidate = found; candidate; candidate = candidate->ai_next) {
+        connection = static_cast<SocketHandle>(
+            socket(candidate->ai_family, candidate->ai_socktype, candidate->ai_protocol));
+        if (connection == kNoSocket) {
+            continue;
+        }
+        if (connect(connection, candidate->ai_addr, static_cast<int>(candidate->ai_addrlen)) ==
+            0) {
+            SetNoDelay(connection);
+            break;
+        }
+        error = SocketError("connect");
+        CloseSocket(connection);
+        connection = kNoSocket;
+    }
+    freeaddrinfo(found);
+    return connection;
+}
+
+SocketHandle AcceptSocket(SocketHandle listener) {
+    while (true) {
+        const auto connection = static_cast<SocketHandle>(accept(listener, nullptr, nullptr));
+        if (connection != kNoSocket) {
+            // Harmless on Unix sockets, where it just fails.
+            SetNoDelay(connection);
+            return connection;
+        }
+#ifndef _WIN32
+        if (errno == EINTR || errno == ECONNABORTED) {
+            continue;
+        }
+#endif
+        return kNoSocket;
+    }
+}
+
+void ShutdownSocket(SocketHandle socket) {
+    if (socket == kNoSocket) {
+        return;
+    }
+#ifdef _WIN32
+    shutdown(socket, SD_BOTH);
+#else
+    shutdown(socket, SHUT_RDWR);
+#endif
+}
+
+void CloseSocket(SocketHandle socket) {
+    if (socket == kNoSocket) {
+        return;
+    }
+#ifdef _WIN32
+    closesocket(socket);
+#else
+    close(socket);
+#endif
+}
+
+bool SendAll(SocketHandle socket, const char* data, size_t size) {
+    while (size > 0) {
+#ifdef _WIN32
+        const int sent = send(socket, data, static_cast<int>(std::min<size_t>(size, 1 << 30)), 0);
+#else
+        const ssize_t sent = send(socket, data, size, MSG_NOSIGNAL);
+        if (sent < 0 && errno == EINTR) {
+            continue;
+        }
+#endif
+        if (sent <= 0) {
+            return false;
+        }
+        data += sent;
+        size -= static_cast<size_t>(sent);
+    }
+    return true;
+}
+
+bool ReceiveFrame(SocketHandle socket, std::string& body) {
+    unsigned char header[4];
+    if (!ReceiveAll(socket, reinterpret_cast<char*>(header), sizeof(header))) {
+        return false;
+    }
+    const uint32_t size = static_cast<uint32_t>(header[0]) |
+                          static_cast<uint32_t>(header[1]) << 8 |
+                          static_cast<uint32_t>(header[2]) << 16 |
+                          static_cast<uint32_t>(header[3]) << 24;
+    if (size > kMaxFrameBytes) {
+        return false;
+    }
+    body.resize(size);
+    return ReceiveAll(socket, body.data(), size);
+}
+
+}  // namespace inventory
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <sqlite3.h>
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "item_pager.h"
+#include "items.h"
+#include "search_filter.h"
+
+namespace inventory {
+
+// The inventory service protocol. Every message is a frame: a 4-byte
+// little-endian body length, then the body. A request body is the request
+// id (4 bytes), the ServiceOp byte and its fields; a response body is the id
+// of the request it answers, the ServiceStatus byte and its fields. Integers
+// in the fields are LEB128 varints, signed ones zigzag-encoded first, and
+// strings a varint byte length followed by UTF-8.
+//
+// Clients may send any number of requests before reading a response
+// (pipelining). Responses to reads can overtake each other and the writes
+// sent before them; writes are applied and answered in the order they were
+// sent. A read sent after a write's response has arrived sees that write.
+constexpr uint32_t kMaxFrameBytes = 16u << 20;
+
+enum class ServiceOp : uint8_t {
+    kPing,
+    // filter -> count
+    kCount,
+    // filter, direction, keyed, after, limit, offset -> rows
+    kPage,
+    // item_id -> rows (one)
+    kLoad,
+    // item -> item_id
+    kInsert,
+    // item, delta: the text fields and a stock movement in one savepoint
+    kUpdate,
+    // item_id
+    kDelete,
+    kOpCount,
+};
+
+enum class ServiceStatus : uint8_t {
+    kOk,
+    kNotFound,
+    // error holds the reason.
+    kFailed,
+    // The frame could not be decoded; the server closes the connection.
+    kBadRequest,
+};
+
+struct ServiceRequest {
+    uint32_t id = 0;
+    ServiceOp op = ServiceOp::kPing;
+    SearchFilter filter;
+    PageDirection direction = PageDirection::kOlder;
+    bool keyed = false;
+    PageKey after;
+    sqlite3_int64 limit = 0;
+    sqlite3_int64 offset = 0;
+    Item item;
+    sqlite3_int64 item_id = 0;
+    int delta = 0;
+
+    bool IsWrite() const {
+        return op == ServiceOp::kInsert || op == ServiceOp::kUpdate || op == ServiceOp::kDelete;
+    }
+};
+
+// One kItemSelectColumns row; created_at exactly as stored, so that it can
+// be sent back as a PageKey.
+struct ServiceRow {
+    Item item;
+    std::string created_at;
+};
+
+struct ServiceResponse {
+    uint32_t id = 0;
+    ServiceStatus status = ServiceStatus::kOk;
+    std::string error;
+    // kCount: the count. kInsert: the new id.
+    sqlite3_int64 value = 0;
+    std::vector<ServiceRow> rows;
+};
+
+// Appends one whole frame, length included, to |frame|.
+void EncodeRequest(const ServiceRequest& request, std::string& frame);
+void EncodeResponse(const ServiceResponse& response, std::string& frame);
+// Decode a frame body; false when it is truncated, has bytes left over or
+// holds an unknown op or status.
+bool DecodeRequest(std::string_view body, ServiceRequest& request);
+bool DecodeResponse(std::string_view body, ServiceResponse& response);
+
+// Reads a kItemSelectColumns row into |row|.
+void ReadServiceRow(sqlite3_stmt* statement, ServiceRow& row);
+
+#ifdef _WIN32
+using SocketHandle = uintptr_t;
+#else
+using SocketHandle = int;
+#endif
+constexpr SocketHandle kNoSocket = static_cast<SocketHandle>(-1);
+
+// Addresses are "unix:/path/to/socket" (not on Windows), "host:port" or
+// ":port", which listens on every interface and connects to localhost.
+SocketHandle ListenSocket(const std::string& address, std::string& error);
+SocketHandle ConnectSocket(const std::string& address, std::string& error);
+// kNoSocket once the listening socket has been shut down.
+SocketHandle AcceptSocket(SocketHandle listener);
+// Wakes any thread blocked on the socket; CloseSocket then releases it.
+void ShutdownSocket(SocketHandle socket);
+void CloseSocket(SocketHandle socket);
+
+bool SendAll(SocketHandle socket, const char* data, size_t size);
+// Reads one frame body into |body|; false on end of stream, an error or a
+// frame larger than kMaxFrameBytes.
+bool ReceiveFrame(SocketHandle socket, std::string& body);
+
+}  // namespace inventory
@@ -0,0 +1,501 @@
+#include "snapshot.h"
+
+#include <algorithm>
+#include <thread>
+
+#include "metrics.h"
+#include "parallel_ranges.h"
+#include "result_set.h"
+
+namespace inventory {
+namespace {
+
+constexpr int kTextColumnIndex[] = {1, 2, 3, 4};
+constexpr int kQuantityColumn = 5;
+constexpr int kCreatedAtColumn = 6;
+
+std::string_view ColumnView(sqlite3_stmt* statement, int column) {
+    const unsigned char* text = sqlite3_column_text(statement, column);
+    if (!text) {
+        return {};
+    }
+    return {reinterpret_cast<const char*>(text),
+            static_cast<size_t>(sqlite3_column_bytes(statement, column))};
+}
+
+bool ReadDigits(std::string_view text, size_t position, size_t count, int& out) {
+    out = 0;
+    for (size_t i = position; i < position + count; ++i) {
+        if (text[i] < '0' || text[i] > '9') {
+            return false;
+        }
+        out = out * 10 + (text[i] - '0');
+    }
+    return true;
+}
+
+// Days since 1970-01-01 in the proleptic Gregorian calendar.
+int64_t DaysFromCivil(int year, int month, int day) {
+    year -= month <= 2;
+    const int64_t era = (year >= 0 ? year : year - 399) / 400;
+    const int64_t year_of_era = year - era * 400;
+    const int64_t day_of_year = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    const int64_t day_of_era =
+        year_of_era * 365 + year_of_era / 4 - year_of_era / 100 + day_of_year;
+    return era * 146097 + day_of_era - 719468;
+}
+
+int64_t CreatedMs(sqlite3_stmt* statement) {
+    int64_t created_ms = 0;
+    ParseTimestamp(ColumnView(statement, kCreatedAtColumn), created_ms);
+    return created_ms;
+}
+
+}  // namespace
+
+bool ParseTimestamp(std::string_view text, int64_t& out) {
+    if (text.size() != 19 && text.size() != 23) {
+        return false;
+    }
+    int year, month, day, hour, minute, second, millisecond = 0;
+    if (!ReadDigits(text, 0, 4, year) || text[4] != '-' || !ReadDigits(text, 5, 2, month) ||
+        text[7] != '-' || !ReadDigits(text, 8, 2, day) || (text[10] != ' ' && text[10] != 'T') ||
+        !ReadDigits(text, 11, 2, hour) || text[13] != ':' || !ReadDigits(text, 14, 2, minute) ||
+        text[16] != ':' || !ReadDigits(text, 17, 2, second)) {
+        return false;
+    }
+    if (text.size() == 23 && (text[19] != '.' || !ReadDigits(text, 20, 3, millisecond))) {
+        return false;
+    }
+    if (month < 1 || month > 12 || day < 1 || day > 31 || hour > 23 || minute > 59 ||
+        second > 59) {
+        return false;
+    }
+    const int64_t seconds =
+        DaysFromCivil(year, month, day) * 86400 + hour * 3600 + minute * 60 + second;
+    out = seconds * 1000 + millisecond;
+    return true;
+}
+
+uint32_t ItemSnapshot::Dictionary::Intern(std::string_view value) {
+    auto found = codes.find(value);
+    if (found != codes.end()) {
+        return found->second;
+    }
+    const auto code = static_cast<uint32_t>(values.size());
+    values.emplace_back(value);
+    codes.emplace(values.back(), code);
+    return code;
+}
+
+void ItemSnapshot::Dictionary::Clear() {
+    codes.clear();
+    values.clear();
+}
+
+ItemSnapshot::ItemSnapshot(const SnapshotOptions& options) : options_(options) {}
+
+void ItemSnapshot::Clear() {
+    for (int column = 0; column < kTextColumns; ++column) {
+        dictionaries_[column].Clear();
+        codes_[column].clear();
+    }
+    for (BigramIndex& index : fuzzy_indexes_) {
+        index.Clear();
+    }
+    ids_.clear();
+    quantities_.clear();
+    created_ms_.clear();
+    live_.clear();
+    positions_.clear();
+    live_rows_ = 0;
+    loaded_ = false;
+}
+
+bool ItemSnapshot::Load(Database& database) {
+    Clear();
+    sqlite3_int64 count = 0;
+    {
+        Statement statement = database.Prepare("SELECT COUNT(*) FROM items");
+        if (!statement || sqlite3_step(statement.get()) != SQLITE_ROW) {
+            return false;
+        }
+        count = sqlite3_column_int64(statement.get(), 0);
+    }
+    if (count > options_.max_rows) {
+        return false;
+    }
+
+    Statement statement =
+        database.Prepare(std::string(kItemSelectColumns) + " ORDER BY created_at, id");
+    if (!statement) {
+        return false;
+    }
+    const auto rows = static_cast<size_t>(count);
+    for (int column = 0; column < kTextColumns; ++column) {
+        codes_[column].reserve(rows);
+    }
+    ids_.reserve(rows);
+    quantities_.reserve(rows);
+    created_ms_.reserve(rows);
+    live_.reserve(rows);
+
+    int result;
+    while ((result = sqlite3_step(statement.get())) == SQLITE_ROW) {
+        Append(statement.get());
+    }
+    if (result != SQLITE_DONE) {
+        Clear();
+        return false;
+    }
+    RebuildPositions();
+    loaded_ = true;
+    return true;
+}
+
+void ItemSnapshot::Append(sqlite3_stmt* statement) {
+    for (int column = 0; column < kTextColumns; ++column) {
+        codes_[column].push_back(
+            dictionaries_[column].Intern(ColumnView(statement, kTextColumnIndex[column])));
+    }
+    ids_.push_back(sqlite3_column_int64(statement, 0));
+    quantities_.push_back(sqlite3_column_int(statement, kQuantityColumn));
+    created_ms_.push_back(CreatedMs(statement));
+    live_.push_back(1);
+    ++live_rows_;
+}
+
+void ItemSnapshot::Insert(size_t position, sqlite3_stmt* statement) {
+    if (position == ids_.size()) {
+        Append(statement);
+        positions_[ids_.back()] = position;
+        return;
+    }
+    // Only rows with an older created_at than the newest one land here, e.g.
+    // rows imported with explicit timestamps; it costs a shift of every column.
+    for (int column = 0; column < kTextColumns; ++column) {
+        codes_[column].insert(
+            codes_[column].begin() + static_cast<ptrdiff_t>(position),
+            dictionaries_[column].Intern(ColumnView(statement, kTextColumnIndex[column])));
+    }
+    const auto at = static_cast<ptrdiff_t>(position);
+    ids_.insert(ids_.begin() + at, sqlite3_column_int64(statement, 0));
+    quantities_.insert(quantities_.begin() + at, sqlite3_column_int(statement, kQuantityColumn));
+    created_ms_.insert(created_ms_.begin() + at, CreatedMs(statement));
+    live_.insert(live_.begin() + at, 1);
+    ++live_rows_;
+    RebuildPositions();
+}
+
+void ItemSnapshot::Assign(size_t position, sqlite3_stmt* statement) {
+    for (int column = 0; column < kTextColumns; ++column) {
+        codes_[column][position] =
+            dictionaries_[column].Intern(ColumnView(statement, kTextColumnIndex[column]));
+    }
+    quantities_[position] = sqlite3_column_int(statement, kQuantityColumn);
+}
+
+void ItemSnapshot::Erase(size_t position) {
+    live_[position] = 0;
+    --live_rows_;
+    positions_.erase(ids_[position]);
+    const size_t dead = ids_.size() - live_rows_;
+    if (dead > 1024 && dead > live_rows_ / 4) {
+        Compact();
+    }
+}
+
+// Drops deleted rows and the dictionary values only they used.
+void ItemSnapshot::Compact() {
+    size_t kept = 0;
+    for (int column = 0; column < kTextColumns; ++column) {
+        Dictionary compacted;
+        std::vector<uint32_t> remap(dictionaries_[column].values.size(), UINT32_MAX);
+        std::vector<uint32_t>& codes = codes_[column];
+        kept = 0;
+        for (size_t i = 0; i < codes.size(); ++i) {
+            if (!live_[i]) {
+                continue;
+            }
+            uint32_t& code = remap[codes[i]];
+            if (code == UINT32_MAX) {
+                code = compacted.Intern(dictionaries_[column].values[codes[i]]);
+            }
+            codes[kept++] = code;
+        }
+        codes.resize(kept);
+        dictionaries_[column] = std::move(compacted);
+    }
+    for (BigramIndex& index : fuzzy_indexes_) {
+        index.Clear();
+    }
+    kept = 0;
+    for (size_t i = 0; i < ids_.size(); ++i) {
+        if (live_[i]) {
+            ids_[kept] = ids_[i];
+            quantities_[kept] = quantities_[i];
+            created_ms_[kept] = created_ms_[i];
+            ++kept;
+        }
+    }
+    ids_.resize(kept);
+    quantities_.resize(kept);
+    created_ms_.resize(kept);
+    live_.assign(kept, 1);
+    RebuildPositions();
+}
+
+void ItemSnapshot::RebuildPositions() {
+    positions_.clear();
+    positions_.reserve(live_rows_);
+    for (size_t i = 0; i < ids_.size(); ++i) {
+        if (live_[i]) {
+            positions_[ids_[i]] = i;
+        }
+    }
+}
+
+size_t ItemSnapshot::LowerBound(const Key& key) const {
+    size_t first = 0;
+    size_t count = ids_.size();
+    while (count > 0) {
+        const size_t step = count / 2;
+        const size_t middle = first + step;
+        if (created_ms_[middle] < key.created_ms ||
+            (created_ms_[middle] == key.created_ms && ids_[middle] < key.id)) {
+            first = middle + 1;
+            count -= step + 1;
+        } else {
+            count = step;
+        }
+    }
+    return first;
+}
+
+bool ItemSnapshot::Sync(Database& database, sqlite3_int64 id) {
+    if (!loaded_) {
+        return false;
+    }
+    Statement statement = database.Prepare(std::string(kItemSelectColumns) + " WHERE id = ?");
+    if (!statement) {
+        return false;
+    }
+    sqlite3_bind_int64(statement.get(), 1, id);
+    const int result = sqlite3_step(statement.get());
+    auto found = positions_.find(id);
+    if (result == SQLITE_DONE) {
+        if (found != positions_.end()) {
+            Erase(found->second);
+        }
+        return true;
+    }
+    if (result != SQLITE_ROW) {
+        return false;
+    }
+
+    const Key key{CreatedMs(statement.get()), id};
+    if (found != positions_.end()) {
+        if (created_ms_[found->second] == key.created_ms) {
+            Assign(found->second, statement.get());
+            return true;
+        }
+        Erase(found->second);
+    }
+    Insert(LowerBound(key), statement.get());
+    return true;
+}
+
+size_t ItemSnapshot::ThreadCount(size_t size) const {
+    if (size < options_.parallel_min_rows) {
+        return 1;
+    }
+    size_t threads = options_.threads ? options_.threads : std::thread::hardware_concurrency();
+    // Keep every range big enough to be worth a thread.
+    const size_t by_size = size / std::max<size_t>(options_.parallel_min_rows / 4, 1);
+    return std::max<size_t>(std::min(threads, by_size), 1);
+}
+
+void ItemSnapshot::MatchValues(int column, const TermMatcher& matcher,
+                               std::vector<uint8_t>& match) const {
+    const std::deque<std::string>& values = dictionaries_[column].values;
+    match.resize(values.size());
+    ForEachRange(values.size(), ThreadCount(values.size()), [&](size_t first, size_t last, size_t) {
+        for (size_t v = first; v < last; ++v) {
+            match[v] = matcher.Matches(values[v]) ? 1 : 0;
+        }
+    });
+}
+
+void ItemSnapshot::Search(const SearchFilter& filter, std::vector<sqlite3_int64>& ids) const {
+    ScopedLatency latency(Metrics().operation(Operation::kSnapshotSearch));
+    ids.clear();
+    if (!loaded_) {
+        return;
+    }
+
+    // Evaluate each term once per distinct value of its column.
+    const std::string* terms[kTextColumns] = {&filter.name, &filter.part_number, &filter.nsn,
+                                              &filter.serial_number};
+    constexpr FilterField fields[kTextColumns] = {kFilterName, kFilterPartNumber, kFilterNsn,
+                                                  kFilterSerialNumber};
+    std::vector<uint8_t> matches[kTextColumns];
+    const uint8_t* active[kTextColumns];
+    const uint32_t* codes[kTextColumns];
+    int active_count = 0;
+    for (int column = 0; column < kTextColumns; ++column) {
+        if (terms[column]->empty()) {
+            continue;
+        }
+        MatchValues(column, TermMatcher(fields[column], *terms[column]), matches[column]);
+        active[active_count] = matches[column].data();
+        codes[active_count] = codes_[column].data();
+        ++active_count;
+    }
+
+    // Then scan the columns. Each range writes every candidate position and
+    // advances only past the ones that match, so the loop has no branches on
+    // the data.
+    const size_t size = ids_.size();
+    const size_t slots = ThreadCount(size);
+    std::vector<std::vector<uint32_t>> found(slots);
+    const bool has_quantity = filter.has_quantity;
+    const int32_t quantity = filter.quantity;
+    ForEachRange(size, slots, [&](size_t first, size_t last, size_t slot) {
+        std::vector<uint32_t>& out = found[slot];
+        out.resize(last - first + 1);
+        size_t count = 0;
+        for (size_t i = first; i < last; ++i) {
+            uint8_t keep = live_[i];
+            keep &= static_cast<uint8_t>(!has_quantity | (quantities_[i] == quantity));
+            for (int term = 0; term < active_count; ++term) {
+                keep &= active[term][codes[term][i]];
+            }
+            out[count] = static_cast<uint32_t>(i);
+            count += keep;
+        }
+        out.resize(count);
+    });
+
+    size_t total = 0;
+    for (const auto& positions : found) {
+        total += positions.size();
+    }
+    ids.reserve(total);
+    for (size_t slot = slots; slot-- > 0;) {
+        const std::vector<uint32_t>& positions = found[slot];
+        for (size_t i = positions.size(); i-- > 0;) {
+            ids.push_back(ids_[positions[i]]);
+        }
+    }
+}
+
+void ItemSnapshot::FuzzySearch(const SearchFilter& filter, std::vector<sqlite3_int64>& ids) {
+    ScopedLatency latency(Metrics().operation(Operation::kFuzzySearch));
+    ids.clear();
+    if (!loaded_ || (filter.name.empty() && filter.part_number.empty())) {
+        return;
+    }
+
+    // The typos of each distinct name and part number, kTooFar past the
+    // budget. The bigram index leaves only a few values to run the matcher
+    // on, except for terms too short for its filter.
+    constexpr uint8_t kTooFar = 0xFF;
+    const std::string* fuzzy_terms[] = {&filter.name, &filter.part_number};
+    std::vector<uint8_t> typos[kPartNumber + 1];
+    const uint8_t* fuzzy_active[kPartNumber + 1];
+    const uint32_t* fuzzy_codes[kPartNumber + 1];
+    int fuzzy_count = 0;
+    for (int column = kName; column <= kPartNumber; ++column) {
+        if (fuzzy_terms[column]->empty()) {
+            continue;
+        }
+        const std::deque<std::string>& values = dictionaries_[column].values;
+        BigramIndex& index = fuzzy_indexes_[column];
+        while (index.size() < values.size()) {
+            index.Add(values[index.size()]);
+        }
+        const FuzzyMatcher matcher(*fuzzy_terms[column]);
+        std::vector<uint8_t>& typo = typos[column];
+        typo.assign(values.size(), kTooFar);
+        std::vector<uint32_t> candidates;
+        const bool filtered = index.Candidates(*fuzzy_terms[column], matcher.budget(), candidates);
+        const size_t count = filtered ? candidates.size() : values.size();
+        ForEachRange(count, ThreadCount(count), [&](size_t first, size_t last, size_t) {
+            for (size_t i = first; i < last; ++i) {
+                const uint32_t code = filtered ? candidates[i] : static_cast<uint32_t>(i);
+                const int distance = matcher.Distance(values[code]);
+                if (distance >= 0) {
+                    typo[code] = static_cast<uint8_t>(distance);
+                }
+            }
+        });
+        fuzzy_active[fuzzy_count] = typo.data();
+        fuzzy_codes[fuzzy_count] = codes_[column].data();
+        ++fuzzy_count;
+    }
+
+    const std::string* exact_terms[] = {&filter.nsn, &filter.serial_number};
+    constexpr FilterField exact_fields[] = {kFilterNsn, kFilterSerialNumber};
+    std::vector<uint8_t> matches[2];
+    const uint8_t* exact_active[2];
+    const uint32_t* exact_codes[2];
+    int exact_count = 0;
+    for (int term = 0; term < 2; ++term) {
+        if (exact_terms[term]->empty()) {
+            continue;
+        }
+        const int column = kNsn + term;
+        MatchValues(column, TermMatcher(exact_fields[term], *exact_terms[term]), matches[term]);
+        exact_active[exact_count] = matches[term].data();
+        exact_codes[exact_count] = codes_[column].data();
+        ++exact_count;
+    }
+
+    // Sort the matching rows by their total typos as they are found: one
+    // list per total and range, each in row order.
+    constexpr size_t kTotals = 3 * (kPartNumber + 1) + 1;
+    const size_t size = ids_.size();
+    const size_t slots = ThreadCount(size);
+    std::vector<std::vector<uint32_t>> found(slots * kTotals);
+    const bool has_quantity = filter.has_quantity;
+    const int32_t quantity = filter.quantity;
+    ForEachRange(size, slots, [&](size_t first, size_t last, size_t slot) {
+        for (size_t i = first; i < last; ++i) {
+            if (!live_[i] || (has_quantity && quantities_[i] != quantity)) {
+                continue;
+            }
+            unsigned total = 0;
+            bool keep = true;
+            for (int term = 0; term < fuzzy_count && keep; ++term) {
+                const uint8_t typo = fuzzy_active[term][fuzzy_codes[term][i]];
+                keep = typo != kTooFar;
+                total += typo;
+            }
+            for (int term = 0; term < exact_count && keep; ++term) {
+                keep = exact_active[term][exact_codes[term][i]] != 0;
+            }
+            if (keep) {
+                found[total * slots + slot].push_back(static_cast<uint32_t>(i));
+            }
+        }
+    });
+
+    for (size_t total = 0; total < kTotals; ++total) {
+        for (size_t slot = slots; slot-- > 0;) {
+            const std::vector<uint32_t>& positions = found[total * slots + slot];
+            for (size_t i = positions.size(); i-- > 0;) {
+                ids.push_back(ids_[positions[i]]);
+            }
+        }
+    }
+}
+
+size_t ItemSnapshot::distinct_values() const {
+    size_t total = 0;
+    for (const Dictionary& dictionary : dictionaries_) {
+        total += dictionary.values.size();
+    }
+    return total;
+}
+
+}  // namespace inventory
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <sqlite3.h>
+
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "database.h"
+#include "fuzzy_match.h"
+#include "search_filter.h"
+
+namespace inventory {
+
+struct SnapshotOptions {
+    bool enabled = true;
+    // Larger tables stay on the SQLite path.
+    sqlite3_int64 max_rows = 2000000;
+    // Tables at least this large are filtered on several threads.
+    size_t parallel_min_rows = 1 << 16;
+    // 0 uses every core.
+    unsigned threads = 0;
+};
+
+// Parses "YYYY-MM-DD HH:MM:SS[.fff]" as UTC milliseconds since 1970; returns
+// false for anything else.
+bool ParseTimestamp(std::string_view text, int64_t& out);
+
+// The whole items table in columns: each text column is a dictionary of
+// distinct values plus one code per row, next to plain id, quantity and
+// created_at arrays. A search evaluates each LIKE term once per distinct value
+// and then scans the code columns, which is much cheaper than running LIKE on
+// every row. Rows are kept in (created_at, id) order, so results come out in
+// display order without sorting.
+//
+// Not thread-safe; the owner applies every change it writes through Sync.
+class ItemSnapshot {
+public:
+    explicit ItemSnapshot(const SnapshotOptions& options = SnapshotOptions());
+
+    ItemSnapshot(const ItemSnapshot&) = delete;
+    ItemSnapshot& operator=(const ItemSnapshot&) = delete;
+    // Moves keep the dictionary values in place, so a snapshot loaded on
+    // another thread can be handed over.
+    ItemSnapshot(ItemSnapshot&&) = default;
+    ItemSnapshot& operator=(ItemSnapshot&&) = default;
+
+    // Replaces the contents with the items table. Fails, leaving the snapshot
+    // empty, when the table has more than max_rows rows.
+    bool Load(Database& database);
+    void Clear();
+    bool loaded() const { return loaded_; }
+
+    // Re-reads one row after a write: updates it, adds it or drops it.
+    bool Sync(Database& database, sqlite3_int64 id);
+
+    // Ids of the matching rows, newest first, exactly as the SQL search
+    // would return them.
+    void Search(const SearchFilter& filter, std::vector<sqlite3_int64>& ids) const;
+
+    // Ids of the rows whose name and part number each hold the term with at
+    // most FuzzyEditBudget typos, for when Search finds nothing; the other
+    // fields must match as in Search. Fewest typos first, then newest first.
+    // Indexes the names and part numbers on first use, and each value added
+    // since on later calls.
+    void FuzzySearch(const SearchFilter& filter, std::vector<sqlite3_int64>& ids);
+
+    size_t size() const { return live_rows_; }
+    size_t distinct_values() const;
+
+private:
+    enum TextColumn { kName, kPartNumber, kNsn, kSerialNumber, kTextColumns };
+
+    struct Dictionary {
+        // A deque never moves its elements, so the index can point into them.
+        std::deque<std::string> values;
+        std::unordered_map<std::string_view, uint32_t> codes;
+
+        uint32_t Intern(std::string_view value);
+        void Clear();
+    };
+
+    struct Key {
+        int64_t created_ms;
+        sqlite3_int64 id;
+    };
+
+    void Append(sqlite3_stmt* statement);
+    void Insert(size_t position, sqlite3_stmt* statement);
+    void Assign(size_t position, sqlite3_stmt* statement);
+    void Erase(size_t position);
+    void Compact();
+    void RebuildPositions();
+    // Sets match[code] to 1 for the values of |column| that |matcher| accepts.
+    void MatchValues(int column, const TermMatcher& matcher, std::vector<uint8_t>& match) const;
+    size_t LowerBound(const Key& key) const;
+    size_t ThreadCount(size_t size) const;
+
+    SnapshotOptions options_;
+    bool loaded_ = false;
+    Dictionary dictionaries_[kTextColumns];
+    std::vector<uint32_t> codes_[kTextColumns];
+    // Over the name and part number dictionaries; Compact renumbers them.
+    BigramIndex fuzzy_indexes_[kPartNumber + 1];
+    std::vector<sqlite3_int64> ids_;
+    std::vector<int32_t> quantities_;
+    std::vector<int64_t> created_ms_;
+    // 0 for rows deleted since the last compaction.
+    std::vector<uint8_t> live_;
+    size_t live_rows_ = 0;
+    std::unordered_map<sqlite3_int64, size_t> positions_;
+};
+
+}  // namespace inventory
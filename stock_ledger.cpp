@@ -0,0 +1,161 @@
+#include "stock_ledger.h"
+
+#include <string>
+
+namespace inventory {
+namespace {
+
+bool ApplyAll(Database& database, const std::vector<StockDelta>& deltas) {
+    // The range check keeps the total inside the int the rest of the program
+    // reads it into.
+    Statement adjust = database.Prepare(
+        "UPDATE items SET quantity = quantity + ?1"
+        " WHERE id = ?2 AND quantity + ?1 BETWEEN -2147483648 AND 2147483647");
+    Statement record =
+        database.Prepare("INSERT INTO stock_movements (item_id, delta) VALUES (?, ?)");
+    if (!adjust || !record) {
+        return false;
+    }
+    for (const StockDelta& delta : deltas) {
+        sqlite3_bind_int(adjust.get(), 1, delta.delta);
+        sqlite3_bind_int64(adjust.get(), 2, delta.item_id);
+        const int adjusted = sqlite3_step(adjust.get());
+        sqlite3_reset(adjust.get());
+        if (adjusted != SQLITE_DONE || sqlite3_changes(database.handle()) != 1) {
+            return false;
+        }
+        sqlite3_bind_int64(record.get(), 1, delta.item_id);
+        sqlite3_bind_int(record.get(), 2, delta.delta);
+        const int recorded = sqlite3_step(record.get());
+        sqlite3_reset(record.get());
+        if (recorded != SQLITE_DONE) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool FoldMovements(Database& database, sqlite3_int64 through_id, StockCompaction& result) {
+    // An item's quantity as of |through_id| is its current total less every
+    // movement recorded after it. A deleted item keeps its movements while it
+    // has a tombstone, so it is checkpointed too, from the quantity its newest
+    // tombstone recorded: it has no movements after the delete. An item with
+    // neither a row nor a tombstone gets no checkpoint.
+    Statement checkpoint = database.Prepare(
+        "INSERT INTO stock_checkpoints (item_id, quantity, through_id)"
+        " SELECT item_id, total - COALESCE((SELECT SUM(later.delta) FROM stock_movements"
+        " AS later WHERE later.item_id = folded.item_id AND later.id > ?1), 0), ?1"
+        " FROM (SELECT item_id, COALESCE("
+        "(SELECT quantity FROM items WHERE items.id = moved.item_id),"
+        " (SELECT old_quantity FROM item_journal AS deleted"
+        " WHERE deleted.item_id = moved.item_id AND action = 3 ORDER BY id DESC LIMIT 1))"
+        " AS total FROM (SELECT DISTINCT item_id FROM stock_movements WHERE id <= ?1) AS moved)"
+        " AS folded WHERE total IS NOT NULL"
+        " ON CONFLICT(item_id) DO UPDATE SET quantity = excluded.quantity,"
+        " through_id = excluded.through_id, created_at = excluded.created_at");
+    if (!checkpoint) {
+        return false;
+    }
+    sqlite3_bind_int64(checkpoint.get(), 1, through_id);
+    if (sqlite3_step(checkpoint.get()) != SQLITE_DONE) {
+        return false;
+    }
+    result.items = sqlite3_changes(database.handle());
+
+    // Point-in-time views need every movement since the time they rebuild.
+    Statement horizon = database.Prepare(
+        "UPDATE item_journal_horizon SET changed_at = MAX(changed_at,"
+        " (SELECT created_at FROM stock_movements WHERE id = ?)) WHERE id = 1");
+    if (!horizon) {
+        return false;
+    }
+    sqlite3_bind_int64(horizon.get(), 1, through_id);
+    if (sqlite3_step(horizon.get()) != SQLITE_DONE) {
+        return false;
+    }
+
+    Statement purge = database.Prepare("DELETE FROM stock_movements WHERE id <= ?");
+    if (!purge) {
+        return false;
+    }
+    sqlite3_bind_int64(purge.get(), 1, through_id);
+    if (sqlite3_step(purge.get()) != SQLITE_DONE) {
+        return false;
+    }
+    result.movements = sqlite3_changes(database.handle());
+    return true;
+}
+
+}  // namespace
+
+bool ApplyStockDeltas(Database& database, const std::vector<StockDelta>& deltas) {
+    if (deltas.empty()) {
+        return true;
+    }
+    if (!database.Execute("SAVEPOINT stock_deltas")) {
+        return false;
+    }
+    const bool ok = ApplyAll(database, deltas);
+    if (!ok) {
+        database.Execute("ROLLBACK TO stock_deltas");
+    }
+    return database.Execute("RELEASE stock_deltas") && ok;
+}
+
+bool CompactStockMovements(Database& database, int keep_seconds, StockCompaction* result) {
+    StockCompaction compaction;
+    if (result) {
+        *result = compaction;
+    }
+    sqlite3_int64 through_id = 0;
+    {
+        Statement cutoff = database.Prepare(
+            "SELECT MAX(id) FROM stock_movements"
+            " WHERE created_at < strftime('%Y-%m-%d %H:%M:%f', 'now', ?)");
+        if (!cutoff) {
+            return false;
+        }
+        const std::string age = std::to_string(-static_cast<long long>(keep_seconds)) +
+                                " seconds";
+        sqlite3_bind_text(cutoff.get(), 1, age.c_str(), -1, SQLITE_TRANSIENT);
+        if (sqlite3_step(cutoff.get()) != SQLITE_ROW) {
+            return false;
+        }
+        through_id = sqlite3_column_int64(cutoff.get(), 0);
+    }
+    if (through_id == 0) {
+        return true;
+    }
+
+    if (!database.Execute("SAVEPOINT stock_compaction")) {
+        return false;
+    }
+    const bool ok = FoldMovements(database, through_id, compaction);
+    if (!ok) {
+        database.Execute("ROLLBACK TO stock_compaction");
+    }
+    if (!database.Execute("RELEASE stock_compaction") || !ok) {
+        return false;
+    }
+    if (result) {
+        *result = compaction;
+    }
+    return true;
+}
+
+bool RestartStockLedger(Database& database, sqlite3_int64 item_id, int quantity) {
+    Statement checkpoint = database.Prepare(
+        "INSERT INTO stock_checkpoints (item_id, quantity, through_id)"
+        " VALUES (?1, ?2, (SELECT COALESCE(MAX(seq), 0) FROM sqlite_sequence"
+        " WHERE name = 'stock_movements'))"
+        " ON CONFLICT(item_id) DO UPDATE SET quantity = excluded.quantity,"
+        " through_id = excluded.through_id, created_at = excluded.created_at");
+    if (!checkpoint) {
+        return false;
+    }
+    sqlite3_bind_int64(checkpoint.get(), 1, item_id);
+    sqlite3_bind_int(checkpoint.get(), 2, quantity);
+    return sqlite3_step(checkpoint.get()) == SQLITE_DONE;
+}
+
+}  // namespace inventory
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <sqlite3.h>
+
+#include <vector>
+
+#include "database.h"
+
+namespace inventory {
+
+struct StockDelta {
+    sqlite3_int64 item_id = 0;
+    int delta = 0;
+};
+
+struct StockCompaction {
+    // Movements folded into checkpoints and deleted.
+    sqlite3_int64 movements = 0;
+    // Items whose checkpoint was written.
+    sqlite3_int64 items = 0;
+};
+
+// Quantities change only through signed deltas recorded in stock_movements;
+// items.quantity is their running total, adjusted in the same transaction as
+// each movement, starting from the opening movement a trigger records when
+// the row is inserted. Because a delta is added to whatever the row holds when the
+// write runs, concurrent writers never overwrite each other's changes.
+//
+// Applies every delta or none of them, inside the caller's transaction if
+// there is one. Fails when an item does not exist or its quantity would
+// leave the int range.
+bool ApplyStockDeltas(Database& database, const std::vector<StockDelta>& deltas);
+
+// Folds movements older than |keep_seconds| into stock_checkpoints, which
+// record each item's quantity as of the last folded movement, then deletes
+// them and moves the change journal horizon past them; a negative age
+// includes movements of the next seconds as well. Runs inside the caller's
+// transaction if there is one.
+bool CompactStockMovements(Database& database, int keep_seconds,
+                           StockCompaction* result = nullptr);
+
+// Checkpoints |item_id| at |quantity| as of the newest movement, for an item
+// that comes back with that quantity while its older movements are kept.
+bool RestartStockLedger(Database& database, sqlite3_int64 item_id, int quantity);
+
+}  // namespace inventory
@@ -0,0 +1,169 @@
+#include "storage_worker.h"
+
+#include <chrono>
+#include <vector>
+
+#include "metrics.h"
+#include "schema.h"
+
+namespace inventory {
+
+bool StorageWorker::Start(const std::string& path, const StorageOptions& options) {
+    Stop();
+    options_ = options;
+    if (!database_.Open(path) || !database_.Configure(options_) || !EnsureSchema(database_)) {
+        database_.Close();
+        return false;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = false;
+    }
+    thread_ = std::thread(&StorageWorker::Run, this);
+    return true;
+}
+
+void StorageWorker::Stop() {
+    if (!thread_.joinable()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    wake_.notify_all();
+    thread_.join();
+    database_.Close();
+}
+
+void StorageWorker::PostWrite(Task task, Completion done) {
+    Post(Request{std::move(task), std::move(done), true});
+}
+
+void StorageWorker::PostQuery(Task task, Completion done) {
+    Post(Request{std::move(task), std::move(done), false});
+}
+
+void StorageWorker::Post(Request request) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        queue_.push_back(std::move(request));
+    }
+    wake_.notify_one();
+}
+
+StorageStats StorageWorker::stats() const {
+    StorageStats stats;
+    stats.writes = writes_.load(std::memory_order_relaxed);
+    stats.failed_writes = failed_writes_.load(std::memory_order_relaxed);
+    stats.commits = commits_.load(std::memory_order_relaxed);
+    stats.queries = queries_.load(std::memory_order_relaxed);
+    return stats;
+}
+
+std::string StorageWorker::last_error() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return last_error_;
+}
+
+void StorageWorker::SetLastError(std::string message) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    last_error_ = std::move(message);
+}
+
+void StorageWorker::Run() {
+    const auto window = std::chrono::milliseconds(options_.group_commit_window_ms);
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        wake_.wait(lock, [this] { return stopping_ || !queue_.empty(); });
+        if (queue_.empty()) {
+            return;
+        }
+
+        Request request = std::move(queue_.front());
+        queue_.pop_front();
+        if (!request.write) {
+            lock.unlock();
+            bool ok = request.task(database_);
+            queries_.fetch_add(1, std::memory_order_relaxed);
+            if (request.done) {
+                request.done(ok);
+            }
+            lock.lock();
+            continue;
+        }
+
+        // Collect the writes that follow, waiting briefly for more. A query
+        // ends the group so that it sees every write queued before it.
+        std::deque<Request> group;
+        group.push_back(std::move(request));
+        const auto deadline = std::chrono::steady_clock::now() + window;
+        while (group.size() < options_.max_group_size) {
+            if (!queue_.empty()) {
+                if (!queue_.front().write) {
+                    break;
+                }
+                group.push_back(std::move(queue_.front()));
+                queue_.pop_front();
+                continue;
+            }
+            if (stopping_ || !wake_.wait_until(lock, deadline, [this] {
+                    return stopping_ || !queue_.empty();
+                })) {
+                break;
+            }
+        }
+        lock.unlock();
+        RunWriteGroup(group);
+        lock.lock();
+    }
+}
+
+void StorageWorker::RunWriteGroup(std::deque<Request>& group) {
+    std::vector<char> results(group.size(), 0);
+    bool committed = false;
+    const auto start = std::chrono::steady_clock::now();
+    if (database_.Execute("BEGIN IMMEDIATE")) {
+        for (size_t i = 0; i < group.size(); ++i) {
+            if (!database_.Execute("SAVEPOINT storage_write")) {
+                SetLastError(database_.last_error());
+                continue;
+            }
+            results[i] = group[i].task(database_) ? 1 : 0;
+            if (!results[i]) {
+                // Read before the rollback replaces it. A task can also fail
+                // without an SQLite error, e.g. when its row has gone.
+                const int code = sqlite3_errcode(database_.handle());
+                const bool sqlite_error =
+                    code != SQLITE_OK && code != SQLITE_ROW && code != SQLITE_DONE;
+                SetLastError(sqlite_error ? sqlite3_errmsg(database_.handle())
+                                          : "the change did not apply");
+                database_.Execute("ROLLBACK TO storage_write");
+            }
+            database_.Execute("RELEASE storage_write");
+        }
+        committed = database_.Execute("COMMIT");
+        if (!committed) {
+            SetLastError(database_.last_error());
+            database_.Execute("ROLLBACK");
+        } else {
+            commits_.fetch_add(1, std::memory_order_relaxed);
+            Metrics().operation(Operation::kCommit).Record(ScopedLatency::ElapsedNs(start));
+        }
+    } else {
+        SetLastError(database_.last_error());
+    }
+
+    for (size_t i = 0; i < group.size(); ++i) {
+        bool ok = committed && results[i];
+        writes_.fetch_add(1, std::memory_order_relaxed);
+        if (!ok) {
+            failed_writes_.fetch_add(1, std::memory_order_relaxed);
+        }
+        if (group[i].done) {
+            group[i].done(ok);
+        }
+    }
+}
+
+}  // namespace inventory
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "database.h"
+
+namespace inventory {
+
+struct StorageStats {
+    uint64_t writes = 0;
+    uint64_t failed_writes = 0;
+    uint64_t commits = 0;
+    uint64_t queries = 0;
+};
+
+// Owns a connection on a dedicated thread and runs requests from a FIFO
+// queue. Writes that are queued close together share one transaction (group
+// commit); each still succeeds or fails on its own through a savepoint.
+// Completions run on the storage thread, so UI callers forward them to their
+// own thread, e.g. with PostMessage.
+class StorageWorker {
+public:
+    using Task = std::function<bool(Database& database)>;
+    using Completion = std::function<void(bool ok)>;
+
+    StorageWorker() = default;
+    ~StorageWorker() { Stop(); }
+
+    StorageWorker(const StorageWorker&) = delete;
+    StorageWorker& operator=(const StorageWorker&) = delete;
+
+    // Opens and migrates the database, then starts the thread.
+    bool Start(const std::string& path, const StorageOptions& options);
+    // Runs everything already queued, then joins the thread.
+    void Stop();
+
+    void PostWrite(Task task, Completion done);
+    void PostQuery(Task task, Completion done);
+
+    StorageStats stats() const;
+    // Why the most recent failed write failed, as SQLite put it.
+    std::string last_error() const;
+
+private:
+    struct Request {
+        Task task;
+        Completion done;
+        bool write = false;
+    };
+
+    void Post(Request request);
+    void Run();
+    void RunWriteGroup(std::deque<Request>& group);
+    void SetLastError(std::string message);
+
+    Database database_;
+    StorageOptions options_;
+    std::thread thread_;
+    mutable std::mutex mutex_;
+    std::condition_variable wake_;
+    std::deque<Request> queue_;
+    bool stopping_ = false;
+    std::string last_error_;
+    std::atomic<uint64_t> writes_{0};
+    std::atomic<uint64_t> failed_writes_{0};
+    std::atomic<uint64_t> commits_{0};
+    std::atomic<uint64_t> queries_{0};
+};
+
+}  // namespace inventory
@@ -0,0 +1,100 @@
+#include <sqlite3.h>
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "bulk_export.h"
+#include "bulk_import.h"
+#include "database.h"
+#include "items.h"
+#include "search_filter.h"
+#include "test_support.h"
+
+namespace {
+
+using inventory::testing::InsertTestItems;
+using inventory::testing::OpenMemory;
+using inventory::testing::TempDatabase;
+using inventory::testing::TestItem;
+
+// Every stored item, with its keys, one string per row in a fixed order.
+std::vector<std::string> StoredRows(inventory::Database& database) {
+    std::vector<std::string> rows;
+    inventory::Statement statement = database.Prepare(
+        "SELECT quote(name) || '|' || quote(part_number) || '|' || quote(nsn) || '|' ||"
+        " quote(serial_number) || '|' || quantity || '|' || quote(nsn_key) || '|' ||"
+        " quote(part_key) || '|' || quote(serial_key)"
+        " FROM items ORDER BY serial_number, name");
+    while (statement && sqlite3_step(statement.get()) == SQLITE_ROW) {
+        rows.emplace_back(reinterpret_cast<const char*>(sqlite3_column_text(statement.get(), 0)));
+    }
+    return rows;
+}
+
+bool Export(inventory::Database& database, const std::string& path) {
+    std::FILE* out = std::fopen(path.c_str(), "wb");
+    if (!out) {
+        return false;
+    }
+    inventory::ExportReport report;
+    const bool ok = inventory::ExportItems(database, inventory::SearchFilter(), out,
+                                           inventory::ExportOptions(), report);
+    return std::fclose(out) == 0 && ok;
+}
+
+// Items exported to CSV and imported into an empty database come back
+// unchanged, however awkward their text: separators, quotes, line breaks,
+// edge whitespace and non-ASCII characters.
+TEST(CsvRoundTrip) {
+    inventory::Database source;
+    REQUIRE(OpenMemory(source));
+    REQUIRE(InsertTestItems(source, 500));
+    const char* const kAwkward[] = {
+        "Pump, hydraulic",   "Seal \"O\" ring",   "Two\nlines",        "Windows\r\nbreak",
+        "\"quoted\"",        "  leading spaces",  "trailing tab\t",    "Ventil \xc3\xb6l 12 mm",
+        "ends in newline\n", "\n\"starts\" oddly", "a,\"b\",\nc\r\n\"", "Bolt 5\" long",
+    };
+    int serial = 1000;
+    for (const char* text : kAwkward) {
+        inventory::Item item = TestItem(serial++);
+        item.name = text;
+        REQUIRE(inventory::InsertItem(source, item));
+        item = TestItem(serial++);
+        item.part_number = std::string("P-") + text;
+        item.serial_number = std::string(text) + " SN";
+        REQUIRE(inventory::InsertItem(source, item));
+    }
+
+    TempDatabase csv("inventory_test_round_trip.csv");
+    REQUIRE(Export(source, csv.path()));
+
+    inventory::Database target;
+    REQUIRE(OpenMemory(target));
+    inventory::ImportReport report;
+    std::vector<uint64_t> rejected;
+    REQUIRE(inventory::ImportManifest(target, csv.path(), inventory::ImportOptions(), report,
+                                      [&rejected](const inventory::ImportError& error) {
+                                          rejected.push_back(error.line);
+                                      }));
+    CHECK(rejected.empty());
+    CHECK(report.duplicates == 0);
+
+    const std::vector<std::string> expected = StoredRows(source);
+    const std::vector<std::string> imported = StoredRows(target);
+    CHECK(expected.size() == 500 + 2 * std::size(kAwkward));
+    CHECK(imported == expected);
+    for (size_t i = 0; i < expected.size() && i < imported.size(); ++i) {
+        if (imported[i] != expected[i]) {
+            std::fprintf(stderr, "  %s\n  came back as %s\n", expected[i].c_str(),
+                         imported[i].c_str());
+            break;
+        }
+    }
+}
+
+}  // namespace
+
+int main() {
+    return inventory::testing::RunTests();
+}
@@ -0,0 +1,150 @@
+#include <sqlite3.h>
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "bulk_import.h"
+#include "database.h"
+#include "test_support.h"
+
+namespace {
+
+using inventory::testing::OpenMemory;
+using inventory::testing::TempDatabase;
+
+bool WriteFile(const std::string& path, const std::string& contents) {
+    std::FILE* file = std::fopen(path.c_str(), "wb");
+    if (!file) {
+        return false;
+    }
+    const bool ok = std::fwrite(contents.data(), 1, contents.size(), file) == contents.size();
+    return std::fclose(file) == 0 && ok;
+}
+
+std::vector<std::string> QueryTexts(inventory::Database& database, const std::string& sql) {
+    std::vector<std::string> texts;
+    inventory::Statement statement = database.Prepare(sql);
+    while (statement && sqlite3_step(statement.get()) == SQLITE_ROW) {
+        const auto* text = reinterpret_cast<const char*>(sqlite3_column_text(statement.get(), 0));
+        texts.emplace_back(text ? text : "");
+    }
+    return texts;
+}
+
+// Imports |manifest| into |database| and collects the rejected lines.
+bool Import(inventory::Database& database, const std::string& manifest,
+            const inventory::ImportOptions& options, inventory::ImportReport& report,
+            std::vector<uint64_t>& rejected) {
+    TempDatabase file("inventory_test_manifest.csv");
+    return WriteFile(file.path(), manifest) &&
+           inventory::ImportManifest(database, file.path(), options, report,
+                                     [&rejected](const inventory::ImportError& error) {
+                                         rejected.push_back(error.line);
+                                     });
+}
+
+std::string Record(const std::string& name, int i, const std::string& quantity = "1") {
+    char rest[64];
+    std::snprintf(rest, sizeof(rest), ",P-%05d,5305-01-000-%04d,SN-%06d,", i, i, i);
+    return name + rest + quantity + "\n";
+}
+
+// A record ends at a line break outside quotes, and errors give the line the
+// record starts on.
+TEST(QuotedFieldsSpanLines) {
+    inventory::Database database;
+    REQUIRE(OpenMemory(database));
+    const std::string manifest =
+        "name,part_number,nsn,serial_number,quantity\n" +  // line 1
+        Record("\"Pump\nwith two\nlines\"", 1) +            // lines 2-4
+        Record("\"Seal, \"\"O\"\" ring\"", 2) +             // line 5
+        Record("Bolt 5\" long", 3) +                        // line 6
+        Record("\"Gasket\r\nset\"", 4, "x") +               // lines 7-8, rejected
+        Record("\"Relay\n\"", 5) +                          // lines 9-10
+        "\"Valve,P-6,5305-01-000-0006,SN-000006,1\r\n"      // lines 11-12, unterminated
+        "Washer,P-7,5305-01-000-0007,SN-000007,1\n";
+    inventory::ImportReport report;
+    std::vector<uint64_t> rejected;
+    REQUIRE(Import(database, manifest, inventory::ImportOptions(), report, rejected));
+
+    CHECK(report.lines == 6);
+    CHECK(report.inserted == 4);
+    CHECK(rejected == std::vector<uint64_t>({7, 11}));
+    CHECK(QueryTexts(database, "SELECT name FROM items ORDER BY id") ==
+          std::vector<std::string>(
+              {"Pump\nwith two\nlines", "Seal, \"O\" ring", "Bolt 5\" long", "Relay\n"}));
+}
+
+// Records and quoted line breaks fall on every position of a small read
+// buffer, including an escaped quote split across two reads.
+TEST(RecordsStraddleReadBuffers) {
+    constexpr int kRecords = 3000;
+    inventory::Database database;
+    REQUIRE(OpenMemory(database));
+    std::string manifest;
+    std::vector<std::string> names;
+    std::vector<uint64_t> expected_rejected;
+    uint64_t line = 1;
+    for (int i = 0; i < kRecords; ++i) {
+        std::string name =
+            "Item " + std::to_string(i) + std::string(static_cast<size_t>(i % 37), '-');
+        std::string quoted = name;
+        const int breaks = i % 3;
+        for (int b = 0; b < breaks; ++b) {
+            name += "\n\"q\"";
+            quoted += "\n\"\"q\"\"";
+        }
+        const bool bad = i % 101 == 50;
+        manifest += Record("\"" + quoted + "\"", i, bad ? "many" : "2");
+        if (bad) {
+            expected_rejected.push_back(line);
+        } else {
+            names.push_back(name);
+        }
+        line += static_cast<uint64_t>(breaks) + 1;
+    }
+    inventory::ImportOptions options;
+    options.buffer_size = 4096;
+    options.duplicates = inventory::ImportDuplicates::kIgnore;
+    inventory::ImportReport report;
+    std::vector<uint64_t> rejected;
+    REQUIRE(Import(database, manifest, options, report, rejected));
+
+    CHECK(report.lines == kRecords);
+    CHECK(report.inserted == names.size());
+    CHECK(rejected == expected_rejected);
+    CHECK(QueryTexts(database, "SELECT name FROM items ORDER BY id") == names);
+}
+
+// A record longer than the read buffer is rejected whole, line breaks in
+// quotes included, and the records after it keep their line numbers.
+TEST(OverlongRecordIsSkipped) {
+    inventory::Database database;
+    REQUIRE(OpenMemory(database));
+    std::string huge = "\"";
+    for (int i = 0; i < 500; ++i) {
+        huge += "twenty bytes of text\n";
+    }
+    huge += "\"";
+    const std::string manifest = Record("Before", 1) +     // line 1
+                                 Record(huge, 2) +         // lines 2-502
+                                 Record("Bad", 3, "-x") +  // line 503
+                                 Record("After", 4);       // line 504
+    inventory::ImportOptions options;
+    options.buffer_size = 4096;
+    inventory::ImportReport report;
+    std::vector<uint64_t> rejected;
+    REQUIRE(Import(database, manifest, options, report, rejected));
+
+    CHECK(rejected == std::vector<uint64_t>({2, 503}));
+    CHECK(report.inserted == 2);
+    CHECK(QueryTexts(database, "SELECT name FROM items ORDER BY id") ==
+          std::vector<std::string>({"Before", "After"}));
+}
+
+}  // namespace
+
+int main() {
+    return inventory::testing::RunTests();
+}
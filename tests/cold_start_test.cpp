@@ -0,0 +1,80 @@
+#include <sqlite3.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "cold_start.h"
+#include "database.h"
+#include "snapshot.h"
+#include "test_support.h"
+
+namespace {
+
+using inventory::testing::InsertTestItems;
+using inventory::testing::OpenMemory;
+using inventory::testing::QueryIds;
+using inventory::testing::TempDatabase;
+
+constexpr int kItems = 5000;
+
+TEST(CountItemsCounts) {
+    inventory::Database database;
+    REQUIRE(OpenMemory(database));
+    REQUIRE(InsertTestItems(database, kItems));
+    std::atomic<bool> cancelled{false};
+    sqlite3_int64 count = 0;
+    CHECK(inventory::CountItems(database, count, &cancelled) && count == kItems);
+    count = 0;
+    CHECK(inventory::CountItems(database, count) && count == kItems);
+}
+
+// Closing the window sets the flag, which interrupts the startup count and
+// warm-up instead of waiting for them, and leaves the connection usable.
+TEST(CancelledStartupStops) {
+    inventory::Database database;
+    REQUIRE(OpenMemory(database));
+    REQUIRE(InsertTestItems(database, kItems));
+    std::atomic<bool> cancelled{true};
+    sqlite3_int64 count = -1;
+    CHECK(!inventory::CountItems(database, count, &cancelled));
+    inventory::ItemSnapshot snapshot;
+    CHECK(!inventory::WarmUp(database, snapshot, &cancelled));
+
+    // Nothing is left interrupting the connection afterwards.
+    CHECK(QueryIds(database, "SELECT COUNT(*) FROM items") ==
+          std::vector<sqlite3_int64>({kItems}));
+}
+
+// The flag is set from another thread, as when the window closes, at any
+// point of the count: the interrupt never outlives it and fails a later
+// statement on the connection.
+TEST(ConcurrentCancelLeavesConnectionUsable) {
+    TempDatabase file("inventory_test_cold_count.db");
+    {
+        inventory::Database database;
+        REQUIRE(database.Open(file.path()));
+        REQUIRE(database.Configure(inventory::StorageOptions()));
+        REQUIRE(inventory::EnsureSchema(database));
+        REQUIRE(InsertTestItems(database, kItems));
+    }
+    inventory::Database database;
+    REQUIRE(database.Open(file.path()));
+    std::atomic<bool> cancelled{false};
+    sqlite3_int64 count = 0;
+    for (int i = 0; i < 50; ++i) {
+        cancelled = false;
+        std::thread closer([&cancelled] { cancelled = true; });
+        const bool counted = inventory::CountItems(database, count, &cancelled);
+        closer.join();
+        CHECK(!counted || count == kItems);
+        CHECK(QueryIds(database, "SELECT COUNT(*) FROM items") ==
+              std::vector<sqlite3_int64>({kItems}));
+    }
+}
+
+}  // namespace
+
+int main() {
+    return inventory::testing::RunTests();
+}
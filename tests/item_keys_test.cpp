@@ -0,0 +1,158 @@
+#include <sqlite3.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "database.h"
+#include "item_keys.h"
+#include "search_filter.h"
+#include "test_support.h"
+
+namespace {
+
+using inventory::testing::InsertTestItems;
+using inventory::testing::OpenMemory;
+
+constexpr int kItems = 200;
+
+// Every grouping of the same 13 digits gives one key; anything that is not
+// a digit or a separator, or a digit too many or too few, gives none.
+TEST(ParseNsnGroupings) {
+    int64_t key = 0;
+    REQUIRE(inventory::ParseNsn("5305-00-123-4567", key));
+    CHECK(inventory::NsnSupplyClass(key) == 5305);
+    CHECK(inventory::NsnNiin(key) == 1234567);
+    const int64_t expected = key;
+    for (const char* text : {"5305001234567", "5305 00 123 4567", "  5305-00-1234567\r\n",
+                             "5305\t00\t123\t4567", "5-3-0-5-0-0-1-2-3-4-5-6-7"}) {
+        int64_t parsed = 0;
+        CHECK(inventory::ParseNsn(text, parsed) && parsed == expected);
+    }
+    CHECK(inventory::ParseNsn("0000-00-000-0000", key) && key == 0);
+    CHECK(inventory::ParseNsn("9999-99-999-9999", key) &&
+          inventory::NsnSupplyClass(key) == 9999 && inventory::NsnNiin(key) == 999999999);
+
+    key = 42;
+    for (const char* text : {"", "5305-00-123-456", "5305-00-123-45678", "5305.00.123.4567",
+                             "5305-00-123-456X", "NSN 5305-00-123-4567", "=5305001234567"}) {
+        CHECK(!inventory::ParseNsn(text, key));
+    }
+    CHECK(key == 42);
+}
+
+// Keys sort by supply class first.
+TEST(NsnKeysSortBySupplyClass) {
+    int64_t low = 0;
+    int64_t high = 0;
+    REQUIRE(inventory::ParseNsn("5305-99-999-9999", low));
+    REQUIRE(inventory::ParseNsn("5306-00-000-0001", high));
+    CHECK(low < high);
+    CHECK(inventory::PackNsn(5305, 999999999) == low);
+}
+
+// Dashes and whitespace are dropped and ASCII letters upper-cased; every
+// other character is kept as it is.
+TEST(IdentifierKeyFolding) {
+    CHECK(inventory::IdentifierKey("sn-000012") == "SN000012");
+    CHECK(inventory::IdentifierKey(" Sn 0000-12\t\r\n") == "SN000012");
+    CHECK(inventory::IdentifierKey("p/n.12_a#b") == "P/N.12_A#B");
+    CHECK(inventory::IdentifierKey("R\xC3\xA9" "f-1") == "R\xC3\xA9" "F1");
+    CHECK(inventory::IdentifierKey("- \t").empty());
+    CHECK(inventory::IdentifierKey("").empty());
+
+    for (const char* text : {"sn-000012", "SN 000012", "s-n-0-0-0-0-1-2", "SN000012"}) {
+        CHECK(inventory::IdentifierKeyEquals(text, "SN000012"));
+    }
+    CHECK(!inventory::IdentifierKeyEquals("SN-0000123", "SN000012"));
+    CHECK(!inventory::IdentifierKeyEquals("SN-00001", "SN000012"));
+    CHECK(!inventory::IdentifierKeyEquals("SN_000012", "SN000012"));
+    CHECK(inventory::IdentifierKeyEquals("--", ""));
+}
+
+// The ids |filter| finds through the SQL search conditions.
+std::vector<sqlite3_int64> Search(inventory::Database& database,
+                                  const inventory::SearchFilter& filter) {
+    std::string sql = "SELECT id FROM items";
+    inventory::AppendFilterConditions(filter, sql);
+    sql += " ORDER BY id";
+    std::vector<sqlite3_int64> ids;
+    inventory::Statement statement = database.Prepare(sql);
+    if (!statement) {
+        return ids;
+    }
+    inventory::BindFilter(statement.get(), filter, 1);
+    while (sqlite3_step(statement.get()) == SQLITE_ROW) {
+        ids.push_back(sqlite3_column_int64(statement.get(), 0));
+    }
+    return ids;
+}
+
+// A part or serial number term starting with '=' is a whole identifier
+// matched on its key; without the prefix the same text is a substring.
+// A complete NSN is matched on its key with or without it.
+TEST(ExactPrefix) {
+    inventory::Database database;
+    REQUIRE(OpenMemory(database) && InsertTestItems(database, kItems));
+    const std::vector<sqlite3_int64> item_12 = {13};
+
+    inventory::SearchFilter filter;
+    filter.serial_number = "=sn 0000-12";
+    CHECK(filter.ExactMask() == inventory::kFilterSerialNumber);
+    CHECK(Search(database, filter) == item_12);
+    filter.serial_number = "sn 0000-12";
+    CHECK(filter.ExactMask() == 0);
+    CHECK(Search(database, filter).empty());
+    // A substring of the serial number is not the whole of it.
+    filter.serial_number = "=SN-00001";
+    CHECK(Search(database, filter).empty());
+    filter.serial_number = "SN-00001";
+    CHECK(Search(database, filter).size() == 10);
+    // Nothing left once normalized: not an identifier, so a substring.
+    filter.serial_number = "= -";
+    CHECK(filter.ExactMask() == 0);
+
+    filter = inventory::SearchFilter();
+    filter.part_number = "=p00012";
+    CHECK(filter.ExactMask() == inventory::kFilterPartNumber);
+    CHECK(Search(database, filter) == item_12);
+
+    // TestItem(i) has NSN 5305-01-(i % 1000)-(i % 10000).
+    filter = inventory::SearchFilter();
+    filter.nsn = "5305 01 012 0012";
+    CHECK(filter.ExactMask() == inventory::kFilterNsn);
+    CHECK(Search(database, filter) == item_12);
+    filter.nsn = "=5305010120012";
+    CHECK(filter.ExactMask() == inventory::kFilterNsn);
+    CHECK(Search(database, filter) == item_12);
+    filter.nsn = "=5305-01-012";
+    CHECK(filter.ExactMask() == 0);
+
+    // The name is never an identifier.
+    filter = inventory::SearchFilter();
+    filter.name = "=Hex bolt";
+    CHECK(filter.ExactMask() == 0);
+    CHECK(Search(database, filter).empty());
+}
+
+// The in-memory matcher agrees with the key look-up.
+TEST(ExactPrefixMatcher) {
+    const inventory::TermMatcher serial(inventory::kFilterSerialNumber, "=sn 0000-12");
+    CHECK(serial.Matches("SN-000012"));
+    CHECK(serial.Matches("sn000012"));
+    CHECK(!serial.Matches("SN-0000123"));
+    CHECK(!serial.Matches("XSN-000012"));
+    const inventory::TermMatcher substring(inventory::kFilterSerialNumber, "sn-00001");
+    CHECK(substring.Matches("SN-000012"));
+    CHECK(!substring.Matches("SN 000012"));
+    const inventory::TermMatcher nsn(inventory::kFilterNsn, "5305010120012");
+    CHECK(nsn.Matches("5305-01-012-0012"));
+    CHECK(!nsn.Matches("5305-01-012-0013"));
+    CHECK(!nsn.Matches("not an nsn"));
+}
+
+}  // namespace
+
+int main() {
+    return inventory::testing::RunTests();
+}
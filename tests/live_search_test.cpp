@@ -0,0 +1,322 @@
+#include <sqlite3.h>
+
+#include <atomic>
+#include <chrono>
+#include <cctype>
+#include <condition_variable>
+#include <cstddef>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "database.h"
+#include "live_search.h"
+#include "search_filter.h"
+#include "test_support.h"
+
+namespace {
+
+using inventory::testing::InsertTestItems;
+using inventory::testing::TempDatabase;
+
+constexpr int kItems = 2000;
+
+// Collects the results the search thread hands over.
+class Results {
+public:
+    inventory::LiveSearch::ResultHandler Handler() {
+        return [this](inventory::LiveSearchResult result) {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                results_.push_back(std::move(result));
+            }
+            arrived_.notify_all();
+        };
+    }
+
+    // Waits until |count| results have arrived; false on timeout.
+    bool WaitFor(size_t count, std::chrono::milliseconds timeout = std::chrono::seconds(10)) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        return arrived_.wait_for(lock, timeout, [&] { return results_.size() >= count; });
+    }
+
+    std::vector<inventory::LiveSearchResult> Take() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return std::move(results_);
+    }
+
+private:
+    std::mutex mutex_;
+    std::condition_variable arrived_;
+    std::vector<inventory::LiveSearchResult> results_;
+};
+
+bool Fill(const std::string& path) {
+    inventory::Database database;
+    return database.Open(path) && database.Configure(inventory::StorageOptions()) &&
+           inventory::EnsureSchema(database) && InsertTestItems(database, kItems);
+}
+
+inventory::LiveSearchOptions Debounced(int debounce_ms) {
+    inventory::LiveSearchOptions options;
+    options.debounce_ms = debounce_ms;
+    return options;
+}
+
+inventory::SearchFilter NameFilter(const char* name) {
+    inventory::SearchFilter filter;
+    filter.name = name;
+    return filter;
+}
+
+// Typing restarts the debounce, so a burst of keystrokes runs one query, for
+// the last filter, and the generations in between never produce a result.
+TEST(DebounceDropsStaleGenerations) {
+    TempDatabase file("inventory_test_live_debounce.db");
+    REQUIRE(Fill(file.path()));
+    Results results;
+    inventory::LiveSearch search;
+    REQUIRE(search.Start(file.path(), inventory::StorageOptions(), Debounced(100),
+                         results.Handler()));
+
+    uint64_t last = 0;
+    for (const char* typed : {"H", "He", "Hex", "Hex ", "Hex b"}) {
+        const uint64_t generation = search.Submit(NameFilter(typed));
+        CHECK(generation > last);
+        last = generation;
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    REQUIRE(results.WaitFor(1));
+    // Long enough for a stale generation to show up if one were going to.
+    std::this_thread::sleep_for(std::chrono::milliseconds(250));
+    const std::vector<inventory::LiveSearchResult> delivered = results.Take();
+    REQUIRE(delivered.size() == 1);
+    CHECK(delivered[0].generation == last);
+    CHECK(delivered[0].filter.name == "Hex b");
+    CHECK(delivered[0].complete && !delivered[0].refined);
+    CHECK(delivered[0].total_count == kItems / 8);
+    CHECK(delivered[0].latency_us >= 100 * 1000);
+
+    const inventory::LiveSearchStats stats = search.stats();
+    CHECK(stats.keystrokes == 5);
+    CHECK(stats.queries == 1);
+
+    // A cancelled search produces nothing at all.
+    search.Submit(NameFilter("Relay"));
+    search.Cancel();
+    std::this_thread::sleep_for(std::chrono::milliseconds(250));
+    CHECK(results.Take().empty());
+    search.Stop();
+}
+
+// LIKE, slowed down on connections opened from now on, so that a query is
+// still running when the next keystroke arrives. Counts the rows the slow
+// pattern was tested against.
+std::atomic<int> g_slow_rows{0};
+constexpr char kSlowPattern[] = "%o%";
+
+void SlowLike(sqlite3_context* context, int, sqlite3_value** argv) {
+    const char* pattern = reinterpret_cast<const char*>(sqlite3_value_text(argv[0]));
+    const char* value = reinterpret_cast<const char*>(sqlite3_value_text(argv[1]));
+    if (pattern && std::strcmp(pattern, kSlowPattern) == 0) {
+        g_slow_rows.fetch_add(1);
+        std::this_thread::sleep_for(std::chrono::microseconds(500));
+    }
+    // Every name is ASCII, so a plain case-insensitive substring test will do.
+    std::string term = pattern ? std::string(pattern) : std::string();
+    if (term.size() >= 2 && term.front() == '%' && term.back() == '%') {
+        term = term.substr(1, term.size() - 2);
+    }
+    std::string text = value ? value : "";
+    for (char& c : term) {
+        c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    }
+    for (char& c : text) {
+        c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    }
+    sqlite3_result_int(context, text.find(term) != std::string::npos ? 1 : 0);
+}
+
+int RegisterSlowLike(sqlite3* db, char**, const sqlite3_api_routines*) {
+    return sqlite3_create_function(db, "like", 2, SQLITE_UTF8, nullptr, SlowLike, nullptr,
+                                   nullptr);
+}
+
+// A new keystroke interrupts the query that is already running, through the
+// progress handler, instead of waiting for it to finish.
+TEST(ProgressHandlerInterruptsSupersededQuery) {
+    TempDatabase file("inventory_test_live_interrupt.db");
+    REQUIRE(Fill(file.path()));
+    Results results;
+    inventory::LiveSearch search;
+    using Init = void (*)();
+    sqlite3_auto_extension(reinterpret_cast<Init>(RegisterSlowLike));
+    const bool started =
+        search.Start(file.path(), inventory::StorageOptions(), Debounced(0), results.Handler());
+    sqlite3_cancel_auto_extension(reinterpret_cast<Init>(RegisterSlowLike));
+    REQUIRE(started);
+
+    g_slow_rows = 0;
+    search.Submit(NameFilter("o"));
+    // The slow query takes a full second; wait for it to be well under way.
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (g_slow_rows.load() < 50 && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    REQUIRE(g_slow_rows.load() >= 50);
+    const auto superseded_at = std::chrono::steady_clock::now();
+    const uint64_t generation = search.Submit(NameFilter("Relay"));
+    REQUIRE(results.WaitFor(1));
+    const auto waited = std::chrono::steady_clock::now() - superseded_at;
+
+    const std::vector<inventory::LiveSearchResult> delivered = results.Take();
+    REQUIRE(delivered.size() == 1);
+    CHECK(delivered[0].generation == generation);
+    CHECK(delivered[0].total_count == kItems / 8);
+    CHECK(g_slow_rows.load() < kItems);
+    CHECK(search.stats().cancelled == 1);
+    CHECK(search.stats().queries == 2);
+    CHECK(waited < std::chrono::milliseconds(500));
+    search.Stop();
+}
+
+// A narrower filter is answered from the previous result in memory, and
+// gives exactly the rows, in the same order, that a fresh query does.
+TEST(RefineMatchesFreshQuery) {
+    TempDatabase file("inventory_test_live_refine.db");
+    REQUIRE(Fill(file.path()));
+    Results results;
+    inventory::LiveSearch search;
+    REQUIRE(search.Start(file.path(), inventory::StorageOptions(), Debounced(0),
+                         results.Handler()));
+
+    // Each pair is a filter and a narrower one typed after it.
+    std::vector<std::pair<inventory::SearchFilter, inventory::SearchFilter>> steps;
+    inventory::SearchFilter filter = NameFilter("o");
+    for (int step = 0; step < 4; ++step) {
+        const inventory::SearchFilter broad = filter;
+        switch (step) {
+            case 0:
+                filter.name = "ol";
+                break;
+            case 1:
+                filter.nsn = "-01-1";
+                break;
+            case 2:
+                filter.part_number = "P-001";
+                break;
+            case 3:
+                filter.has_quantity = true;
+                filter.quantity = 20;
+                break;
+        }
+        steps.emplace_back(broad, filter);
+    }
+    // An exact identifier only narrows itself.
+    inventory::SearchFilter exact;
+    exact.serial_number = "=sn-000106";
+    filter = exact;
+    filter.name = "u";
+    steps.emplace_back(exact, filter);
+
+    size_t matched = 0;
+    for (const auto& [broad, next] : steps) {
+        search.Invalidate();
+        search.Submit(broad);
+        REQUIRE(results.WaitFor(1));
+        std::vector<inventory::LiveSearchResult> first = results.Take();
+        REQUIRE(first.size() == 1 && first[0].complete && !first[0].refined);
+
+        search.Submit(next);
+        REQUIRE(results.WaitFor(1));
+        std::vector<inventory::LiveSearchResult> refined = results.Take();
+        REQUIRE(refined.size() == 1);
+        CHECK(refined[0].refined && refined[0].complete);
+
+        search.Invalidate();
+        search.Submit(next);
+        REQUIRE(results.WaitFor(1));
+        std::vector<inventory::LiveSearchResult> fresh = results.Take();
+        REQUIRE(fresh.size() == 1);
+        CHECK(!fresh[0].refined && fresh[0].complete);
+        CHECK(refined[0].ids == fresh[0].ids);
+        CHECK(refined[0].total_count == fresh[0].total_count);
+        matched += fresh[0].ids.empty() ? 0 : 1;
+    }
+    CHECK(matched == steps.size());
+    CHECK(search.stats().refinements == steps.size());
+    search.Stop();
+}
+
+// A refine abandoned for a newer keystroke must not spoil the result it was
+// narrowing: the next narrower filter still refines from the whole of it.
+TEST(SupersededRefineKeepsPreviousResult) {
+    constexpr int kRefineItems = 20000;
+    TempDatabase file("inventory_test_live_superseded_refine.db");
+    {
+        // Long names keep the refine busy long enough to be caught part way.
+        inventory::Database database;
+        REQUIRE(database.Open(file.path()) &&
+                database.Configure(inventory::StorageOptions()) &&
+                inventory::EnsureSchema(database) && database.Execute("BEGIN"));
+        for (int i = 0; i < kRefineItems; ++i) {
+            inventory::Item item = inventory::testing::TestItem(i);
+            item.name = std::string(200, 'x') + item.name;
+            REQUIRE(inventory::InsertItem(database, item));
+        }
+        REQUIRE(database.Execute("COMMIT"));
+    }
+    Results results;
+    inventory::LiveSearch search;
+    REQUIRE(search.Start(file.path(), inventory::StorageOptions(), Debounced(0),
+                         results.Handler()));
+
+    // "Relay" does not narrow "24 V", so it is only refined when the refine
+    // for "24 V" was abandoned before replacing the result; the rows that
+    // refine had already matched are the ones "Relay" must find again.
+    bool abandoned = false;
+    for (int attempt = 0; attempt < 20 && !abandoned; ++attempt) {
+        search.Invalidate();
+        search.Submit(inventory::SearchFilter());
+        REQUIRE(results.WaitFor(1));
+        std::vector<inventory::LiveSearchResult> all = results.Take();
+        REQUIRE(all.size() == 1 && all[0].complete && all[0].total_count == kRefineItems);
+
+        const uint64_t refinements = search.stats().refinements;
+        search.Submit(NameFilter("24 V"));
+        while (search.stats().refinements == refinements) {
+            std::this_thread::yield();
+        }
+        const uint64_t generation = search.Submit(NameFilter("Relay"));
+        // The refine for "24 V" may still have finished and been handed over.
+        std::vector<inventory::LiveSearchResult> last;
+        while (last.empty() || last.back().generation != generation) {
+            REQUIRE(results.WaitFor(1));
+            for (auto& result : results.Take()) {
+                last.push_back(std::move(result));
+            }
+        }
+        REQUIRE(last.back().complete);
+        abandoned = last.back().refined;
+
+        search.Invalidate();
+        search.Submit(NameFilter("Relay"));
+        REQUIRE(results.WaitFor(1));
+        std::vector<inventory::LiveSearchResult> fresh = results.Take();
+        REQUIRE(fresh.size() == 1 && !fresh[0].refined);
+        CHECK(fresh[0].total_count == kRefineItems / 8);
+        CHECK(last.back().ids == fresh[0].ids);
+    }
+    CHECK(abandoned);
+    CHECK(search.stats().cancelled >= 1);
+    search.Stop();
+}
+
+}  // namespace
+
+int main() {
+    return inventory::testing::RunTests();
+}
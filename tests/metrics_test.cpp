@@ -0,0 +1,140 @@
+#include <cstdint>
+#include <limits>
+#include <thread>
+#include <vector>
+
+#include "metrics.h"
+#include "search_filter.h"
+#include "test_support.h"
+
+namespace {
+
+using inventory::HistogramSnapshot;
+using inventory::kHistogramBuckets;
+using inventory::kHistogramSubBuckets;
+using inventory::LatencyHistogram;
+
+// Small values have a bucket each; above them the buckets tile the whole
+// uint64_t range without gaps, and none is wider than 1/16 of its values.
+TEST(BucketBoundaries) {
+    for (uint64_t ns = 0; ns < kHistogramSubBuckets; ++ns) {
+        CHECK(LatencyHistogram::BucketIndex(ns) == static_cast<int>(ns));
+        CHECK(LatencyHistogram::BucketUpperBound(static_cast<int>(ns)) == ns);
+    }
+    for (int index = 1; index < kHistogramBuckets; ++index) {
+        const uint64_t lower = LatencyHistogram::BucketUpperBound(index - 1) + 1;
+        const uint64_t upper = LatencyHistogram::BucketUpperBound(index);
+        CHECK(lower <= upper);
+        CHECK(LatencyHistogram::BucketIndex(lower) == index);
+        CHECK(LatencyHistogram::BucketIndex(upper) == index);
+        CHECK((upper - lower) * kHistogramSubBuckets < lower);
+    }
+    CHECK(LatencyHistogram::BucketIndex(16) == 16);
+    CHECK(LatencyHistogram::BucketIndex(31) == 31);
+    CHECK(LatencyHistogram::BucketIndex(32) == 32);
+    CHECK(LatencyHistogram::BucketIndex(33) == 32);
+    CHECK(LatencyHistogram::BucketUpperBound(kHistogramBuckets - 1) ==
+          std::numeric_limits<uint64_t>::max());
+    CHECK(LatencyHistogram::BucketIndex(std::numeric_limits<uint64_t>::max()) ==
+          kHistogramBuckets - 1);
+}
+
+// A percentile is the upper bound of the bucket holding that rank, never
+// more than the largest value recorded.
+TEST(PercentileMath) {
+    LatencyHistogram histogram;
+    CHECK(histogram.Snapshot().Percentile(0.5) == 0);
+    CHECK(histogram.Snapshot().MeanNs() == 0.0);
+
+    for (uint64_t ns = 1; ns <= 1000; ++ns) {
+        histogram.Record(ns);
+    }
+    const HistogramSnapshot snapshot = histogram.Snapshot();
+    CHECK(snapshot.count == 1000);
+    CHECK(snapshot.sum_ns == 500500);
+    CHECK(snapshot.max_ns == 1000);
+    CHECK(snapshot.MeanNs() == 500.5);
+    for (const double quantile : {0.5, 0.9, 0.99}) {
+        const uint64_t exact = static_cast<uint64_t>(quantile * 1000);
+        const uint64_t percentile = snapshot.Percentile(quantile);
+        CHECK(percentile ==
+              LatencyHistogram::BucketUpperBound(LatencyHistogram::BucketIndex(exact)));
+        CHECK(percentile >= exact);
+        CHECK(percentile <= exact + exact / kHistogramSubBuckets);
+    }
+    // The rank is rounded and at least 1, and quantiles out of range clamp.
+    CHECK(snapshot.Percentile(0.0) == 1);
+    CHECK(snapshot.Percentile(-1.0) == 1);
+    CHECK(snapshot.Percentile(1.0) == 1000);
+    CHECK(snapshot.Percentile(2.0) == 1000);
+
+    // One slow outlier: p99 of 100 values is the 99th, the maximum is the
+    // outlier itself rather than its bucket's upper bound.
+    LatencyHistogram outlier;
+    for (int i = 0; i < 99; ++i) {
+        outlier.Record(10);
+    }
+    outlier.Record(1000003);
+    CHECK(outlier.Snapshot().Percentile(0.99) == 10);
+    CHECK(outlier.Snapshot().Percentile(1.0) == 1000003);
+}
+
+// Record from many threads at once loses nothing.
+TEST(ConcurrentRecord) {
+    constexpr int kThreads = 8;
+    constexpr uint64_t kPerThread = 200000;
+    LatencyHistogram histogram;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kThreads; ++t) {
+        threads.emplace_back([&histogram, t] {
+            for (uint64_t i = 0; i < kPerThread; ++i) {
+                histogram.Record(i % 64 + static_cast<uint64_t>(t) * 1000);
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    const HistogramSnapshot snapshot = histogram.Snapshot();
+    CHECK(snapshot.count == kThreads * kPerThread);
+    uint64_t sum = 0;
+    std::vector<uint64_t> buckets(kHistogramBuckets);
+    for (int t = 0; t < kThreads; ++t) {
+        for (uint64_t i = 0; i < kPerThread; ++i) {
+            const uint64_t ns = i % 64 + static_cast<uint64_t>(t) * 1000;
+            sum += ns;
+            ++buckets[LatencyHistogram::BucketIndex(ns)];
+        }
+    }
+    CHECK(snapshot.sum_ns == sum);
+    CHECK(snapshot.max_ns == (kThreads - 1) * 1000 + 63);
+    CHECK(snapshot.buckets == buckets);
+}
+
+// Threads asking for the same shape at once all get the one histogram.
+TEST(ConcurrentShapeAllocation) {
+    constexpr int kThreads = 8;
+    inventory::MetricsRegistry registry;
+    const uint32_t shape = inventory::SearchShape(inventory::kSearchCount, 3);
+    std::vector<LatencyHistogram*> seen(kThreads);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kThreads; ++t) {
+        threads.emplace_back([&, t] {
+            seen[t] = &registry.shape(shape);
+            seen[t]->Record(100);
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    for (LatencyHistogram* histogram : seen) {
+        CHECK(histogram == seen[0]);
+    }
+    CHECK(registry.shape(shape).Snapshot().count == kThreads);
+}
+
+}  // namespace
+
+int main() {
+    return inventory::testing::RunTests();
+}
@@ -0,0 +1,223 @@
+#include <sqlite3.h>
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "item_pager.h"
+#include "schema.h"
+#include "search_filter.h"
+#include "test_support.h"
+
+namespace {
+
+using inventory::testing::InsertTestItems;
+using inventory::testing::OpenMemory;
+
+enum class Terms {
+    // Substrings, scanned.
+    kScan,
+    // Substrings long enough for items_fts, which only uses it for two or
+    // more of them together.
+    kTrigram,
+    // The same, except that the name, NSN and serial number terms are long
+    // enough to go to items_fts on their own.
+    kLongTrigram,
+    // Whole identifiers, looked up by key; the name stays a substring.
+    kExact,
+};
+
+const char* TermsName(Terms terms) {
+    switch (terms) {
+        case Terms::kScan:
+            return "scan";
+        case Terms::kTrigram:
+            return "trigram";
+        case Terms::kLongTrigram:
+            return "long trigram";
+        case Terms::kExact:
+            return "exact";
+    }
+    return "";
+}
+
+inventory::SearchFilter MakeFilter(unsigned mask, Terms terms) {
+    inventory::SearchFilter filter;
+    const bool trigram = terms == Terms::kTrigram || terms == Terms::kLongTrigram;
+    filter.mode = trigram ? inventory::SearchMode::kTrigramIndex : inventory::SearchMode::kScan;
+    const bool exact = terms == Terms::kExact;
+    const bool long_terms = terms == Terms::kLongTrigram;
+    if (mask & inventory::kFilterName) {
+        filter.name = terms == Terms::kScan ? "ol" : long_terms ? "Hex bolt" : "bolt";
+    }
+    if (mask & inventory::kFilterPartNumber) {
+        filter.part_number = exact ? "=p 00012" : "P-000";
+    }
+    if (mask & inventory::kFilterNsn) {
+        filter.nsn = exact ? "5305 01 012 0012" : long_terms ? "5305-01-01" : "-01-0";
+    }
+    if (mask & inventory::kFilterSerialNumber) {
+        filter.serial_number = exact ? "=sn000012" : long_terms ? "SN-000012" : "SN-00";
+    }
+    if (mask & inventory::kFilterQuantity) {
+        filter.has_quantity = true;
+        filter.quantity = 12;
+    }
+    return filter;
+}
+
+// Every step of the plan, one per line.
+std::string QueryPlan(inventory::Database& database, const char* sql) {
+    std::string plan;
+    sqlite3_stmt* explain = nullptr;
+    const std::string text = std::string("EXPLAIN QUERY PLAN ") + sql;
+    if (sqlite3_prepare_v2(database.handle(), text.c_str(), -1, &explain, nullptr) != SQLITE_OK) {
+        return "(" + std::string(sqlite3_errmsg(database.handle())) + ")";
+    }
+    while (sqlite3_step(explain) == SQLITE_ROW) {
+        const unsigned char* detail = sqlite3_column_text(explain, 3);
+        plan += detail ? reinterpret_cast<const char*>(detail) : "";
+        plan += "\n";
+    }
+    sqlite3_finalize(explain);
+    return plan;
+}
+
+bool Contains(const std::string& plan, const char* step) {
+    return plan.find(step) != std::string::npos;
+}
+
+// A step reading every row of items from the table itself.
+bool ScansTable(const std::string& plan) {
+    return ("\n" + plan).find("\nSCAN items\n") != std::string::npos;
+}
+
+// The key index serving one of |filter|'s exact identifiers.
+bool UsesKeyIndex(const std::string& plan, unsigned exact) {
+    return ((exact & inventory::kFilterNsn) && Contains(plan, "idx_items_nsn_key (nsn_key=?)")) ||
+           ((exact & inventory::kFilterPartNumber) &&
+            Contains(plan, "idx_items_part_key (part_key=?)")) ||
+           ((exact & inventory::kFilterSerialNumber) &&
+            Contains(plan, "idx_items_serial_key (serial_key=?)"));
+}
+
+bool UsesTrigramIndex(const std::string& plan) {
+    return Contains(plan, "SCAN items_fts VIRTUAL TABLE INDEX") &&
+           Contains(plan, "SEARCH items USING INTEGER PRIMARY KEY (rowid=?)");
+}
+
+void Report(bool ok, Terms terms, unsigned mask, const char* query, const std::string& plan) {
+    if (!CHECK(ok)) {
+        std::fprintf(stderr, "  %s terms, shape %u, %s:\n%s", TermsName(terms), mask, query,
+                     plan.c_str());
+    }
+}
+
+// The plan each search shape is meant to get, for the count and for the four
+// page queries: an exact identifier is one probe of its key index, indexed
+// terms go through items_fts, and everything else walks idx_items_recent in
+// listing order, from the anchor when there is one, without sorting. No
+// search reads the table itself from end to end.
+void CheckShapes(Terms terms) {
+    inventory::Database database;
+    REQUIRE(OpenMemory(database));
+    const bool trigram = terms == Terms::kTrigram || terms == Terms::kLongTrigram;
+    if (trigram && !inventory::TrigramIndexAvailable(database)) {
+        std::printf("note: SQLite has no FTS5, trigram plans not checked\n");
+        return;
+    }
+    REQUIRE(InsertTestItems(database, 2000));
+    REQUIRE(database.Execute("ANALYZE"));
+
+    for (unsigned mask = 0; mask < inventory::kFilterShapeCount; ++mask) {
+        const inventory::SearchFilter filter = MakeFilter(mask, terms);
+        const unsigned exact = filter.ExactMask();
+        const unsigned indexed = filter.IndexedMask();
+        CHECK(exact == (terms == Terms::kExact ? mask & ~(inventory::kFilterName |
+                                                          inventory::kFilterQuantity)
+                                               : 0u));
+        const unsigned text = mask & ~inventory::kFilterQuantity;
+        const unsigned lone = terms == Terms::kLongTrigram ? text & ~inventory::kFilterPartNumber
+                                                           : 0u;
+        CHECK(indexed == (!trigram ? 0u : (text & (text - 1)) ? text : lone));
+
+        std::string count_sql = "SELECT COUNT(*) FROM items";
+        inventory::AppendFilterConditions(filter, count_sql);
+        const std::string count_plan = QueryPlan(database, count_sql.c_str());
+        bool ok = !ScansTable(count_plan);
+        if (exact) {
+            ok = ok && UsesKeyIndex(count_plan, exact);
+        } else if (indexed) {
+            ok = ok && UsesTrigramIndex(count_plan);
+        } else {
+            ok = ok && Contains(count_plan, "USING COVERING INDEX");
+        }
+        Report(ok, terms, mask, "count", count_plan);
+
+        for (const auto direction :
+             {inventory::PageDirection::kOlder, inventory::PageDirection::kNewer}) {
+            for (const bool keyed : {false, true}) {
+                inventory::Statement page =
+                    inventory::PreparePage(database, filter, direction, keyed);
+                REQUIRE(page);
+                const std::string plan = QueryPlan(database, sqlite3_sql(page.get()));
+                const bool older = direction == inventory::PageDirection::kOlder;
+                ok = !ScansTable(plan);
+                if (exact) {
+                    ok = ok && UsesKeyIndex(plan, exact);
+                } else if (indexed) {
+                    ok = ok && UsesTrigramIndex(plan);
+                } else {
+                    ok = ok && Contains(plan, "COVERING INDEX idx_items_recent") &&
+                         !Contains(plan, "TEMP B-TREE");
+                    if (keyed) {
+                        ok = ok && Contains(plan, older ? "(created_at<?)" : "(created_at>?)");
+                    }
+                }
+                char query[64];
+                std::snprintf(query, sizeof(query), "%s page%s", older ? "older" : "newer",
+                              keyed ? ", keyed" : "");
+                Report(ok, terms, mask, query, plan);
+            }
+        }
+    }
+}
+
+TEST(ScanShapes) {
+    CheckShapes(Terms::kScan);
+}
+
+TEST(TrigramShapes) {
+    CheckShapes(Terms::kTrigram);
+}
+
+TEST(LongTrigramShapes) {
+    CheckShapes(Terms::kLongTrigram);
+}
+
+TEST(ExactShapes) {
+    CheckShapes(Terms::kExact);
+}
+
+// The migrations leave the indexes the plans above rely on.
+TEST(MigratedIndexes) {
+    inventory::Database database;
+    REQUIRE(OpenMemory(database));
+    CHECK(inventory::SchemaVersion(database) == inventory::kSchemaVersion);
+    for (const char* index : {"idx_items_recent", "idx_items_nsn_key", "idx_items_part_key",
+                              "idx_items_serial_key"}) {
+        inventory::Statement statement = database.Prepare(
+            "SELECT 1 FROM sqlite_master WHERE type = 'index' AND name = ?");
+        REQUIRE(statement);
+        sqlite3_bind_text(statement.get(), 1, index, -1, SQLITE_STATIC);
+        if (!CHECK(sqlite3_step(statement.get()) == SQLITE_ROW)) {
+            std::fprintf(stderr, "  missing %s\n", index);
+        }
+    }
+}
+
+}  // namespace
+
+int main() {
+    return inventory::testing::RunTests();
+}
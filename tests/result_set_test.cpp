@@ -0,0 +1,93 @@
+#include <string>
+#include <vector>
+
+#include "result_set.h"
+#include "test_support.h"
+
+namespace {
+
+// Decodes |text| into a buffer of exactly the documented size, plus a guard
+// unit that must be left alone.
+std::u16string Decode(const std::string& text) {
+    constexpr char16_t kGuard = 0x2A2A;
+    std::vector<char16_t> out(text.size() + 1, kGuard);
+    const size_t written = inventory::Utf8ToUtf16(text.data(), text.size(), out.data());
+    CHECK(written <= text.size());
+    CHECK(out[text.size()] == kGuard);
+    return std::u16string(out.data(), written);
+}
+
+// Every length around the eight-byte ASCII block, so that the tail after the
+// last whole block is decoded one byte at a time.
+TEST(Ascii) {
+    CHECK(Decode("").empty());
+    std::string text;
+    std::u16string expected;
+    for (int length = 1; length <= 25; ++length) {
+        const char c = static_cast<char>('a' + length % 26);
+        text += c;
+        expected += static_cast<char16_t>(c);
+        CHECK(Decode(text) == expected);
+    }
+    CHECK(Decode(std::string("a\0b", 3)) == std::u16string(u"a\0b", 3));
+    CHECK(Decode("\x7F") == u"\x7F");
+}
+
+TEST(MultiByteSequences) {
+    // Two bytes: the lowest and highest, and a name with one in it.
+    CHECK(Decode("\xC2\x80") == u"\u0080");
+    CHECK(Decode("\xDF\xBF") == u"\u07FF");
+    CHECK(Decode("Ventil \xC3\x98" "12 mm") == u"Ventil \u00D812 mm");
+    // Three bytes, either side of the surrogate range.
+    CHECK(Decode("\xE0\xA0\x80") == u"\u0800");
+    CHECK(Decode("\xED\x9F\xBF") == u"\uD7FF");
+    CHECK(Decode("\xEE\x80\x80") == u"\uE000");
+    CHECK(Decode("\xEF\xBF\xBF") == u"\uFFFF");
+    CHECK(Decode("\xE2\x82\xAC" "5") == u"\u20AC" "5");
+    // Four bytes become a surrogate pair.
+    CHECK(Decode("\xF0\x90\x80\x80") == u"\U00010000");
+    CHECK(Decode("\xF0\x9F\x94\xA9") == u"\U0001F529");
+    CHECK(Decode("\xF4\x8F\xBF\xBF") == u"\U0010FFFF");
+    const std::u16string pair = Decode("\xF0\x9F\x94\xA9");
+    REQUIRE(pair.size() == 2);
+    CHECK(pair[0] == 0xD83D && pair[1] == 0xDD29);
+    // A sequence straddling an eight-byte block after ASCII.
+    CHECK(Decode("Hex bol\xC3\xA9 M8\xE2\x80\x93" "40") == u"Hex bol\u00E9 M8\u2013" "40");
+}
+
+// A sequence cut short by the end of the text gives one U+FFFD per byte.
+TEST(TruncatedInput) {
+    CHECK(Decode("\xC3") == u"\uFFFD");
+    CHECK(Decode("ab\xE2\x82") == u"ab\uFFFD\uFFFD");
+    CHECK(Decode("\xF0\x9F\x94") == u"\uFFFD\uFFFD\uFFFD");
+    CHECK(Decode("abcdefg\xF0\x9F") == u"abcdefg\uFFFD\uFFFD");
+}
+
+// Each byte that does not start a valid sequence becomes U+FFFD, and
+// decoding carries on with the next byte.
+TEST(InvalidInput) {
+    // Continuation bytes with no lead, and leads that never start a sequence.
+    CHECK(Decode("\x80") == u"\uFFFD");
+    CHECK(Decode("a\xBF" "b") == u"a\uFFFD" "b");
+    CHECK(Decode("\xC0\xAF") == u"\uFFFD\uFFFD");
+    CHECK(Decode("\xC1\xBF") == u"\uFFFD\uFFFD");
+    CHECK(Decode("\xF5\x80\x80\x80") == u"\uFFFD\uFFFD\uFFFD\uFFFD");
+    CHECK(Decode("\xFF") == u"\uFFFD");
+    // A lead followed by something other than a continuation byte.
+    CHECK(Decode("\xC3" "A") == u"\uFFFD" "A");
+    CHECK(Decode("\xE2\x82" "A") == u"\uFFFD\uFFFD" "A");
+    // Overlong forms, UTF-16 surrogates, and code points past U+10FFFF.
+    CHECK(Decode("\xE0\x80\xAF") == u"\uFFFD\uFFFD\uFFFD");
+    CHECK(Decode("\xF0\x80\x80\xAF") == u"\uFFFD\uFFFD\uFFFD\uFFFD");
+    CHECK(Decode("\xED\xA0\x80") == u"\uFFFD\uFFFD\uFFFD");
+    CHECK(Decode("\xED\xBF\xBF") == u"\uFFFD\uFFFD\uFFFD");
+    CHECK(Decode("\xF4\x90\x80\x80") == u"\uFFFD\uFFFD\uFFFD\uFFFD");
+    // Valid text either side of a bad byte is untouched.
+    CHECK(Decode("P-00\xFF" "12\xC3\xA9") == u"P-00\uFFFD" "12\u00E9");
+}
+
+}  // namespace
+
+int main() {
+    return inventory::testing::RunTests();
+}
@@ -0,0 +1,214 @@
+#include <sqlite3.h>
+
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "database.h"
+#include "items.h"
+#include "rollups.h"
+#include "schema.h"
+#include "stock_ledger.h"
+#include "test_support.h"
+
+namespace {
+
+using inventory::testing::InsertTestItems;
+using inventory::testing::OpenMemory;
+using inventory::testing::TestItem;
+
+bool InsertSpelled(inventory::Database& database, const char* nsn, const char* part,
+                   int quantity) {
+    static int serial = 100000;
+    inventory::Item item = TestItem(serial++);
+    item.nsn = nsn;
+    item.part_number = part;
+    item.quantity = quantity;
+    return inventory::InsertItem(database, item);
+}
+
+bool RollupsMatchItems(inventory::Database& database) {
+    inventory::RollupCheck check;
+    if (!inventory::CheckRollups(database, check)) {
+        return false;
+    }
+    for (const inventory::RollupMismatch& mismatch : check.mismatches) {
+        std::fprintf(stderr, "  %s group %s differs\n", inventory::RollupKindName(mismatch.kind),
+                     (mismatch.expected.value.empty() ? mismatch.stored : mismatch.expected)
+                         .value.c_str());
+    }
+    return check.mismatches.empty();
+}
+
+// NSNs and part numbers typed with or without dashes and spaces are one
+// group, shown as its oldest item spells it; an NSN that does not parse
+// groups as stored.
+TEST(SpellingsShareAGroup) {
+    inventory::Database database;
+    REQUIRE(OpenMemory(database));
+    REQUIRE(InsertSpelled(database, "5305-01-123-4567", "ab-100", 1));
+    REQUIRE(InsertSpelled(database, "5305011234567", "AB100", 2));
+    REQUIRE(InsertSpelled(database, "5305 01 123 4567", "AB 100", 4));
+    REQUIRE(InsertSpelled(database, "N/A", "AB-100", 8));
+    REQUIRE(InsertSpelled(database, "N/A", "CD-7", 16));
+    REQUIRE(InsertSpelled(database, "n/a", "CD-7", 32));
+
+    std::vector<inventory::Rollup> rollups;
+    inventory::RollupQuery query;
+    REQUIRE(inventory::QueryRollups(database, query, rollups));
+    REQUIRE(rollups.size() == 3);
+    CHECK(rollups[0].value == "5305-01-123-4567" && rollups[0].items == 3 &&
+          rollups[0].quantity == 7);
+    CHECK(rollups[1].value == "N/A" && rollups[1].quantity == 24);
+    CHECK(rollups[2].value == "n/a" && rollups[2].quantity == 32);
+
+    query.kind = inventory::RollupKind::kPartNumber;
+    REQUIRE(inventory::QueryRollups(database, query, rollups));
+    REQUIRE(rollups.size() == 2);
+    CHECK(rollups[0].value == "CD-7" && rollups[0].quantity == 48);
+    CHECK(rollups[1].value == "ab-100" && rollups[1].items == 4 && rollups[1].quantity == 15);
+
+    inventory::Rollup rollup;
+    CHECK(inventory::LoadRollup(database, inventory::RollupKind::kNsn, "5305-01-123-4567",
+                                rollup) &&
+          rollup.items == 3);
+    CHECK(inventory::LoadRollup(database, inventory::RollupKind::kPartNumber, "ab100", rollup) &&
+          rollup.items == 4);
+    CHECK(!inventory::LoadRollup(database, inventory::RollupKind::kPartNumber, "AB-101", rollup));
+
+    // The display value moves on when the item spelling it leaves.
+    REQUIRE(database.Execute("DELETE FROM items WHERE nsn = '5305-01-123-4567'"));
+    CHECK(inventory::LoadRollup(database, inventory::RollupKind::kNsn, "5305 01 123 4567",
+                                rollup) &&
+          rollup.value == "5305011234567" && rollup.items == 2);
+    CHECK(RollupsMatchItems(database));
+}
+
+// Random saves, edits, deletes and stock deltas keep every rollup equal to
+// the items added up from scratch, including edits that only respell a
+// value within its group.
+TEST(TriggersMatchRebuild) {
+    static const char* const kNsns[] = {"5305-01-000-0001", "5305010000001", "5305-01-000-0002",
+                                        "4730 00 111 2222", "4730-00-111-2222", "unknown"};
+    static const char* const kParts[] = {"p-1", "P1", "P 1", "P-2", "p2", "X-9"};
+    inventory::Database database;
+    REQUIRE(OpenMemory(database));
+    REQUIRE(InsertTestItems(database, 40));
+    std::mt19937 random(11);
+    std::vector<sqlite3_int64> ids;
+    for (sqlite3_int64 id = 1; id <= 40; ++id) {
+        ids.push_back(id);
+    }
+    for (int step = 0; step < 400; ++step) {
+        const int action = static_cast<int>(random() % 4);
+        if (action == 0 || ids.empty()) {
+            inventory::Item item = TestItem(1000 + step);
+            item.nsn = kNsns[random() % 6];
+            item.part_number = kParts[random() % 6];
+            sqlite3_int64 id = 0;
+            REQUIRE(inventory::InsertItem(database, item, &id));
+            ids.push_back(id);
+            continue;
+        }
+        const size_t index = random() % ids.size();
+        if (action == 1) {
+            inventory::Item item;
+            REQUIRE(inventory::LoadItem(database, ids[index], item));
+            item.nsn = kNsns[random() % 6];
+            item.part_number = kParts[random() % 6];
+            item.quantity = static_cast<int>(random() % 100);
+            REQUIRE(inventory::UpdateItem(database, item));
+        } else if (action == 2) {
+            REQUIRE(inventory::DeleteItem(database, ids[index]));
+            ids.erase(ids.begin() + static_cast<std::ptrdiff_t>(index));
+        } else {
+            REQUIRE(inventory::ApplyStockDeltas(
+                database, {{ids[index], static_cast<int>(random() % 21) - 10}}));
+        }
+        if (step % 50 == 49 && !CHECK(RollupsMatchItems(database))) {
+            return;
+        }
+    }
+    CHECK(RollupsMatchItems(database));
+}
+
+// When an item leaves a group, the triggers find the group's next first and
+// last created_at and its oldest spelling in one probe of its index. SQLite
+// does not count an expression index as covering, so the plan alone does
+// not show that; the number of VM steps does.
+TEST(GroupLookupsAreOneProbe) {
+    constexpr int kGroupSize = 2000;
+    inventory::Database database;
+    REQUIRE(OpenMemory(database));
+    REQUIRE(database.Execute("BEGIN"));
+    for (int i = 0; i < kGroupSize; ++i) {
+        REQUIRE(InsertSpelled(database, "5305-01-123-4567", "AB-1", 1));
+    }
+    REQUIRE(database.Execute("COMMIT"));
+    for (int kind = 0; kind < static_cast<int>(inventory::RollupKind::kRollupKindCount); ++kind) {
+        const auto rollup_kind = static_cast<inventory::RollupKind>(kind);
+        const std::string key = inventory::RollupKey(rollup_kind);
+        const std::string group = " FROM items WHERE " + key + " = (SELECT " + key +
+                                  " FROM items WHERE id = 1)";
+        for (const std::string& sql :
+             {"SELECT MIN(created_at)" + group, "SELECT MAX(created_at)" + group,
+              std::string("SELECT ") + inventory::RollupColumn(rollup_kind) + group +
+                  " ORDER BY created_at, id LIMIT 1"}) {
+            inventory::Statement statement = database.Prepare(sql);
+            REQUIRE(statement);
+            REQUIRE(sqlite3_step(statement.get()) == SQLITE_ROW);
+            const int steps =
+                sqlite3_stmt_status(statement.get(), SQLITE_STMTSTATUS_VM_STEP, 0);
+            if (!CHECK(steps < 100)) {
+                std::fprintf(stderr, "  %s: %d steps\n", sql.c_str(), steps);
+            }
+        }
+    }
+}
+
+// A database whose rollups migration 8 keyed on the column as stored is
+// rekeyed when it is opened.
+TEST(MigrationRekeysVersion8) {
+    inventory::Database database;
+    REQUIRE(OpenMemory(database));
+    REQUIRE(InsertSpelled(database, "5305-01-123-4567", "AB-1", 1));
+    REQUIRE(InsertSpelled(database, "5305011234567", "ab1", 2));
+    REQUIRE(database.Execute(
+        "DROP TRIGGER rollup_insert; DROP TRIGGER rollup_delete;"
+        "DROP TRIGGER rollup_update; DROP TRIGGER rollup_quantity;"
+        "DROP TRIGGER stock_ledger_insert;"
+        "DROP INDEX idx_items_nsn_group; DROP INDEX idx_items_part_group;"
+        "DROP TABLE rollup_nsn; DROP TABLE rollup_part_number; DROP TABLE rollup_name;"
+        "CREATE INDEX idx_items_nsn_created ON items(nsn, created_at);"
+        "CREATE INDEX idx_items_part_created ON items(part_number, created_at);"
+        "CREATE TABLE rollup_nsn (value TEXT PRIMARY KEY, items INTEGER NOT NULL,"
+        " quantity INTEGER NOT NULL, first_created_at TEXT NOT NULL,"
+        " last_created_at TEXT NOT NULL) WITHOUT ROWID;"
+        "CREATE TABLE rollup_part_number (value TEXT PRIMARY KEY, items INTEGER NOT NULL,"
+        " quantity INTEGER NOT NULL, first_created_at TEXT NOT NULL,"
+        " last_created_at TEXT NOT NULL) WITHOUT ROWID;"
+        "CREATE TABLE rollup_name (value TEXT PRIMARY KEY, items INTEGER NOT NULL,"
+        " quantity INTEGER NOT NULL, first_created_at TEXT NOT NULL,"
+        " last_created_at TEXT NOT NULL) WITHOUT ROWID;"
+        "PRAGMA user_version = 8;"));
+
+    REQUIRE(inventory::EnsureSchema(database));
+    CHECK(inventory::SchemaVersion(database) == inventory::kSchemaVersion);
+    CHECK(RollupsMatchItems(database));
+    inventory::Rollup rollup;
+    CHECK(inventory::LoadRollup(database, inventory::RollupKind::kPartNumber, "AB1", rollup) &&
+          rollup.items == 2 && rollup.quantity == 3);
+    CHECK(inventory::testing::QueryIds(database,
+                                       "SELECT 1 FROM sqlite_master WHERE name IN"
+                                       " ('idx_items_nsn_created', 'idx_items_part_created')")
+              .empty());
+    REQUIRE(InsertSpelled(database, "5305 01 123 4567", "AB 1", 4));
+    CHECK(RollupsMatchItems(database));
+}
+
+}  // namespace
+
+int main() {
+    return inventory::testing::RunTests();
+}
@@ -0,0 +1,296 @@
+#include <sqlite3.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "item_pager.h"
+#include "result_set.h"
+#include "row_cache.h"
+#include "search_filter.h"
+#include "test_support.h"
+
+namespace {
+
+using inventory::testing::InsertTestItems;
+using inventory::testing::OpenMemory;
+using inventory::testing::QueryIds;
+
+constexpr int kItems = 53;
+
+// kItems items whose created_at comes in runs of five equal values, so that
+// most page boundaries fall between rows with the same created_at and only
+// the id tells them apart.
+bool OpenWithTies(inventory::Database& database) {
+    return OpenMemory(database) && InsertTestItems(database, kItems) &&
+           database.Execute("UPDATE items SET created_at ="
+                            " printf('2024-03-01 08:00:%02d.000', id / 5)");
+}
+
+std::vector<sqlite3_int64> ExpectedOrder(inventory::Database& database,
+                                         const std::string& where = "") {
+    return QueryIds(database, "SELECT id FROM items" + where +
+                                  " ORDER BY created_at DESC, id DESC");
+}
+
+void CheckRow(inventory::RowCache& cache, const std::vector<sqlite3_int64>& expected,
+              sqlite3_int64 index) {
+    inventory::RowRef row = cache.Row(index);
+    CHECK(row);
+    CHECK(row && row.id() == expected[static_cast<size_t>(index)]);
+}
+
+TEST(TiesShareCreatedAt) {
+    inventory::Database database;
+    REQUIRE(OpenWithTies(database));
+    const std::vector<sqlite3_int64> distinct = QueryIds(
+        database, "SELECT COUNT(*) FROM (SELECT DISTINCT created_at FROM items)");
+    REQUIRE(distinct.size() == 1);
+    CHECK(distinct[0] == kItems / 5 + 1);
+}
+
+TEST(RowCacheForward) {
+    inventory::Database database;
+    REQUIRE(OpenWithTies(database));
+    const std::vector<sqlite3_int64> expected = ExpectedOrder(database);
+    inventory::RowCache cache(4, 3);
+    REQUIRE(cache.Reset(database, inventory::SearchFilter()));
+    REQUIRE(cache.total_count() == kItems);
+    for (sqlite3_int64 i = 0; i < kItems; ++i) {
+        CheckRow(cache, expected, i);
+        CHECK(cache.resident_rows() <= 3 * 4);
+    }
+    CHECK(!cache.Row(kItems));
+    CHECK(!cache.Row(-1));
+    // Every page is read once, each one anchored on the page before it.
+    CHECK(cache.pages_loaded() == (kItems + 3) / 4);
+}
+
+TEST(RowCacheBackward) {
+    inventory::Database database;
+    REQUIRE(OpenWithTies(database));
+    const std::vector<sqlite3_int64> expected = ExpectedOrder(database);
+    inventory::RowCache cache(4, 3);
+    REQUIRE(cache.Reset(database, inventory::SearchFilter()));
+    for (sqlite3_int64 i = kItems - 1; i >= 0; --i) {
+        CheckRow(cache, expected, i);
+    }
+    CHECK(cache.pages_loaded() == (kItems + 3) / 4);
+}
+
+TEST(RowCacheJumpsAndComesBack) {
+    inventory::Database database;
+    REQUIRE(OpenWithTies(database));
+    const std::vector<sqlite3_int64> expected = ExpectedOrder(database);
+    inventory::RowCache cache(4, 3);
+    REQUIRE(cache.Reset(database, inventory::SearchFilter()));
+    // Pages are evicted and read again from whichever neighbour is nearest,
+    // in both directions.
+    std::mt19937 random(7);
+    for (int i = 0; i < 400; ++i) {
+        CheckRow(cache, expected, static_cast<sqlite3_int64>(random() % kItems));
+    }
+    for (sqlite3_int64 i = 0; i < kItems; i += 9) {
+        cache.Prefetch(i, i + 2);
+        CheckRow(cache, expected, i);
+        CHECK(cache.resident_rows() <= 3 * 4);
+    }
+}
+
+TEST(RowCacheFiltered) {
+    inventory::Database database;
+    REQUIRE(OpenWithTies(database));
+    const std::vector<sqlite3_int64> expected =
+        ExpectedOrder(database, " WHERE name LIKE '%o%'");
+    REQUIRE(!expected.empty());
+    inventory::SearchFilter filter;
+    filter.name = "o";
+    inventory::RowCache cache(3, 3);
+    REQUIRE(cache.Reset(database, filter));
+    REQUIRE(cache.total_count() == static_cast<sqlite3_int64>(expected.size()));
+    for (sqlite3_int64 i = cache.total_count() - 1; i >= 0; --i) {
+        CheckRow(cache, expected, i);
+    }
+    for (sqlite3_int64 i = 0; i < cache.total_count(); ++i) {
+        CheckRow(cache, expected, i);
+    }
+}
+
+// Only the screen and one page either side of it are decoded, and a count
+// the caller already has is used as it is.
+TEST(RowCachePrefetchMargin) {
+    inventory::Database database;
+    REQUIRE(OpenWithTies(database));
+    const std::vector<sqlite3_int64> expected = ExpectedOrder(database);
+    inventory::RowCache cache(4, 8);
+    REQUIRE(cache.Reset(database, inventory::SearchFilter(), kItems));
+    CHECK(cache.total_count() == kItems);
+    CHECK(cache.resident_rows() == 0);
+    cache.Prefetch(20, 27);
+    CHECK(cache.pages_loaded() == 4);
+    CHECK(cache.resident_rows() == 4 * 4);
+    for (sqlite3_int64 i = 16; i < 32; ++i) {
+        CheckRow(cache, expected, i);
+    }
+    CHECK(cache.pages_loaded() == 4);
+    // The last page is short, and there is nothing beyond it to prefetch.
+    cache.Prefetch(kItems - 1, kItems - 1);
+    CHECK(cache.resident_rows() <= 8 * 4);
+    CheckRow(cache, expected, kItems - 1);
+    CHECK(cache.pages_loaded() == 6);
+}
+
+int Interrupt(void*) {
+    return 1;
+}
+
+// A read that stops early, as when LiveSearch cancels a query, must not be
+// cached as a short page: the rows come back once reads succeed again.
+TEST(RowCacheInterruptedReadIsNotCached) {
+    inventory::Database database;
+    REQUIRE(OpenWithTies(database));
+    const std::vector<sqlite3_int64> expected = ExpectedOrder(database);
+    inventory::RowCache cache(4, 3);
+    REQUIRE(cache.Reset(database, inventory::SearchFilter()));
+    CheckRow(cache, expected, 0);
+
+    sqlite3_progress_handler(database.handle(), 1, Interrupt, nullptr);
+    CHECK(!cache.Row(5));
+    CHECK(!cache.Row(kItems - 1));
+    cache.ResetWithIds(database, {expected[3], expected[2]});
+    CHECK(!cache.Row(0));
+    CHECK(cache.resident_rows() == 0);
+    sqlite3_progress_handler(database.handle(), 0, nullptr, nullptr);
+
+    CHECK(cache.Row(0) && cache.Row(0).id() == expected[3]);
+    CHECK(cache.Row(1) && cache.Row(1).id() == expected[2]);
+    REQUIRE(cache.Reset(database, inventory::SearchFilter()));
+    sqlite3_progress_handler(database.handle(), 1, Interrupt, nullptr);
+    CHECK(!cache.Row(6));
+    sqlite3_progress_handler(database.handle(), 0, nullptr, nullptr);
+    for (sqlite3_int64 i = 0; i < kItems; ++i) {
+        CheckRow(cache, expected, i);
+    }
+}
+
+TEST(ItemPagerForwardAndBack) {
+    inventory::Database database;
+    REQUIRE(OpenWithTies(database));
+    const std::vector<sqlite3_int64> expected = ExpectedOrder(database);
+    inventory::ItemPager pager(4);
+    pager.Reset(inventory::SearchFilter());
+    inventory::ResultSet rows;
+
+    std::vector<std::vector<sqlite3_int64>> pages;
+    std::vector<sqlite3_int64> seen;
+    while (true) {
+        REQUIRE(pager.Next(database, rows));
+        if (rows.empty()) {
+            break;
+        }
+        pages.emplace_back();
+        for (size_t i = 0; i < rows.size(); ++i) {
+            pages.back().push_back(rows.id(i));
+            seen.push_back(rows.id(i));
+        }
+    }
+    CHECK(seen == expected);
+    REQUIRE(!pages.empty());
+
+    // Back from the last page to the first, page by page.
+    for (size_t page = pages.size() - 1; page-- > 0;) {
+        REQUIRE(pager.Previous(database, rows));
+        std::vector<sqlite3_int64> ids;
+        for (size_t i = 0; i < rows.size(); ++i) {
+            ids.push_back(rows.id(i));
+        }
+        CHECK(ids == pages[page]);
+    }
+    REQUIRE(pager.Previous(database, rows));
+    CHECK(rows.empty());
+    REQUIRE(pager.Next(database, rows));
+    CHECK(rows.size() == pages[1].size() && rows.id(0) == pages[1][0]);
+}
+
+std::vector<sqlite3_int64> PageIds(const inventory::ResultSet& rows) {
+    std::vector<sqlite3_int64> ids;
+    for (size_t i = 0; i < rows.size(); ++i) {
+        ids.push_back(rows.id(i));
+    }
+    return ids;
+}
+
+// Page boundaries that fall inside a run of equal created_at values, on its
+// first or last row, and between runs: every row is on exactly one page, in
+// both directions, whatever the page size and however long the runs. A row
+// that anchors the cursor may also be deleted before the next step.
+TEST(ItemPagerBoundaryTies) {
+    for (const int run : {1, 3, 4, 5, kItems}) {
+        inventory::Database database;
+        REQUIRE(OpenMemory(database) && InsertTestItems(database, kItems));
+        const std::string ties =
+            "UPDATE items SET created_at = printf('2024-03-01 08:00:%02d.000', (id - 1) / " +
+            std::to_string(run) + " % 60)";
+        REQUIRE(database.Execute(ties.c_str()));
+        const std::vector<sqlite3_int64> expected = ExpectedOrder(database);
+        REQUIRE(expected.size() == static_cast<size_t>(kItems));
+
+        for (int page_size = 1; page_size <= 6; ++page_size) {
+            inventory::ItemPager pager(page_size);
+            pager.Reset(inventory::SearchFilter());
+            inventory::ResultSet rows;
+            std::vector<std::vector<sqlite3_int64>> pages;
+            while (true) {
+                REQUIRE(pager.Next(database, rows));
+                if (rows.empty()) {
+                    break;
+                }
+                const size_t start = pages.size() * static_cast<size_t>(page_size);
+                const std::vector<sqlite3_int64> ids = PageIds(rows);
+                const std::vector<sqlite3_int64> slice(
+                    expected.begin() + static_cast<std::ptrdiff_t>(start),
+                    expected.begin() +
+                        static_cast<std::ptrdiff_t>(std::min(start + ids.size(), expected.size())));
+                if (!CHECK(ids == slice)) {
+                    std::fprintf(stderr, "  run %d, page size %d, page %zu\n", run, page_size,
+                                 pages.size());
+                }
+                pages.push_back(ids);
+            }
+            CHECK(pages.size() == static_cast<size_t>((kItems + page_size - 1) / page_size));
+            for (size_t page = pages.size() - 1; page-- > 0;) {
+                REQUIRE(pager.Previous(database, rows));
+                CHECK(PageIds(rows) == pages[page]);
+            }
+        }
+
+        // Delete the row each page ends on before asking for the next one.
+        inventory::ItemPager pager(4);
+        pager.Reset(inventory::SearchFilter());
+        inventory::ResultSet rows;
+        std::vector<sqlite3_int64> seen;
+        std::vector<sqlite3_int64> deleted;
+        while (true) {
+            REQUIRE(pager.Next(database, rows));
+            if (rows.empty()) {
+                break;
+            }
+            const std::vector<sqlite3_int64> ids = PageIds(rows);
+            seen.insert(seen.end(), ids.begin(), ids.end());
+            const std::string remove = "DELETE FROM items WHERE id = " + std::to_string(ids.back());
+            REQUIRE(database.Execute(remove.c_str()));
+            deleted.push_back(ids.back());
+        }
+        CHECK(seen == expected);
+        CHECK(ExpectedOrder(database).size() == expected.size() - deleted.size());
+    }
+}
+
+}  // namespace
+
+int main() {
+    return inventory::testing::RunTests();
+}
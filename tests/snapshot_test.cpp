@@ -0,0 +1,182 @@
+#include <sqlite3.h>
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "database.h"
+#include "items.h"
+#include "search_filter.h"
+#include "snapshot.h"
+#include "test_support.h"
+
+namespace {
+
+using inventory::testing::InsertTestItems;
+using inventory::testing::OpenMemory;
+using inventory::testing::TestItem;
+
+constexpr int kItems = 600;
+
+// kItems test items whose created_at comes in runs of seven equal values, so
+// that the order within each run is down to the id, and a few names that
+// LIKE folds only in their ASCII letters.
+bool OpenItems(inventory::Database& database) {
+    if (!OpenMemory(database) || !InsertTestItems(database, kItems) ||
+        !database.Execute("UPDATE items SET created_at ="
+                          " printf('2024-03-01 08:%02d:%02d.250', id / 7 / 60, id / 7 % 60)")) {
+        return false;
+    }
+    for (const char* name : {"Ventil \xC3\x98" "12 mm", "VENTIL \xC3\xB8" "12 MM",
+                             "Caf\xC3\xA9 filter"}) {
+        inventory::Item item = TestItem(kItems);
+        item.name = name;
+        if (!inventory::InsertItem(database, item)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// The ids the SQL search returns for |filter|, in display order.
+std::vector<sqlite3_int64> SqlSearch(inventory::Database& database,
+                                     const inventory::SearchFilter& filter) {
+    std::string sql = "SELECT id FROM items";
+    inventory::AppendFilterConditions(filter, sql);
+    sql += " ORDER BY created_at DESC, id DESC";
+    std::vector<sqlite3_int64> ids;
+    inventory::Statement statement = database.Prepare(sql);
+    if (!statement) {
+        return ids;
+    }
+    inventory::BindFilter(statement.get(), filter, 1);
+    while (sqlite3_step(statement.get()) == SQLITE_ROW) {
+        ids.push_back(sqlite3_column_int64(statement.get(), 0));
+    }
+    return ids;
+}
+
+// Terms for every field: plain substrings, substrings in other case and with
+// LIKE wildcards, and whole identifiers.
+struct Terms {
+    const char* name;
+    const char* part_number;
+    const char* nsn;
+    const char* serial_number;
+    int quantity;
+};
+
+constexpr Terms kTerms[] = {
+    {"o", "P-000", "-01-0", "SN-00", 12},
+    {"HEX%T", "p_00", "01_01", "sn-0001", 0},
+    {"\xC3\xB8" "12", "%2", "5305-01-1", "%0_", 49},
+    {"bolt", "=p 00012", "5305 01 012 0012", "=sn000012", 12},
+};
+
+inventory::SearchFilter MakeFilter(unsigned mask, const Terms& terms) {
+    inventory::SearchFilter filter;
+    if (mask & inventory::kFilterName) {
+        filter.name = terms.name;
+    }
+    if (mask & inventory::kFilterPartNumber) {
+        filter.part_number = terms.part_number;
+    }
+    if (mask & inventory::kFilterNsn) {
+        filter.nsn = terms.nsn;
+    }
+    if (mask & inventory::kFilterSerialNumber) {
+        filter.serial_number = terms.serial_number;
+    }
+    if (mask & inventory::kFilterQuantity) {
+        filter.has_quantity = true;
+        filter.quantity = terms.quantity;
+    }
+    return filter;
+}
+
+// Every filter shape with every set of terms gives the same ids, in the same
+// order, from the snapshot as from SQLite. Returns how many found anything.
+int CompareShapes(inventory::Database& database, const inventory::ItemSnapshot& snapshot) {
+    int found = 0;
+    std::vector<sqlite3_int64> ids;
+    for (const Terms& terms : kTerms) {
+        for (unsigned mask = 0; mask < inventory::kFilterShapeCount; ++mask) {
+            const inventory::SearchFilter filter = MakeFilter(mask, terms);
+            const std::vector<sqlite3_int64> expected = SqlSearch(database, filter);
+            snapshot.Search(filter, ids);
+            if (!CHECK(ids == expected)) {
+                std::fprintf(stderr, "  shape %u, name '%s': %zu ids, SQL %zu\n", mask,
+                             terms.name, ids.size(), expected.size());
+            }
+            found += expected.empty() ? 0 : 1;
+        }
+    }
+    return found;
+}
+
+TEST(SearchMatchesSql) {
+    inventory::Database database;
+    REQUIRE(OpenItems(database));
+    inventory::ItemSnapshot snapshot;
+    REQUIRE(snapshot.Load(database));
+    CHECK(snapshot.size() == kItems + 3);
+    // Most shapes find something, or the comparison proves little.
+    CHECK(CompareShapes(database, snapshot) >
+          static_cast<int>(inventory::kFilterShapeCount * 2));
+}
+
+// The same, with the rows split across threads however small the table.
+TEST(ParallelSearchMatchesSql) {
+    inventory::Database database;
+    REQUIRE(OpenItems(database));
+    inventory::SnapshotOptions options;
+    options.parallel_min_rows = 1;
+    options.threads = 5;
+    inventory::ItemSnapshot snapshot(options);
+    REQUIRE(snapshot.Load(database));
+    CompareShapes(database, snapshot);
+}
+
+// Rows written after the load and applied with Sync are found where SQLite
+// finds them: edited, deleted, and new rows sharing a created_at.
+TEST(SyncedSearchMatchesSql) {
+    inventory::Database database;
+    REQUIRE(OpenItems(database));
+    inventory::ItemSnapshot snapshot;
+    REQUIRE(snapshot.Load(database));
+
+    for (sqlite3_int64 id = 3; id <= kItems; id += 11) {
+        inventory::Item item;
+        REQUIRE(inventory::LoadItem(database, id, item));
+        item.name = id % 2 ? "Hex bolt M8" : "o-ring";
+        item.serial_number = "SN-00" + item.serial_number.substr(3);
+        REQUIRE(inventory::UpdateItem(database, item));
+        CHECK(snapshot.Sync(database, id));
+    }
+    for (sqlite3_int64 id = 5; id <= kItems; id += 13) {
+        REQUIRE(inventory::DeleteItem(database, id));
+        CHECK(snapshot.Sync(database, id));
+    }
+    // Updating an item that is gone changes nothing, and says so.
+    inventory::Item gone = TestItem(5);
+    gone.id = 5;
+    CHECK(!inventory::UpdateItem(database, gone));
+    for (int i = 0; i < 20; ++i) {
+        sqlite3_int64 id = 0;
+        REQUIRE(inventory::InsertItem(database, TestItem(kItems + i), &id));
+        const std::string tie =
+            "UPDATE items SET created_at = '2024-03-01 08:00:10.250' WHERE id = " +
+            std::to_string(id);
+        REQUIRE(database.Execute(tie.c_str()));
+        CHECK(snapshot.Sync(database, id));
+    }
+    const std::vector<sqlite3_int64> all = SqlSearch(database, inventory::SearchFilter());
+    CHECK(snapshot.size() == all.size());
+    CompareShapes(database, snapshot);
+}
+
+}  // namespace
+
+int main() {
+    return inventory::testing::RunTests();
+}
@@ -0,0 +1,257 @@
+#include <sqlite3.h>
+
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bulk_import.h"
+#include "change_journal.h"
+#include "database.h"
+#include "stock_ledger.h"
+#include "test_support.h"
+
+namespace {
+
+using inventory::testing::InsertTestItems;
+using inventory::testing::OpenMemory;
+using inventory::testing::QueryIds;
+using inventory::testing::TempDatabase;
+using inventory::testing::TestItem;
+
+std::vector<sqlite3_int64> Quantities(inventory::Database& database) {
+    return QueryIds(database, "SELECT quantity FROM items ORDER BY id");
+}
+
+// True when every item's quantity equals its checkpoint, if it has one,
+// plus the movements recorded after it.
+bool LedgerBalances(inventory::Database& database) {
+    return QueryIds(database,
+                    "SELECT items.id FROM items"
+                    " LEFT JOIN stock_checkpoints ON stock_checkpoints.item_id = items.id"
+                    " WHERE items.quantity <> COALESCE(stock_checkpoints.quantity, 0) +"
+                    " (SELECT COALESCE(SUM(delta), 0) FROM stock_movements WHERE"
+                    " item_id = items.id AND id > COALESCE(stock_checkpoints.through_id, 0))")
+        .empty();
+}
+
+// A batch with one bad delta changes nothing at all.
+TEST(BatchIsAllOrNothing) {
+    inventory::Database database;
+    REQUIRE(OpenMemory(database));
+    REQUIRE(InsertTestItems(database, 3));
+    const std::vector<sqlite3_int64> before = Quantities(database);
+    const std::vector<sqlite3_int64> movements =
+        QueryIds(database, "SELECT id FROM stock_movements");
+
+    CHECK(!inventory::ApplyStockDeltas(database, {{1, 5}, {2, -3}, {99, 1}}));
+    CHECK(!inventory::ApplyStockDeltas(database, {{1, 5}, {3, INT_MAX}}));
+    CHECK(Quantities(database) == before);
+    CHECK(QueryIds(database, "SELECT id FROM stock_movements") == movements);
+
+    REQUIRE(inventory::ApplyStockDeltas(database, {{1, 5}, {2, -3}, {1, 2}}));
+    const std::vector<sqlite3_int64> after = Quantities(database);
+    CHECK(after[0] == before[0] + 7);
+    CHECK(after[1] == before[1] - 3);
+    CHECK(after[2] == before[2]);
+    CHECK(LedgerBalances(database));
+}
+
+// Saved, imported, restored and redone items all start their ledger with
+// the quantity they are inserted with; a zero quantity records nothing.
+TEST(InsertsOpenTheLedger) {
+    inventory::Database database;
+    REQUIRE(OpenMemory(database));
+    REQUIRE(InsertTestItems(database, 3));
+    CHECK(QueryIds(database, "SELECT delta FROM stock_movements ORDER BY id") ==
+          std::vector<sqlite3_int64>({1, 2}));
+
+    TempDatabase manifest("inventory_test_opening.csv");
+    std::FILE* file = std::fopen(manifest.path().c_str(), "wb");
+    REQUIRE(file);
+    std::fputs("name,part_number,nsn,serial_number,quantity\n"
+               "Pump,P-9,5305-01-999-0001,SN-9001,40\n"
+               "Seal,P-8,5305-01-999-0002,SN-9002,0\n",
+               file);
+    REQUIRE(std::fclose(file) == 0);
+    inventory::ImportReport report;
+    REQUIRE(inventory::ImportManifest(database, manifest.path(), inventory::ImportOptions(),
+                                      report, nullptr));
+    CHECK(report.inserted == 2);
+    CHECK(LedgerBalances(database));
+    CHECK(QueryIds(database, "SELECT COUNT(*) FROM stock_movements") ==
+          std::vector<sqlite3_int64>({3}));
+
+    // Undoing a save drops the item whatever its quantity; redoing it, and
+    // undoing a delete, bring it back with a balanced ledger.
+    inventory::Item item = TestItem(7);
+    sqlite3_int64 id = 0;
+    inventory::ItemChange insert;
+    REQUIRE(inventory::RecordChange(
+        database, [&](inventory::Database& db) { return inventory::InsertItem(db, item, &id); },
+        insert));
+    REQUIRE(inventory::ApplyStockDeltas(database, {{id, 5}}));
+    inventory::ItemChange undo;
+    inventory::ItemChange redo;
+    REQUIRE(inventory::RevertChange(database, insert, undo));
+    CHECK(QueryIds(database, "SELECT id FROM items WHERE id = " + std::to_string(id)).empty());
+    REQUIRE(inventory::RevertChange(database, undo, redo));
+    CHECK(QueryIds(database, "SELECT quantity FROM items WHERE id = " + std::to_string(id)) ==
+          std::vector<sqlite3_int64>({12}));
+    CHECK(LedgerBalances(database));
+
+    inventory::ItemChange remove;
+    REQUIRE(inventory::RecordChange(
+        database, [&](inventory::Database& db) { return inventory::DeleteItem(db, 2); },
+        remove));
+    REQUIRE(inventory::RevertChange(database, remove, undo));
+    CHECK(QueryIds(database, "SELECT quantity FROM items WHERE id = 2") ==
+          std::vector<sqlite3_int64>({1}));
+    REQUIRE(inventory::ApplyStockDeltas(database, {{2, 3}}));
+    CHECK(LedgerBalances(database));
+}
+
+// Items stored before the opening movements existed get a checkpoint for
+// the quantity their movements do not account for.
+TEST(MigrationCheckpointsOpeningStock) {
+    inventory::Database database;
+    REQUIRE(OpenMemory(database));
+    REQUIRE(database.Execute("DROP TRIGGER stock_ledger_insert; PRAGMA user_version = 9;"));
+    REQUIRE(InsertTestItems(database, 4));
+    REQUIRE(inventory::ApplyStockDeltas(database, {{2, 10}, {3, -2}}));
+    REQUIRE(inventory::CompactStockMovements(database, -1));
+    REQUIRE(inventory::ApplyStockDeltas(database, {{3, 4}}));
+    REQUIRE(inventory::InsertItem(database, TestItem(5)));
+
+    REQUIRE(inventory::EnsureSchema(database));
+    CHECK(inventory::SchemaVersion(database) == inventory::kSchemaVersion);
+    CHECK(LedgerBalances(database));
+    REQUIRE(inventory::InsertItem(database, TestItem(6)));
+    CHECK(QueryIds(database, "SELECT delta FROM stock_movements WHERE item_id = 6") ==
+          std::vector<sqlite3_int64>({6}));
+    CHECK(LedgerBalances(database));
+}
+
+// Folding the ledger checkpoints a deleted item from its tombstone, so that
+// it still balances once its movements are gone and comes back with its
+// quantity when the delete is undone.
+TEST(CompactionCheckpointsTombstones) {
+    inventory::Database database;
+    REQUIRE(OpenMemory(database));
+    REQUIRE(InsertTestItems(database, 3));
+    REQUIRE(inventory::ApplyStockDeltas(database, {{2, 5}, {3, 4}, {3, -1}}));
+    inventory::ItemChange remove;
+    REQUIRE(inventory::RecordChange(
+        database, [&](inventory::Database& db) { return inventory::DeleteItem(db, 3); },
+        remove));
+
+    inventory::StockCompaction compaction;
+    REQUIRE(inventory::CompactStockMovements(database, -1, &compaction));
+    CHECK(compaction.movements == 5);
+    CHECK(compaction.items == 2);
+    CHECK(QueryIds(database, "SELECT COUNT(*) FROM stock_movements") ==
+          std::vector<sqlite3_int64>({0}));
+    CHECK(QueryIds(database, "SELECT quantity FROM stock_checkpoints ORDER BY item_id") ==
+          std::vector<sqlite3_int64>({6, 5}));
+    CHECK(LedgerBalances(database));
+
+    inventory::ItemChange undo;
+    REQUIRE(inventory::RevertChange(database, remove, undo));
+    CHECK(QueryIds(database, "SELECT quantity FROM items WHERE id = 3") ==
+          std::vector<sqlite3_int64>({5}));
+    CHECK(LedgerBalances(database));
+}
+
+// Many connections apply random deltas to a few hot items at once, while
+// one of them also compacts the ledger. No update may be lost: every item
+// ends at its starting quantity plus the sum of the deltas applied to it.
+TEST(ConcurrentDeltasLoseNoUpdates) {
+    constexpr int kItems = 16;
+    constexpr int kThreads = 8;
+    constexpr int kBatches = 60;
+    constexpr int kBatchSize = 25;
+    TempDatabase file("inventory_test_stock_stress.db");
+    std::vector<sqlite3_int64> seed;
+    {
+        inventory::Database database;
+        REQUIRE(database.Open(file.path()));
+        REQUIRE(database.Configure(inventory::StorageOptions()));
+        REQUIRE(inventory::EnsureSchema(database));
+        REQUIRE(InsertTestItems(database, kItems));
+        seed = Quantities(database);
+        REQUIRE(seed.size() == kItems);
+    }
+
+    std::vector<std::vector<long long>> applied(kThreads, std::vector<long long>(kItems, 0));
+    std::atomic<int> failures{0};
+    const auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kThreads; ++t) {
+        threads.emplace_back([&, t] {
+            inventory::Database database;
+            if (!database.Open(file.path()) ||
+                !database.Configure(inventory::StorageOptions())) {
+                failures.fetch_add(1);
+                return;
+            }
+            std::mt19937 random(static_cast<unsigned>(t + 1));
+            std::vector<inventory::StockDelta> deltas(kBatchSize);
+            for (int batch = 0; batch < kBatches; ++batch) {
+                for (inventory::StockDelta& delta : deltas) {
+                    delta.item_id = 1 + static_cast<sqlite3_int64>(random() % kItems);
+                    delta.delta = static_cast<int>(random() % 21) - 10;
+                }
+                bool ok = database.Execute("BEGIN IMMEDIATE") &&
+                          inventory::ApplyStockDeltas(database, deltas);
+                if (ok && t == 0 && batch % 10 == 9) {
+                    ok = inventory::CompactStockMovements(database, -1);
+                }
+                if (!ok || !database.Execute("COMMIT")) {
+                    database.Execute("ROLLBACK");
+                    failures.fetch_add(1);
+                    return;
+                }
+                for (const inventory::StockDelta& delta : deltas) {
+                    applied[static_cast<size_t>(t)][static_cast<size_t>(delta.item_id - 1)] +=
+                        delta.delta;
+                }
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    const double seconds =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    REQUIRE(failures.load() == 0);
+    std::printf("  %d deltas on %d threads, %.0f deltas/s\n",
+                kThreads * kBatches * kBatchSize, kThreads,
+                kThreads * kBatches * kBatchSize / seconds);
+
+    inventory::Database database;
+    REQUIRE(database.Open(file.path()));
+    const std::vector<sqlite3_int64> quantities = Quantities(database);
+    REQUIRE(quantities.size() == kItems);
+    for (size_t item = 0; item < kItems; ++item) {
+        long long expected = seed[item];
+        for (const std::vector<long long>& thread_applied : applied) {
+            expected += thread_applied[item];
+        }
+        if (!CHECK(quantities[item] == expected)) {
+            std::fprintf(stderr, "  item %zu: %lld, expected %lld\n", item + 1,
+                         static_cast<long long>(quantities[item]), expected);
+        }
+    }
+    CHECK(LedgerBalances(database));
+    CHECK(!QueryIds(database, "SELECT item_id FROM stock_checkpoints").empty());
+}
+
+}  // namespace
+
+int main() {
+    return inventory::testing::RunTests();
+}
@@ -0,0 +1,182 @@
+#include <sqlite3.h>
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "items.h"
+#include "storage_worker.h"
+#include "test_support.h"
+
+namespace {
+
+using inventory::testing::QueryIds;
+using inventory::testing::TempDatabase;
+using inventory::testing::TestItem;
+
+inventory::StorageOptions GroupOptions(int window_ms) {
+    inventory::StorageOptions options;
+    options.group_commit_window_ms = window_ms;
+    return options;
+}
+
+// Inserts TestItem(i); every |fail_every|th write then fails after its
+// insert, alternately with an SQLite error and without one.
+inventory::StorageWorker::Task InsertTask(int i, int fail_every) {
+    return [i, fail_every](inventory::Database& database) {
+        if (!inventory::InsertItem(database, TestItem(i))) {
+            return false;
+        }
+        if (fail_every == 0 || i % fail_every != fail_every - 1) {
+            return true;
+        }
+        if (i % 2 == 0) {
+            return false;
+        }
+        return database.Execute("INSERT INTO items (name) VALUES (NULL)");
+    };
+}
+
+bool ExpectedToFail(int i, int fail_every) {
+    return fail_every != 0 && i % fail_every == fail_every - 1;
+}
+
+// The numbers i of the stored TestItem(i), read back from their serial numbers.
+std::vector<sqlite3_int64> StoredItemNumbers(const std::string& path) {
+    inventory::Database database;
+    if (!database.Open(path)) {
+        return {};
+    }
+    return QueryIds(database,
+                    "SELECT CAST(substr(serial_number, 4) AS INTEGER) FROM items ORDER BY 1");
+}
+
+// Three writes queued well inside one commit window share one transaction;
+// the one in the middle fails, and only its own insert is rolled back.
+TEST(FailingWriteRollsBackOnlyItsSavepoint) {
+    TempDatabase file("inventory_test_storage_group.db");
+    inventory::StorageWorker worker;
+    REQUIRE(worker.Start(file.path(), GroupOptions(200)));
+
+    std::vector<int> results(4, -1);
+    std::mutex mutex;
+    auto record = [&](int slot) {
+        return [&, slot](bool ok) {
+            std::lock_guard<std::mutex> lock(mutex);
+            results[static_cast<size_t>(slot)] = ok ? 1 : 0;
+        };
+    };
+    worker.PostWrite(InsertTask(0, 0), record(0));
+    worker.PostWrite(
+        [](inventory::Database& database) {
+            return inventory::InsertItem(database, TestItem(1)) &&
+                   database.Execute("INSERT INTO items (name) VALUES (NULL)");
+        },
+        record(1));
+    worker.PostWrite(InsertTask(2, 0), record(2));
+    // A query ends the group and sees every write queued before it.
+    sqlite3_int64 count = -1;
+    worker.PostQuery(
+        [&count](inventory::Database& database) {
+            std::vector<sqlite3_int64> rows = QueryIds(database, "SELECT COUNT(*) FROM items");
+            count = rows.empty() ? -1 : rows[0];
+            return true;
+        },
+        record(3));
+    worker.Stop();
+
+    CHECK(results == std::vector<int>({1, 0, 1, 1}));
+    CHECK(count == 2);
+    const inventory::StorageStats stats = worker.stats();
+    CHECK(stats.writes == 3);
+    CHECK(stats.failed_writes == 1);
+    CHECK(stats.commits == 1);
+    CHECK(stats.queries == 1);
+    CHECK(worker.last_error().find("NOT NULL") != std::string::npos);
+    CHECK(StoredItemNumbers(file.path()) == std::vector<sqlite3_int64>({0, 2}));
+}
+
+// Many threads queue writes as fast as they can, some of which fail, and
+// stop the worker straight after: every write completes exactly once, the
+// failures leave nothing behind, and the writes share transactions.
+TEST(GroupCommitStress) {
+    constexpr int kThreads = 8;
+    constexpr int kWritesPerThread = 500;
+    constexpr int kFailEvery = 7;
+    TempDatabase file("inventory_test_storage_stress.db");
+    inventory::StorageWorker worker;
+    REQUIRE(worker.Start(file.path(), GroupOptions(2)));
+
+    std::vector<std::atomic<int>> completions(kThreads * kWritesPerThread);
+    std::atomic<int> wrong_result{0};
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kThreads; ++t) {
+        threads.emplace_back([&, t] {
+            for (int n = 0; n < kWritesPerThread; ++n) {
+                const int i = t * kWritesPerThread + n;
+                worker.PostWrite(InsertTask(i, kFailEvery), [&, i](bool ok) {
+                    completions[static_cast<size_t>(i)].fetch_add(1);
+                    if (ok == ExpectedToFail(i, kFailEvery)) {
+                        wrong_result.fetch_add(1);
+                    }
+                });
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    worker.Stop();
+
+    const int total = kThreads * kWritesPerThread;
+    CHECK(std::all_of(completions.begin(), completions.end(),
+                      [](const std::atomic<int>& count) { return count.load() == 1; }));
+    CHECK(wrong_result.load() == 0);
+
+    std::vector<sqlite3_int64> expected;
+    for (int i = 0; i < total; ++i) {
+        if (!ExpectedToFail(i, kFailEvery)) {
+            expected.push_back(i);
+        }
+    }
+    const inventory::StorageStats stats = worker.stats();
+    CHECK(stats.writes == static_cast<uint64_t>(total));
+    CHECK(stats.failed_writes == static_cast<uint64_t>(total) - expected.size());
+    CHECK(stats.commits > 0 && stats.commits < static_cast<uint64_t>(total));
+    CHECK(StoredItemNumbers(file.path()) == expected);
+}
+
+// A write whose transaction cannot even begin still completes, as a failure.
+TEST(WritesCompleteWhenTheTransactionFails) {
+    TempDatabase file("inventory_test_storage_busy.db");
+    inventory::StorageOptions options = GroupOptions(2);
+    options.busy_timeout_ms = 0;
+    inventory::StorageWorker worker;
+    REQUIRE(worker.Start(file.path(), options));
+
+    inventory::Database other;
+    REQUIRE(other.Open(file.path()));
+    REQUIRE(other.Execute("BEGIN IMMEDIATE"));
+    std::atomic<int> failed{0};
+    for (int i = 0; i < 20; ++i) {
+        worker.PostWrite(InsertTask(i, 0), [&failed](bool ok) {
+            failed.fetch_add(ok ? 0 : 1);
+        });
+    }
+    worker.Stop();
+    other.Execute("ROLLBACK");
+
+    CHECK(failed.load() == 20);
+    CHECK(worker.stats().failed_writes == 20);
+    CHECK(!worker.last_error().empty());
+    CHECK(StoredItemNumbers(file.path()).empty());
+}
+
+}  // namespace
+
+int main() {
+    return inventory::testing::RunTests();
+}
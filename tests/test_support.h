@@ -0,0 +1,153 @@
+#pragma once
+
+#include <sqlite3.h>
+
+#include <cstdio>
+#include <filesystem>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include "database.h"
+#include "items.h"
+#include "schema.h"
+
+// A small harness for the ctest executables, so that the tests need nothing
+// beyond the core library and SQLite. TEST registers a function, CHECK
+// reports a failed condition and carries on, REQUIRE also leaves the test,
+// and RunTests runs every test in the order they were defined.
+namespace inventory::testing {
+
+struct TestCase {
+    const char* name;
+    void (*run)();
+};
+
+inline std::vector<TestCase>& Registry() {
+    static std::vector<TestCase> tests;
+    return tests;
+}
+
+inline int& Failures() {
+    static int failures = 0;
+    return failures;
+}
+
+struct Registrar {
+    Registrar(const char* name, void (*run)()) { Registry().push_back({name, run}); }
+};
+
+inline bool Check(bool ok, const char* condition, const char* file, int line) {
+    if (!ok) {
+        ++Failures();
+        std::fprintf(stderr, "%s:%d: check failed: %s\n", file, line, condition);
+    }
+    return ok;
+}
+
+// Returns the process exit code: 0 when every check passed.
+inline int RunTests() {
+    int failed_tests = 0;
+    for (const TestCase& test : Registry()) {
+        const int before = Failures();
+        test.run();
+        const bool passed = Failures() == before;
+        std::printf("%-6s %s\n", passed ? "ok" : "FAILED", test.name);
+        failed_tests += passed ? 0 : 1;
+    }
+    std::printf("%zu tests, %d failed\n", Registry().size(), failed_tests);
+    return failed_tests == 0 ? 0 : 1;
+}
+
+// A migrated in-memory database.
+inline bool OpenMemory(Database& database) {
+    return database.Open(":memory:") && EnsureSchema(database);
+}
+
+// Deterministic item |i|. Names repeat every eight items, every other value
+// is unique.
+inline Item TestItem(int i) {
+    static const char* const kNames[] = {"Hex bolt",     "Lock washer", "Hydraulic pump",
+                                         "O-ring seal",  "Gasket",      "Relay 24 V",
+                                         "Bearing assy", "Ventil 12 mm"};
+    char part[32];
+    char nsn[32];
+    char serial[32];
+    std::snprintf(part, sizeof(part), "P-%05d", i);
+    std::snprintf(nsn, sizeof(nsn), "5305-01-%03d-%04d", i % 1000, i % 10000);
+    std::snprintf(serial, sizeof(serial), "SN-%06d", i);
+    Item item;
+    item.name = kNames[i % 8];
+    item.part_number = part;
+    item.nsn = nsn;
+    item.serial_number = serial;
+    item.quantity = i % 50;
+    return item;
+}
+
+// Inserts TestItem(0) to TestItem(count - 1) in one transaction.
+inline bool InsertTestItems(Database& database, int count) {
+    if (!database.Execute("BEGIN")) {
+        return false;
+    }
+    for (int i = 0; i < count; ++i) {
+        if (!InsertItem(database, TestItem(i))) {
+            database.Execute("ROLLBACK");
+            return false;
+        }
+    }
+    return database.Execute("COMMIT");
+}
+
+// The integer in the first column of every row of |sql|.
+inline std::vector<sqlite3_int64> QueryIds(Database& database, const std::string& sql) {
+    std::vector<sqlite3_int64> ids;
+    Statement statement = database.Prepare(sql);
+    while (statement && sqlite3_step(statement.get()) == SQLITE_ROW) {
+        ids.push_back(sqlite3_column_int64(statement.get(), 0));
+    }
+    return ids;
+}
+
+// A database file in the temporary directory, removed together with its
+// -wal and -shm files before and after the test.
+class TempDatabase {
+public:
+    explicit TempDatabase(const char* name)
+        : path_((std::filesystem::temp_directory_path() / name).string()) {
+        Remove();
+    }
+    ~TempDatabase() { Remove(); }
+
+    TempDatabase(const TempDatabase&) = delete;
+    TempDatabase& operator=(const TempDatabase&) = delete;
+
+    const std::string& path() const { return path_; }
+
+private:
+    void Remove() {
+        std::error_code ignored;
+        for (const char* suffix : {"", "-wal", "-shm", "-journal"}) {
+            std::filesystem::remove(path_ + suffix, ignored);
+        }
+    }
+
+    std::string path_;
+};
+
+}  // namespace inventory::testing
+
+#define TEST(name)                                                              \
+    static void name();                                                         \
+    static const ::inventory::testing::Registrar name##_registrar(#name, name); \
+    static void name()
+
+#define CHECK(condition) \
+    ::inventory::testing::Check(static_cast<bool>(condition), #condition, __FILE__, __LINE__)
+
+#define REQUIRE(condition)       \
+    do {                         \
+        if (!CHECK(condition)) { \
+            return;              \
+        }                        \
+    } while (0)
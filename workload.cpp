@@ -0,0 +1,389 @@
+#include "workload.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <future>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "data_generator.h"
+#include "items.h"
+#include "row_cache.h"
+#include "schema.h"
+#include "search_filter.h"
+#include "snapshot.h"
+#include "stock_ledger.h"
+#include "storage_worker.h"
+
+namespace inventory {
+namespace {
+
+constexpr const char* kOperationNames[] = {"search", "scroll", "save", "update", "delete"};
+static_assert(sizeof(kOperationNames) / sizeof(kOperationNames[0]) == kWorkloadOperationCount,
+              "every workload operation needs a name");
+
+// The window's state, minus the window.
+class Session {
+public:
+    explicit Session(const WorkloadOptions& options)
+        : options_(options), random_(options.seed), generator_(SaveOptions(options)) {}
+
+    bool Open(const std::string& path, const StorageOptions& storage, WorkloadReport& report) {
+        if (!storage_.Start(path, storage) || !database_.Open(path) ||
+            !database_.Configure(storage)) {
+            report.fatal_error = "cannot open " + path;
+            return false;
+        }
+        mode_ = TrigramIndexAvailable(database_) ? SearchMode::kTrigramIndex : SearchMode::kScan;
+        report.search_path = mode_ == SearchMode::kTrigramIndex ? "trigram" : "scan";
+        if (options_.use_snapshot && snapshot_.Load(database_)) {
+            report.search_path = "snapshot";
+        }
+        Statement range = database_.Prepare("SELECT MIN(id), MAX(id), COUNT(*) FROM items");
+        if (!range || sqlite3_step(range.get()) != SQLITE_ROW) {
+            report.fatal_error = sqlite3_errmsg(database_.handle());
+            return false;
+        }
+        min_id_ = sqlite3_column_int64(range.get(), 0);
+        max_id_ = sqlite3_column_int64(range.get(), 1);
+        report.start_rows = static_cast<uint64_t>(sqlite3_column_int64(range.get(), 2));
+        filter_.mode = mode_;
+        return Refresh();
+    }
+
+    void Close() {
+        storage_.Stop();
+        rows_.Clear();
+        snapshot_.Clear();
+        database_.Close();
+    }
+
+    WorkloadOperation Pick() {
+        unsigned total = 0;
+        for (unsigned weight : options_.mix) {
+            total += weight;
+        }
+        unsigned ticket = static_cast<unsigned>(random_.Below(std::max(total, 1u)));
+        for (int operation = 0; operation < kWorkloadOperationCount; ++operation) {
+            if (ticket < options_.mix[operation]) {
+                return static_cast<WorkloadOperation>(operation);
+            }
+            ticket -= options_.mix[operation];
+        }
+        return kWorkloadSearch;
+    }
+
+    bool Run(WorkloadOperation operation) {
+        switch (operation) {
+            case kWorkloadSearch:
+                return Search();
+            case kWorkloadScroll:
+                return Scroll();
+            case kWorkloadSave:
+                return Save();
+            case kWorkloadUpdate:
+                return Update();
+            case kWorkloadDelete:
+                return Delete();
+            default:
+                return false;
+        }
+    }
+
+private:
+    static GeneratorOptions SaveOptions(const WorkloadOptions& options) {
+        GeneratorOptions generator;
+        generator.seed = options.seed ^ 0x5A5A5A5A5A5A5A5Aull;
+        generator.rows = std::max<uint64_t>(options.operations, 1000);
+        return generator;
+    }
+
+    // RefreshResults, then the list view asking for the first screen.
+    bool Refresh() {
+        if (snapshot_.loaded() && !filter_.ExactMask()) {
+            std::vector<sqlite3_int64> ids;
+            snapshot_.Search(filter_, ids);
+            rows_.ResetWithIds(database_, std::move(ids));
+        } else if (!rows_.Reset(database_, filter_)) {
+            return false;
+        }
+        return Show(0);
+    }
+
+    bool Show(sqlite3_int64 first) {
+        const sqlite3_int64 last =
+            std::min<sqlite3_int64>(first + options_.visible_rows, rows_.total_count()) - 1;
+        rows_.Prefetch(first, last);
+        for (sqlite3_int64 index = first; index <= last; ++index) {
+            if (!rows_.Row(index)) {
+                // Rows deleted after a snapshot search are shown blank.
+                if (!snapshot_.loaded()) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    // A row picked uniformly by id; false only when the table is empty.
+    bool SampleItem(Item& item) {
+        if (max_id_ < min_id_ || max_id_ <= 0) {
+            return false;
+        }
+        for (int attempt = 0; attempt < 2; ++attempt) {
+            const sqlite3_int64 from =
+                attempt == 0 ? min_id_ + static_cast<sqlite3_int64>(random_.Below(
+                                             static_cast<uint64_t>(max_id_ - min_id_ + 1)))
+                             : min_id_;
+            Statement statement =
+                database_.Prepare("SELECT id FROM items WHERE id >= ? ORDER BY id LIMIT 1");
+            if (!statement) {
+                return false;
+            }
+            sqlite3_bind_int64(statement.get(), 1, from);
+            if (sqlite3_step(statement.get()) == SQLITE_ROW) {
+                const sqlite3_int64 id = sqlite3_column_int64(statement.get(), 0);
+                statement.Release();
+                return LoadItem(database_, id, item);
+            }
+        }
+        return false;
+    }
+
+    // At least the three characters a trigram lookup needs, up to all of it.
+    size_t TypedLength(const std::string& text) {
+        return text.size() <= 3 ? text.size() : 3 + random_.Below(text.size() - 2);
+    }
+
+    // What a clerk would type to find |item|: part of a word of its name, the
+    // start of its part number, its NSN or the last group of it, its serial
+    // number, or a name word with the quantity.
+    void TermsFor(const Item& item, SearchFilter& filter) {
+        filter = SearchFilter();
+        filter.mode = mode_;
+        const uint64_t field = random_.Below(100);
+        if (field < 40 || field >= 95) {
+            std::vector<std::string> words;
+            std::string word;
+            for (char c : item.name + " ") {
+                if (c == ' ' || c == ',') {
+                    if (word.size() >= 3) {
+                        words.push_back(word);
+                    }
+                    word.clear();
+                } else {
+                    word += c;
+                }
+            }
+            if (words.empty()) {
+                words.push_back(item.name);
+            }
+            const std::string& chosen = words[random_.Below(words.size())];
+            filter.name = chosen.substr(0, TypedLength(chosen));
+            if (field >= 95) {
+                filter.has_quantity = true;
+                filter.quantity = item.quantity;
+            }
+        } else if (field < 60) {
+            filter.part_number = item.part_number.substr(0, TypedLength(item.part_number));
+        } else if (field < 80) {
+            const bool whole = random_.Below(2) == 0;
+            filter.nsn = whole || item.nsn.size() < 4 ? item.nsn
+                                                      : item.nsn.substr(item.nsn.size() - 4);
+        } else {
+            filter.serial_number = item.serial_number;
+        }
+    }
+
+    bool Search() {
+        Item item;
+        if (!SampleItem(item)) {
+            filter_ = SearchFilter();
+            filter_.mode = mode_;
+        } else {
+            TermsFor(item, filter_);
+        }
+        return Refresh();
+    }
+
+    bool Scroll() {
+        const sqlite3_int64 total = rows_.total_count();
+        if (total <= options_.visible_rows) {
+            return Show(0);
+        }
+        const auto first = static_cast<sqlite3_int64>(
+            random_.Below(static_cast<uint64_t>(total - options_.visible_rows + 1)));
+        return Show(first);
+    }
+
+    // Posts |task| like the window and waits for its completion; then the
+    // window's OnStorageDone.
+    bool Write(StorageWorker::Task task, const std::shared_ptr<sqlite3_int64>& id) {
+        std::promise<bool> done;
+        std::future<bool> result = done.get_future();
+        storage_.PostWrite(std::move(task), [&done](bool ok) { done.set_value(ok); });
+        if (!result.get()) {
+            return false;
+        }
+        if (snapshot_.loaded() && !snapshot_.Sync(database_, *id)) {
+            snapshot_.Clear();
+        }
+        filter_ = SearchFilter();
+        filter_.mode = mode_;
+        return Refresh();
+    }
+
+    bool Save() {
+        Item item;
+        generator_.Next(item);
+        auto id = std::make_shared<sqlite3_int64>(0);
+        if (!Write([item, id](Database& database) { return InsertItem(database, item, id.get()); },
+                   id)) {
+            return false;
+        }
+        max_id_ = std::max(max_id_, *id);
+        min_id_ = min_id_ > 0 ? min_id_ : *id;
+        return true;
+    }
+
+    bool Update() {
+        Item item;
+        if (!SampleItem(item)) {
+            return Save();
+        }
+        // The quantity edit changed by a few units; the text fields as shown.
+        const int delta = static_cast<int>(random_.Below(11)) - 5;
+        const std::vector<StockDelta> deltas = {{item.id, delta}};
+        auto id = std::make_shared<sqlite3_int64>(item.id);
+        return Write(
+            [item, deltas](Database& database) {
+                return UpdateItem(database, item) &&
+                       (deltas[0].delta == 0 || ApplyStockDeltas(database, deltas));
+            },
+            id);
+    }
+
+    bool Delete() {
+        Item item;
+        if (!SampleItem(item)) {
+            return Save();
+        }
+        auto id = std::make_shared<sqlite3_int64>(item.id);
+        return Write([id](Database& database) { return DeleteItem(database, *id); }, id);
+    }
+
+    WorkloadOptions options_;
+    Random random_;
+    ItemGenerator generator_;
+    StorageWorker storage_;
+    Database database_;
+    RowCache rows_;
+    ItemSnapshot snapshot_;
+    SearchMode mode_ = SearchMode::kScan;
+    SearchFilter filter_;
+    sqlite3_int64 min_id_ = 0;
+    sqlite3_int64 max_id_ = 0;
+};
+
+void AppendLatency(const char* name, uint64_t failures, double seconds,
+                   const HistogramSnapshot& latency, bool last, std::string& out) {
+    char text[512];
+    std::snprintf(text, sizeof(text),
+                  "    \"%s\": {\"count\": %" PRIu64 ", \"failed\": %" PRIu64
+                  ", \"ops_per_second\": %.1f, \"mean_us\": %.1f, \"p50_us\": %.1f"
+                  ", \"p90_us\": %.1f, \"p99_us\": %.1f, \"max_us\": %.1f}%s\n",
+                  name, latency.count, failures, seconds > 0.0 ? latency.count / seconds : 0.0,
+                  latency.MeanNs() / 1e3, latency.Percentile(0.50) / 1e3,
+                  latency.Percentile(0.90) / 1e3, latency.Percentile(0.99) / 1e3,
+                  latency.max_ns / 1e3, last ? "" : ",");
+    out += text;
+}
+
+}  // namespace
+
+bool RunWorkload(const std::string& path, const StorageOptions& storage,
+                 const WorkloadOptions& options, WorkloadReport& report) {
+    report = WorkloadReport();
+    report.seed = options.seed;
+    Session session(options);
+    if (!session.Open(path, storage, report)) {
+        session.Close();
+        return false;
+    }
+
+    std::atomic<bool> finished{false};
+    std::thread backup_thread;
+    if (!options.backup_path.empty()) {
+        backup_thread = std::thread([&] {
+            const BackupProgress progress = [&finished](int, int) { return !finished.load(); };
+            BackupReport backup;
+            while (BackupDatabase(path, options.backup_path, options.backup, backup, progress)) {
+                ++report.backups;
+                report.backup_bytes += backup.bytes;
+                report.backup_seconds += backup.seconds;
+            }
+            if (!backup.cancelled) {
+                report.backup_error = backup.fatal_error;
+            }
+        });
+    }
+
+    LatencyHistogram latency[kWorkloadOperationCount];
+    const auto start = std::chrono::steady_clock::now();
+    for (uint64_t i = 0; i < options.operations; ++i) {
+        const WorkloadOperation operation = session.Pick();
+        const auto began = std::chrono::steady_clock::now();
+        const bool ok = session.Run(operation);
+        latency[operation].Record(ScopedLatency::ElapsedNs(began));
+        ++report.operations;
+        if (!ok) {
+            ++report.failed;
+            ++report.failures[operation];
+        }
+    }
+    report.seconds =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    finished.store(true);
+    if (backup_thread.joinable()) {
+        backup_thread.join();
+    }
+    for (int operation = 0; operation < kWorkloadOperationCount; ++operation) {
+        report.latency[operation] = latency[operation].Snapshot();
+    }
+    session.Close();
+    return true;
+}
+
+void FormatWorkloadJson(const WorkloadReport& report, std::string& out) {
+    char text[512];
+    std::snprintf(text, sizeof(text),
+                  "{\n  \"seed\": %" PRIu64 ",\n  \"start_rows\": %" PRIu64
+                  ",\n  \"search_path\": \"%s\",\n  \"operations\": %" PRIu64
+                  ",\n  \"failed\": %" PRIu64
+                  ",\n  \"seconds\": %.3f,\n  \"ops_per_second\": %.1f,\n  \"latency\": {\n",
+                  report.seed, report.start_rows, report.search_path, report.operations,
+                  report.failed, report.seconds, report.OperationsPerSecond());
+    out += text;
+    for (int operation = 0; operation < kWorkloadOperationCount; ++operation) {
+        AppendLatency(kOperationNames[operation], report.failures[operation], report.seconds,
+                      report.latency[operation], operation + 1 == kWorkloadOperationCount, out);
+    }
+    out += "  }";
+    if (report.backups > 0 || !report.backup_error.empty()) {
+        const double seconds = report.backup_seconds;
+        std::snprintf(text, sizeof(text),
+                      ",\n  \"backup\": {\"count\": %" PRIu64 ", \"mb\": %.1f"
+                      ", \"seconds\": %.3f, \"mb_per_second\": %.1f, \"failed\": %s}",
+                      report.backups, report.backup_bytes / 1e6, seconds,
+                      seconds > 0.0 ? report.backup_bytes / seconds / 1e6 : 0.0,
+                      report.backup_error.empty() ? "false" : "true");
+        out += text;
+    }
+    out += "\n}\n";
+}
+
+}  // namespace inventory
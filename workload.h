@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "backup.h"
+#include "database.h"
+#include "metrics.h"
+
+namespace inventory {
+
+enum WorkloadOperation {
+    // Search button: count the matches and show the first screen.
+    kWorkloadSearch,
+    // Jump to a random place in the current result and show that screen.
+    kWorkloadScroll,
+    // Save, Update and Delete wait for the write, then refresh the list with
+    // the cleared search fields, as the window does.
+    kWorkloadSave,
+    kWorkloadUpdate,
+    kWorkloadDelete,
+    kWorkloadOperationCount,
+};
+
+struct WorkloadOptions {
+    uint64_t seed = 1;
+    uint64_t operations = 2000;
+    // Relative weights in WorkloadOperation order; mostly lookups, as at a
+    // stock counter.
+    unsigned mix[kWorkloadOperationCount] = {40, 30, 10, 15, 5};
+    // List view rows on screen; a search or scroll reads this many.
+    int visible_rows = 40;
+    // Search an ItemSnapshot when the table fits in one, like the window.
+    bool use_snapshot = true;
+    // When set, the database is backed up here over and over while the
+    // actions run, to show what an online backup costs the window.
+    std::string backup_path;
+    BackupOptions backup;
+};
+
+struct WorkloadReport {
+    uint64_t seed = 0;
+    uint64_t start_rows = 0;
+    // "snapshot", "trigram" or "scan".
+    const char* search_path = "scan";
+    uint64_t operations = 0;
+    uint64_t failed = 0;
+    double seconds = 0.0;
+    uint64_t failures[kWorkloadOperationCount] = {};
+    HistogramSnapshot latency[kWorkloadOperationCount];
+    // The backups that completed during the run; one still running at the
+    // end is cancelled and not counted.
+    uint64_t backups = 0;
+    uint64_t backup_bytes = 0;
+    double backup_seconds = 0.0;
+    std::string backup_error;
+    std::string fatal_error;
+
+    double OperationsPerSecond() const { return seconds > 0.0 ? operations / seconds : 0.0; }
+};
+
+// Replays a seeded sequence of the window's actions against the database at
+// |path|, through the same code: searches and scrolling go through RowCache
+// (or the snapshot) on one connection, writes through a StorageWorker, and
+// each action waits for the previous one, as on the UI thread. Search terms
+// are taken from rows sampled out of the table, so they match what is
+// actually stored. The same seed on the same database replays the same
+// actions.
+bool RunWorkload(const std::string& path, const StorageOptions& storage,
+                 const WorkloadOptions& options, WorkloadReport& report);
+
+// One JSON object with the totals and, per action, the count, failures,
+// throughput and the mean, p50, p90, p99 and max latency in microseconds;
+// with a backup path, also the backups' count and throughput.
+void FormatWorkloadJson(const WorkloadReport& report, std::string& out);
+
+}  // namespace inventory